@@ -9,21 +9,91 @@
 
 extern MPI_HANDLE g_mpiHandle;
 
+static const char* g_mpiSocket = "/run/osconfig/mpid.sock";
+
+static const char g_componentNameKey[] = "ComponentName";
+static const char g_objectNameKey[] = "ObjectName";
+static const char g_payloadKey[] = "Payload";
+static const char g_statusKey[] = "Status";
+
+// The connection to the MPI server is kept open and reused across calls for as long as the server keeps it alive
+static int g_mpiSocketHandle = -1;
+static SOCKET_BUFFER g_mpiSocketBuffer = {0};
+
+static void CloseMpiConnection(void)
+{
+    if (0 <= g_mpiSocketHandle)
+    {
+        close(g_mpiSocketHandle);
+        g_mpiSocketHandle = -1;
+    }
+
+    InitializeSocketBuffer(&g_mpiSocketBuffer, -1);
+}
+
+// A kept-alive connection the server has since closed reads as end of stream (or fails) without blocking
+static bool IsMpiConnectionAlive(void)
+{
+    char next = 0;
+    ssize_t bytes = 0;
+
+    // Unread bytes left from a previous response mean the stream is out of step, do not reuse it
+    if ((0 > g_mpiSocketHandle) || (false == IsSocketBufferEmpty(&g_mpiSocketBuffer)))
+    {
+        return false;
+    }
+
+    bytes = recv(g_mpiSocketHandle, &next, sizeof(next), MSG_PEEK | MSG_DONTWAIT);
+    return (0 > bytes) && ((EAGAIN == errno) || (EWOULDBLOCK == errno));
+}
+
+static int OpenMpiConnection(const char* name)
+{
+    struct sockaddr_un socketAddress = {0};
+    socklen_t socketLength = 0;
+    int status = MPI_OK;
+
+    CloseMpiConnection();
+
+    g_mpiSocketHandle = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (0 > g_mpiSocketHandle)
+    {
+        status = errno ? errno : EIO;
+        OsConfigLogError(GetLog(), "CallMpi(%s): failed to open socket '%s' (%d)", name, g_mpiSocket, status);
+        return status;
+    }
+
+    memset(&socketAddress, 0, sizeof(socketAddress));
+    socketAddress.sun_family = AF_UNIX;
+    strncpy(socketAddress.sun_path, g_mpiSocket, sizeof(socketAddress.sun_path) - 1);
+    socketLength = sizeof(socketAddress);
+
+    if (0 != connect(g_mpiSocketHandle, (struct sockaddr*)&socketAddress, socketLength))
+    {
+        status = errno ? errno : EIO;
+        OsConfigLogError(GetLog(), "CallMpi(%s): failed to connect to socket '%s' (%d)", name, g_mpiSocket, status);
+        CloseMpiConnection();
+    }
+    else
+    {
+        InitializeSocketBuffer(&g_mpiSocketBuffer, g_mpiSocketHandle);
+    }
+
+    return status;
+}
+
 static int CallMpi(const char* name, const char* request, char** response, int* responseSize)
 {
-    const char* mpiSocket = "/run/osconfig/mpid.sock";
-    const char* dataFormat = "POST /%s/ HTTP/1.1\r\nHost: OSConfig\r\nUser-Agent: OSConfig\r\nAccept: */*\r\nContent-Type: application/json\r\nContent-Length: %d\r\n\r\n%s";
+    const char* dataFormat = "POST /%s/ HTTP/1.1\r\nHost: OSConfig\r\nUser-Agent: OSConfig\r\nAccept: */*\r\nConnection: keep-alive\r\nContent-Type: application/json\r\nContent-Length: %d\r\n\r\n%s";
     
-    int socketHandle = -1;
     char* data = {0};
     int estimatedDataSize = 0;
     int actualDataSize = 0;
     char contentLengthString[MPI_MAX_CONTENT_LENGTH] = {0};
-    struct sockaddr_un socketAddress = {0};
-    socklen_t socketLength = 0;
     ssize_t bytes = 0;
     int status = MPI_OK;
-    int httpStatus = -1;
+    HTTP_HEADER header = {0};
+    bool reused = false;
 
     if ((NULL == name) || (NULL == request) || (NULL == response) || (NULL == responseSize))
     {
@@ -47,53 +117,40 @@ static int CallMpi(const char* name, const char* request, char** response, int*
     }
 
     memset(data, 0, estimatedDataSize);
+    snprintf(data, estimatedDataSize, dataFormat, name, (int)strlen(request), request);
+    actualDataSize = (int)strlen(data);
 
-    socketHandle = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (0 > socketHandle)
-    {
-        status = errno ? errno : EIO;
-        OsConfigLogError(GetLog(), "CallMpi(%s): failed to open socket '%s' (%d)", name, mpiSocket, status);
-    }
-    else
+    if (!(reused = IsMpiConnectionAlive()))
     {
-        memset(&socketAddress, 0, sizeof(socketAddress));
-        socketAddress.sun_family = AF_UNIX;
-        strncpy(socketAddress.sun_path, mpiSocket, sizeof(socketAddress.sun_path) - 1);
-        socketLength = sizeof(socketAddress);
+        status = OpenMpiConnection(name);
     }
 
     if (MPI_OK == status)
     {
-        if (0 == connect(socketHandle, (struct sockaddr*)&socketAddress, socketLength))
+        // MSG_NOSIGNAL: a server that went away must fail the call, not terminate the agent with SIGPIPE
+        bytes = send(g_mpiSocketHandle, data, actualDataSize, MSG_NOSIGNAL);
+        
+        // The server may close a kept-alive connection at any time, when that happens resend once on a fresh connection
+        if ((bytes != actualDataSize) && reused && (MPI_OK == (status = OpenMpiConnection(name))))
         {
-            snprintf(data, estimatedDataSize, dataFormat, name, strlen(request), request);
-            actualDataSize = (int)strlen(data);
-        }
-        else
-        {
-            status = errno ? errno : EIO;
-            OsConfigLogError(GetLog(), "CallMpi(%s): failed to connect to socket '%s' (%d)", name, mpiSocket, status);
+            bytes = send(g_mpiSocketHandle, data, actualDataSize, MSG_NOSIGNAL);
         }
-    }
 
-    if (MPI_OK == status)
-    {
-        bytes = send(socketHandle, data, actualDataSize, 0);
-        if (bytes != actualDataSize)
+        if ((MPI_OK == status) && (bytes != actualDataSize))
         {
             status = errno ? errno : EIO;
             if (IsFullLoggingEnabled())
             {
-                OsConfigLogError(GetLog(), "CallMpi(%s): failed to send request '%s' (%d bytes) to socket '%s' (%d)", name, data, actualDataSize, mpiSocket, status);
+                OsConfigLogError(GetLog(), "CallMpi(%s): failed to send request '%s' (%d bytes) to socket '%s' (%d)", name, data, actualDataSize, g_mpiSocket, status);
             }
             else
             {
-                OsConfigLogError(GetLog(), "CallMpi(%s): failed to send request to socket '%s' of %d bytes (%d)", name, mpiSocket, actualDataSize, status);
+                OsConfigLogError(GetLog(), "CallMpi(%s): failed to send request to socket '%s' of %d bytes (%d)", name, g_mpiSocket, actualDataSize, status);
             }
         }
-        else if (IsFullLoggingEnabled())
+        else if ((MPI_OK == status) && IsFullLoggingEnabled())
         {
-            OsConfigLogInfo(GetLog(), "CallMpi(%s): sent to '%s' '%s' (%d bytes)", name, mpiSocket, data, actualDataSize);
+            OsConfigLogInfo(GetLog(), "CallMpi(%s): sent to '%s' '%s' (%d bytes)", name, g_mpiSocket, data, actualDataSize);
         }
     }
 
@@ -101,22 +158,28 @@ static int CallMpi(const char* name, const char* request, char** response, int*
 
     if (MPI_OK == status)
     {
-        httpStatus = ReadHttpStatusFromSocket(socketHandle, GetLog());
-        status = (200 == httpStatus) ? MPI_OK : httpStatus;
+        if (0 == (status = ReadHttpHeaderFromSocketBuffer(&g_mpiSocketBuffer, &header, GetLog())))
+        {
+            status = (200 == header.status) ? MPI_OK : header.status;
+        }
+        else
+        {
+            OsConfigLogError(GetLog(), "CallMpi(%s): failed to read response header from socket '%s' (%d)", name, g_mpiSocket, status);
+        }
     }
 
     if (MPI_OK == status)
     {
-        *responseSize = ReadHttpContentLengthFromSocket(socketHandle, GetLog());
+        *responseSize = header.contentLength;
         *response = (char*)malloc(*responseSize + 1);
         if (NULL != *response)
         {
             memset(*response, 0, *responseSize + 1);
             
-            if (*responseSize != read(socketHandle, *response, *responseSize))
+            if (*responseSize != ReadHttpBodyFromSocketBuffer(&g_mpiSocketBuffer, *response, *responseSize, GetLog()))
             {
                 status = errno ? errno : EIO;
-                OsConfigLogError(GetLog(), "CallMpi(%s): failed to read %d bytes response from socket '%s' (%d)", name, *responseSize, mpiSocket, status);
+                OsConfigLogError(GetLog(), "CallMpi(%s): failed to read %d bytes response from socket '%s' (%d)", name, *responseSize, g_mpiSocket, status);
             }
         }
         else
@@ -127,15 +190,16 @@ static int CallMpi(const char* name, const char* request, char** response, int*
         }
     }
 
-    if (0 <= socketHandle)
+    // After any failure the position of the next response on the stream is unknown, start over on a new connection
+    if ((MPI_OK != status) || (false == header.keepAlive))
     {
-        close(socketHandle);
+        CloseMpiConnection();
     }
 
     if (IsFullLoggingEnabled())
     {
         OsConfigLogInfo(GetLog(), "CallMpi(name: '%s', request: '%s', response: '%s', response size: %d bytes) to socket '%s' returned %d", 
-            name, request, *response, *responseSize, mpiSocket, status);
+            name, request, *response, *responseSize, g_mpiSocket, status);
     }
     
     return status;
@@ -254,6 +318,9 @@ void CallMpiClose(MPI_HANDLE clientSession)
 
     CallMpi(name, request, &response, &responseSize);
 
+    // The session is over, do not hold on to the server connection
+    CloseMpiConnection();
+
     FREE_MEMORY(request);
     FREE_MEMORY(response);
     
@@ -514,6 +581,194 @@ int CallMpiGetReported(MPI_JSON_STRING* payload, int* payloadSizeBytes)
     return status;
 }
 
+// MPI payloads are not null terminated
+static JSON_Value* ParsePayload(const MPI_JSON_STRING payload, const int payloadSizeBytes)
+{
+    JSON_Value* value = NULL;
+    char* buffer = NULL;
+
+    if (NULL != (buffer = (char*)malloc(payloadSizeBytes + 1)))
+    {
+        memcpy(buffer, payload, payloadSizeBytes);
+        buffer[payloadSizeBytes] = 0;
+        value = json_parse_string(buffer);
+        FREE_MEMORY(buffer);
+    }
+
+    return value;
+}
+
+static int CallMpiMany(const char* name, bool isSet, MPI_OBJECT* objects, const int count)
+{
+    const char* requestBodyFormat = "{ \"ClientSession\": %s, \"Objects\": %s }";
+
+    JSON_Value* objectsValue = NULL;
+    JSON_Array* objectsArray = NULL;
+    JSON_Value* itemValue = NULL;
+    JSON_Object* itemObject = NULL;
+    JSON_Value* payloadValue = NULL;
+    JSON_Value* responseValue = NULL;
+    JSON_Array* responseArray = NULL;
+    JSON_Object* responseItem = NULL;
+    char* serializedObjects = NULL;
+    char* payload = NULL;
+    char* request = NULL;
+    char* response = NULL;
+    int requestSize = 0;
+    int responseSize = 0;
+    int status = MPI_OK;
+    int i = 0;
+
+    if ((NULL == g_mpiHandle) || (0 == strlen((char*)g_mpiHandle)))
+    {
+        status = EPERM;
+        OsConfigLogError(GetLog(), "%s: called without a valid MPI handle (%d)", name, status);
+        return status;
+    }
+
+    if ((NULL == objects) || (0 >= count))
+    {
+        status = EINVAL;
+        OsConfigLogError(GetLog(), "%s: invalid arguments (%d)", name, status);
+        return status;
+    }
+
+    if ((NULL == (objectsValue = json_value_init_array())) || (NULL == (objectsArray = json_value_get_array(objectsValue))))
+    {
+        json_value_free(objectsValue);
+        return ENOMEM;
+    }
+
+    for (i = 0; (i < count) && (MPI_OK == status); i++)
+    {
+        objects[i].status = EINVAL;
+        payloadValue = NULL;
+
+        if ((NULL == objects[i].componentName) || (NULL == objects[i].objectName))
+        {
+            status = EINVAL;
+            OsConfigLogError(GetLog(), "%s: invalid object %d (%d)", name, i, status);
+            break;
+        }
+
+        if (isSet)
+        {
+            if ((NULL == objects[i].payload) || (0 >= objects[i].payloadSizeBytes) || (!IsValidMimObjectPayload(objects[i].payload, objects[i].payloadSizeBytes, GetLog())) ||
+                (NULL == (payloadValue = ParsePayload(objects[i].payload, objects[i].payloadSizeBytes))))
+            {
+                status = EINVAL;
+                OsConfigLogError(GetLog(), "%s(%s, %s): invalid payload (%d)", name, objects[i].componentName, objects[i].objectName, status);
+                break;
+            }
+        }
+        else
+        {
+            objects[i].payload = NULL;
+            objects[i].payloadSizeBytes = 0;
+        }
+
+        itemObject = NULL;
+        if ((NULL == (itemValue = json_value_init_object())) || (NULL == (itemObject = json_value_get_object(itemValue))) ||
+            (JSONSuccess != json_object_set_string(itemObject, g_componentNameKey, objects[i].componentName)) ||
+            (JSONSuccess != json_object_set_string(itemObject, g_objectNameKey, objects[i].objectName)) ||
+            ((NULL != payloadValue) && (JSONSuccess != json_object_set_value(itemObject, g_payloadKey, payloadValue))) ||
+            (JSONSuccess != json_array_append_value(objectsArray, itemValue)))
+        {
+            status = ENOMEM;
+            OsConfigLogError(GetLog(), "%s: failed to allocate memory for request (%d)", name, status);
+            if ((NULL == itemObject) || (payloadValue != json_object_get_value(itemObject, g_payloadKey)))
+            {
+                json_value_free(payloadValue);
+            }
+            json_value_free(itemValue);
+        }
+    }
+
+    if ((MPI_OK == status) && (NULL == (serializedObjects = json_serialize_to_string(objectsValue))))
+    {
+        status = ENOMEM;
+    }
+
+    json_value_free(objectsValue);
+
+    if (MPI_OK == status)
+    {
+        requestSize = strlen(requestBodyFormat) + strlen((char*)g_mpiHandle) + strlen(serializedObjects) + 1;
+        if (NULL != (request = (char*)malloc(requestSize)))
+        {
+            snprintf(request, requestSize, requestBodyFormat, (char*)g_mpiHandle, serializedObjects);
+            status = CallMpi(name, request, &response, &responseSize);
+        }
+        else
+        {
+            status = ENOMEM;
+            OsConfigLogError(GetLog(), "%s: failed to allocate memory for request (%d)", name, status);
+        }
+    }
+
+    json_free_serialized_string(serializedObjects);
+    FREE_MEMORY(request);
+
+    // The response lists the objects in request order, each with its own status
+    if ((MPI_OK == status) && ((NULL == response) || (NULL == (responseValue = json_parse_string(response))) ||
+        (NULL == (responseArray = json_value_get_array(responseValue))) || (count != (int)json_array_get_count(responseArray))))
+    {
+        status = EINVAL;
+        OsConfigLogError(GetLog(), "%s: invalid response (%d)", name, status);
+    }
+
+    for (i = 0; (MPI_OK == status) && (i < count); i++)
+    {
+        if ((NULL == (responseItem = json_array_get_object(responseArray, i))) || (JSONNumber != json_value_get_type(json_object_get_value(responseItem, g_statusKey))))
+        {
+            objects[i].status = EINVAL;
+            continue;
+        }
+
+        objects[i].status = (int)json_object_get_number(responseItem, g_statusKey);
+
+        if ((false == isSet) && (MPI_OK == objects[i].status))
+        {
+            objects[i].payload = NULL;
+            objects[i].payloadSizeBytes = 0;
+
+            if ((NULL == (payloadValue = json_object_get_value(responseItem, g_payloadKey))) || (NULL == (payload = json_serialize_to_string(payloadValue))))
+            {
+                objects[i].status = EINVAL;
+            }
+            else
+            {
+                // Serialized with the default allocator, released by the caller with CallMpiFree
+                objects[i].payload = payload;
+                objects[i].payloadSizeBytes = (int)strlen(payload);
+                payload = NULL;
+            }
+        }
+
+        if (IsFullLoggingEnabled())
+        {
+            OsConfigLogInfo(GetLog(), "%s(%p, %s, %s): %d", name, g_mpiHandle, objects[i].componentName, objects[i].objectName, objects[i].status);
+        }
+    }
+
+    json_value_free(responseValue);
+    FREE_MEMORY(response);
+
+    OsConfigLogInfo(GetLog(), "%s(%p, %d objects) returned %d", name, g_mpiHandle, count, status);
+
+    return status;
+}
+
+int CallMpiGetMany(MPI_OBJECT* objects, const int count)
+{
+    return CallMpiMany("MpiGetMany", false, objects, count);
+}
+
+int CallMpiSetMany(MPI_OBJECT* objects, const int count)
+{
+    return CallMpiMany("MpiSetMany", true, objects, count);
+}
+
 void CallMpiFree(MPI_JSON_STRING payload)
 {
     FREE_MEMORY(payload);
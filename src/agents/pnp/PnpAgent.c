@@ -465,13 +465,7 @@ static void ReportProperties()
         return;
     }
 
-    for (int i = 0; i < g_numReportedProperties; i++)
-    {
-        if ((strlen(g_reportedProperties[i].componentName) > 0) && (strlen(g_reportedProperties[i].propertyName) > 0))
-        {
-            ReportPropertyToIotHub(g_reportedProperties[i].componentName, g_reportedProperties[i].propertyName, &(g_reportedProperties[i].lastPayloadHash));
-        }
-    }
+    ReportPropertiesToIotHub(g_reportedProperties, g_numReportedProperties);
 }
 
 static void LoadDesiredConfigurationFromFile()
@@ -10,6 +10,12 @@
 
 #define EXTRA_PROP_PAYLOAD_ESTIMATE 256
 
+// Status returned by CallMpi when the platform does not serve the requested call
+#define HTTP_NOT_FOUND_STATUS 404
+
+// IoT Hub limits the reported properties of a twin to 32 KB, larger reports are split into several patches
+#define MAX_REPORTED_PATCH_SIZE 32768
+
 static const char g_componentMarker[] = "__t";
 static const char g_desiredObjectName[] = "desired";
 static const char g_desiredVersion[] = "$version";
@@ -30,6 +36,8 @@ static const char g_propertyAckTemplate[] = "{\"""%s\":{\"__t\":\"c\",\"%s\":{\"
 
 IOTHUB_DEVICE_CLIENT_LL_HANDLE g_moduleHandle = NULL;
 
+static REPORTED_STATE_TRANSPORT g_reportedStateTransport = IoTHubDeviceClient_LL_SendReportedState;
+
 static bool g_lostNetworkConnection = false;
 
 typedef IOTHUB_CLIENT_RESULT(*PROPERTY_UPDATE_CALLBACK)(const char* componentName, const char* propertyName, JSON_Value* propertyValue, int version);
@@ -37,17 +45,32 @@ typedef IOTHUB_CLIENT_RESULT(*PROPERTY_UPDATE_CALLBACK)(const char* componentNam
 static const char g_connectionAuthenticated[] = "IOTHUB_CLIENT_CONNECTION_AUTHENTICATED";
 static const char g_connectionUnauthenticated[] = "IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED";
 
-#define MAX_DESIRED_TWIN_QUEUE 10
-typedef struct DESIRED_TWIN_UPDATE
+// Reported property values sent in one patch, each recorded as reported once IoT Hub acknowledges the patch
+typedef struct REPORTED_PATCH_ENTRY
 {
-    DEVICE_TWIN_UPDATE_STATE updateState;
-    unsigned char* payload;
-    size_t size;
-    int processed;
-} DESIRED_TWIN_UPDATE;
+    REPORTED_PROPERTY* property;
+    size_t payloadHash;
+} REPORTED_PATCH_ENTRY;
 
-static DESIRED_TWIN_UPDATE g_desiredTwinUpdates[MAX_DESIRED_TWIN_QUEUE] = {0};
-static int g_desiredTwinUpdatesIndex = 0;
+typedef struct REPORTED_PATCH
+{
+    int count;
+    REPORTED_PATCH_ENTRY entries[];
+} REPORTED_PATCH;
+
+// Desired property values waiting to be sent to the platform, at most one (the latest) per component and property
+typedef struct DESIRED_PROPERTY_UPDATE
+{
+    char* componentName;
+    char* propertyName;
+    char* value;
+    int valueLength;
+    int version;
+} DESIRED_PROPERTY_UPDATE;
+
+static DESIRED_PROPERTY_UPDATE* g_desiredPropertyUpdates = NULL;
+static int g_numDesiredPropertyUpdates = 0;
+static int g_maxDesiredPropertyUpdates = 0;
 
 static void IotHubConnectionStatusCallback(IOTHUB_CLIENT_CONNECTION_STATUS result, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* userContextCallback)
 {
@@ -129,22 +152,6 @@ static void IotHubConnectionStatusCallback(IOTHUB_CLIENT_CONNECTION_STATUS resul
     UNUSED(userContextCallback);
 }
 
-static IOTHUB_CLIENT_RESULT PropertyUpdateFromIotHubCallback(const char* componentName, const char* propertyName, JSON_Value* propertyValue, int version)
-{
-    IOTHUB_CLIENT_RESULT result = IOTHUB_CLIENT_ERROR;
-
-    if (NULL == componentName)
-    {
-        LogErrorWithTelemetry(GetLog(), "PropertyUpdateFromIotHubCallback: property %s arrived with a NULL component name, indicating root", propertyName);
-        return result;
-    }
-
-    OsConfigLogInfo(GetLog(), "PropertyUpdateFromIotHubCallback: invoking %s for property %s, version %d", componentName, propertyName, version);
-    result = UpdatePropertyFromIotHub(componentName, propertyName, propertyValue, version);
-
-    return result;
-}
-
 static char* CopyPayloadToString(const unsigned char* payload, size_t size)
 {
     char* jsonStr = NULL;
@@ -307,73 +314,201 @@ static IOTHUB_CLIENT_RESULT ProcessJsonFromTwin(DEVICE_TWIN_UPDATE_STATE updateS
     return result;
 }
 
-static void QueueDesiredTwinUpdate(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned char* payload, size_t size)
+static void ClearDesiredTwinUpdates()
 {
-    // This code is currently running all on a single thread. If it will become multi-threaded, 
-    // add a mutex and lock within all functions that access this common desired twin queue data.
+    int i = 0;
 
-    int queueSize = (int)ARRAY_SIZE(g_desiredTwinUpdates);
+    for (i = 0; i < g_numDesiredPropertyUpdates; i++)
+    {
+        FREE_MEMORY(g_desiredPropertyUpdates[i].componentName);
+        FREE_MEMORY(g_desiredPropertyUpdates[i].propertyName);
+        json_free_serialized_string(g_desiredPropertyUpdates[i].value);
+    }
 
-    if ((NULL == payload) || (0 == size))
+    FREE_MEMORY(g_desiredPropertyUpdates);
+    g_numDesiredPropertyUpdates = 0;
+    g_maxDesiredPropertyUpdates = 0;
+}
+
+static IOTHUB_CLIENT_RESULT QueueDesiredPropertyUpdate(const char* componentName, const char* propertyName, JSON_Value* propertyValue, int version)
+{
+    DESIRED_PROPERTY_UPDATE* update = NULL;
+    DESIRED_PROPERTY_UPDATE* updates = NULL;
+    char* serializedValue = NULL;
+    int maxUpdates = 0;
+    int i = 0;
+
+    if (NULL == componentName)
     {
-        LogErrorWithTelemetry(GetLog(), "QueueDesiredTwinUpdate failed, no payload to queue (%p, %d)", payload,  (int)size);
-        return;
+        LogErrorWithTelemetry(GetLog(), "QueueDesiredPropertyUpdate: property %s arrived with a NULL component name, indicating root", propertyName);
+        return IOTHUB_CLIENT_ERROR;
+    }
+
+    if (NULL == (serializedValue = json_serialize_to_string(propertyValue)))
+    {
+        OsConfigLogInfo(GetLog(), "%s: %s property update requested with no data (nothing to do)", componentName, propertyName);
+        return IOTHUB_CLIENT_OK;
+    }
+
+    for (i = 0; i < g_numDesiredPropertyUpdates; i++)
+    {
+        if ((0 == strcmp(g_desiredPropertyUpdates[i].componentName, componentName)) && (0 == strcmp(g_desiredPropertyUpdates[i].propertyName, propertyName)))
+        {
+            update = &(g_desiredPropertyUpdates[i]);
+            break;
+        }
     }
-   
-    // Clear existing slot
-    FREE_MEMORY(g_desiredTwinUpdates[g_desiredTwinUpdatesIndex].payload);
-    memset(&(g_desiredTwinUpdates[g_desiredTwinUpdatesIndex]), 0, sizeof(g_desiredTwinUpdates[g_desiredTwinUpdatesIndex]));
 
-    // Allocate memory for new desired twin payload to queue
-    g_desiredTwinUpdates[g_desiredTwinUpdatesIndex].payload = malloc(size);
-    if (NULL != g_desiredTwinUpdates[g_desiredTwinUpdatesIndex].payload)
+    if (NULL != update)
     {
-        // Fill in the slot (the processed field is already cleared to 0)
-        memcpy(g_desiredTwinUpdates[g_desiredTwinUpdatesIndex].payload, payload, size);
-        g_desiredTwinUpdates[g_desiredTwinUpdatesIndex].updateState = updateState;
-        g_desiredTwinUpdates[g_desiredTwinUpdatesIndex].size = size;
-        OsConfigLogInfo(GetLog(), "Queued desired payload of %d bytes at slot %d", (int)size, g_desiredTwinUpdatesIndex + 1);
+        // A later desired value supersedes the one still waiting to be sent
+        OsConfigLogInfo(GetLog(), "%s: queued update of property %s, version %d, superseded by version %d", componentName, propertyName, update->version, version);
+        json_free_serialized_string(update->value);
     }
     else
     {
-        LogErrorWithTelemetry(GetLog(), "QueueDesiredTwinUpdate failed to allocate buffer for new payload (%d bytes)", (int)size);
+        if (g_numDesiredPropertyUpdates >= g_maxDesiredPropertyUpdates)
+        {
+            maxUpdates = (g_maxDesiredPropertyUpdates > 0) ? (2 * g_maxDesiredPropertyUpdates) : 16;
+            if (NULL == (updates = (DESIRED_PROPERTY_UPDATE*)realloc(g_desiredPropertyUpdates, maxUpdates * sizeof(DESIRED_PROPERTY_UPDATE))))
+            {
+                LogErrorWithTelemetry(GetLog(), "QueueDesiredPropertyUpdate: out of memory queueing %d property updates", maxUpdates);
+                json_free_serialized_string(serializedValue);
+                return IOTHUB_CLIENT_ERROR;
+            }
+
+            g_desiredPropertyUpdates = updates;
+            g_maxDesiredPropertyUpdates = maxUpdates;
+        }
+
+        update = &(g_desiredPropertyUpdates[g_numDesiredPropertyUpdates]);
+        memset(update, 0, sizeof(DESIRED_PROPERTY_UPDATE));
+
+        if ((NULL == (update->componentName = strdup(componentName))) || (NULL == (update->propertyName = strdup(propertyName))))
+        {
+            LogErrorWithTelemetry(GetLog(), "QueueDesiredPropertyUpdate: out of memory queueing %s.%s", componentName, propertyName);
+            FREE_MEMORY(update->componentName);
+            FREE_MEMORY(update->propertyName);
+            json_free_serialized_string(serializedValue);
+            return IOTHUB_CLIENT_ERROR;
+        }
+
+        g_numDesiredPropertyUpdates += 1;
     }
 
-    // Circular buffer, when full, continue overwritting from beginning
-    g_desiredTwinUpdatesIndex += 1;
-    if (g_desiredTwinUpdatesIndex >= queueSize)
+    update->value = serializedValue;
+    update->valueLength = (int)strlen(serializedValue);
+    update->version = version;
+
+    return IOTHUB_CLIENT_OK;
+}
+
+void QueueDesiredTwinUpdate(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned char* payload, size_t size)
+{
+    // This code is currently running all on a single thread. If it will become multi-threaded, 
+    // add a mutex and lock within all functions that access this common desired twin queue data.
+
+    IOTHUB_CLIENT_RESULT result = IOTHUB_CLIENT_OK;
+
+    if ((NULL == payload) || (0 == size))
     {
-        g_desiredTwinUpdatesIndex = 0;
+        LogErrorWithTelemetry(GetLog(), "QueueDesiredTwinUpdate failed, no payload to queue (%p, %d)", payload,  (int)size);
+        return;
+    }
+
+    if (DEVICE_TWIN_UPDATE_COMPLETE == updateState)
+    {
+        // The full twin carries every desired property, nothing queued before it is still current
+        ClearDesiredTwinUpdates();
     }
+
+    // Merge the update into the queue, property by property, so that only the latest desired value of each is kept
+    result = ProcessJsonFromTwin(updateState, payload, size, QueueDesiredPropertyUpdate);
+    OsConfigLogInfo(GetLog(), "Queued desired payload of %d bytes, %d property updates pending (%d)", (int)size, g_numDesiredPropertyUpdates, (int)result);
 }
 
-static void ClearDesiredTwinUpdates()
+static IOTHUB_CLIENT_RESULT AckDesiredPropertyUpdate(const char* componentName, const char* propertyName, char* serializedValue, int valueLength, int version, int mpiResult)
 {
-    int queueSize = (int)ARRAY_SIZE(g_desiredTwinUpdates);
-    int i = 0;
+    IOTHUB_CLIENT_RESULT result = IOTHUB_CLIENT_OK;
+    int propertyUpdateResult = PNP_STATUS_SUCCESS;
 
-    for (i = 0; i < queueSize; i++)
+    if (MPI_OK == mpiResult)
     {
-        FREE_MEMORY(g_desiredTwinUpdates[i].payload);
+        OsConfigLogInfo(GetLog(), "%s: property %s successfully updated via MPI", componentName, propertyName);
+        propertyUpdateResult = PNP_STATUS_SUCCESS;
     }
+    else
+    {
+        LogErrorWithTelemetry(GetLog(), "%s.%s: MpiSet failed with %d", componentName, propertyName, mpiResult);
+        propertyUpdateResult = PNP_STATUS_BAD_DATA;
+    }
+
+    result = AckPropertyUpdateToIotHub(componentName, propertyName, serializedValue, valueLength, version, propertyUpdateResult);
+
+    TraceLoggingWrite(g_providerHandle, "UpdatePropertyFromIotHub",
+        TraceLoggingString(componentName, "Component"),
+        TraceLoggingString(propertyName, "Property"),
+        TraceLoggingInt32((int32_t)result, "Result"));
 
-    memset(g_desiredTwinUpdates, 0, sizeof(g_desiredTwinUpdates));
+    return result;
 }
 
 void ProcessDesiredTwinUpdates()
 {
-    int queueSize = (int)ARRAY_SIZE(g_desiredTwinUpdates);
+    MPI_OBJECT* objects = NULL;
+    bool platformAlreadyRunning = true;
+    int mpiResult = MPI_OK;
+    int count = g_numDesiredPropertyUpdates;
     int i = 0;
-    
-    for (i = 0; i < queueSize; i++)
+
+    if (0 >= count)
+    {
+        return;
+    }
+
+    if (NULL == (objects = (MPI_OBJECT*)calloc(count, sizeof(MPI_OBJECT))))
+    {
+        // Keep the updates queued for the next time
+        LogErrorWithTelemetry(GetLog(), "ProcessDesiredTwinUpdates: out of memory allocating %d objects to update", count);
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        objects[i].componentName = g_desiredPropertyUpdates[i].componentName;
+        objects[i].objectName = g_desiredPropertyUpdates[i].propertyName;
+        objects[i].payload = g_desiredPropertyUpdates[i].value;
+        objects[i].payloadSizeBytes = g_desiredPropertyUpdates[i].valueLength;
+
+        if (IsFullLoggingEnabled())
+        {
+            OsConfigLogInfo(GetLog(), "%s.%s: received %.*s (%d bytes)", objects[i].componentName, objects[i].objectName, objects[i].payloadSizeBytes, objects[i].payload, objects[i].payloadSizeBytes);
+        }
+    }
+
+    // All queued desired properties are sent to the platform in a single round trip
+    mpiResult = CallMpiSetMany(objects, count);
+    if ((MPI_OK != mpiResult) && RefreshMpiClientSession(&platformAlreadyRunning) && (false == platformAlreadyRunning))
     {
-        if ((g_desiredTwinUpdates[i].size > 0) && (NULL != g_desiredTwinUpdates[i].payload) && (0 == g_desiredTwinUpdates[i].processed))
+        mpiResult = CallMpiSetMany(objects, count);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (MPI_OK != mpiResult)
         {
-            IOTHUB_CLIENT_RESULT result = ProcessJsonFromTwin(g_desiredTwinUpdates[i].updateState, g_desiredTwinUpdates[i].payload, g_desiredTwinUpdates[i].size, PropertyUpdateFromIotHubCallback);
-            g_desiredTwinUpdates[i].processed = 1;
-            OsConfigLogInfo(GetLog(), "ProcessDesiredTwinUpdates: processing desired twin update at slot %d completed with result %d", i + 1, (int)result);
+            // A platform that predates MpiSetMany, or a batch rejected as a whole, set the properties one at a time
+            // so that each gets its own result
+            objects[i].status = CallMpiSet(objects[i].componentName, objects[i].objectName, objects[i].payload, objects[i].payloadSizeBytes);
         }
+
+        AckDesiredPropertyUpdate(objects[i].componentName, objects[i].objectName, objects[i].payload, objects[i].payloadSizeBytes, g_desiredPropertyUpdates[i].version, objects[i].status);
     }
+
+    OsConfigLogInfo(GetLog(), "ProcessDesiredTwinUpdates: processed %d desired property updates (%d)", count, mpiResult);
+
+    FREE_MEMORY(objects);
+    ClearDesiredTwinUpdates();
 }
 
 static void ModuleTwinCallback(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned char* payload, size_t size, void* userContextCallback)
@@ -430,7 +565,7 @@ IOTHUB_DEVICE_CLIENT_LL_HANDLE IotHubInitialize(const char* modelId, const char*
 
     bool urlEncodeOn = true;
 
-    g_desiredTwinUpdatesIndex = 0;
+    ClearDesiredTwinUpdates();
 
     if (NULL != g_moduleHandle)
     {
@@ -519,35 +654,15 @@ static void ReadReportedStateCallback(int statusCode, void* userContextCallback)
     }
 }
 
-IOTHUB_CLIENT_RESULT ReportPropertyToIotHub(const char* componentName, const char* propertyName, size_t* lastPayloadHash)
+// Reports one property value already read from the platform, mpiResult is the status of that read
+static IOTHUB_CLIENT_RESULT ReportPropertyValueToIotHub(const char* componentName, const char* propertyName, int mpiResult, const char* valuePayload, int valueLength, size_t* lastPayloadHash)
 {
     IOTHUB_CLIENT_RESULT result = IOTHUB_CLIENT_OK;
-    char* valuePayload = NULL;
-    int valueLength = 0;
     char* decoratedPayload = NULL;
     int decoratedLength = 0;
     size_t hashPayload = 0;
     bool reportProperty = true;
-    bool platformAlreadyRunning = true;
-    int mpiResult = MPI_OK;
-
-    LogAssert(GetLog(), NULL != componentName);
-    LogAssert(GetLog(), NULL != propertyName);
-
-    if (NULL == g_moduleHandle)
-    {
-        LogErrorWithTelemetry(GetLog(), "%s: the component needs to be initialized before reporting properties", componentName);
-        return IOTHUB_CLIENT_ERROR;
-    }
-
-    mpiResult =  CallMpiGet(componentName, propertyName, &valuePayload, &valueLength);
-    if ((MPI_OK != mpiResult) && RefreshMpiClientSession(&platformAlreadyRunning) && (false == platformAlreadyRunning))
-    {
-        CallMpiFree(valuePayload);
 
-        mpiResult = CallMpiGet(componentName, propertyName, &valuePayload, &valueLength);
-    }
-        
     if ((MPI_OK == mpiResult) && (valueLength > 0) && (NULL != valuePayload))
     {
         decoratedLength = strlen(componentName) + strlen(propertyName) + valueLength + EXTRA_PROP_PAYLOAD_ESTIMATE;
@@ -574,7 +689,7 @@ IOTHUB_CLIENT_RESULT ReportPropertyToIotHub(const char* componentName, const cha
 
             if (reportProperty)
             {
-                result = IoTHubDeviceClient_LL_SendReportedState(g_moduleHandle, (const unsigned char*)decoratedPayload, decoratedLength, ReadReportedStateCallback, (void*)propertyName);
+                result = g_reportedStateTransport(g_moduleHandle, (const unsigned char*)decoratedPayload, decoratedLength, ReadReportedStateCallback, (void*)propertyName);
 
                 if (IsFullLoggingEnabled())
                 {
@@ -621,9 +736,358 @@ IOTHUB_CLIENT_RESULT ReportPropertyToIotHub(const char* componentName, const cha
         result = IOTHUB_CLIENT_ERROR;
     }
 
+    FREE_MEMORY(decoratedPayload);
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT ReportPropertyToIotHub(const char* componentName, const char* propertyName, size_t* lastPayloadHash)
+{
+    IOTHUB_CLIENT_RESULT result = IOTHUB_CLIENT_OK;
+    char* valuePayload = NULL;
+    int valueLength = 0;
+    bool platformAlreadyRunning = true;
+    int mpiResult = MPI_OK;
+
+    LogAssert(GetLog(), NULL != componentName);
+    LogAssert(GetLog(), NULL != propertyName);
+
+    if (NULL == g_moduleHandle)
+    {
+        LogErrorWithTelemetry(GetLog(), "%s: the component needs to be initialized before reporting properties", componentName);
+        return IOTHUB_CLIENT_ERROR;
+    }
+
+    mpiResult =  CallMpiGet(componentName, propertyName, &valuePayload, &valueLength);
+    if ((MPI_OK != mpiResult) && RefreshMpiClientSession(&platformAlreadyRunning) && (false == platformAlreadyRunning))
+    {
+        CallMpiFree(valuePayload);
+
+        mpiResult = CallMpiGet(componentName, propertyName, &valuePayload, &valueLength);
+    }
+
+    result = ReportPropertyValueToIotHub(componentName, propertyName, mpiResult, valuePayload, valueLength, lastPayloadHash);
+
     CallMpiFree(valuePayload);
 
-    FREE_MEMORY(decoratedPayload);
+    return result;
+}
+
+void SetReportedStateTransport(REPORTED_STATE_TRANSPORT transport)
+{
+    g_reportedStateTransport = (NULL != transport) ? transport : IoTHubDeviceClient_LL_SendReportedState;
+}
+
+static void ReportedPatchCallback(int statusCode, void* userContextCallback)
+{
+    REPORTED_PATCH* patch = (REPORTED_PATCH*)userContextCallback;
+    int i = 0;
+
+    if (NULL == patch)
+    {
+        return;
+    }
+
+    if ((statusCode >= 200) && (statusCode < 300))
+    {
+        // Only acknowledged values are skipped in the next reports
+        for (i = 0; i < patch->count; i++)
+        {
+            patch->entries[i].property->lastPayloadHash = patch->entries[i].payloadHash;
+        }
+
+        if (IsFullLoggingEnabled())
+        {
+            OsConfigLogInfo(GetLog(), "Report of %d properties complete with status %d", patch->count, statusCode);
+        }
+    }
+    else
+    {
+        OsConfigLogError(GetLog(), "Report of %d properties failed with status %d, these will be reported again", patch->count, statusCode);
+    }
+
+    FREE_MEMORY(patch);
+}
+
+static bool AppendToReportedPatch(char** buffer, int* length, int* size, const char* format, ...)
+{
+    va_list arguments;
+    char* newBuffer = NULL;
+    int newSize = 0;
+    int formattedLength = 0;
+
+    va_start(arguments, format);
+    formattedLength = vsnprintf(NULL, 0, format, arguments);
+    va_end(arguments);
+
+    if (formattedLength < 0)
+    {
+        return false;
+    }
+
+    if ((*length + formattedLength + 1) > *size)
+    {
+        newSize = ((*size > 0) ? *size : EXTRA_PROP_PAYLOAD_ESTIMATE);
+        while (newSize < (*length + formattedLength + 1))
+        {
+            newSize *= 2;
+        }
+
+        if (NULL == (newBuffer = (char*)realloc(*buffer, newSize)))
+        {
+            LogErrorWithTelemetry(GetLog(), "Out of memory allocating %d bytes for the reported patch", newSize);
+            return false;
+        }
+
+        *buffer = newBuffer;
+        *size = newSize;
+    }
+
+    va_start(arguments, format);
+    vsnprintf(*buffer + *length, *size - *length, format, arguments);
+    va_end(arguments);
+
+    *length += formattedLength;
+
+    return true;
+}
+
+// Sends the patch built so far and takes ownership of its acknowledgement context
+static IOTHUB_CLIENT_RESULT SendReportedPatch(char* buffer, int length, REPORTED_PATCH* patch)
+{
+    IOTHUB_CLIENT_RESULT result = IOTHUB_CLIENT_OK;
+    int count = patch->count;
+    int i = 0;
+
+    result = g_reportedStateTransport(g_moduleHandle, (const unsigned char*)buffer, length, ReportedPatchCallback, patch);
+
+    if (IsFullLoggingEnabled())
+    {
+        OsConfigLogInfo(GetLog(), "Reported %.*s (%d bytes, %d properties), result: %d", length, buffer, length, count, result);
+    }
+
+    if (IOTHUB_CLIENT_OK != result)
+    {
+        LogErrorWithTelemetry(GetLog(), "IoTHubDeviceClient_LL_SendReportedState failed with %d for %d properties", result, count);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        TraceLoggingWrite(g_providerHandle, "ReportPropertyToIotHub",
+            TraceLoggingString(patch->entries[i].property->componentName, "Component"),
+            TraceLoggingString(patch->entries[i].property->propertyName, "Property"),
+            TraceLoggingInt32((int32_t)result, "Result"));
+    }
+
+    if (IOTHUB_CLIENT_OK != result)
+    {
+        // The callback is not going to be invoked for a patch that was not accepted
+        FREE_MEMORY(patch);
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT ReportPropertiesToIotHub(REPORTED_PROPERTY* reportedProperties, int numReportedProperties)
+{
+    IOTHUB_CLIENT_RESULT result = IOTHUB_CLIENT_OK;
+    IOTHUB_CLIENT_RESULT sendResult = IOTHUB_CLIENT_OK;
+    MPI_OBJECT* objects = NULL;
+    REPORTED_PATCH_ENTRY* entries = NULL;
+    REPORTED_PATCH* patch = NULL;
+    bool* pending = NULL;
+    char* buffer = NULL;
+    const char* openComponentName = NULL;
+    bool platformAlreadyRunning = true;
+    bool sameComponent = false;
+    bool patchFailed = false;
+    int mpiResult = MPI_OK;
+    int numPending = 0;
+    int length = 0;
+    int size = 0;
+    int neededLength = 0;
+    int count = 0;
+    int i = 0;
+    int j = 0;
+
+    if ((NULL == reportedProperties) || (0 >= numReportedProperties))
+    {
+        return IOTHUB_CLIENT_OK;
+    }
+
+    if (NULL == g_moduleHandle)
+    {
+        LogErrorWithTelemetry(GetLog(), "The component needs to be initialized before reporting properties");
+        return IOTHUB_CLIENT_ERROR;
+    }
+
+    if ((NULL == (objects = (MPI_OBJECT*)calloc(numReportedProperties, sizeof(MPI_OBJECT)))) ||
+        (NULL == (entries = (REPORTED_PATCH_ENTRY*)calloc(numReportedProperties, sizeof(REPORTED_PATCH_ENTRY)))) ||
+        (NULL == (pending = (bool*)calloc(numReportedProperties, sizeof(bool)))))
+    {
+        LogErrorWithTelemetry(GetLog(), "Out of memory allocating %d objects to report", numReportedProperties);
+        FREE_MEMORY(objects);
+        FREE_MEMORY(entries);
+        return IOTHUB_CLIENT_ERROR;
+    }
+
+    for (i = 0; i < numReportedProperties; i++)
+    {
+        if ((strlen(reportedProperties[i].componentName) > 0) && (strlen(reportedProperties[i].propertyName) > 0))
+        {
+            objects[count].componentName = reportedProperties[i].componentName;
+            objects[count].objectName = reportedProperties[i].propertyName;
+            entries[count].property = &(reportedProperties[i]);
+            count += 1;
+        }
+    }
+
+    // All reported properties are read from the platform in a single round trip
+    mpiResult = (count > 0) ? CallMpiGetMany(objects, count) : MPI_OK;
+    if ((MPI_OK != mpiResult) && RefreshMpiClientSession(&platformAlreadyRunning) && (false == platformAlreadyRunning))
+    {
+        mpiResult = CallMpiGetMany(objects, count);
+    }
+
+    for (j = 0; j < count; j++)
+    {
+        if (HTTP_NOT_FOUND_STATUS == mpiResult)
+        {
+            // A platform that predates MpiGetMany, read the properties one at a time
+            objects[j].status = CallMpiGet(objects[j].componentName, objects[j].objectName, &(objects[j].payload), &(objects[j].payloadSizeBytes));
+        }
+        else if (MPI_OK != mpiResult)
+        {
+            objects[j].status = mpiResult;
+        }
+
+        if ((MPI_OK == objects[j].status) && (objects[j].payloadSizeBytes > 0) && (NULL != objects[j].payload))
+        {
+            // Only the values that changed since the last acknowledged report go in the patch
+            entries[j].payloadHash = HashString(objects[j].payload);
+            if (entries[j].payloadHash != entries[j].property->lastPayloadHash)
+            {
+                pending[j] = true;
+                numPending += 1;
+            }
+        }
+        else
+        {
+            // Avoid log abuse when a component specified in configuration is not active
+            if (IsFullLoggingEnabled())
+            {
+                if (MPI_OK == objects[j].status)
+                {
+                    LogErrorWithTelemetry(GetLog(), "%s.%s: MpiGet returned MMI_OK with no payload", objects[j].componentName, objects[j].objectName);
+                }
+                else
+                {
+                    LogErrorWithTelemetry(GetLog(), "%s.%s: MpiGet failed with %d", objects[j].componentName, objects[j].objectName, objects[j].status);
+                }
+            }
+            else
+            {
+                LogErrorJustTelemetry(GetLog(), "%s.%s: MpiGet failed with %d", objects[j].componentName, objects[j].objectName, objects[j].status);
+            }
+            result = IOTHUB_CLIENT_ERROR;
+        }
+    }
+
+    // The changed values are merged into one patch, grouped by component, split only when a patch would exceed the limit
+    for (j = 0; (j < count) && (false == patchFailed); j++)
+    {
+        if (false == pending[j])
+        {
+            continue;
+        }
+
+        for (i = j; i < count; i++)
+        {
+            if ((false == pending[i]) || (0 != strcmp(objects[i].componentName, objects[j].componentName)))
+            {
+                continue;
+            }
+
+            // Opening the component (and closing the previous one), the property with its value, and closing the patch
+            sameComponent = (NULL != openComponentName) && (0 == strcmp(openComponentName, objects[i].componentName));
+            neededLength = (sameComponent ? 0 : ((NULL != openComponentName) ? 2 : 0) + (int)strlen(objects[i].componentName) + 13) +
+                (int)strlen(objects[i].objectName) + objects[i].payloadSizeBytes + 4 + 2;
+
+            if ((NULL != patch) && (patch->count > 0) && ((length + neededLength) > MAX_REPORTED_PATCH_SIZE))
+            {
+                if (AppendToReportedPatch(&buffer, &length, &size, "}}"))
+                {
+                    sendResult = SendReportedPatch(buffer, length, patch);
+                }
+                else
+                {
+                    sendResult = IOTHUB_CLIENT_ERROR;
+                    FREE_MEMORY(patch);
+                }
+
+                result = (IOTHUB_CLIENT_OK == sendResult) ? result : sendResult;
+                patch = NULL;
+                sameComponent = false;
+            }
+
+            if (NULL == patch)
+            {
+                if (NULL == (patch = (REPORTED_PATCH*)calloc(1, sizeof(REPORTED_PATCH) + numPending * sizeof(REPORTED_PATCH_ENTRY))))
+                {
+                    LogErrorWithTelemetry(GetLog(), "Out of memory allocating a patch for %d properties to report", numPending);
+                    patchFailed = true;
+                    break;
+                }
+
+                length = 0;
+                openComponentName = NULL;
+                if (false == AppendToReportedPatch(&buffer, &length, &size, "{"))
+                {
+                    patchFailed = true;
+                    break;
+                }
+            }
+
+            if (((false == sameComponent) &&
+                (false == AppendToReportedPatch(&buffer, &length, &size, (NULL != openComponentName) ? "},\"%s\":{\"__t\":\"c\"" : "\"%s\":{\"__t\":\"c\"", objects[i].componentName))) ||
+                (false == AppendToReportedPatch(&buffer, &length, &size, ",\"%s\":%.*s", objects[i].objectName, objects[i].payloadSizeBytes, objects[i].payload)))
+            {
+                patchFailed = true;
+                break;
+            }
+
+            openComponentName = objects[i].componentName;
+            patch->entries[patch->count] = entries[i];
+            patch->count += 1;
+            pending[i] = false;
+            numPending -= 1;
+        }
+    }
+
+    if ((false == patchFailed) && (NULL != patch) && (patch->count > 0) && AppendToReportedPatch(&buffer, &length, &size, "}}"))
+    {
+        sendResult = SendReportedPatch(buffer, length, patch);
+        result = (IOTHUB_CLIENT_OK == sendResult) ? result : sendResult;
+    }
+    else
+    {
+        FREE_MEMORY(patch);
+    }
+
+    if (patchFailed)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+    }
+
+    for (j = 0; j < count; j++)
+    {
+        CallMpiFree(objects[j].payload);
+    }
+
+    FREE_MEMORY(buffer);
+    FREE_MEMORY(pending);
+    FREE_MEMORY(entries);
+    FREE_MEMORY(objects);
 
     return result;
 }
@@ -631,7 +1095,6 @@ IOTHUB_CLIENT_RESULT ReportPropertyToIotHub(const char* componentName, const cha
 IOTHUB_CLIENT_RESULT UpdatePropertyFromIotHub(const char* componentName, const char* propertyName, const JSON_Value* propertyValue, int version)
 {
     IOTHUB_CLIENT_RESULT result = IOTHUB_CLIENT_OK;
-    int propertyUpdateResult = PNP_STATUS_SUCCESS;
     char* serializedValue = NULL;
     int valueLength = 0;
     bool platformAlreadyRunning = true;
@@ -661,29 +1124,11 @@ IOTHUB_CLIENT_RESULT UpdatePropertyFromIotHub(const char* componentName, const c
             mpiResult = CallMpiSet(componentName, propertyName, serializedValue, valueLength);
         }
 
-        if (MPI_OK == mpiResult)
-        {
-            OsConfigLogInfo(GetLog(), "%s: property %s successfully updated via MPI", componentName, propertyName);
-            result = IOTHUB_CLIENT_OK;
-            propertyUpdateResult = PNP_STATUS_SUCCESS;
-        }
-        else
-        {
-            LogErrorWithTelemetry(GetLog(), "%s.%s: MpiSet failed with %d", componentName, propertyName, mpiResult);
-            result = IOTHUB_CLIENT_INVALID_ARG;
-            propertyUpdateResult = PNP_STATUS_BAD_DATA;
-        }
-
-        result = AckPropertyUpdateToIotHub(componentName, propertyName, serializedValue, valueLength, version, propertyUpdateResult);
+        result = AckDesiredPropertyUpdate(componentName, propertyName, serializedValue, valueLength, version, mpiResult);
 
         json_free_serialized_string(serializedValue);
     }
 
-    TraceLoggingWrite(g_providerHandle, "UpdatePropertyFromIotHub",
-        TraceLoggingString(componentName, "Component"),
-        TraceLoggingString(propertyName, "Property"),
-        TraceLoggingInt32((int32_t)result, "Result"));
-
     return result;
 }
 
@@ -719,7 +1164,7 @@ IOTHUB_CLIENT_RESULT AckPropertyUpdateToIotHub(const char* componentName, const
         LogAssert(GetLog(), ackValueLength >= (int)strlen(ackBuffer));
         ackValueLength = strlen(ackBuffer);
 
-        result = IoTHubDeviceClient_LL_SendReportedState(g_moduleHandle, (const unsigned char*)ackBuffer, ackValueLength, AckReportedStateCallback, NULL);
+        result = g_reportedStateTransport(g_moduleHandle, (const unsigned char*)ackBuffer, ackValueLength, AckReportedStateCallback, NULL);
 
         if (IsFullLoggingEnabled())
         {
@@ -9,12 +9,28 @@ extern "C"
 {
 #endif
 
+// One object of a batched MpiGetMany or MpiSetMany call
+typedef struct MPI_OBJECT
+{
+    const char* componentName;
+    const char* objectName;
+
+    // Input for CallMpiSetMany, output of CallMpiGetMany to be released with CallMpiFree
+    MPI_JSON_STRING payload;
+    int payloadSizeBytes;
+
+    // Result of the individual get or set
+    int status;
+} MPI_OBJECT;
+
 MPI_HANDLE CallMpiOpen(const char* clientName, const unsigned int maxPayloadSizeBytes);
 void CallMpiClose(MPI_HANDLE clientSession);
 int CallMpiSet(const char* componentName, const char* propertyName, const MPI_JSON_STRING payload, const int payloadSizeBytes);
 int CallMpiGet(const char* componentName, const char* propertyName, MPI_JSON_STRING* payload, int* payloadSizeBytes);
 int CallMpiSetDesired(const MPI_JSON_STRING payload, const int payloadSizeBytes);
 int CallMpiGetReported(MPI_JSON_STRING* payload, int* payloadSizeBytes);
+int CallMpiGetMany(MPI_OBJECT* objects, const int count);
+int CallMpiSetMany(MPI_OBJECT* objects, const int count);
 void CallMpiFree(MPI_JSON_STRING payload);
 
 #ifdef __cplusplus
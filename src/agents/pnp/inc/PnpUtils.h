@@ -5,6 +5,7 @@
 #define PNPUTILS_H
 
 #include "AgentCommon.h"
+#include "ConfigUtils.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -13,6 +14,10 @@ extern "C"
 
 typedef void(*IOTHUB_CLIENT_REPORTED_STATE_CALLBACK)(int status_code, void* userContextCallback);
 
+// Same contract as IoTHubDeviceClient_LL_SendReportedState, which is the default
+typedef IOTHUB_CLIENT_RESULT(*REPORTED_STATE_TRANSPORT)(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle, const unsigned char* reportedState, size_t size,
+    IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback);
+
 IOTHUB_DEVICE_CLIENT_LL_HANDLE IotHubInitialize(const char* modelId, const char* productInfo, const char* connectionString, bool traceOn, 
     const char* x509Certificate, const char* x509PrivateKeyHandle, const HTTP_PROXY_OPTIONS* proxyName, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol);
 void IotHubDeInitialize(void);
@@ -26,10 +31,16 @@ void IotHubDoWork(void);
 // - IOTHUB_CLIENT_INDEFINITE_TIME
 IOTHUB_CLIENT_RESULT UpdatePropertyFromIotHub(const char* componentName, const char* propertyName, const JSON_Value* propertyValue, int version);
 IOTHUB_CLIENT_RESULT ReportPropertyToIotHub(const char* componentName, const char* propertyName, size_t* lastPayloadHash);
+IOTHUB_CLIENT_RESULT ReportPropertiesToIotHub(REPORTED_PROPERTY* reportedProperties, int numReportedProperties);
 IOTHUB_CLIENT_RESULT AckPropertyUpdateToIotHub(const char* componentName, const char* propertyName, char* propertyValue, int valueLength, int version, int propertyUpdateResult);
 
+// Merges a twin update from IoT Hub into the desired properties waiting for ProcessDesiredTwinUpdates
+void QueueDesiredTwinUpdate(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned char* payload, size_t size);
 void ProcessDesiredTwinUpdates();
 
+// Replaces the IoT Hub client for sending reported state, for example with a fake in tests, NULL restores the default
+void SetReportedStateTransport(REPORTED_STATE_TRANSPORT transport);
+
 #ifdef __cplusplus
 }
 #endif
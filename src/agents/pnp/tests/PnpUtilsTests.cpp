@@ -0,0 +1,342 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <Logging.h>
+
+// Declared with C linkage ahead of AgentCommon.h, which declares it without
+extern "C" OSCONFIG_LOG_HANDLE GetLog();
+
+#include "../inc/PnpUtils.h"
+#include "../inc/MpiClient.h"
+#include "../inc/PnpAgent.h"
+
+// The agent entry points and the MPI client are replaced with the fakes below, PnpUtils is the code under test
+TRACELOGGING_DEFINE_PROVIDER(g_providerHandle, "Microsoft.Azure.OsConfigAgent",
+    (0xcf452c24, 0x662b, 0x4cc5, 0x97, 0x26, 0x5e, 0xfe, 0x82, 0x7d, 0xb2, 0x81));
+
+extern "C" IOTHUB_DEVICE_CLIENT_LL_HANDLE g_moduleHandle;
+
+// Same as the limit of a reported patch in PnpUtils.c
+static const size_t g_maxReportedPatchSize = 32768;
+
+// Returned by CallMpi for calls the platform does not serve
+static const int HTTP_NOT_FOUND_STATUS = 404;
+
+// Reported values served by the fake MPI client, by component and object name
+static std::map<std::pair<std::string, std::string>, std::string> g_reportedValues;
+
+struct SentPatch
+{
+    std::string payload;
+    IOTHUB_CLIENT_REPORTED_STATE_CALLBACK callback;
+    void* context;
+};
+
+static std::vector<SentPatch> g_sentPatches;
+
+// Desired values received by the fake MPI client as "component.object=payload", one list per MpiSetMany call
+static std::vector<std::vector<std::string>> g_setManyCalls;
+static std::vector<std::string> g_setCalls;
+static int g_setManyResult = MPI_OK;
+
+// Result of setting an object, MPI_OK when not listed
+static std::map<std::pair<std::string, std::string>, int> g_setStatuses;
+
+static std::string DescribeSet(const char* componentName, const char* propertyName, const MPI_JSON_STRING payload, const int payloadSizeBytes)
+{
+    return std::string(componentName) + "." + propertyName + "=" + std::string(payload, payloadSizeBytes);
+}
+
+static int GetSetStatus(const char* componentName, const char* propertyName)
+{
+    auto status = g_setStatuses.find(std::make_pair(std::string(componentName), std::string(propertyName)));
+    return (status == g_setStatuses.end()) ? MPI_OK : status->second;
+}
+
+OSCONFIG_LOG_HANDLE GetLog()
+{
+    return nullptr;
+}
+
+void ScheduleRefreshConnection(void)
+{
+}
+
+bool RefreshMpiClientSession(bool* platformAlreadyRunning)
+{
+    *platformAlreadyRunning = true;
+    return false;
+}
+
+int CallMpiGet(const char* componentName, const char* propertyName, MPI_JSON_STRING* payload, int* payloadSizeBytes)
+{
+    auto value = g_reportedValues.find(std::make_pair(std::string(componentName), std::string(propertyName)));
+    if (value == g_reportedValues.end())
+    {
+        return ENOENT;
+    }
+
+    *payload = strdup(value->second.c_str());
+    *payloadSizeBytes = static_cast<int>(value->second.size());
+    return MPI_OK;
+}
+
+int CallMpiGetMany(MPI_OBJECT* objects, const int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        objects[i].status = CallMpiGet(objects[i].componentName, objects[i].objectName, &objects[i].payload, &objects[i].payloadSizeBytes);
+    }
+    return MPI_OK;
+}
+
+int CallMpiSet(const char* componentName, const char* propertyName, const MPI_JSON_STRING payload, const int payloadSizeBytes)
+{
+    g_setCalls.push_back(DescribeSet(componentName, propertyName, payload, payloadSizeBytes));
+    return GetSetStatus(componentName, propertyName);
+}
+
+int CallMpiSetMany(MPI_OBJECT* objects, const int count)
+{
+    g_setManyCalls.emplace_back();
+    if (MPI_OK != g_setManyResult)
+    {
+        return g_setManyResult;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        g_setManyCalls.back().push_back(DescribeSet(objects[i].componentName, objects[i].objectName, objects[i].payload, objects[i].payloadSizeBytes));
+        objects[i].status = GetSetStatus(objects[i].componentName, objects[i].objectName);
+    }
+    return MPI_OK;
+}
+
+void CallMpiFree(MPI_JSON_STRING payload)
+{
+    free(payload);
+}
+
+static IOTHUB_CLIENT_RESULT FakeSendReportedState(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle, const unsigned char* reportedState, size_t size,
+    IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
+{
+    UNUSED(handle);
+    g_sentPatches.push_back({std::string(reinterpret_cast<const char*>(reportedState), size), reportedStateCallback, userContextCallback});
+    return IOTHUB_CLIENT_OK;
+}
+
+namespace OSConfig::Agent::Tests
+{
+    class PnpUtilsTests : public ::testing::Test
+    {
+    protected:
+        REPORTED_PROPERTY m_properties[4] = {};
+
+        void SetUp() override
+        {
+            const char* names[][2] = {{"ComponentA", "ObjectA"}, {"ComponentB", "ObjectB"}, {"ComponentA", "ObjectC"}, {"ComponentC", "ObjectD"}};
+
+            for (int i = 0; i < 4; i++)
+            {
+                strcpy(m_properties[i].componentName, names[i][0]);
+                strcpy(m_properties[i].propertyName, names[i][1]);
+            }
+
+            g_reportedValues.clear();
+            g_sentPatches.clear();
+            g_setManyCalls.clear();
+            g_setCalls.clear();
+            g_setManyResult = MPI_OK;
+            g_setStatuses.clear();
+            g_moduleHandle = reinterpret_cast<IOTHUB_DEVICE_CLIENT_LL_HANDLE>(this);
+            SetReportedStateTransport(FakeSendReportedState);
+        }
+
+        void TearDown() override
+        {
+            // The patches still outstanding own their context, a failed ack releases it without touching the properties
+            Acknowledge(500);
+            SetReportedStateTransport(nullptr);
+            g_moduleHandle = nullptr;
+        }
+
+        void SetValue(int index, const std::string& value)
+        {
+            g_reportedValues[std::make_pair(std::string(m_properties[index].componentName), std::string(m_properties[index].propertyName))] = value;
+        }
+
+        void QueueTwin(DEVICE_TWIN_UPDATE_STATE updateState, const char* twin)
+        {
+            QueueDesiredTwinUpdate(updateState, reinterpret_cast<const unsigned char*>(twin), strlen(twin));
+        }
+
+        std::vector<std::string> GetSentPayloads()
+        {
+            std::vector<std::string> payloads;
+            for (auto& patch : g_sentPatches)
+            {
+                payloads.push_back(patch.payload);
+            }
+            return payloads;
+        }
+
+        void Acknowledge(int statusCode)
+        {
+            std::vector<SentPatch> patches;
+            patches.swap(g_sentPatches);
+
+            for (auto& patch : patches)
+            {
+                patch.callback(statusCode, patch.context);
+            }
+        }
+    };
+
+    TEST_F(PnpUtilsTests, ReportPropertiesInOnePatch)
+    {
+        SetValue(0, "1");
+        SetValue(1, "\"text\"");
+        SetValue(2, "{\"a\":[1,2]}");
+        SetValue(3, "true");
+
+        EXPECT_EQ(IOTHUB_CLIENT_OK, ReportPropertiesToIotHub(m_properties, 4));
+        ASSERT_EQ(1, g_sentPatches.size());
+        EXPECT_STREQ("{\"ComponentA\":{\"__t\":\"c\",\"ObjectA\":1,\"ObjectC\":{\"a\":[1,2]}},\"ComponentB\":{\"__t\":\"c\",\"ObjectB\":\"text\"},\"ComponentC\":{\"__t\":\"c\",\"ObjectD\":true}}",
+            g_sentPatches[0].payload.c_str());
+    }
+
+    TEST_F(PnpUtilsTests, ReportPropertiesSplitsLargePatches)
+    {
+        int reported = 0;
+
+        // Two of these values do not fit in one patch
+        for (int i = 0; i < 4; i++)
+        {
+            SetValue(i, "\"" + std::string(20000, 'a' + i) + "\"");
+        }
+
+        EXPECT_EQ(IOTHUB_CLIENT_OK, ReportPropertiesToIotHub(m_properties, 4));
+        ASSERT_EQ(4, g_sentPatches.size());
+
+        for (auto& patch : g_sentPatches)
+        {
+            JSON_Value* patchValue = nullptr;
+            JSON_Object* patchObject = nullptr;
+
+            EXPECT_LE(patch.payload.size(), g_maxReportedPatchSize);
+            ASSERT_NE(nullptr, patchValue = json_parse_string(patch.payload.c_str()));
+            ASSERT_NE(nullptr, patchObject = json_value_get_object(patchValue));
+
+            for (size_t i = 0; i < json_object_get_count(patchObject); i++)
+            {
+                // Each component carries its marker next to the reported objects
+                reported += static_cast<int>(json_object_get_count(json_value_get_object(json_object_get_value_at(patchObject, i)))) - 1;
+            }
+
+            json_value_free(patchValue);
+        }
+
+        EXPECT_EQ(4, reported);
+    }
+
+    TEST_F(PnpUtilsTests, ReportPropertiesAgainUntilAcknowledged)
+    {
+        SetValue(0, "1");
+        SetValue(1, "2");
+        SetValue(2, "3");
+        SetValue(3, "4");
+
+        // Not acknowledged yet, the same values are sent again
+        EXPECT_EQ(IOTHUB_CLIENT_OK, ReportPropertiesToIotHub(m_properties, 4));
+        EXPECT_EQ(IOTHUB_CLIENT_OK, ReportPropertiesToIotHub(m_properties, 4));
+        EXPECT_EQ(2, g_sentPatches.size());
+        EXPECT_EQ(g_sentPatches[0].payload, g_sentPatches[1].payload);
+
+        Acknowledge(204);
+        EXPECT_EQ(IOTHUB_CLIENT_OK, ReportPropertiesToIotHub(m_properties, 4));
+        EXPECT_EQ(0, g_sentPatches.size());
+
+        // Only the changed value is sent, and sent again after a failed ack
+        SetValue(1, "5");
+        EXPECT_EQ(IOTHUB_CLIENT_OK, ReportPropertiesToIotHub(m_properties, 4));
+        ASSERT_EQ(1, g_sentPatches.size());
+        EXPECT_STREQ("{\"ComponentB\":{\"__t\":\"c\",\"ObjectB\":5}}", g_sentPatches[0].payload.c_str());
+
+        Acknowledge(500);
+        EXPECT_EQ(IOTHUB_CLIENT_OK, ReportPropertiesToIotHub(m_properties, 4));
+        ASSERT_EQ(1, g_sentPatches.size());
+        EXPECT_STREQ("{\"ComponentB\":{\"__t\":\"c\",\"ObjectB\":5}}", g_sentPatches[0].payload.c_str());
+
+        Acknowledge(200);
+        EXPECT_EQ(IOTHUB_CLIENT_OK, ReportPropertiesToIotHub(m_properties, 4));
+        EXPECT_EQ(0, g_sentPatches.size());
+    }
+
+    TEST_F(PnpUtilsTests, DesiredUpdatesAreCoalesced)
+    {
+        QueueTwin(DEVICE_TWIN_UPDATE_PARTIAL, "{\"ComponentA\":{\"__t\":\"c\",\"ObjectA\":1,\"ObjectB\":\"text\"},\"$version\":3}");
+        QueueTwin(DEVICE_TWIN_UPDATE_PARTIAL, "{\"ComponentA\":{\"__t\":\"c\",\"ObjectA\":2},\"ComponentB\":{\"__t\":\"c\",\"ObjectC\":[1]},\"$version\":4}");
+        ProcessDesiredTwinUpdates();
+
+        // The second value of ObjectA replaces the first one in place
+        ASSERT_EQ(1, g_setManyCalls.size());
+        EXPECT_EQ(std::vector<std::string>({"ComponentA.ObjectA=2", "ComponentA.ObjectB=\"text\"", "ComponentB.ObjectC=[1]"}), g_setManyCalls[0]);
+        EXPECT_TRUE(g_setCalls.empty());
+
+        EXPECT_EQ(std::vector<std::string>({
+            "{\"ComponentA\":{\"__t\":\"c\",\"ObjectA\":{\"value\":2,\"ac\":200,\"ad\":\"-\",\"av\":4}}}",
+            "{\"ComponentA\":{\"__t\":\"c\",\"ObjectB\":{\"value\":\"text\",\"ac\":200,\"ad\":\"-\",\"av\":3}}}",
+            "{\"ComponentB\":{\"__t\":\"c\",\"ObjectC\":{\"value\":[1],\"ac\":200,\"ad\":\"-\",\"av\":4}}}"}), GetSentPayloads());
+
+        // Nothing is left queued
+        ProcessDesiredTwinUpdates();
+        EXPECT_EQ(1, g_setManyCalls.size());
+    }
+
+    TEST_F(PnpUtilsTests, CompleteTwinDropsQueuedUpdates)
+    {
+        QueueTwin(DEVICE_TWIN_UPDATE_PARTIAL, "{\"ComponentA\":{\"__t\":\"c\",\"ObjectA\":1,\"ObjectB\":2},\"$version\":3}");
+        QueueTwin(DEVICE_TWIN_UPDATE_COMPLETE, "{\"desired\":{\"ComponentA\":{\"__t\":\"c\",\"ObjectA\":5},\"$version\":9},\"reported\":{}}");
+        ProcessDesiredTwinUpdates();
+
+        ASSERT_EQ(1, g_setManyCalls.size());
+        EXPECT_EQ(std::vector<std::string>({"ComponentA.ObjectA=5"}), g_setManyCalls[0]);
+        EXPECT_EQ(std::vector<std::string>({"{\"ComponentA\":{\"__t\":\"c\",\"ObjectA\":{\"value\":5,\"ac\":200,\"ad\":\"-\",\"av\":9}}}"}), GetSentPayloads());
+    }
+
+    TEST_F(PnpUtilsTests, DesiredUpdatesFallBackToSingleSets)
+    {
+        g_setManyResult = HTTP_NOT_FOUND_STATUS;
+        g_setStatuses[std::make_pair(std::string("ComponentB"), std::string("ObjectC"))] = EINVAL;
+
+        QueueTwin(DEVICE_TWIN_UPDATE_PARTIAL, "{\"ComponentA\":{\"__t\":\"c\",\"ObjectA\":1},\"ComponentB\":{\"__t\":\"c\",\"ObjectC\":2},\"$version\":5}");
+        ProcessDesiredTwinUpdates();
+
+        EXPECT_EQ(1, g_setManyCalls.size());
+        EXPECT_EQ(std::vector<std::string>({"ComponentA.ObjectA=1", "ComponentB.ObjectC=2"}), g_setCalls);
+
+        // Each property is acknowledged with the result of its own set
+        EXPECT_EQ(std::vector<std::string>({
+            "{\"ComponentA\":{\"__t\":\"c\",\"ObjectA\":{\"value\":1,\"ac\":200,\"ad\":\"-\",\"av\":5}}}",
+            "{\"ComponentB\":{\"__t\":\"c\",\"ObjectC\":{\"value\":2,\"ac\":400,\"ad\":\"-\",\"av\":5}}}"}), GetSentPayloads());
+    }
+
+    TEST_F(PnpUtilsTests, DesiredUpdatesAckedWithTheirOwnStatus)
+    {
+        g_setStatuses[std::make_pair(std::string("ComponentA"), std::string("ObjectB"))] = EINVAL;
+
+        QueueTwin(DEVICE_TWIN_UPDATE_PARTIAL, "{\"ComponentA\":{\"__t\":\"c\",\"ObjectA\":true,\"ObjectB\":false},\"$version\":7}");
+        ProcessDesiredTwinUpdates();
+
+        ASSERT_EQ(1, g_setManyCalls.size());
+        EXPECT_TRUE(g_setCalls.empty());
+        EXPECT_EQ(std::vector<std::string>({
+            "{\"ComponentA\":{\"__t\":\"c\",\"ObjectA\":{\"value\":true,\"ac\":200,\"ad\":\"-\",\"av\":7}}}",
+            "{\"ComponentA\":{\"__t\":\"c\",\"ObjectB\":{\"value\":false,\"ac\":400,\"ad\":\"-\",\"av\":7}}}"}), GetSentPayloads());
+    }
+}
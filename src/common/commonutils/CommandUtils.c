@@ -2,6 +2,13 @@
 // Licensed under the MIT License.
 
 #include "Internal.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+
+extern char** environ;
 
 static bool g_commandLoggingEnabled = false;
 
@@ -15,13 +22,22 @@ bool IsCommandLoggingEnabled(void)
     return g_commandLoggingEnabled;
 }
 
-static void KillProcess(pid_t processId)
+// Milliseconds between checks of a command that ended while something it started still holds its output open
+#define COMMAND_OUTPUT_GRACE 100
+
+// Milliseconds between checks whether the command exited, when the kernel has no pidfd to poll
+#define COMMAND_EXIT_POLL_INTERVAL 10
+
+#define COMMAND_OUTPUT_CHUNK 4096
+
+// Milliseconds a canceled command gets to exit after SIGTERM before its process group is killed
+#define COMMAND_TERMINATE_GRACE 1000
+
+static long long GetMonotonicMilliseconds(void)
 {
-    fflush(NULL);
-    if (processId > 0)
-    {
-        kill(processId, SIGKILL);
-    }
+    struct timespec now = {0};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((long long)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
 }
 
 static int NormalizeStatus(int status)
@@ -41,205 +57,393 @@ static int NormalizeStatus(int status)
     return newStatus;
 }
 
-static int SystemCommand(void* context, const char* command, int timeoutSeconds, CommandCallback callback, void* log)
+static int OpenProcessDescriptor(pid_t processId)
 {
-    const int callbackIntervalSeconds = 5; //seconds
-    const int signalIntervalMicroSeconds = 25000; //microseconds
-    const int defaultCommandTimeout = 60; //seconds
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, processId, 0);
+#else
+    UNUSED(processId);
+    errno = ENOSYS;
+    return -1;
+#endif
+}
 
-    pid_t intermediateProcess = -1;
-    pid_t workerProcess = -1;
-    pid_t timerProcess = -1;
-    pid_t childProcess = -1;
-    int status = -1;
-    int intermediateStatus = -1;
-    int totalWaitSeconds = 0;
-    int timeout = (timeoutSeconds > 0) ? timeoutSeconds : defaultCommandTimeout;
-    
-    bool mainProcessThread = (bool)(getpid() == gettid());
+// Starts the command in a new process group with stdout and stderr going to the output descriptor, default signal
+// dispositions and nothing blocked. posix_spawn clones without copying the address space, unlike fork
+static int SpawnCommand(const char* program, char* const arguments[], bool searchPath, int outputDescriptor, pid_t* processId)
+{
+    posix_spawn_file_actions_t fileActions;
+    posix_spawnattr_t attributes;
+    sigset_t signals;
+    int status = 0;
+
+    if (0 != (status = posix_spawn_file_actions_init(&fileActions)))
+    {
+        return status;
+    }
 
-    fflush(NULL);
+    if (0 != (status = posix_spawnattr_init(&attributes)))
+    {
+        posix_spawn_file_actions_destroy(&fileActions);
+        return status;
+    }
 
-    if ((timeoutSeconds > 0) || (NULL != callback))
+    if ((0 == (status = posix_spawn_file_actions_adddup2(&fileActions, outputDescriptor, STDOUT_FILENO))) &&
+        (0 == (status = posix_spawn_file_actions_adddup2(&fileActions, outputDescriptor, STDERR_FILENO))) &&
+        (0 == (status = posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF))) &&
+        (0 == (status = posix_spawnattr_setpgroup(&attributes, 0))) &&
+        (0 == sigemptyset(&signals)) && (0 == (status = posix_spawnattr_setsigmask(&attributes, &signals))) &&
+        (0 == sigfillset(&signals)) && (0 == (status = posix_spawnattr_setsigdefault(&attributes, &signals))))
     {
-        if (IsCommandLoggingEnabled())
+        status = searchPath ? posix_spawnp(processId, program, &fileActions, &attributes, arguments, environ) :
+            posix_spawn(processId, program, &fileActions, &attributes, arguments, environ);
+    }
+
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&fileActions);
+
+    return status;
+}
+
+// Following characters are replaced in place with spaces:
+// all special characters from 0x00 to 0x1F except 0x0A (LF) when replaceEol is false
+// plus 0x22 (") and 0x5C (\) characters that break the JSON envelope when forJson is true
+static void SanitizeCommandOutput(char* output, size_t outputSize, bool replaceEol, bool forJson)
+{
+    char next = 0;
+    size_t i = 0;
+
+    for (i = 0; i < outputSize; i++)
+    {
+        next = output[i];
+        if ((replaceEol && (EOL == next)) || ((next >= 0) && (next < 0x20) && (EOL != next)) || (0x7F == next) || (forJson && (('"' == next) || ('\\' == next))))
         {
-            OsConfigLogInfo(log, "SystemCommand: executing command '%s' with timeout of %d seconds and%scancelation on %s thread", 
-                command, timeout, (NULL == callback) ? " no " : " ", mainProcessThread ? "main process" : "worker");
+            output[i] = ' ';
         }
+    }
+}
 
-        // Fork an intermediate process to act as the parent for two more forked processes:
-        // one to actually execute the system command and the other to sleep and act as a timer.
-        // Whichever of these two children processes finishes first, that causes the other to be killed.
-        // The intermediate process exists as a parent for these (instead of the current process being
-        // the parent) to avoid collision with any other children processes.
+// Copies the sanitized output into a new string
+static char* CopyCommandOutput(const char* output, size_t outputSize, bool replaceEol, bool forJson)
+{
+    char* textResult = NULL;
 
-        if (0 == (intermediateProcess = fork()))
+    if (NULL != (textResult = (char*)malloc(outputSize + 1)))
+    {
+        if (outputSize > 0)
         {
-            // Intermediate process
+            memcpy(textResult, output, outputSize);
+        }
+        SanitizeCommandOutput(textResult, outputSize, replaceEol, forJson);
+        textResult[outputSize] = 0;
+    }
 
-            if (0 == (workerProcess = fork()))
-            {
-                // Worker process
-                status = execl("/bin/sh", "sh", "-c", command, (char*)NULL);
-                _exit(status);
-            }
-            else if (workerProcess < 0)
-            {
-                // Intermediate process
-                if (IsCommandLoggingEnabled())
-                {
-                    OsConfigLogError(log, "Failed forking process to execute command");
-                }
-                status = -1;
+    return textResult;
+}
 
-                // Kill the timer process if created and wait on it before exiting otherwise timer becomes a zombie process
-                if (timerProcess > 0)
-                {
-                    KillProcess(timerProcess);
-                    waitpid(timerProcess, &intermediateStatus, 0);
-                }
-                _exit(status);
-            }
+// Appends what can be read from the output without blocking, up to limit bytes and discarding the rest, or hands it
+// to the output callback as it comes when there is one (sanitized unless rawOutput). Returns false once all writers closed the output
+static bool ReadCommandOutput(int outputDescriptor, char** output, size_t* outputSize, size_t* outputCapacity, size_t limit, size_t* totalSize,
+    bool replaceEol, bool forJson, bool rawOutput, CommandOutputCallback outputCallback, void* context)
+{
+    char chunk[COMMAND_OUTPUT_CHUNK];
+    char* newOutput = NULL;
+    size_t newCapacity = 0;
+    size_t kept = 0;
+    ssize_t bytes = 0;
 
-            if (0 == (timerProcess = fork()))
+    while (0 != (bytes = read(outputDescriptor, chunk, sizeof(chunk))))
+    {
+        if (bytes < 0)
+        {
+            return (EINTR == errno) || (EAGAIN == errno) || (EWOULDBLOCK == errno);
+        }
+
+        *totalSize += bytes;
+
+        if (NULL != outputCallback)
+        {
+            if (!rawOutput)
             {
-                // Timer process
-                status = ETIME;
-                if (NULL == callback)
-                {
-                    sleep(timeout);
-                }
-                else
-                {
-                    while (totalWaitSeconds < timeout)
-                    {
-                        // If the callback returns non zero, cancel the command
-                        if (0 != callback(context))
-                        {
-                            status = ECANCELED;
-                            break;
-                        }
-                        sleep(callbackIntervalSeconds);
-                        totalWaitSeconds += callbackIntervalSeconds;
-                    }
-                }
-                _exit(status);
+                SanitizeCommandOutput(chunk, (size_t)bytes, replaceEol, forJson);
             }
-            else if (timerProcess < 0)
+            outputCallback(context, chunk, (size_t)bytes);
+            continue;
+        }
+
+        kept = (*outputSize < limit) ? (((limit - *outputSize) < (size_t)bytes) ? (limit - *outputSize) : (size_t)bytes) : 0;
+
+        if (kept > 0)
+        {
+            if ((*outputSize + kept) > *outputCapacity)
             {
-                // Intermediate process
-                if (IsCommandLoggingEnabled())
+                newCapacity = (*outputCapacity > 0) ? *outputCapacity : COMMAND_OUTPUT_CHUNK;
+                while (newCapacity < (*outputSize + kept))
                 {
-                    OsConfigLogError(log, "Failed forking timer process");
+                    newCapacity *= 2;
                 }
-                status = -1;
 
-                // Kill the worker process if created and wait on it before exiting otherwise worker becomes a zombie process
-                if (workerProcess > 0)
+                if (NULL == (newOutput = (char*)realloc(*output, newCapacity)))
                 {
-                    KillProcess(workerProcess);
-                    waitpid(workerProcess, &intermediateStatus, 0);
+                    continue;
                 }
-                _exit(status);
+
+                *output = newOutput;
+                *outputCapacity = newCapacity;
             }
 
-            // Wait on the child process (worker or timer) that finishes first
-            childProcess = waitpid(0, &status, 0);
-            status = NormalizeStatus(status);
-            if (childProcess == workerProcess)
+            memcpy(*output + *outputSize, chunk, kept);
+            *outputSize += kept;
+        }
+    }
+
+    return false;
+}
+
+// Stops a canceled command: SIGTERM to its process group, SIGKILL to what is left of it once the command exited or
+// after the grace period
+static void TerminateCommand(pid_t processId, int processDescriptor)
+{
+    long long deadline = GetMonotonicMilliseconds() + COMMAND_TERMINATE_GRACE;
+    long long now = 0;
+    struct pollfd descriptor = {0};
+    siginfo_t information;
+    int waitStatus = 0;
+
+    kill(-processId, SIGTERM);
+
+    while ((now = GetMonotonicMilliseconds()) < deadline)
+    {
+        if (processDescriptor >= 0)
+        {
+            // Readable once the command exited, the zombie keeps the process group id from being reused until it is reaped
+            descriptor.fd = processDescriptor;
+            descriptor.events = POLLIN;
+            descriptor.revents = 0;
+            if (0 != poll(&descriptor, 1, (int)(deadline - now)))
             {
-                if (IsCommandLoggingEnabled())
-                {
-                    OsConfigLogInfo(log, "Command execution complete with status %d", status);
-                }
-                KillProcess(timerProcess);
+                break;
             }
-            else
+        }
+        else
+        {
+            // Without a pidfd, checks whether the command exited without reaping it
+            memset(&information, 0, sizeof(information));
+            if ((0 == waitid(P_PID, processId, &information, WEXITED | WNOHANG | WNOWAIT)) && (0 != information.si_pid))
             {
-                // Timer process is done, kill the timed out worker process
-                if (IsCommandLoggingEnabled())
-                {
-                    OsConfigLogError(log, "Command timed out or it was canceled, command process killed (%d)", status);
-                }
-                KillProcess(workerProcess);
+                break;
             }
-
-            // Wait on the remaining child (either worker or timer) and exit (the intermediate process)
-            waitpid(0, &intermediateStatus, 0);
-            _exit(status);
+            usleep(COMMAND_EXIT_POLL_INTERVAL * 1000);
         }
-        else if (intermediateProcess > 0)
+    }
+
+    kill(-processId, SIGKILL);
+    while ((0 > waitpid(processId, &waitStatus, 0)) && (EINTR == errno));
+}
+
+// Runs the program and waits for it in the calling process: the output is read from a pipe while a pidfd (or, without one,
+// a short poll) tells when the program exits, and the timeout, callback and cancel descriptor are checked in between
+static int RunCommand(void* context, const char* program, char* const arguments[], bool searchPath, const char* commandName, bool replaceEol, bool forJson, bool rawOutput,
+    unsigned int maxTextResultBytes, unsigned int timeoutSeconds, char** textResult, CommandCallback callback, int cancelDescriptor, CommandOutputCallback outputCallback, void* log)
+{
+    const int callbackIntervalSeconds = 5; //seconds
+    const int defaultCommandTimeout = 60; //seconds
+
+    int outputPipe[2] = {-1, -1};
+    int processDescriptor = -1;
+    pid_t processId = -1;
+    struct pollfd descriptors[3];
+    nfds_t descriptorCount = 0;
+    char* output = NULL;
+    size_t outputSize = 0;
+    size_t outputCapacity = 0;
+    size_t totalSize = 0;
+    size_t limit = (maxTextResultBytes > 0) ? (maxTextResultBytes - 1) : (size_t)-1;
+    bool outputOpen = true;
+    bool exited = false;
+    bool cancelable = (NULL != callback) || (cancelDescriptor >= 0);
+    int timeout = ((timeoutSeconds > 0) || cancelable) ? ((timeoutSeconds > 0) ? (int)timeoutSeconds : defaultCommandTimeout) : 0;
+    long long now = GetMonotonicMilliseconds();
+    long long deadline = (timeout > 0) ? (now + (timeout * 1000LL)) : 0;
+    long long nextCallback = now;
+    long long exitTime = 0;
+    long long wait = 0;
+    int waitStatus = 0;
+    int status = 0;
+
+    if (IsCommandLoggingEnabled())
+    {
+        OsConfigLogInfo(log, "RunCommand: executing command '%s' with timeout of %d seconds and%scancelation", commandName, timeout, cancelable ? " " : " no ");
+    }
+
+    if (0 != pipe2(outputPipe, O_CLOEXEC))
+    {
+        status = errno ? errno : EMFILE;
+        OsConfigLogError(log, "RunCommand: failed to create pipe for command output (%d)", status);
+        return status;
+    }
+
+    fcntl(outputPipe[0], F_SETFL, fcntl(outputPipe[0], F_GETFL) | O_NONBLOCK);
+
+    status = SpawnCommand(program, arguments, searchPath, outputPipe[1], &processId);
+    close(outputPipe[1]);
+
+    if (0 != status)
+    {
+        if (IsCommandLoggingEnabled())
         {
-            // Wait on the intermediate process to finish
-            waitpid(intermediateProcess, &status, 0);
+            OsConfigLogError(log, "RunCommand: failed to start command '%s' (%d)", commandName, status);
         }
-        else
+        close(outputPipe[0]);
+        return status;
+    }
+
+    processDescriptor = OpenProcessDescriptor(processId);
+
+    while (false == exited)
+    {
+        now = GetMonotonicMilliseconds();
+
+        if ((NULL != callback) && (now >= nextCallback))
         {
-            status = -1;
-            if (IsCommandLoggingEnabled())
+            // If the callback returns non zero, cancel the command
+            if (0 != callback(context))
             {
-                OsConfigLogError(log, "Failed forking intermediate process");
+                status = ECANCELED;
+                break;
             }
+            nextCallback = now + (callbackIntervalSeconds * 1000LL);
+        }
+
+        if ((deadline > 0) && (now >= deadline))
+        {
+            status = ETIME;
+            break;
+        }
+
+        wait = (deadline > 0) ? (deadline - now) : -1;
+        wait = ((NULL != callback) && ((wait < 0) || ((nextCallback - now) < wait))) ? (nextCallback - now) : wait;
+        wait = ((processDescriptor < 0) && ((wait < 0) || (wait > COMMAND_EXIT_POLL_INTERVAL))) ? COMMAND_EXIT_POLL_INTERVAL : wait;
+
+        descriptorCount = 0;
+        if (outputOpen)
+        {
+            descriptors[descriptorCount].fd = outputPipe[0];
+            descriptors[descriptorCount].events = POLLIN;
+            descriptors[descriptorCount++].revents = 0;
+        }
+        if (processDescriptor >= 0)
+        {
+            descriptors[descriptorCount].fd = processDescriptor;
+            descriptors[descriptorCount].events = POLLIN;
+            descriptors[descriptorCount++].revents = 0;
+        }
+        if (cancelDescriptor >= 0)
+        {
+            descriptors[descriptorCount].fd = cancelDescriptor;
+            descriptors[descriptorCount].events = POLLIN;
+            descriptors[descriptorCount++].revents = 0;
+        }
+
+        if ((0 > poll(descriptors, descriptorCount, (int)wait)) && (EINTR != errno))
+        {
+            status = errno;
+            break;
+        }
+
+        // The cancel descriptor is the last one polled, readable as soon as the command is canceled
+        if ((cancelDescriptor >= 0) && (0 != (descriptors[descriptorCount - 1].revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL))))
+        {
+            status = ECANCELED;
+            break;
+        }
+
+        if (outputOpen)
+        {
+            outputOpen = ReadCommandOutput(outputPipe[0], &output, &outputSize, &outputCapacity, limit, &totalSize, replaceEol, forJson, rawOutput, outputCallback, context);
+        }
+
+        if (processId == waitpid(processId, &waitStatus, WNOHANG))
+        {
+            exited = true;
+            status = NormalizeStatus(waitStatus);
         }
     }
-    else
+
+    if (false == exited)
     {
+        // Timed out, canceled or failed waiting: kill the whole process group, the shell and whatever it started.
+        // A canceled command is asked to terminate first
         if (IsCommandLoggingEnabled())
         {
-            OsConfigLogInfo(log, "SystemCommand: executing command '%s' without timeout or cancelation on %s thread", 
-                command, mainProcessThread ? "main process" : "worker");
+            OsConfigLogError(log, "RunCommand: command '%s' timed out or it was canceled, command process killed (%d)", commandName, status);
         }
-        if (0 == (workerProcess = fork()))
+
+        if (ECANCELED == status)
         {
-            // Worker process
-            status = execl("/bin/sh", "sh", "-c", command, (char*)NULL);
-            _exit(status);
+            TerminateCommand(processId, processDescriptor);
         }
-        else if (workerProcess > 0)
+        else
         {
-            // Wait on the worker process to terminate
-            waitpid(workerProcess, &status, 0);
+            kill(-processId, SIGKILL);
+            while ((0 > waitpid(processId, &waitStatus, 0)) && (EINTR == errno));
         }
-        else
+    }
+    else
+    {
+        // Output that processes started by the command write shortly after it ended, without waiting on daemons that keep it open
+        exitTime = GetMonotonicMilliseconds();
+        while (outputOpen && ((now = GetMonotonicMilliseconds()) < (exitTime + COMMAND_OUTPUT_GRACE)) && ((0 == deadline) || (now < deadline)))
         {
-            // If our fork fails, try system(), if that also fails then the call fails
-            if (IsCommandLoggingEnabled())
+            descriptors[0].fd = outputPipe[0];
+            descriptors[0].events = POLLIN;
+            descriptors[0].revents = 0;
+
+            if (0 == poll(descriptors, 1, (int)(exitTime + COMMAND_OUTPUT_GRACE - now)))
             {
-                OsConfigLogError(log, "Failed forking process to execute command, attempting system");
+                break;
             }
-            status = system(command);
+
+            outputOpen = ReadCommandOutput(outputPipe[0], &output, &outputSize, &outputCapacity, limit, &totalSize, replaceEol, forJson, rawOutput, outputCallback, context);
+            exitTime = GetMonotonicMilliseconds();
         }
     }
 
-    status = NormalizeStatus(status);
+    if (outputOpen)
+    {
+        ReadCommandOutput(outputPipe[0], &output, &outputSize, &outputCapacity, limit, &totalSize, replaceEol, forJson, rawOutput, outputCallback, context);
+    }
+
+    close(outputPipe[0]);
+    if (processDescriptor >= 0)
+    {
+        close(processDescriptor);
+    }
+
+    // Whether the command succeeded or failed, any output is returned, truncated to the desired maximum
+    if ((NULL != textResult) && (NULL == outputCallback) && (totalSize > 0))
+    {
+        *textResult = CopyCommandOutput(output, outputSize, replaceEol, forJson);
+    }
+
+    FREE_MEMORY(output);
+
     if (IsCommandLoggingEnabled())
     {
-        OsConfigLogInfo(log, "SystemCommand: command '%s' completed with %d", command, status);
+        OsConfigLogInfo(log, "RunCommand: command '%s' completed with %d", commandName, status);
     }
+
     return status;
 }
 
-#define MAX_COMMAND_RESULT_FILE_NAME 100
-
 int ExecuteCommand(void* context, const char* command, bool replaceEol, bool forJson, unsigned int maxTextResultBytes, unsigned int timeoutSeconds, char** textResult, CommandCallback callback, void* log)
 {
-    const char g_commandTextResultFileTemplate[] = "/tmp/~OSConfig.TextResult%u";
-    const char g_commandSeparator[] = " > ";
-    const char g_commandTerminator[] = " 2>&1";
-    
-    int status = -1;
-    FILE* resultsFile = NULL;
-    int fileSize = 0;
-    int next = 0;
-    int i = 0;
-    char* commandLine = NULL;
+    char* arguments[] = { "sh", "-c", NULL, NULL };
     size_t commandLineLength = 0;
     size_t maximumCommandLine = 0;
-    char commandTextResultFile[MAX_COMMAND_RESULT_FILE_NAME] = {0};
-    bool wrappedCommand = false;
+    int status = -1;
 
-    if ((NULL == command) || (0 == system(NULL)))
+    if (NULL == command)
     {
         if (IsCommandLoggingEnabled())
         {
@@ -248,14 +452,7 @@ int ExecuteCommand(void* context, const char* command, bool replaceEol, bool for
         return -1;
     }
 
-    commandLineLength = strlen(command);
-    wrappedCommand = (('(' == command[0]) || (')' == command[commandLineLength]));
-
-    // Append a random number to the results file to prevent parallel commands overwriting each other results
-    snprintf(commandTextResultFile, sizeof(commandTextResultFile), g_commandTextResultFileTemplate, rand());
-
-    commandLineLength += strlen(g_commandSeparator) + strlen(commandTextResultFile) + strlen(g_commandTerminator) + (wrappedCommand ? 0 : 2) + 1;
-
+    commandLineLength = strlen(command) + 1;
     maximumCommandLine = (size_t)sysconf(_SC_ARG_MAX);
     if (commandLineLength > maximumCommandLine)
     {
@@ -266,94 +463,90 @@ int ExecuteCommand(void* context, const char* command, bool replaceEol, bool for
         return E2BIG;
     }
 
-    commandLine = (char*)malloc(commandLineLength);
-    if (NULL == commandLine)
+    arguments[2] = (char*)command;
+
+    // Execute the command with the requested timeout: error ETIME (62) means the command timed out
+    status = RunCommand(context, "/bin/sh", arguments, false, command, replaceEol, forJson, false, maxTextResultBytes, timeoutSeconds, textResult, callback, -1, NULL, log);
+
+    if (IsCommandLoggingEnabled())
+    {
+        OsConfigLogInfo(log, "Context: '%p'", context);
+        OsConfigLogInfo(log, "Command: '%s'", command);
+        OsConfigLogInfo(log, "Status: %d (errno: %d)", status, errno);
+        OsConfigLogInfo(log, "Text result: '%s'", ((NULL != textResult) && (NULL != *textResult)) ? (*textResult) : "");
+    }
+
+    return status;
+}
+
+int ExecuteCommandWithOutputCallback(void* context, const char* command, bool replaceEol, bool forJson, unsigned int timeoutSeconds, int cancelDescriptor, CommandOutputCallback outputCallback, void* log)
+{
+    char* arguments[] = { "sh", "-c", NULL, NULL };
+    int status = -1;
+
+    if ((NULL == command) || (NULL == outputCallback))
+    {
+        OsConfigLogError(log, "ExecuteCommandWithOutputCallback: invalid arguments");
+        return -1;
+    }
+
+    if ((strlen(command) + 1) > (size_t)sysconf(_SC_ARG_MAX))
     {
         if (IsCommandLoggingEnabled())
         {
-            OsConfigLogError(log, "Cannot run command '%s', cannot allocate %u bytes for command, out of memory", command, (unsigned)commandLineLength);
+            OsConfigLogError(log, "Cannot run command '%s', command too long", command);
         }
-        return ENOMEM;
+        return E2BIG;
     }
 
-    snprintf(commandLine, commandLineLength, wrappedCommand ? "%s%s%s%s" : "(%s)%s%s%s", command, g_commandSeparator, commandTextResultFile, g_commandTerminator);
- 
-    // Execute the command with the requested timeout: error ETIME (62) means the command timed out
-    status = SystemCommand(context, commandLine, timeoutSeconds, callback, log);
+    arguments[2] = (char*)command;
 
-    free(commandLine);
+    status = RunCommand(context, "/bin/sh", arguments, false, command, replaceEol, forJson, false, 0, timeoutSeconds, NULL, NULL, cancelDescriptor, outputCallback, log);
 
-    // Read the text result from the output of the command, if any, whether command succeeded or failed
-    if (NULL != textResult)
+    if (IsCommandLoggingEnabled())
     {
-        resultsFile = fopen(commandTextResultFile, "r");
-        if (resultsFile)
-        {
-            fseek(resultsFile, 0, SEEK_END);
-            fileSize = ftell(resultsFile);
-            fseek(resultsFile, 0, SEEK_SET);
+        OsConfigLogInfo(log, "ExecuteCommandWithOutputCallback(%s): status %d", command, status);
+    }
 
-            if (fileSize > 0)
-            {
-                // Truncate to desired maximum, if any
-                if ((maxTextResultBytes > 0) && ((fileSize + 1) > maxTextResultBytes))
-                {
-                    fileSize = (maxTextResultBytes > 1) ? (maxTextResultBytes - 1) : 0;
-                }
+    return status;
+}
 
-                *textResult = (char*)malloc(fileSize + 1);
-                if (NULL != *textResult)
-                {
-                    memset(*textResult, 0, fileSize + 1);
-                    for (i = 0; i < fileSize; i++)
-                    {
-                        next = fgetc(resultsFile);
-
-                        if (EOF == next)
-                        {
-                            break;
-                        }
-
-                        // Copy the data. Following characters are replaced with spaces:
-                        // all special characters from 0x00 to 0x1F except 0x0A (LF) when replaceEol is false
-                        // plus 0x22 (") and 0x5C (\) characters that break the JSON envelope when forJson is true
-                        if ((replaceEol && (EOL == next)) || ((next < 0x20) && (EOL != next)) || (0x7F == next) || (forJson && (('"' == next) || ('\\' == next))))
-                        {
-                            (*textResult)[i] = ' ';
-                        }
-                        else
-                        {
-                            (*textResult)[i] = (char)next;
-                        }
-                    }
-                }
-            }
+int ExecuteProgram(void* context, const char* const arguments[], bool replaceEol, bool forJson, unsigned int maxTextResultBytes, unsigned int timeoutSeconds, char** textResult, CommandCallback callback, void* log)
+{
+    int status = -1;
 
-            fclose(resultsFile);
-        }
+    if ((NULL == arguments) || (NULL == arguments[0]))
+    {
+        OsConfigLogError(log, "ExecuteProgram: invalid arguments");
+        return -1;
     }
 
-    remove(commandTextResultFile);
+    status = RunCommand(context, arguments[0], (char* const*)arguments, true, arguments[0], replaceEol, forJson, false, maxTextResultBytes, timeoutSeconds, textResult, callback, -1, NULL, log);
 
     if (IsCommandLoggingEnabled())
     {
-        OsConfigLogInfo(log, "Context: '%p'", context);
-        OsConfigLogInfo(log, "Command: '%s'", command);
-        OsConfigLogInfo(log, "Status: %d (errno: %d)", status, errno);
-        OsConfigLogInfo(log, "Text result: '%s'", (NULL != textResult) ? (*textResult) : "");
+        OsConfigLogInfo(log, "ExecuteProgram(%s): status %d, text result: '%s'", arguments[0], status, ((NULL != textResult) && (NULL != *textResult)) ? (*textResult) : "");
     }
 
     return status;
 }
 
+static void HashCommandOutput(void* context, const char* output, size_t outputSize)
+{
+    Sha256Update((SHA256_CONTEXT*)context, output, outputSize);
+}
+
 char* HashCommand(const char* source, void* log)
 {
-    static const char hashCommandTemplate[] = "%s | sha256sum | head -c 64";
-    
+    // Like the former 'source | sha256sum' pipeline, only the standard output is hashed, byte for byte as the command writes it
+    static const char hashCommandTemplate[] = "(%s) 2>/dev/null";
+
+    char* arguments[] = { "sh", "-c", NULL, NULL };
+    SHA256_CONTEXT context;
     char* command = NULL;
     char* hash = NULL;
+    int status = 0;
     int length = 0;
-    int status = -1;
 
     if (NULL == source)
     {
@@ -361,22 +554,36 @@ char* HashCommand(const char* source, void* log)
     }
 
     length = (int)(strlen(source) + strlen(hashCommandTemplate));
+    if ((size_t)length > (size_t)sysconf(_SC_ARG_MAX))
+    {
+        OsConfigLogError(log, "HashCommand: command too long");
+        return NULL;
+    }
+
     command = (char*)malloc(length);
     if (NULL != command)
     {
-        memset(command, 0, length);
         snprintf(command, length, hashCommandTemplate, source);
-        
-        status = ExecuteCommand(NULL, command, false, false, 0, 0, &hash, NULL, log);
-        if (0 != status)
+        arguments[2] = command;
+
+        Sha256Initialize(&context);
+
+        // The output of a command that fails is not hashed
+        if (0 == (status = RunCommand(&context, "/bin/sh", arguments, false, command, false, false, true, 0, 0, NULL, NULL, -1, HashCommandOutput, log)))
+        {
+            hash = Sha256FinalizeToString(&context);
+        }
+        else
         {
-            FREE_MEMORY(hash);
+            OsConfigLogError(log, "HashCommand: command failed with %d", status);
         }
+
+        FREE_MEMORY(command);
     }
     else
     {
         OsConfigLogError(log, "HashCommand: out of memory");
     }
 
-    return (0 == status) ? hash : NULL;
+    return hash;
 }
\ No newline at end of file
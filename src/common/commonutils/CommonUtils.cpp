@@ -2,6 +2,7 @@
 // Licensed under the MIT License.
 
 #include "Internal.h"
+#include "MimObjectSchema.h"
 
 size_t HashString(const char* source)
 {
@@ -87,6 +88,124 @@ bool IsValidClientName(const char* name)
     return isValid;
 }
 
+// Draft-04 JSON schema every MIM object payload must satisfy
+static const char g_mimObjectSchemaJson[] = R"""({
+  "$schema": "http://json-schema.org/draft-04/schema#",
+  "description": "MIM object JSON payload schema",
+  "definitions": {
+    "string": {
+      "type": "string"
+    },
+    "integer": {
+      "type": "integer"
+    },
+    "boolean": {
+      "type": "boolean"
+    },
+    "integerEnumeration": {
+      "type": "integer"
+    },
+    "stringArray": {
+      "type": "array",
+      "items": {
+        "type": "string"
+      }
+    },
+    "integerArray": {
+      "type": "array",
+      "items": {
+        "type": "integer"
+      }
+    },
+    "stringMap": {
+      "type": "object",
+      "additionalProperties": {
+        "type": ["string", "null"]
+      }
+    },
+    "integerMap": {
+      "type": "object",
+      "additionalProperties": {
+        "type": ["integer", "null"]
+      }
+    },
+    "object": {
+      "type": "object",
+      "additionalProperties": {
+        "anyOf": [
+          {
+            "$ref": "#/definitions/string"
+          },
+          {
+            "$ref": "#/definitions/integer"
+          },
+          {
+            "$ref": "#/definitions/boolean"
+          },
+          {
+            "$ref": "#/definitions/integerEnumeration"
+          },
+          {
+            "$ref": "#/definitions/stringArray"
+          },
+          {
+            "$ref": "#/definitions/integerArray"
+          },
+          {
+            "$ref": "#/definitions/stringMap"
+          },
+          {
+            "$ref": "#/definitions/integerMap"
+          }
+        ]
+      }
+    },
+    "objectArray": {
+      "type": "array",
+      "items": {
+        "$ref": "#/definitions/object"
+      }
+    }
+  },
+  "anyOf": [
+    {
+      "$ref": "#/definitions/string"
+    },
+    {
+      "$ref": "#/definitions/integer"
+    },
+    {
+      "$ref": "#/definitions/boolean"
+    },
+    {
+      "$ref": "#/definitions/object"
+    },
+    {
+      "$ref": "#/definitions/objectArray"
+    },
+    {
+      "$ref": "#/definitions/stringArray"
+    },
+    {
+      "$ref": "#/definitions/integerArray"
+    },
+    {
+      "$ref": "#/definitions/stringMap"
+    },
+    {
+      "$ref": "#/definitions/integerMap"
+    }
+  ]
+})""";
+
+// Compiled on first use and never modified afterwards, one schema serves concurrent validators on all threads
+const rapidjson::SchemaDocument& GetMimObjectSchema()
+{
+    static rapidjson::Document schemaDocument;
+    static const rapidjson::SchemaDocument schema(schemaDocument.Parse(g_mimObjectSchemaJson));
+    return schema;
+}
+
 bool IsValidMimObjectPayload(const char* payload, const int payloadSizeBytes, void* log)
 {
     if ((0 == payloadSizeBytes) || (nullptr == payload))
@@ -96,139 +215,26 @@ bool IsValidMimObjectPayload(const char* payload, const int payloadSizeBytes, vo
 
     bool isValid = true;
 
-    const char schemaJson[] = R"""({
-      "$schema": "http://json-schema.org/draft-04/schema#",
-      "description": "MIM object JSON payload schema",
-      "definitions": {
-        "string": {
-          "type": "string"
-        },
-        "integer": {
-          "type": "integer"
-        },
-        "boolean": {
-          "type": "boolean"
-        },
-        "integerEnumeration": {
-          "type": "integer"
-        },
-        "stringArray": {
-          "type": "array",
-          "items": {
-            "type": "string"
-          }
-        },
-        "integerArray": {
-          "type": "array",
-          "items": {
-            "type": "integer"
-          }
-        },
-        "stringMap": {
-          "type": "object",
-          "additionalProperties": {
-            "type": ["string", "null"]
-          }
-        },
-        "integerMap": {
-          "type": "object",
-          "additionalProperties": {
-            "type": ["integer", "null"]
-          }
-        },
-        "object": {
-          "type": "object",
-          "additionalProperties": {
-            "anyOf": [
-              {
-                "$ref": "#/definitions/string"
-              },
-              {
-                "$ref": "#/definitions/integer"
-              },
-              {
-                "$ref": "#/definitions/boolean"
-              },
-              {
-                "$ref": "#/definitions/integerEnumeration"
-              },
-              {
-                "$ref": "#/definitions/stringArray"
-              },
-              {
-                "$ref": "#/definitions/integerArray"
-              },
-              {
-                "$ref": "#/definitions/stringMap"
-              },
-              {
-                "$ref": "#/definitions/integerMap"
-              }
-            ]
-          }
-        },
-        "objectArray": {
-          "type": "array",
-          "items": {
-            "$ref": "#/definitions/object"
-          }
-        }
-      },
-      "anyOf": [
-        {
-          "$ref": "#/definitions/string"
-        },
-        {
-          "$ref": "#/definitions/integer"
-        },
-        {
-          "$ref": "#/definitions/boolean"
-        },
-        {
-          "$ref": "#/definitions/object"
-        },
-        {
-          "$ref": "#/definitions/objectArray"
-        },
-        {
-          "$ref": "#/definitions/stringArray"
-        },
-        {
-          "$ref": "#/definitions/integerArray"
-        },
-        {
-          "$ref": "#/definitions/stringMap"
-        },
-        {
-          "$ref": "#/definitions/integerMap"
-        }
-      ]
-    })""";
-
-    rapidjson::Document sd;
-    sd.Parse(schemaJson);
-    rapidjson::SchemaDocument schema(sd);
-    rapidjson::Document document;
+    // The payload is validated while it is parsed, in a single pass and without building a document
+    rapidjson::MemoryStream memoryStream(payload, payloadSizeBytes);
+    rapidjson::EncodedInputStream<rapidjson::UTF8<>, rapidjson::MemoryStream> stream(memoryStream);
+    rapidjson::SchemaValidator validator(GetMimObjectSchema());
+    rapidjson::Reader reader;
 
-    if (document.Parse(payload, payloadSizeBytes).HasParseError())
+    if (reader.Parse(stream, validator).IsError())
     {
-        if (IsFullLoggingEnabled())
-        {
-            OsConfigLogError(log, "MIM object JSON payload pcannot be parsed");
-        }
-        isValid = false;
-    }
-    else
-    {
-        rapidjson::SchemaValidator validator(schema);
-        if (!document.Accept(validator))
+        if (!validator.IsValid())
         {
             if (IsFullLoggingEnabled())
             {
                 OsConfigLogError(log, "MIM object JSON payload is invalid according to the schema");
             }
-            isValid = false;
         }
+        else if (IsFullLoggingEnabled())
+        {
+            OsConfigLogError(log, "MIM object JSON payload pcannot be parsed");
+        }
+        isValid = false;
     }
 
     if (IsFullLoggingEnabled() && (false == isValid))
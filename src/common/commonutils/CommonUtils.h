@@ -25,6 +25,44 @@
 #define EOL 10
 #endif
 
+#define MAX_MPI_URI_LENGTH 32
+
+// Largest HTTP header accepted, also the size of the read buffer kept per connection
+#define MAX_HTTP_HEADER_SIZE 8192
+
+typedef struct SOCKET_BUFFER
+{
+    int socketHandle;
+
+    // Bytes read from the socket and not yet consumed are data[start] to data[end - 1]
+    int start;
+    int end;
+    char data[MAX_HTTP_HEADER_SIZE];
+} SOCKET_BUFFER;
+
+#define SHA256_DIGEST_SIZE 32
+
+// Incremental SHA-256, blocks are hashed with the SHA instructions of the CPU when it has them
+typedef struct SHA256_CONTEXT
+{
+    unsigned int state[8];
+    unsigned long long length;
+    unsigned char block[64];
+    unsigned int blockSize;
+} SHA256_CONTEXT;
+
+typedef struct HTTP_HEADER
+{
+    // Request target without slashes (the MPI call name) for requests, empty for responses
+    char uri[MAX_MPI_URI_LENGTH];
+
+    // Status code for responses, 0 for requests
+    int status;
+
+    int contentLength;
+    bool keepAlive;
+} HTTP_HEADER;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -38,10 +76,22 @@ void SetCommandLogging(bool commandLogging);
 bool IsCommandLoggingEnabled(void);
 
 typedef int(*CommandCallback)(void* context);
+typedef void(*CommandOutputCallback)(void* context, const char* output, size_t outputSize);
 
-// If called from the main process thread the timeoutSeconds and callback arguments are ignored
+// Runs the command with /bin/sh -c, stdout and stderr are captured together into textResult. A timeout of 0 with no callback
+// waits for the command to finish, otherwise the command is killed with ETIME after the timeout (60 seconds when not set)
+// or with ECANCELED when the callback, called about every 5 seconds, returns non zero
 int ExecuteCommand(void* context, const char* command, bool replaceEol, bool forJson, unsigned int maxTextResultBytes, unsigned int timeoutSeconds, char** textResult, CommandCallback callback, void* log);
 
+// Same as ExecuteCommand, except that the output is not collected: it is handed to outputCallback, sanitized like the
+// text result, in chunks as the command writes it. Instead of a polled callback, the command is canceled with ECANCELED
+// as soon as cancelDescriptor (an eventfd for instance, -1 for none) becomes readable: its process group gets SIGTERM,
+// then SIGKILL after a second. Cancelable commands get the same default timeout as commands with a callback
+int ExecuteCommandWithOutputCallback(void* context, const char* command, bool replaceEol, bool forJson, unsigned int timeoutSeconds, int cancelDescriptor, CommandOutputCallback outputCallback, void* log);
+
+// Same as ExecuteCommand for a fixed program without a shell: arguments is null terminated and arguments[0] is looked up in PATH
+int ExecuteProgram(void* context, const char* const arguments[], bool replaceEol, bool forJson, unsigned int maxTextResultBytes, unsigned int timeoutSeconds, char** textResult, CommandCallback callback, void* log);
+
 int RestrictFileAccessToCurrentAccountOnly(const char* fileName);
 
 bool FileExists(const char* name);
@@ -50,8 +100,22 @@ char* DuplicateString(const char* source);
 
 size_t HashString(const char* source);
 
+// SHA-256 of the standard output of the command, as 64 lowercase hex characters like sha256sum prints it, NULL when the command fails
 char* HashCommand(const char* source, void* log);
 
+void Sha256Initialize(SHA256_CONTEXT* context);
+void Sha256Update(SHA256_CONTEXT* context, const void* data, size_t size);
+void Sha256Finalize(SHA256_CONTEXT* context, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+// Finalizes the context into the digest as 64 lowercase hex characters, the way sha256sum prints it
+char* Sha256FinalizeToString(SHA256_CONTEXT* context);
+
+// SHA-256 as 64 lowercase hex characters of a buffer, of a file, and of the contents of the files in a directory tree
+// with names ending in suffix (all files when null) taken in name order
+char* HashBuffer(const void* data, size_t size);
+char* HashFile(const char* fileName, void* log);
+char* HashDirectory(const char* directory, const char* suffix, void* log);
+
 bool IsValidClientName(const char* name);
 
 bool IsValidMimObjectPayload(const char* payload, const int payloadSizeBytes, void* log);
@@ -74,6 +138,11 @@ char* GetProductVersion(void* log);
 char* GetSystemCapabilities(void* log);
 char* GetSystemConfiguration(void* log);
 
+// Parsers behind the device information above: the value of a 'KEY=value' line of os-release for the key exactly, and the value
+// after the first ':' of the first line that contains the key (like 'grep -m 1 key') of lscpu, lshw and /proc/cpuinfo
+char* GetOsReleaseProperty(const char* osRelease, const char* key, bool truncateAtFirstSpace);
+char* GetListedProperty(const char* text, const char* key, bool truncateAtFirstSpace);
+
 void RemovePrefixBlanks(char* target);
 void RemovePrefixUpTo(char* target, char marker);
 void RemoveTrailingBlanks(char* target);
@@ -89,6 +158,11 @@ char* ReadUriFromSocket(int socketHandle, void* log);
 int ReadHttpStatusFromSocket(int socketHandle, void* log);
 int ReadHttpContentLengthFromSocket(int socketHandle, void* log);
 
+void InitializeSocketBuffer(SOCKET_BUFFER* buffer, int socketHandle);
+bool IsSocketBufferEmpty(const SOCKET_BUFFER* buffer);
+int ReadHttpHeaderFromSocketBuffer(SOCKET_BUFFER* buffer, HTTP_HEADER* header, void* log);
+int ReadHttpBodyFromSocketBuffer(SOCKET_BUFFER* buffer, char* body, int contentLength, void* log);
+
 int SleepMilliseconds(long milliseconds);
 
 bool IsDaemonActive(const char* name, void* log);
@@ -3,17 +3,14 @@
 
 #include "Internal.h"
 
-#define MAX_DAEMON_COMMAND_LENGTH 256
+// systemctl is run directly, with no shell in between and no command line to build from the daemon name
 
 bool IsDaemonActive(const char* name, void* log)
 {
-    const char* isActiveTemplate = "systemctl is-active %s";
-    char isActiveCommand[MAX_DAEMON_COMMAND_LENGTH] = {0};
+    const char* isActive[] = { "systemctl", "is-active", name, NULL };
     bool status = true;
 
-    snprintf(isActiveCommand, sizeof(isActiveCommand), isActiveTemplate, name);
-
-    if (ESRCH == ExecuteCommand(NULL, isActiveCommand, false, false, 0, 0, NULL, NULL, log))
+    if (ESRCH == ExecuteProgram(NULL, isActive, false, false, 0, 0, NULL, NULL, log))
     {
         status = false;
     }
@@ -23,21 +20,16 @@ bool IsDaemonActive(const char* name, void* log)
 
 bool EnableAndStartDaemon(const char* name, void* log)
 {
-    const char* enableTemplate = "systemctl enable %s";
-    const char* startTemplate = "systemctl start %s";
-    char enableCommand[MAX_DAEMON_COMMAND_LENGTH] = {0};
-    char startCommand[MAX_DAEMON_COMMAND_LENGTH] = {0};
+    const char* enable[] = { "systemctl", "enable", name, NULL };
+    const char* start[] = { "systemctl", "start", name, NULL };
     bool status = true;
 
     if (false == IsDaemonActive(name, log))
     {
-        snprintf(enableCommand, sizeof(enableCommand), enableTemplate, name);
-        snprintf(startCommand, sizeof(startCommand), startTemplate, name);
-
         OsConfigLogInfo(log, "Starting %s", name);
 
-        status = ((0 == ExecuteCommand(NULL, enableCommand, false, false, 0, 0, NULL, NULL, log)) &&
-            (0 == ExecuteCommand(NULL, startCommand, false, false, 0, 0, NULL, NULL, log)));
+        status = ((0 == ExecuteProgram(NULL, enable, false, false, 0, 0, NULL, NULL, log)) &&
+            (0 == ExecuteProgram(NULL, start, false, false, 0, 0, NULL, NULL, log)));
     }
 
     return status;
@@ -45,15 +37,9 @@ bool EnableAndStartDaemon(const char* name, void* log)
 
 void StopAndDisableDaemon(const char* name, void* log)
 {
-    const char* stopTemplate = "sudo systemctl stop %s";
-    const char* disableTemplate = "sudo systemctl disable %s";
-    char stopCommand[MAX_DAEMON_COMMAND_LENGTH] = {0};
-    char disableCommand[MAX_DAEMON_COMMAND_LENGTH] = {0};
-    bool status = true;
+    const char* stop[] = { "sudo", "systemctl", "stop", name, NULL };
+    const char* disable[] = { "sudo", "systemctl", "disable", name, NULL };
 
-    snprintf(stopCommand, sizeof(stopCommand), stopTemplate, name);
-    snprintf(disableCommand, sizeof(disableCommand), disableTemplate, name);
-
-    ExecuteCommand(NULL, stopCommand, false, false, 0, 0, NULL, NULL, log);
-    ExecuteCommand(NULL, disableCommand, false, false, 0, 0, NULL, NULL, log);
-}
\ No newline at end of file
+    ExecuteProgram(NULL, stop, false, false, 0, 0, NULL, NULL, log);
+    ExecuteProgram(NULL, disable, false, false, 0, 0, NULL, NULL, log);
+}
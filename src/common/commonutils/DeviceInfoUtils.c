@@ -2,6 +2,10 @@
 // Licensed under the MIT License.
 
 #include "Internal.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/sysinfo.h>
+#include <sys/utsname.h>
 
 void RemovePrefixBlanks(char* target)
 {
@@ -73,122 +77,188 @@ void TruncateAtFirst(char* target, char marker)
     }
 }
 
-char* GetOsName(void* log)
+#define OS_RELEASE_FILE "/etc/os-release"
+#define CPU_INFO_FILE "/proc/cpuinfo"
+#define DMI_ID_DIRECTORY "/sys/devices/virtual/dmi/id/"
+
+// Large enough for os-release and the first processor of cpuinfo, the only one read
+#define DEVICE_INFO_FILE_SIZE 8192
+
+// lshw takes seconds, the system class is queried once for all the properties that need it
+static char* g_lshwSystem = NULL;
+static bool g_lshwSystemQueried = false;
+static pthread_mutex_t g_lshwSystemMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Reads up to size - 1 bytes of the file into buffer, proc and sysfs files report no size so this reads until end of file
+static ssize_t ReadDeviceInfoFile(const char* fileName, char* buffer, size_t size)
 {
-    const char* osNameCommand = "cat /etc/os-release | grep ID=";
-    const char* osPrettyNameCommand = "cat /etc/os-release | grep PRETTY_NAME=";
-    char* textResult = NULL;
+    ssize_t length = 0;
+    ssize_t bytes = 0;
+    int file = -1;
 
-    if (0 == ExecuteCommand(NULL, osPrettyNameCommand, true, true, 0, 0, &textResult, NULL, log))
+    if (0 > (file = open(fileName, O_RDONLY | O_CLOEXEC)))
     {
-        RemovePrefixBlanks(textResult);
-        RemoveTrailingBlanks(textResult);
-        RemovePrefixUpTo(textResult, '=');
-        RemovePrefixBlanks(textResult);
-        
-        // Comment next line to capture the full pretty name including version (example: 'Ubuntu 20.04.3 LTS')
-        TruncateAtFirst(textResult, ' ');
-    }
-    else if (0 == ExecuteCommand(NULL, osNameCommand, true, true, 0, 0, &textResult, NULL, log))
-    {
-        // PRETTY_NAME did not work, try ID
-        RemovePrefixBlanks(textResult);
-        RemoveTrailingBlanks(textResult);
-        RemovePrefixUpTo(textResult, '=');
-        RemovePrefixBlanks(textResult);
-        TruncateAtFirst(textResult, ' ');
-    }
-    else    
-    {
-        FREE_MEMORY(textResult);
+        return -1;
     }
 
-    if (IsFullLoggingEnabled())
+    while (((size_t)length < (size - 1)) && (0 != (bytes = read(file, buffer + length, size - 1 - length))))
     {
-        OsConfigLogInfo(log, "OS name: '%s'", textResult);
+        if (bytes < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            break;
+        }
+        length += bytes;
     }
-    
-    return textResult;
+
+    close(file);
+    buffer[length] = 0;
+
+    return length;
 }
 
-char* GetOsVersion(void* log)
+// Copies the value the way the former shell pipelines returned it: control characters and the JSON breaking '"' and '\'
+// characters become spaces, then blanks around the value are removed and, when requested, all from the first space
+static char* CopyDeviceInfoValue(const char* value, size_t length, bool truncateAtFirstSpace)
 {
-    const char* osVersionCommand = "cat /etc/os-release | grep VERSION=";
-    char* textResult = NULL;
+    char* result = NULL;
+    size_t i = 0;
 
-    if (0 == ExecuteCommand(NULL, osVersionCommand, true, true, 0, 0, &textResult, NULL, log))
+    if (NULL == (result = (char*)malloc(length + 1)))
     {
-        RemovePrefixBlanks(textResult);
-        RemoveTrailingBlanks(textResult);
-        RemovePrefixUpTo(textResult, '=');
-        RemovePrefixBlanks(textResult);
-        TruncateAtFirst(textResult, ' ');
+        return NULL;
     }
-    else
+
+    for (i = 0; i < length; i++)
     {
-        FREE_MEMORY(textResult);
+        result[i] = ((value[i] >= 0) && (value[i] < 0x20)) || (0x7F == value[i]) || ('"' == value[i]) || ('\\' == value[i]) ? ' ' : value[i];
     }
+    result[length] = 0;
 
-    if (IsFullLoggingEnabled())
+    RemovePrefixBlanks(result);
+    if (truncateAtFirstSpace)
     {
-        OsConfigLogInfo(log, "OS version: '%s'", textResult);
+        TruncateAtFirst(result, ' ');
+    }
+    else
+    {
+        RemoveTrailingBlanks(result);
     }
 
-    return textResult;
+    return result;
 }
 
-static char* GetHardwareProperty(const char* command, bool truncateAtFirstSpace, void* log)
+// Value of a 'KEY=value' line of os-release, for the key exactly
+char* GetOsReleaseProperty(const char* osRelease, const char* key, bool truncateAtFirstSpace)
 {
-    char* textResult = NULL;
+    size_t keyLength = strlen(key);
+    const char* line = osRelease;
+    const char* end = NULL;
 
-    if (0 == ExecuteCommand(NULL, command, true, true, 0, 0, &textResult, NULL, log))
+    while ((NULL != line) && (0 != *line))
     {
-        RemovePrefixUpTo(textResult, ':');
-        RemovePrefixBlanks(textResult);
-        
-        if (truncateAtFirstSpace)
-        {
-            TruncateAtFirst(textResult, ' ');
-        }
-        else
+        end = strchr(line, EOL);
+
+        if ((0 == strncmp(line, key, keyLength)) && ('=' == line[keyLength]))
         {
-            RemoveTrailingBlanks(textResult);
+            line += keyLength + 1;
+            return CopyDeviceInfoValue(line, end ? (size_t)(end - line) : strlen(line), truncateAtFirstSpace);
         }
+
+        line = end ? (end + 1) : NULL;
     }
-    else
+
+    return NULL;
+}
+
+// Value after the first ':' of the first line that contains the key, like 'grep -m 1 key' did on the output of lscpu and lshw
+char* GetListedProperty(const char* text, const char* key, bool truncateAtFirstSpace)
+{
+    const char* found = NULL;
+    const char* line = NULL;
+    const char* end = NULL;
+    const char* separator = NULL;
+
+    if ((NULL == text) || (NULL == (found = strstr(text, key))))
     {
-        FREE_MEMORY(textResult);
+        return NULL;
     }
 
-    return textResult;
+    for (line = found; (line > text) && (EOL != line[-1]); line--);
+    end = strchr(found, EOL);
+    end = end ? end : (found + strlen(found));
+
+    if ((NULL == (separator = memchr(line, ':', end - line))))
+    {
+        separator = line - 1;
+    }
+
+    return CopyDeviceInfoValue(separator + 1, end - separator - 1, truncateAtFirstSpace);
 }
 
-static char* GetAnotherOsProperty(const char* command, void* log)
+static char* GetOsReleaseValue(const char* key, const char* alternateKey, void* log)
 {
-    char* textResult = NULL;
-    
-    if (NULL == command)
+    char osRelease[DEVICE_INFO_FILE_SIZE];
+    char* value = NULL;
+
+    if (0 > ReadDeviceInfoFile(OS_RELEASE_FILE, osRelease, sizeof(osRelease)))
     {
+        OsConfigLogError(log, "Cannot read '%s' (%d)", OS_RELEASE_FILE, errno);
         return NULL;
     }
 
-    if (0 == ExecuteCommand(NULL, command, true, true, 0, 0, &textResult, NULL, log))
+    if ((NULL == (value = GetOsReleaseProperty(osRelease, key, true))) && (NULL != alternateKey))
     {
-        RemovePrefixBlanks(textResult);
-        RemoveTrailingBlanks(textResult);
+        value = GetOsReleaseProperty(osRelease, alternateKey, true);
     }
-    else
+
+    return value;
+}
+
+char* GetOsName(void* log)
+{
+    // Only the first word of PRETTY_NAME ('Ubuntu' of 'Ubuntu 20.04.3 LTS'), or of ID when there is no pretty name
+    char* textResult = GetOsReleaseValue("PRETTY_NAME", "ID", log);
+
+    if (IsFullLoggingEnabled())
     {
-        FREE_MEMORY(textResult);
+        OsConfigLogInfo(log, "OS name: '%s'", textResult);
+    }
+    
+    return textResult;
+}
+
+char* GetOsVersion(void* log)
+{
+    char* textResult = GetOsReleaseValue("VERSION", NULL, log);
+
+    if (IsFullLoggingEnabled())
+    {
+        OsConfigLogInfo(log, "OS version: '%s'", textResult);
     }
 
     return textResult;
 }
 
+static char* GetUnameProperty(size_t offset, void* log)
+{
+    struct utsname name;
+
+    if (0 != uname(&name))
+    {
+        OsConfigLogError(log, "uname failed (%d)", errno);
+        return NULL;
+    }
+
+    return CopyDeviceInfoValue((const char*)&name + offset, strlen((const char*)&name + offset), false);
+}
+
 char* GetOsKernelName(void* log)
 {
-    static char* osKernelNameCommand = "uname -s";
-    char* textResult = GetAnotherOsProperty(osKernelNameCommand, log);
+    char* textResult = GetUnameProperty(offsetof(struct utsname, sysname), log);
     
     if (IsFullLoggingEnabled())
     {
@@ -200,8 +270,7 @@ char* GetOsKernelName(void* log)
 
 char* GetOsKernelRelease(void* log)
 {
-    static char* osKernelReleaseCommand = "uname -r";
-    char* textResult = GetAnotherOsProperty(osKernelReleaseCommand, log);
+    char* textResult = GetUnameProperty(offsetof(struct utsname, release), log);
     
     if (IsFullLoggingEnabled())
     {
@@ -213,8 +282,7 @@ char* GetOsKernelRelease(void* log)
 
 char* GetOsKernelVersion(void* log)
 {
-    static char* osKernelVersionCommand = "uname -v";
-    char* textResult = GetAnotherOsProperty(osKernelVersionCommand, log);
+    char* textResult = GetUnameProperty(offsetof(struct utsname, version), log);
     
     if (IsFullLoggingEnabled())
     {
@@ -224,10 +292,31 @@ char* GetOsKernelVersion(void* log)
     return textResult;
 }
 
+// The property of the first processor in cpuinfo. Architectures whose cpuinfo lacks it (such as ARM, where lscpu
+// names the vendor and model from its own tables) fall back to lscpu
+static char* GetCpuProperty(const char* cpuInfoKey, const char* lscpuKey, void* log)
+{
+    const char* lscpu[] = { "lscpu", NULL };
+    char cpuInfo[DEVICE_INFO_FILE_SIZE];
+    char* textResult = NULL;
+    char* value = NULL;
+
+    if ((0 > ReadDeviceInfoFile(CPU_INFO_FILE, cpuInfo, sizeof(cpuInfo))) || (NULL == (value = GetListedProperty(cpuInfo, cpuInfoKey, false))))
+    {
+        if (0 == ExecuteProgram(NULL, lscpu, false, false, 0, 0, &textResult, NULL, log))
+        {
+            value = GetListedProperty(textResult, lscpuKey, false);
+        }
+        FREE_MEMORY(textResult);
+    }
+
+    return value;
+}
+
 char* GetCpuType(void* log)
 {
-    const char* osCpuTypeCommand = "lscpu | grep Architecture:";
-    char* textResult = GetHardwareProperty(osCpuTypeCommand, false, log);
+    // What lscpu reports as the architecture
+    char* textResult = GetUnameProperty(offsetof(struct utsname, machine), log);
     
     if (IsFullLoggingEnabled())
     {
@@ -239,8 +328,7 @@ char* GetCpuType(void* log)
 
 char* GetCpuVendor(void* log)
 {
-    const char* osCpuVendorCommand = "lscpu | grep \"Vendor ID:\"";
-    char* textResult = GetHardwareProperty(osCpuVendorCommand, false, log);
+    char* textResult = GetCpuProperty("vendor_id", "Vendor ID:", log);
     
     if (IsFullLoggingEnabled())
     {
@@ -252,8 +340,7 @@ char* GetCpuVendor(void* log)
 
 char* GetCpuModel(void* log)
 {
-    const char* osCpuModelCommand = "lscpu | grep \"Model name:\"";
-    char* textResult = GetHardwareProperty(osCpuModelCommand, false, log);
+    char* textResult = GetCpuProperty("model name", "Model name:", log);
     
     if (IsFullLoggingEnabled())
     {
@@ -263,16 +350,23 @@ char* GetCpuModel(void* log)
     return textResult;
 }
 
-long GetTotalMemory(void* log)
+// MemTotal and MemFree of /proc/meminfo in kB, as sysinfo reports them
+static long GetMemory(bool total, void* log)
 {
-    const char* osTotalMemoryCommand = "grep MemTotal /proc/meminfo";
-    char* textResult = GetHardwareProperty(osTotalMemoryCommand, true, log);
-    long totalMemory = 0;
-    
-    if (NULL != textResult)
+    struct sysinfo info;
+
+    if (0 != sysinfo(&info))
     {
-        totalMemory = atol(textResult);
+        OsConfigLogError(log, "sysinfo failed (%d)", errno);
+        return 0;
     }
+
+    return (long)(((unsigned long long)(total ? info.totalram : info.freeram) * info.mem_unit) / 1024);
+}
+
+long GetTotalMemory(void* log)
+{
+    long totalMemory = GetMemory(true, log);
     
     if (IsFullLoggingEnabled())
     {
@@ -284,14 +378,7 @@ long GetTotalMemory(void* log)
 
 long GetFreeMemory(void* log)
 {
-    const char* osFreeMemoryCommand = "grep MemFree /proc/meminfo";
-    char* textResult = GetHardwareProperty(osFreeMemoryCommand, true, log);
-    long freeMemory = 0;
-    
-    if (NULL != textResult)
-    {
-        freeMemory = atol(textResult);
-    }
+    long freeMemory = GetMemory(false, log);
 
     if (IsFullLoggingEnabled())
     {
@@ -301,16 +388,54 @@ long GetFreeMemory(void* log)
     return freeMemory;
 }
 
-char* GetProductName(void* log)
+// Property of 'lshw -c system', run once and kept for the life of the process
+static char* GetSystemProperty(const char* key, void* log)
 {
-    const char* osProductNameCommand = "cat /sys/devices/virtual/dmi/id/product_name";
-    const char* osProductNameAlternateCommand = "lshw -c system | grep -m 1 \"product:\"";
-    char* textResult = GetAnotherOsProperty(osProductNameCommand, log);
-    
-    if ((NULL == textResult) || (0 == strlen(textResult)))
+    const char* lshw[] = { "lshw", "-c", "system", NULL };
+    char* value = NULL;
+
+    pthread_mutex_lock(&g_lshwSystemMutex);
+
+    if (false == g_lshwSystemQueried)
+    {
+        if (0 != ExecuteProgram(NULL, lshw, false, false, 0, 0, &g_lshwSystem, NULL, log))
+        {
+            FREE_MEMORY(g_lshwSystem);
+        }
+        g_lshwSystemQueried = true;
+    }
+
+    value = GetListedProperty(g_lshwSystem, key, false);
+
+    pthread_mutex_unlock(&g_lshwSystemMutex);
+
+    return value;
+}
+
+// DMI identification from sysfs, which lshw also reads, falling back to lshw
+static char* GetProductProperty(const char* dmiFileName, const char* lshwKey, void* log)
+{
+    char dmiValue[256];
+    char* value = NULL;
+    ssize_t length = 0;
+
+    if (0 < (length = ReadDeviceInfoFile(dmiFileName, dmiValue, sizeof(dmiValue))))
+    {
+        value = CopyDeviceInfoValue(dmiValue, (size_t)length, false);
+    }
+
+    if ((NULL == value) || (0 == strlen(value)))
     {
-        textResult = GetHardwareProperty(osProductNameAlternateCommand, false, log);
+        FREE_MEMORY(value);
+        value = GetSystemProperty(lshwKey, log);
     }
+
+    return value;
+}
+
+char* GetProductName(void* log)
+{
+    char* textResult = GetProductProperty(DMI_ID_DIRECTORY "product_name", "product:", log);
     
     if (IsFullLoggingEnabled())
     {
@@ -322,14 +447,7 @@ char* GetProductName(void* log)
 
 char* GetProductVendor(void* log)
 {
-    const char* osProductVendorCommand = "cat /sys/devices/virtual/dmi/id/sys_vendor";
-    const char* osProductVendorAlternateCommand = "lshw -c system | grep -m 1 \"vendor:\"";
-    char* textResult = GetAnotherOsProperty(osProductVendorCommand, log);
-
-    if ((NULL == textResult) || (0 == strlen(textResult)))
-    {
-        textResult = GetHardwareProperty(osProductVendorAlternateCommand, false, log);
-    }
+    char* textResult = GetProductProperty(DMI_ID_DIRECTORY "sys_vendor", "vendor:", log);
     
     if (IsFullLoggingEnabled())
     {
@@ -341,14 +459,7 @@ char* GetProductVendor(void* log)
 
 char* GetProductVersion(void* log)
 {
-    const char* osProductVersionCommand = "cat /sys/devices/virtual/dmi/id/product_version";
-    const char* osProductVersionAlternateCommand = "lshw -c system | grep -m 1 \"version:\"";
-    char* textResult = GetHardwareProperty(osProductVersionCommand, false, log);
-
-    if ((NULL == textResult) || (0 == strlen(textResult)))
-    {
-        textResult = GetHardwareProperty(osProductVersionAlternateCommand, false, log);
-    }
+    char* textResult = GetProductProperty(DMI_ID_DIRECTORY "product_version", "version:", log);
 
     if (IsFullLoggingEnabled())
     {
@@ -360,8 +471,7 @@ char* GetProductVersion(void* log)
 
 char* GetSystemCapabilities(void* log)
 {
-    const char* osSystemCapabilitiesCommand = "lshw -c system | grep -m 1 \"capabilities:\"";
-    char* textResult = GetHardwareProperty(osSystemCapabilitiesCommand, false, log);
+    char* textResult = GetSystemProperty("capabilities:", log);
 
     if (IsFullLoggingEnabled())
     {
@@ -373,8 +483,7 @@ char* GetSystemCapabilities(void* log)
 
 char* GetSystemConfiguration(void* log)
 {
-    const char* osSystemConfigurationCommand = "lshw -c system | grep -m 1 \"configuration:\"";
-    char* textResult = GetHardwareProperty(osSystemConfigurationCommand, false, log);
+    char* textResult = GetSystemProperty("configuration:", log);
 
     if (IsFullLoggingEnabled())
     {
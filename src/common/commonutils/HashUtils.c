@@ -0,0 +1,466 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "Internal.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA256_X86_EXTENSIONS
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define SHA256_ARM_EXTENSIONS
+#endif
+
+#define SHA256_BLOCK_SIZE 64
+
+// Files are hashed through a buffer when they cannot be mapped (such as proc files), and directories through this much of a path
+#define HASH_READ_SIZE 65536
+#define HASH_PATH_LENGTH 4096
+
+typedef void(*SHA256_BLOCKS)(unsigned int state[8], const unsigned char* data, size_t blocks);
+
+static const unsigned int g_sha256RoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static SHA256_BLOCKS g_sha256Blocks = NULL;
+static pthread_once_t g_sha256Once = PTHREAD_ONCE_INIT;
+
+#define ROTATE_RIGHT(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void Sha256BlocksPortable(unsigned int state[8], const unsigned char* data, size_t blocks)
+{
+    unsigned int schedule[64];
+    unsigned int a, b, c, d, e, f, g, h, t1, t2;
+    int i = 0;
+
+    while (blocks--)
+    {
+        for (i = 0; i < 16; i++)
+        {
+            schedule[i] = ((unsigned int)data[i * 4] << 24) | ((unsigned int)data[i * 4 + 1] << 16) | ((unsigned int)data[i * 4 + 2] << 8) | data[i * 4 + 3];
+        }
+
+        for (i = 16; i < 64; i++)
+        {
+            t1 = schedule[i - 2];
+            t2 = schedule[i - 15];
+            schedule[i] = (ROTATE_RIGHT(t1, 17) ^ ROTATE_RIGHT(t1, 19) ^ (t1 >> 10)) + schedule[i - 7] +
+                (ROTATE_RIGHT(t2, 7) ^ ROTATE_RIGHT(t2, 18) ^ (t2 >> 3)) + schedule[i - 16];
+        }
+
+        a = state[0];
+        b = state[1];
+        c = state[2];
+        d = state[3];
+        e = state[4];
+        f = state[5];
+        g = state[6];
+        h = state[7];
+
+        for (i = 0; i < 64; i++)
+        {
+            t1 = h + (ROTATE_RIGHT(e, 6) ^ ROTATE_RIGHT(e, 11) ^ ROTATE_RIGHT(e, 25)) + ((e & f) ^ (~e & g)) + g_sha256RoundConstants[i] + schedule[i];
+            t2 = (ROTATE_RIGHT(a, 2) ^ ROTATE_RIGHT(a, 13) ^ ROTATE_RIGHT(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+
+        data += SHA256_BLOCK_SIZE;
+    }
+}
+
+#if defined(SHA256_X86_EXTENSIONS)
+// SHA extensions (SHA-NI), 4 rounds per pair of sha256rnds2 with the state kept as ABEF and CDGH
+__attribute__((target("sha,sse4.1")))
+static void Sha256BlocksX86(unsigned int state[8], const unsigned char* data, size_t blocks)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i schedule[16];
+    __m128i state0, state1, saved0, saved1, message, swapped;
+    int i = 0;
+
+    swapped = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+    state0 = _mm_alignr_epi8(swapped, state1, 8);
+    state1 = _mm_blend_epi16(state1, swapped, 0xF0);
+
+    while (blocks--)
+    {
+        saved0 = state0;
+        saved1 = state1;
+
+        for (i = 0; i < 16; i++)
+        {
+            if (i < 4)
+            {
+                schedule[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + (i * 16))), byteSwap);
+            }
+            else
+            {
+                schedule[i] = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(schedule[i - 4], schedule[i - 3]),
+                    _mm_alignr_epi8(schedule[i - 1], schedule[i - 2], 4)), schedule[i - 1]);
+            }
+
+            message = _mm_add_epi32(schedule[i], _mm_loadu_si128((const __m128i*)&g_sha256RoundConstants[i * 4]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(message, 0x0E));
+        }
+
+        state0 = _mm_add_epi32(state0, saved0);
+        state1 = _mm_add_epi32(state1, saved1);
+
+        data += SHA256_BLOCK_SIZE;
+    }
+
+    swapped = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(swapped, state1, 0xF0));
+    _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, swapped, 8));
+}
+#elif defined(SHA256_ARM_EXTENSIONS)
+// ARMv8 cryptography extensions, 4 rounds per sha256h/sha256h2 pair
+__attribute__((target("+crypto")))
+static void Sha256BlocksArm(unsigned int state[8], const unsigned char* data, size_t blocks)
+{
+    uint32x4_t schedule[16];
+    uint32x4_t state0, state1, saved0, saved1, message, previous;
+    int i = 0;
+
+    state0 = vld1q_u32(&state[0]);
+    state1 = vld1q_u32(&state[4]);
+
+    while (blocks--)
+    {
+        saved0 = state0;
+        saved1 = state1;
+
+        for (i = 0; i < 16; i++)
+        {
+            if (i < 4)
+            {
+                schedule[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + (i * 16))));
+            }
+            else
+            {
+                schedule[i] = vsha256su1q_u32(vsha256su0q_u32(schedule[i - 4], schedule[i - 3]), schedule[i - 2], schedule[i - 1]);
+            }
+
+            message = vaddq_u32(schedule[i], vld1q_u32(&g_sha256RoundConstants[i * 4]));
+            previous = state0;
+            state0 = vsha256hq_u32(state0, state1, message);
+            state1 = vsha256h2q_u32(state1, previous, message);
+        }
+
+        state0 = vaddq_u32(state0, saved0);
+        state1 = vaddq_u32(state1, saved1);
+
+        data += SHA256_BLOCK_SIZE;
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+#endif
+
+static void SelectSha256Blocks(void)
+{
+#if defined(SHA256_X86_EXTENSIONS)
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    bool sse41 = (0 != __get_cpuid(1, &eax, &ebx, &ecx, &edx)) && (0 != (ecx & bit_SSE4_1));
+
+    if (sse41 && (0 != __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) && (0 != (ebx & bit_SHA)))
+    {
+        g_sha256Blocks = Sha256BlocksX86;
+        return;
+    }
+#elif defined(SHA256_ARM_EXTENSIONS)
+    if (0 != (getauxval(AT_HWCAP) & HWCAP_SHA2))
+    {
+        g_sha256Blocks = Sha256BlocksArm;
+        return;
+    }
+#endif
+
+    g_sha256Blocks = Sha256BlocksPortable;
+}
+
+void Sha256Initialize(SHA256_CONTEXT* context)
+{
+    static const unsigned int initialState[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+    pthread_once(&g_sha256Once, SelectSha256Blocks);
+
+    memcpy(context->state, initialState, sizeof(initialState));
+    context->length = 0;
+    context->blockSize = 0;
+}
+
+void Sha256Update(SHA256_CONTEXT* context, const void* data, size_t size)
+{
+    const unsigned char* next = (const unsigned char*)data;
+    size_t copied = 0;
+
+    if ((NULL == next) || (0 == size))
+    {
+        return;
+    }
+
+    context->length += size;
+
+    if (context->blockSize > 0)
+    {
+        copied = SHA256_BLOCK_SIZE - context->blockSize;
+        copied = (copied < size) ? copied : size;
+        memcpy(context->block + context->blockSize, next, copied);
+        context->blockSize += (unsigned int)copied;
+        next += copied;
+        size -= copied;
+
+        if (SHA256_BLOCK_SIZE == context->blockSize)
+        {
+            g_sha256Blocks(context->state, context->block, 1);
+            context->blockSize = 0;
+        }
+    }
+
+    // Whole blocks are hashed straight from the caller's data
+    if (size >= SHA256_BLOCK_SIZE)
+    {
+        g_sha256Blocks(context->state, next, size / SHA256_BLOCK_SIZE);
+        next += size - (size % SHA256_BLOCK_SIZE);
+        size %= SHA256_BLOCK_SIZE;
+    }
+
+    if (size > 0)
+    {
+        memcpy(context->block, next, size);
+        context->blockSize = (unsigned int)size;
+    }
+}
+
+void Sha256Finalize(SHA256_CONTEXT* context, unsigned char digest[SHA256_DIGEST_SIZE])
+{
+    unsigned long long bits = context->length * 8;
+    int i = 0;
+
+    context->block[context->blockSize++] = 0x80;
+
+    if (context->blockSize > (SHA256_BLOCK_SIZE - 8))
+    {
+        memset(context->block + context->blockSize, 0, SHA256_BLOCK_SIZE - context->blockSize);
+        g_sha256Blocks(context->state, context->block, 1);
+        context->blockSize = 0;
+    }
+
+    memset(context->block + context->blockSize, 0, SHA256_BLOCK_SIZE - 8 - context->blockSize);
+    for (i = 0; i < 8; i++)
+    {
+        context->block[SHA256_BLOCK_SIZE - 1 - i] = (unsigned char)(bits >> (i * 8));
+    }
+    g_sha256Blocks(context->state, context->block, 1);
+
+    for (i = 0; i < 8; i++)
+    {
+        digest[i * 4] = (unsigned char)(context->state[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(context->state[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(context->state[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)context->state[i];
+    }
+}
+
+char* Sha256FinalizeToString(SHA256_CONTEXT* context)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char* hash = NULL;
+    int i = 0;
+
+    Sha256Finalize(context, digest);
+
+    if (NULL != (hash = (char*)malloc((SHA256_DIGEST_SIZE * 2) + 1)))
+    {
+        for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+        {
+            hash[i * 2] = hexDigits[digest[i] >> 4];
+            hash[i * 2 + 1] = hexDigits[digest[i] & 0x0F];
+        }
+        hash[SHA256_DIGEST_SIZE * 2] = 0;
+    }
+
+    return hash;
+}
+
+char* HashBuffer(const void* data, size_t size)
+{
+    SHA256_CONTEXT context;
+
+    Sha256Initialize(&context);
+    Sha256Update(&context, data, size);
+
+    return Sha256FinalizeToString(&context);
+}
+
+static int UpdateWithFile(SHA256_CONTEXT* context, const char* fileName)
+{
+    struct stat fileStat;
+    unsigned char* contents = NULL;
+    ssize_t bytes = 0;
+    int file = -1;
+    int status = 0;
+
+    if (0 > (file = open(fileName, O_RDONLY | O_CLOEXEC)))
+    {
+        return errno;
+    }
+
+    if ((0 == fstat(file, &fileStat)) && S_ISREG(fileStat.st_mode) && (fileStat.st_size > 0) &&
+        (MAP_FAILED != (contents = (unsigned char*)mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0))))
+    {
+        madvise(contents, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+        Sha256Update(context, contents, (size_t)fileStat.st_size);
+        munmap(contents, (size_t)fileStat.st_size);
+    }
+    else if (NULL != (contents = (unsigned char*)malloc(HASH_READ_SIZE)))
+    {
+        while (0 != (bytes = read(file, contents, HASH_READ_SIZE)))
+        {
+            if (bytes < 0)
+            {
+                if (EINTR == errno)
+                {
+                    continue;
+                }
+                status = errno;
+                break;
+            }
+            Sha256Update(context, contents, (size_t)bytes);
+        }
+        FREE_MEMORY(contents);
+    }
+    else
+    {
+        status = ENOMEM;
+    }
+
+    close(file);
+
+    return status;
+}
+
+char* HashFile(const char* fileName, void* log)
+{
+    SHA256_CONTEXT context;
+    int status = 0;
+
+    if (NULL == fileName)
+    {
+        return NULL;
+    }
+
+    Sha256Initialize(&context);
+
+    if (0 != (status = UpdateWithFile(&context, fileName)))
+    {
+        OsConfigLogError(log, "HashFile: cannot read '%s' (%d)", fileName, status);
+        return NULL;
+    }
+
+    return Sha256FinalizeToString(&context);
+}
+
+static bool HasSuffix(const char* name, const char* suffix)
+{
+    size_t nameLength = strlen(name);
+    size_t suffixLength = strlen(suffix);
+
+    return (nameLength >= suffixLength) && (0 == strcmp(name + nameLength - suffixLength, suffix));
+}
+
+// Contents of the matching regular files in the directory and its subdirectories, in name order so the hash is stable
+static int UpdateWithDirectory(SHA256_CONTEXT* context, const char* directory, const char* suffix, void* log)
+{
+    struct dirent** entries = NULL;
+    struct stat entryStat;
+    char path[HASH_PATH_LENGTH];
+    int count = 0;
+    int status = 0;
+    int i = 0;
+
+    if (0 > (count = scandir(directory, &entries, NULL, alphasort)))
+    {
+        return errno;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if ((0 == status) && (0 != strcmp(entries[i]->d_name, ".")) && (0 != strcmp(entries[i]->d_name, "..")) &&
+            (snprintf(path, sizeof(path), "%s/%s", directory, entries[i]->d_name) < (int)sizeof(path)) && (0 == lstat(path, &entryStat)))
+        {
+            if (S_ISDIR(entryStat.st_mode))
+            {
+                status = UpdateWithDirectory(context, path, suffix, log);
+            }
+            else if (S_ISREG(entryStat.st_mode) && ((NULL == suffix) || HasSuffix(entries[i]->d_name, suffix)) && (0 != (status = UpdateWithFile(context, path))))
+            {
+                OsConfigLogError(log, "HashDirectory: cannot read '%s' (%d)", path, status);
+            }
+        }
+
+        free(entries[i]);
+    }
+
+    free(entries);
+
+    return status;
+}
+
+char* HashDirectory(const char* directory, const char* suffix, void* log)
+{
+    SHA256_CONTEXT context;
+    int status = 0;
+
+    if (NULL == directory)
+    {
+        return NULL;
+    }
+
+    Sha256Initialize(&context);
+
+    if (0 != (status = UpdateWithDirectory(&context, directory, suffix, log)))
+    {
+        OsConfigLogError(log, "HashDirectory: cannot hash '%s' (%d)", directory, status);
+        return NULL;
+    }
+
+    return Sha256FinalizeToString(&context);
+}
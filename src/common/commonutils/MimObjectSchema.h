@@ -0,0 +1,12 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef MIMOBJECTSCHEMA_H
+#define MIMOBJECTSCHEMA_H
+#include <rapidjson/schema.h>
+
+// The schema IsValidMimObjectPayload validates with, compiled once and shared by all threads.
+// A SchemaValidator built from it can validate MIM objects while a larger document is being parsed.
+const rapidjson::SchemaDocument& GetMimObjectSchema();
+
+#endif // MIMOBJECTSCHEMA_H
@@ -2,15 +2,17 @@
 // Licensed under the MIT License.
 
 #include "Internal.h"
+#include <limits.h>
 
-#define MAX_MPI_URI_LENGTH 32
-
+// Legacy unbuffered readers below must not consume past what they parse, these read one byte at a time
 static char* ReadUntilStringFound(int socketHandle, const char* what, void* log)
 {
-    char* found = NULL;
     char* buffer = NULL;
-    char* result = NULL;
-    int size = 1;
+    char* larger = NULL;
+    size_t whatLength = 0;
+    size_t capacity = 64;
+    size_t size = 0;
+    bool found = false;
 
     if ((NULL == what) || (socketHandle < 0))
     {
@@ -18,39 +20,40 @@ static char* ReadUntilStringFound(int socketHandle, const char* what, void* log)
         return NULL;
     }
 
-    buffer = (char*)malloc(size + 1);
+    buffer = (char*)malloc(capacity + 1);
     if (NULL == buffer)
     {
         OsConfigLogError(log, "ReadUntilStringFound: out of memory allocating initial buffer");
         return NULL;
     }
 
-    memset(buffer, 0, size + 1);
+    whatLength = strlen(what);
 
-    while (1 == read(socketHandle, &(buffer[size - 1]), 1))
+    while ((size < MAX_HTTP_HEADER_SIZE) && (1 == read(socketHandle, &(buffer[size]), 1)))
     {
-        if (NULL != (found = strstr(buffer, what)))
+        size += 1;
+        buffer[size] = 0;
+
+        // Only the newest bytes can complete a match, earlier positions were already checked
+        if ((size >= whatLength) && (0 == memcmp(&(buffer[size - whatLength]), what, whatLength)))
         {
-            buffer[size] = 0;
+            found = true;
             break;
         }
-        else
+
+        if (size == capacity)
         {
-            size += 1;
-            buffer = (char*)realloc(buffer, size + 1);
-            if (NULL == buffer)
+            capacity *= 2;
+            if (NULL == (larger = (char*)realloc(buffer, capacity + 1)))
             {
                 OsConfigLogError(log, "ReadUntilStringFound: out of memory reallocating buffer");
                 break;
             }
-            else
-            {
-                buffer[size] = 0;
-            }
+            buffer = larger;
         }
     }
 
-    if (NULL == found)
+    if (false == found)
     {
         FREE_MEMORY(buffer);
     }
@@ -208,4 +211,275 @@ int ReadHttpContentLengthFromSocket(int socketHandle, void* log)
     }
 
     return httpContentLength;
-}
\ No newline at end of file
+}
+
+void InitializeSocketBuffer(SOCKET_BUFFER* buffer, int socketHandle)
+{
+    if (NULL != buffer)
+    {
+        buffer->socketHandle = socketHandle;
+        buffer->start = 0;
+        buffer->end = 0;
+    }
+}
+
+bool IsSocketBufferEmpty(const SOCKET_BUFFER* buffer)
+{
+    return (NULL == buffer) || (buffer->start >= buffer->end);
+}
+
+// Returns 0 when more bytes were appended to the buffer, otherwise ECONNRESET when the peer closed the connection or the read error
+static int FillSocketBuffer(SOCKET_BUFFER* buffer)
+{
+    ssize_t bytes = 0;
+
+    while (0 > (bytes = read(buffer->socketHandle, &(buffer->data[buffer->end]), sizeof(buffer->data) - buffer->end)))
+    {
+        if (EINTR != errno)
+        {
+            return errno ? errno : EIO;
+        }
+    }
+
+    if (0 == bytes)
+    {
+        return ECONNRESET;
+    }
+
+    buffer->end += (int)bytes;
+    return 0;
+}
+
+static bool IsHttpToken(const char* value, const char* valueEnd, const char* token)
+{
+    size_t length = strlen(token);
+    return ((size_t)(valueEnd - value) == length) && (0 == strncasecmp(value, token, length));
+}
+
+static int ParseHttpStartLine(const char* line, const char* lineEnd, HTTP_HEADER* header)
+{
+    const char* httpPrefix = "HTTP/1.";
+    size_t prefixLength = strlen(httpPrefix);
+    const char* target = NULL;
+    const char* version = NULL;
+    int uriLength = 0;
+    int i = 0;
+
+    if (((size_t)(lineEnd - line) > prefixLength) && (0 == strncmp(line, httpPrefix, prefixLength)))
+    {
+        // Status line of a response: HTTP/1.x SP 3DIGIT SP reason
+        if (((lineEnd - line) < (int)(prefixLength + 5)) || (' ' != line[prefixLength + 1]))
+        {
+            return EINVAL;
+        }
+
+        for (i = 0; i < 3; i++)
+        {
+            if (!isdigit(line[prefixLength + 2 + i]))
+            {
+                return EINVAL;
+            }
+            header->status = (header->status * 10) + (line[prefixLength + 2 + i] - '0');
+        }
+
+        header->keepAlive = ('1' == line[prefixLength]);
+        return 0;
+    }
+
+    // Request line: method SP /target SP HTTP/1.x, the target of an MPI request is the name of the call
+    if ((NULL == (target = memchr(line, ' ', lineEnd - line))) || ('/' != *(++target)))
+    {
+        return EINVAL;
+    }
+
+    target += 1;
+    while (((target + uriLength) < lineEnd) && (' ' != target[uriLength]) && ('/' != target[uriLength]) && ('?' != target[uriLength]))
+    {
+        if (uriLength >= (MAX_MPI_URI_LENGTH - 1))
+        {
+            return EINVAL;
+        }
+        header->uri[uriLength] = target[uriLength];
+        uriLength += 1;
+    }
+    header->uri[uriLength] = 0;
+
+    if ((0 == uriLength) || (NULL == (version = memchr(target, ' ', lineEnd - target))) ||
+        ((size_t)(lineEnd - (version + 1)) != (prefixLength + 1)) || (0 != strncmp(version + 1, httpPrefix, prefixLength)))
+    {
+        return EINVAL;
+    }
+
+    header->keepAlive = ('1' == version[prefixLength + 1]);
+    return 0;
+}
+
+static int ParseHttpHeaderLine(const char* line, const char* lineEnd, HTTP_HEADER* header)
+{
+    const char* colon = memchr(line, ':', lineEnd - line);
+    const char* value = NULL;
+    long long contentLength = 0;
+    int i = 0;
+
+    if ((NULL == colon) || (colon == line))
+    {
+        return EINVAL;
+    }
+
+    value = colon + 1;
+    while ((value < lineEnd) && ((' ' == *value) || ('\t' == *value)))
+    {
+        value += 1;
+    }
+
+    while ((lineEnd > value) && ((' ' == lineEnd[-1]) || ('\t' == lineEnd[-1])))
+    {
+        lineEnd -= 1;
+    }
+
+    if (IsHttpToken(line, colon, "Content-Length"))
+    {
+        if ((value == lineEnd) || ((lineEnd - value) > 10))
+        {
+            return EINVAL;
+        }
+
+        for (i = 0; i < (lineEnd - value); i++)
+        {
+            if (!isdigit(value[i]))
+            {
+                return EINVAL;
+            }
+            contentLength = (contentLength * 10) + (value[i] - '0');
+        }
+
+        if (contentLength > INT_MAX)
+        {
+            return EINVAL;
+        }
+
+        header->contentLength = (int)contentLength;
+    }
+    else if (IsHttpToken(line, colon, "Connection"))
+    {
+        if (IsHttpToken(value, lineEnd, "close"))
+        {
+            header->keepAlive = false;
+        }
+        else if (IsHttpToken(value, lineEnd, "keep-alive"))
+        {
+            header->keepAlive = true;
+        }
+    }
+
+    return 0;
+}
+
+int ReadHttpHeaderFromSocketBuffer(SOCKET_BUFFER* buffer, HTTP_HEADER* header, void* log)
+{
+    const char* doubleTerminator = "\r\n\r\n";
+    const char* headerEnd = NULL;
+    const char* line = NULL;
+    const char* lineEnd = NULL;
+    int scanned = 0;
+    int status = 0;
+
+    if ((NULL == buffer) || (NULL == header) || (buffer->socketHandle < 0))
+    {
+        OsConfigLogError(log, "ReadHttpHeaderFromSocketBuffer: invalid arguments");
+        return EINVAL;
+    }
+
+    memset(header, 0, sizeof(*header));
+
+    // Move leftover bytes (the start of a pipelined message) to the front so the whole header can fit
+    if (buffer->start > 0)
+    {
+        memmove(buffer->data, &(buffer->data[buffer->start]), buffer->end - buffer->start);
+        buffer->end -= buffer->start;
+        buffer->start = 0;
+    }
+
+    // Each byte is scanned once, a new read only resumes the search where the previous one stopped
+    while (NULL == (headerEnd = memmem(&(buffer->data[scanned]), buffer->end - scanned, doubleTerminator, 4)))
+    {
+        scanned = (buffer->end > 3) ? (buffer->end - 3) : 0;
+
+        if (buffer->end >= (int)sizeof(buffer->data))
+        {
+            OsConfigLogError(log, "ReadHttpHeaderFromSocketBuffer: header exceeds %d bytes", (int)sizeof(buffer->data));
+            return EMSGSIZE;
+        }
+
+        if (0 != (status = FillSocketBuffer(buffer)))
+        {
+            if ((ECONNRESET != status) || (buffer->end > 0))
+            {
+                OsConfigLogError(log, "ReadHttpHeaderFromSocketBuffer: failed to read header (%d)", status);
+            }
+            return status;
+        }
+    }
+
+    line = buffer->data;
+    lineEnd = memmem(line, headerEnd + 2 - line, "\r\n", 2);
+    status = ParseHttpStartLine(line, lineEnd, header);
+
+    while ((0 == status) && (lineEnd < headerEnd))
+    {
+        line = lineEnd + 2;
+        lineEnd = memmem(line, headerEnd + 2 - line, "\r\n", 2);
+        status = ParseHttpHeaderLine(line, lineEnd, header);
+    }
+
+    buffer->start = (int)(headerEnd - buffer->data) + 4;
+
+    if (0 != status)
+    {
+        OsConfigLogError(log, "ReadHttpHeaderFromSocketBuffer: malformed header '%.*s'", (int)(lineEnd - line), line);
+    }
+    else if (IsFullLoggingEnabled())
+    {
+        OsConfigLogInfo(log, "ReadHttpHeaderFromSocketBuffer: uri '%s', status %d, Content-Length %d, keep-alive %s",
+            header->uri, header->status, header->contentLength, header->keepAlive ? "yes" : "no");
+    }
+
+    return status;
+}
+
+int ReadHttpBodyFromSocketBuffer(SOCKET_BUFFER* buffer, char* body, int contentLength, void* log)
+{
+    int total = 0;
+    ssize_t bytes = 0;
+
+    if ((NULL == buffer) || (buffer->socketHandle < 0) || (NULL == body) || (contentLength < 0))
+    {
+        OsConfigLogError(log, "ReadHttpBodyFromSocketBuffer: invalid arguments");
+        return -1;
+    }
+
+    // Bytes that arrived together with the header first, the rest straight into the body without another copy
+    total = buffer->end - buffer->start;
+    total = (total < contentLength) ? total : contentLength;
+    memcpy(body, &(buffer->data[buffer->start]), total);
+    buffer->start += total;
+
+    while (total < contentLength)
+    {
+        if (0 < (bytes = read(buffer->socketHandle, body + total, contentLength - total)))
+        {
+            total += (int)bytes;
+        }
+        else if ((0 > bytes) && (EINTR == errno))
+        {
+            continue;
+        }
+        else
+        {
+            OsConfigLogError(log, "ReadHttpBodyFromSocketBuffer: read %d bytes of %d (%d)", total, contentLength, (0 == bytes) ? ECONNRESET : errno);
+            break;
+        }
+    }
+
+    return total;
+}
\ No newline at end of file
@@ -4,17 +4,71 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
 #include <time.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include "Logging.h"
 
 #define MAX_LOG_TRIM 1000
 
+// Number of messages an asynchronous log can hold before producers drop new ones, a power of two
+#define LOG_RING_SLOTS 512
+
+// Messages longer than this are formatted into a separate allocation referenced from the slot
+#define LOG_SLOT_TEXT_LENGTH 256
+
+// Maximum number of messages gathered in a single writev
+#define LOG_WRITE_BATCH 64
+
+// Milliseconds the writer waits for an error message before writing out what is queued
+#define LOG_FLUSH_INTERVAL 200
+
+// Times a producer that finds the ring full wakes the writer and yields before dropping its message
+#define LOG_FULL_RETRIES 64
+
+// Milliseconds a signal handler flushing the log waits for the writer to finish its batch before taking over
+#define LOG_SIGNAL_FLUSH_WAIT 100
+
 static bool g_fullLoggingEnabled = false;
+static bool g_asyncLoggingEnabled = false;
+
+// One message of an asynchronous log: the sequence tells whether the slot is free for the producer
+// at that position (equal to the position) or holds its message (position + 1), as in a bounded MPMC queue
+typedef struct LOG_SLOT
+{
+    atomic_size_t sequence;
+    bool console;
+    int length;
+    char* overflow;
+    char text[LOG_SLOT_TEXT_LENGTH];
+} LOG_SLOT;
+
+typedef struct LOG_RING
+{
+    LOG_SLOT slots[LOG_RING_SLOTS];
+    atomic_size_t enqueuePosition;
+    atomic_ullong dropped;
+
+    // Owned by whoever holds the drain flag, the writer thread (one batch at a time) or a signal handler flushing the log
+    size_t dequeuePosition;
+    atomic_flag draining;
+
+    atomic_bool stop;
+    int wakeEvent;
+    pthread_t writer;
+} LOG_RING;
 
 typedef struct OSCONFIG_LOG
 {
@@ -22,6 +76,11 @@ typedef struct OSCONFIG_LOG
     const char* logFileName;
     const char* backLogFileName;
     unsigned int trimLogCount;
+
+    // Set for asynchronous logs, which write through the descriptor instead of the stream
+    LOG_RING* ring;
+    int descriptor;
+    long long size;
 } OSCONFIG_LOG;
 
 void SetFullLogging(bool fullLogging)
@@ -34,11 +93,391 @@ bool IsFullLoggingEnabled()
     return g_fullLoggingEnabled;
 }
 
+void SetAsyncLogging(bool asyncLogging)
+{
+    g_asyncLoggingEnabled = asyncLogging;
+}
+
+bool IsAsyncLoggingEnabled()
+{
+    return g_asyncLoggingEnabled;
+}
+
+bool IsAsyncLog(OSCONFIG_LOG_HANDLE log)
+{
+    return log && ((OSCONFIG_LOG*)log)->ring;
+}
+
 static int RestrictAccessToRootOnly(const char* fileName)
 {
     return chmod(fileName, S_ISUID | S_ISGID | S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IXUSR | S_IXGRP);
 }
 
+static int OpenLogDescriptor(OSCONFIG_LOG* log)
+{
+    struct stat fileStat = {0};
+
+    if (0 <= (log->descriptor = open(log->logFileName, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR)))
+    {
+        log->size = (0 == fstat(log->descriptor, &fileStat)) ? (long long)fileStat.st_size : 0;
+        RestrictAccessToRootOnly(log->logFileName);
+    }
+
+    return log->descriptor;
+}
+
+// Same roll over as TrimLog, done by the writer thread once the size it tracks reaches MAX_LOG_SIZE
+static void RollAsyncLog(OSCONFIG_LOG* log)
+{
+    close(log->descriptor);
+
+    if ((NULL == log->backLogFileName) || (0 != rename(log->logFileName, log->backLogFileName)))
+    {
+        if (0 > truncate(log->logFileName, 0))
+        {
+            unlink(log->logFileName);
+        }
+    }
+
+    OpenLogDescriptor(log);
+
+    if (NULL != log->backLogFileName)
+    {
+        RestrictAccessToRootOnly(log->backLogFileName);
+    }
+}
+
+static void WriteAll(int descriptor, struct iovec* vector, int count)
+{
+    ssize_t written = 0;
+
+    while ((count > 0) && (descriptor >= 0))
+    {
+        if (0 > (written = writev(descriptor, vector, count)))
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            break;
+        }
+
+        // Skip what a short write did take and retry with the rest
+        while ((count > 0) && ((size_t)written >= vector->iov_len))
+        {
+            written -= vector->iov_len;
+            vector += 1;
+            count -= 1;
+        }
+
+        if (count > 0)
+        {
+            vector->iov_base = (char*)vector->iov_base + written;
+            vector->iov_len -= written;
+        }
+    }
+}
+
+// The writer thread only tries for the drain flag. A signal handler waits for the writer's batch in progress, and past
+// LOG_SIGNAL_FLUSH_WAIT drains anyway: it may have interrupted the writer itself, and the process exits right after
+static bool AcquireAsyncLogDrain(LOG_RING* ring, bool inSignal)
+{
+    struct timespec interval = {0, 1000000};
+    int waited = 0;
+
+    while (atomic_flag_test_and_set_explicit(&ring->draining, memory_order_acquire))
+    {
+        if (false == inSignal)
+        {
+            return false;
+        }
+        else if (waited++ >= LOG_SIGNAL_FLUSH_WAIT)
+        {
+            break;
+        }
+
+        nanosleep(&interval, NULL);
+    }
+
+    return true;
+}
+
+// Writes out the published messages in batches and frees their slots, holding the drain flag for one batch at a time.
+// From a signal handler (inSignal) nothing is allocated, freed or rolled over
+static void DrainAsyncLog(OSCONFIG_LOG* log, bool inSignal)
+{
+    LOG_RING* ring = log->ring;
+    LOG_SLOT* slot = NULL;
+    struct iovec fileVector[LOG_WRITE_BATCH];
+    struct iovec consoleVector[LOG_WRITE_BATCH];
+    char droppedMessage[128];
+    unsigned long long dropped = 0;
+    size_t position = 0;
+    int fileCount = 0;
+    int consoleCount = 0;
+    int i = 0;
+
+    do
+    {
+        if (false == AcquireAsyncLogDrain(ring, inSignal))
+        {
+            return;
+        }
+
+        if ((false == inSignal) && (0 < (dropped = atomic_exchange(&ring->dropped, 0))))
+        {
+            fileVector[0].iov_base = droppedMessage;
+            fileVector[0].iov_len = snprintf(droppedMessage, sizeof(droppedMessage), "[%s] [%s:%d]%s%llu log messages were dropped\n",
+                GetFormattedTime(), __SHORT_FILE__, __LINE__, __ERROR__, dropped);
+            WriteAll(log->descriptor, fileVector, 1);
+            log->size += fileVector[0].iov_len;
+        }
+
+        fileCount = 0;
+        consoleCount = 0;
+
+        for (position = ring->dequeuePosition; fileCount < LOG_WRITE_BATCH; position++)
+        {
+            slot = &ring->slots[position & (LOG_RING_SLOTS - 1)];
+            if ((position + 1) != atomic_load_explicit(&slot->sequence, memory_order_acquire))
+            {
+                break;
+            }
+
+            fileVector[fileCount].iov_base = slot->overflow ? slot->overflow : slot->text;
+            fileVector[fileCount].iov_len = slot->length;
+            if (slot->console)
+            {
+                consoleVector[consoleCount++] = fileVector[fileCount];
+            }
+            fileCount += 1;
+        }
+
+        WriteAll(log->descriptor, fileVector, fileCount);
+        WriteAll(STDOUT_FILENO, consoleVector, consoleCount);
+
+        for (i = 0; i < fileCount; i++)
+        {
+            slot = &ring->slots[ring->dequeuePosition & (LOG_RING_SLOTS - 1)];
+            log->size += slot->length;
+            if (false == inSignal)
+            {
+                free(slot->overflow);
+            }
+            slot->overflow = NULL;
+            atomic_store_explicit(&slot->sequence, ring->dequeuePosition + LOG_RING_SLOTS, memory_order_release);
+            ring->dequeuePosition += 1;
+        }
+
+        if ((false == inSignal) && (log->size >= MAX_LOG_SIZE))
+        {
+            RollAsyncLog(log);
+        }
+
+        atomic_flag_clear_explicit(&ring->draining, memory_order_release);
+    } while (LOG_WRITE_BATCH == fileCount);
+}
+
+static void* AsyncLogWriter(void* context)
+{
+    OSCONFIG_LOG* log = (OSCONFIG_LOG*)context;
+    struct pollfd wake = {log->ring->wakeEvent, POLLIN, 0};
+    uint64_t events = 0;
+
+    while (false == atomic_load(&log->ring->stop))
+    {
+        if ((0 < poll(&wake, 1, LOG_FLUSH_INTERVAL)) && (sizeof(events) != read(log->ring->wakeEvent, &events, sizeof(events))))
+        {
+            events = 0;
+        }
+
+        DrainAsyncLog(log, false);
+    }
+
+    DrainAsyncLog(log, false);
+
+    return NULL;
+}
+
+static void WakeAsyncLogWriter(LOG_RING* ring)
+{
+    uint64_t event = 1;
+
+    if (sizeof(event) != write(ring->wakeEvent, &event, sizeof(event)))
+    {
+        event = 0;
+    }
+}
+
+static bool StartAsyncLog(OSCONFIG_LOG* log)
+{
+    LOG_RING* ring = NULL;
+    size_t i = 0;
+
+    if ((NULL == log->logFileName) || (NULL == (ring = (LOG_RING*)calloc(1, sizeof(LOG_RING)))))
+    {
+        return false;
+    }
+
+    for (i = 0; i < LOG_RING_SLOTS; i++)
+    {
+        atomic_init(&ring->slots[i].sequence, i);
+    }
+    atomic_init(&ring->enqueuePosition, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->stop, false);
+    atomic_flag_clear(&ring->draining);
+
+    log->ring = ring;
+
+    if ((0 > (ring->wakeEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))) || (0 > OpenLogDescriptor(log)) ||
+        (0 != pthread_create(&ring->writer, NULL, AsyncLogWriter, log)))
+    {
+        if (log->descriptor >= 0)
+        {
+            close(log->descriptor);
+        }
+        if (ring->wakeEvent >= 0)
+        {
+            close(ring->wakeEvent);
+        }
+        free(ring);
+        log->ring = NULL;
+        log->descriptor = -1;
+        return false;
+    }
+
+    return true;
+}
+
+static void StopAsyncLog(OSCONFIG_LOG* log)
+{
+    LOG_RING* ring = log->ring;
+    size_t i = 0;
+
+    atomic_store(&ring->stop, true);
+    WakeAsyncLogWriter(ring);
+    pthread_join(ring->writer, NULL);
+
+    // Messages reserved but not yet published when the writer stopped are not written
+    for (i = 0; i < LOG_RING_SLOTS; i++)
+    {
+        free(ring->slots[i].overflow);
+    }
+
+    close(ring->wakeEvent);
+    close(log->descriptor);
+    free(ring);
+
+    log->ring = NULL;
+    log->descriptor = -1;
+}
+
+void WriteAsyncLog(OSCONFIG_LOG_HANDLE log, bool error, bool console, const char* file, int line, const char* format, ...)
+{
+    static __thread time_t lastTime = 0;
+    static __thread char formattedTime[TIME_FORMAT_STRING_LENGTH] = {0};
+    LOG_RING* ring = NULL;
+    LOG_SLOT* slot = NULL;
+    struct tm timeInfo = {0};
+    time_t currentTime = time(NULL);
+    size_t position = 0;
+    intptr_t difference = 0;
+    int retries = 0;
+    int prefixLength = 0;
+    int length = 0;
+    va_list arguments;
+
+    if ((NULL == log) || (NULL == (ring = ((OSCONFIG_LOG*)log)->ring)) || (NULL == format))
+    {
+        return;
+    }
+
+    // Reserve a slot without locking: claim the position whose slot is free, drop the message when the ring is full
+    position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+    for (;;)
+    {
+        slot = &ring->slots[position & (LOG_RING_SLOTS - 1)];
+        difference = (intptr_t)atomic_load_explicit(&slot->sequence, memory_order_acquire) - (intptr_t)position;
+
+        if (0 == difference)
+        {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueuePosition, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            if (retries++ >= LOG_FULL_RETRIES)
+            {
+                atomic_fetch_add(&ring->dropped, 1);
+                return;
+            }
+            WakeAsyncLogWriter(ring);
+            sched_yield();
+            position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+        }
+        else
+        {
+            position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+        }
+    }
+
+    // Each thread formats its own time stamp, again only when the second changes
+    if ((currentTime != lastTime) && (NULL != localtime_r(&currentTime, &timeInfo)))
+    {
+        strftime(formattedTime, sizeof(formattedTime), "%Y-%m-%d %H:%M:%S", &timeInfo);
+        lastTime = currentTime;
+    }
+
+    prefixLength = snprintf(slot->text, sizeof(slot->text), "[%s] [%s:%d]%s", formattedTime, file, line, error ? __ERROR__ : __INFO__);
+    prefixLength = (prefixLength < (int)sizeof(slot->text)) ? prefixLength : (int)sizeof(slot->text) - 1;
+
+    va_start(arguments, format);
+    length = vsnprintf(slot->text + prefixLength, sizeof(slot->text) - prefixLength, format, arguments);
+    va_end(arguments);
+    length = (length > 0) ? (prefixLength + length) : prefixLength;
+
+    if ((length + 1) < (int)sizeof(slot->text))
+    {
+        slot->text[length++] = '\n';
+        slot->text[length] = 0;
+    }
+    else if (NULL != (slot->overflow = (char*)malloc(length + 2)))
+    {
+        memcpy(slot->overflow, slot->text, prefixLength);
+        va_start(arguments, format);
+        vsnprintf(slot->overflow + prefixLength, length + 1 - prefixLength, format, arguments);
+        va_end(arguments);
+        slot->overflow[length++] = '\n';
+        slot->overflow[length] = 0;
+    }
+    else
+    {
+        length = sizeof(slot->text) - 1;
+        slot->text[length - 1] = '\n';
+    }
+
+    slot->length = length;
+    slot->console = console;
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+
+    // Errors are written out right away, everything else on the writer's next tick or when a quarter of the ring fills up
+    if (error || (0 == (position & ((LOG_RING_SLOTS / 4) - 1))))
+    {
+        WakeAsyncLogWriter(ring);
+    }
+}
+
+void FlushLog(OSCONFIG_LOG_HANDLE log)
+{
+    if (IsAsyncLog(log))
+    {
+        DrainAsyncLog((OSCONFIG_LOG*)log, true);
+    }
+}
+
 OSCONFIG_LOG_HANDLE OpenLog(const char* logFileName, const char* bakLogFileName)
 {
     OSCONFIG_LOG* newLog = (OSCONFIG_LOG*)malloc(sizeof(OSCONFIG_LOG));
@@ -51,6 +490,17 @@ OSCONFIG_LOG_HANDLE OpenLog(const char* logFileName, const char* bakLogFileName)
 
     newLog->logFileName = logFileName;
     newLog->backLogFileName = newLog->logFileName ? bakLogFileName : NULL;
+    newLog->descriptor = -1;
+
+    // An asynchronous log that cannot be started falls back to the synchronous stream
+    if (g_asyncLoggingEnabled && StartAsyncLog(newLog))
+    {
+        if (NULL != newLog->backLogFileName)
+        {
+            RestrictAccessToRootOnly(newLog->backLogFileName);
+        }
+        return (OSCONFIG_LOG_HANDLE)newLog;
+    }
 
     if (NULL != newLog->logFileName)
     {
@@ -75,6 +525,11 @@ void CloseLog(OSCONFIG_LOG_HANDLE* log)
 
     OSCONFIG_LOG* logToClose = (OSCONFIG_LOG*)(*log);
 
+    if (NULL != logToClose->ring)
+    {
+        StopAsyncLog(logToClose);
+    }
+
     if (NULL != logToClose->log)
     {
         fclose(logToClose->log);
@@ -91,16 +546,19 @@ FILE* GetLogFile(OSCONFIG_LOG_HANDLE log)
     return log ? ((OSCONFIG_LOG*)log)->log : NULL;
 }
 
-static char g_logTime[TIME_FORMAT_STRING_LENGTH] = {0};
+// Each thread formats into its own buffer so concurrent callers do not overwrite each other's time
+static __thread char g_logTime[TIME_FORMAT_STRING_LENGTH] = {0};
 
 // Returns the local date/time formatted as YYYY-MM-DD HH:MM:SS (for example: 2014-03-19 11:11:52)
 char* GetFormattedTime()
 {
     time_t rawTime = {0};
-    struct tm* timeInfo = NULL;
+    struct tm timeInfo = {0};
     time(&rawTime);
-    timeInfo = localtime(&rawTime);
-    strftime(g_logTime, ARRAY_SIZE(g_logTime), "%Y-%m-%d %H:%M:%S", timeInfo);
+    if (NULL != localtime_r(&rawTime, &timeInfo))
+    {
+        strftime(g_logTime, ARRAY_SIZE(g_logTime), "%Y-%m-%d %H:%M:%S", &timeInfo);
+    }
     return g_logTime;
 }
 
@@ -110,7 +568,8 @@ void TrimLog(OSCONFIG_LOG_HANDLE log)
     OSCONFIG_LOG* whatLog = NULL;
     int fileSize = 0;
 
-    if ((NULL == log) || (NULL == (whatLog = (OSCONFIG_LOG*)log)))
+    // Asynchronous logs are rolled over by their writer thread
+    if ((NULL == log) || (NULL == (whatLog = (OSCONFIG_LOG*)log)) || (NULL != whatLog->ring))
     {
         return;
     }
@@ -28,6 +28,15 @@ void CloseLog(OSCONFIG_LOG_HANDLE* log);
 void SetFullLogging(bool fullLogging);
 bool IsFullLoggingEnabled(void);
 
+// Logs opened while asynchronous logging is enabled are written by a background thread, callers only format into a ring
+void SetAsyncLogging(bool asyncLogging);
+bool IsAsyncLoggingEnabled(void);
+bool IsAsyncLog(OSCONFIG_LOG_HANDLE log);
+
+// Writes out what is queued for an asynchronous log, safe to call from a signal handler
+void FlushLog(OSCONFIG_LOG_HANDLE log);
+void WriteAsyncLog(OSCONFIG_LOG_HANDLE log, bool error, bool console, const char* file, int line, const char* format, ...) __attribute__((format(printf, 6, 7)));
+
 FILE* GetLogFile(OSCONFIG_LOG_HANDLE log);
 char* GetFormattedTime();
 void TrimLog(OSCONFIG_LOG_HANDLE log);
@@ -47,24 +56,35 @@ bool IsDaemon(void);
 #define OSCONFIG_LOG_ERROR(log, format, ...) __LOG__(log, format, __ERROR__, ## __VA_ARGS__)
 #define OSCONFIG_FILE_LOG_INFO(log, format, ...) __LOG_TO_FILE__(log, format, __INFO__, ## __VA_ARGS__)
 #define OSCONFIG_FILE_LOG_ERROR(log, format, ...) __LOG_TO_FILE__(log, format, __ERROR__, ## __VA_ARGS__)
+#define OSCONFIG_ASYNC_LOG(log, error, format, ...) WriteAsyncLog(log, error, ((false == IsDaemon()) || (false == IsFullLoggingEnabled())), __SHORT_FILE__, __LINE__, format, ## __VA_ARGS__)
 
 #define OsConfigLogInfo(log, FORMAT, ...) {\
-    if (NULL != GetLogFile(log)) {\
-        OSCONFIG_FILE_LOG_INFO(log, FORMAT, ##__VA_ARGS__);\
-        fflush(GetLogFile(log));\
+    if (IsAsyncLog(log)) {\
+        OSCONFIG_ASYNC_LOG(log, false, FORMAT, ##__VA_ARGS__);\
     }\
-    if ((false == IsDaemon()) || (false == IsFullLoggingEnabled())) {\
-        OSCONFIG_LOG_INFO(log, FORMAT, ##__VA_ARGS__);\
+    else {\
+        if (NULL != GetLogFile(log)) {\
+            OSCONFIG_FILE_LOG_INFO(log, FORMAT, ##__VA_ARGS__);\
+            fflush(GetLogFile(log));\
+        }\
+        if ((false == IsDaemon()) || (false == IsFullLoggingEnabled())) {\
+            OSCONFIG_LOG_INFO(log, FORMAT, ##__VA_ARGS__);\
+        }\
     }\
 }\
 
 #define OsConfigLogError(log, FORMAT, ...) {\
-    if (NULL != GetLogFile(log)) {\
-        OSCONFIG_FILE_LOG_ERROR(log, FORMAT, ##__VA_ARGS__);\
-        fflush(GetLogFile(log));\
+    if (IsAsyncLog(log)) {\
+        OSCONFIG_ASYNC_LOG(log, true, FORMAT, ##__VA_ARGS__);\
     }\
-    if ((false == IsDaemon()) || (false == IsFullLoggingEnabled())) {\
-        OSCONFIG_LOG_ERROR(log, FORMAT, ##__VA_ARGS__);\
+    else {\
+        if (NULL != GetLogFile(log)) {\
+            OSCONFIG_FILE_LOG_ERROR(log, FORMAT, ##__VA_ARGS__);\
+            fflush(GetLogFile(log));\
+        }\
+        if ((false == IsDaemon()) || (false == IsFullLoggingEnabled())) {\
+            OSCONFIG_LOG_ERROR(log, FORMAT, ##__VA_ARGS__);\
+        }\
     }\
 }\
 
@@ -0,0 +1,101 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <cstring>
+#include <string>
+#include <benchmark/benchmark.h>
+#include <CommonUtils.h>
+
+// Run on a release build with: commonbenchmarks --benchmark_repetitions=5
+
+static void BM_IsValidMimObjectPayload(benchmark::State& state, const char* payload)
+{
+    int payloadSizeBytes = static_cast<int>(strlen(payload));
+
+    // The first call pays for compiling the schema, every call after that only validates
+    IsValidMimObjectPayload(payload, payloadSizeBytes, nullptr);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(IsValidMimObjectPayload(payload, payloadSizeBytes, nullptr));
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * payloadSizeBytes);
+}
+
+BENCHMARK_CAPTURE(BM_IsValidMimObjectPayload, String, R"""("value")""");
+BENCHMARK_CAPTURE(BM_IsValidMimObjectPayload, Integer, R"""(1)""");
+BENCHMARK_CAPTURE(BM_IsValidMimObjectPayload, StringMap, R"""({"key1": "value1", "key2": "value2", "key3": null})""");
+BENCHMARK_CAPTURE(BM_IsValidMimObjectPayload, Object, R"""({
+    "string": "value",
+    "integer": 1,
+    "boolean": true,
+    "stringArray": ["value1", "value2"],
+    "integerArray": [1, 2],
+    "stringMap": {"key1": "value1", "key2": "value2"},
+    "integerMap": {"key1": 1, "key2": 2}})""");
+BENCHMARK_CAPTURE(BM_IsValidMimObjectPayload, Invalid, R"""({"stringArray": ["value1", 1]})""");
+
+static void BM_ExecuteCommand(benchmark::State& state, const char* command, unsigned int timeoutSeconds)
+{
+    char* textResult = nullptr;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ExecuteCommand(nullptr, command, false, false, 0, timeoutSeconds, &textResult, nullptr, nullptr));
+        FREE_MEMORY(textResult);
+    }
+}
+
+BENCHMARK_CAPTURE(BM_ExecuteCommand, Echo, "echo test", 0);
+BENCHMARK_CAPTURE(BM_ExecuteCommand, EchoWithTimeout, "echo test", 10);
+BENCHMARK_CAPTURE(BM_ExecuteCommand, Pipeline, "echo test | tr a-z A-Z", 0);
+
+static void BM_ExecuteProgram(benchmark::State& state)
+{
+    const char* echo[] = { "echo", "test", nullptr };
+    char* textResult = nullptr;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ExecuteProgram(nullptr, echo, false, false, 0, 0, &textResult, nullptr, nullptr));
+        FREE_MEMORY(textResult);
+    }
+}
+
+BENCHMARK(BM_ExecuteProgram);
+
+static void BM_HashBuffer(benchmark::State& state)
+{
+    std::string data(static_cast<size_t>(state.range(0)), 'a');
+    char* hash = nullptr;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(hash = HashBuffer(data.c_str(), data.length()));
+        FREE_MEMORY(hash);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+BENCHMARK(BM_HashBuffer)->Arg(64)->Arg(4096)->Arg(1 << 20);
+
+// The shell pipeline fingerprints were computed with before, for comparison with BM_HashBuffer
+static void BM_HashWithShell(benchmark::State& state)
+{
+    std::string command = "echo \"" + std::string(static_cast<size_t>(state.range(0)), 'a') + "\" | sha256sum | head -c 64";
+    char* hash = nullptr;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ExecuteCommand(nullptr, command.c_str(), false, false, 0, 0, &hash, nullptr, nullptr));
+        FREE_MEMORY(hash);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+BENCHMARK(BM_HashWithShell)->Arg(64)->Arg(4096);
+
+BENCHMARK_MAIN();
@@ -1,16 +1,23 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <cstdio>
 #include <string>
 #include <list>
+#include <thread>
+#include <atomic>
+#include <vector>
 #include <time.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
 #include <gtest/gtest.h>
 #include <CommonUtils.h>
+#include <Logging.h>
 
 using namespace std;
 
@@ -205,6 +212,58 @@ TEST_F(CommonUtilsTest, ExecuteCommandWithSpecialCharactersInTextResult)
     FREE_MEMORY(textResult);
 }
 
+static void AppendCommandOutput(void* context, const char* output, size_t outputSize)
+{
+    reinterpret_cast<std::vector<std::string>*>(context)->push_back(std::string(output, outputSize));
+}
+
+TEST_F(CommonUtilsTest, ExecuteCommandWithOutputCallback)
+{
+    std::vector<std::string> chunks;
+    std::string output;
+
+    EXPECT_EQ(0, ExecuteCommandWithOutputCallback(&chunks, "printf 'first\\\\'; sleep 0.5; printf 'second\\n'", true, true, 0, -1, AppendCommandOutput, nullptr));
+
+    // The first chunk arrives while the command is still running
+    ASSERT_LE(2, chunks.size());
+    EXPECT_EQ("first ", chunks[0]);
+
+    for (const std::string& chunk : chunks)
+    {
+        output += chunk;
+    }
+    EXPECT_EQ("first second ", output);
+
+    EXPECT_EQ(ETIME, ExecuteCommandWithOutputCallback(&chunks, "sleep 5", false, false, 1, -1, AppendCommandOutput, nullptr));
+    EXPECT_EQ(-1, ExecuteCommandWithOutputCallback(&chunks, "echo test", false, false, 0, -1, nullptr, nullptr));
+}
+
+TEST_F(CommonUtilsTest, ExecuteCommandWithCancelDescriptor)
+{
+    std::vector<std::string> chunks;
+    int cancelDescriptor = eventfd(0, EFD_CLOEXEC);
+    ASSERT_NE(-1, cancelDescriptor);
+
+    std::thread cancel([cancelDescriptor]()
+    {
+        uint64_t event = 1;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        EXPECT_EQ((ssize_t)sizeof(event), write(cancelDescriptor, &event, sizeof(event)));
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(ECANCELED, ExecuteCommandWithOutputCallback(&chunks, "sleep 10", false, false, 0, cancelDescriptor, AppendCommandOutput, nullptr));
+    EXPECT_GT(1000, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+    cancel.join();
+
+    // Already canceled, a command that ignores SIGTERM is killed after the grace period
+    start = std::chrono::steady_clock::now();
+    EXPECT_EQ(ECANCELED, ExecuteCommandWithOutputCallback(&chunks, "trap '' TERM; sleep 10", false, false, 0, cancelDescriptor, AppendCommandOutput, nullptr));
+    EXPECT_GT(3000, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+
+    close(cancelDescriptor);
+}
+
 TEST_F(CommonUtilsTest, ExecuteCommandWithoutTextResult)
 {
     EXPECT_EQ(0, ExecuteCommand(nullptr, "echo test456", false, true, 0, 0, nullptr, nullptr, nullptr));
@@ -331,6 +390,8 @@ TEST_F(CommonUtilsTest, CancelCommand)
 {
     char* textResult = nullptr;
 
+    ::numberOfTimes = 0;
+
     EXPECT_EQ(ECANCELED, ExecuteCommand(nullptr, "sleep 20", false, true, 0, 120, &textResult, &(CallbackContext::TestCommandCallback), nullptr));
 
     FREE_MEMORY(textResult);
@@ -367,6 +428,8 @@ TEST_F(CommonUtilsTest, CancelCommandWithContext)
 
     char* textResult = nullptr;
 
+    ::numberOfTimes = 0;
+
     EXPECT_EQ(ECANCELED, ExecuteCommand((void*)(&context), "sleep 30", false, true, 0, 120, &textResult, &(CallbackContext::TestCommandCallback), nullptr));
 
     FREE_MEMORY(textResult);
@@ -392,6 +455,26 @@ TEST_F(CommonUtilsTest, ExecuteCommandWithTextResultWithMappedJsonCharacters)
     FREE_MEMORY(textResult);
 }
 
+TEST_F(CommonUtilsTest, ExecuteProgram)
+{
+    const char* echo[] = { "echo", "test", "'$HOME'", NULL };
+    const char* missing[] = { "hh", NULL };
+    const char* sleep[] = { "sleep", "10", NULL };
+    char* textResult = nullptr;
+
+    EXPECT_EQ(0, ExecuteProgram(nullptr, echo, false, false, 0, 0, &textResult, nullptr, nullptr));
+    EXPECT_STREQ("test '$HOME'\n", textResult);
+    FREE_MEMORY(textResult);
+
+    EXPECT_EQ(ENOENT, ExecuteProgram(nullptr, missing, false, false, 0, 0, &textResult, nullptr, nullptr));
+    EXPECT_EQ(nullptr, textResult);
+
+    EXPECT_EQ(ETIME, ExecuteProgram(nullptr, sleep, false, false, 0, 1, &textResult, nullptr, nullptr));
+    FREE_MEMORY(textResult);
+
+    EXPECT_EQ(-1, ExecuteProgram(nullptr, nullptr, false, false, 0, 0, &textResult, nullptr, nullptr));
+}
+
 TEST_F(CommonUtilsTest, ExecuteLongCommand)
 {
     char* textResult = nullptr;
@@ -626,6 +709,36 @@ TEST_F(CommonUtilsTest, ValidateMimObjectPayload)
     ASSERT_FALSE(IsValidMimObjectPayload(invalidIntegerMapPayload, sizeof(invalidIntegerMapPayload), nullptr));
 }
 
+TEST_F(CommonUtilsTest, ValidateMimObjectPayloadConcurrently)
+{
+    const char validPayload[] = R"""({"stringArray": ["value1", "value2"], "integerMap": {"key1": 1, "key2": null}})""";
+    const char invalidPayload[] = R"""({"stringArray": ["value1", 1]})""";
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+
+    // All threads share the one compiled schema
+    for (int i = 0; i < 8; i++)
+    {
+        threads.emplace_back([&]()
+        {
+            for (int j = 0; j < 100; j++)
+            {
+                if (!IsValidMimObjectPayload(validPayload, sizeof(validPayload), nullptr) || IsValidMimObjectPayload(invalidPayload, sizeof(invalidPayload), nullptr))
+                {
+                    failures += 1;
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(0, failures);
+}
+
 struct HttpProxyOptions
 {
     const char* data;
@@ -773,6 +886,90 @@ TEST_F(CommonUtilsTest, OsProperties)
     FREE_MEMORY(kernelRelease);
 }
 
+TEST_F(CommonUtilsTest, GetOsReleaseProperty)
+{
+    const char osRelease[] =
+        "NAME=\"Ubuntu\"\n"
+        "VERSION_ID=\"20.04\"\n"
+        "VERSION=\"20.04.3 LTS (Focal Fossa)\"\n"
+        "ID=ubuntu\n"
+        "PRETTY_NAME=\"Ubuntu 20.04.3 LTS\"";
+    const char osReleaseCrLf[] = "ID=debian\r\nVERSION=\"11 (bullseye)\"\r\n";
+    char* value = nullptr;
+
+    EXPECT_NE(nullptr, value = GetOsReleaseProperty(osRelease, "PRETTY_NAME", false));
+    EXPECT_STREQ("Ubuntu 20.04.3 LTS", value);
+    FREE_MEMORY(value);
+
+    EXPECT_NE(nullptr, value = GetOsReleaseProperty(osRelease, "PRETTY_NAME", true));
+    EXPECT_STREQ("Ubuntu", value);
+    FREE_MEMORY(value);
+
+    EXPECT_NE(nullptr, value = GetOsReleaseProperty(osRelease, "ID", false));
+    EXPECT_STREQ("ubuntu", value);
+    FREE_MEMORY(value);
+
+    // VERSION_ID comes first but VERSION only matches the VERSION key
+    EXPECT_NE(nullptr, value = GetOsReleaseProperty(osRelease, "VERSION", false));
+    EXPECT_STREQ("20.04.3 LTS (Focal Fossa)", value);
+    FREE_MEMORY(value);
+
+    EXPECT_NE(nullptr, value = GetOsReleaseProperty(osRelease, "VERSION", true));
+    EXPECT_STREQ("20.04.3", value);
+    FREE_MEMORY(value);
+
+    EXPECT_EQ(nullptr, GetOsReleaseProperty(osRelease, "VERSION_CODENAME", false));
+    EXPECT_EQ(nullptr, GetOsReleaseProperty(osRelease, "PRETTY", false));
+    EXPECT_EQ(nullptr, GetOsReleaseProperty("", "ID", false));
+
+    EXPECT_NE(nullptr, value = GetOsReleaseProperty(osReleaseCrLf, "ID", false));
+    EXPECT_STREQ("debian", value);
+    FREE_MEMORY(value);
+
+    EXPECT_NE(nullptr, value = GetOsReleaseProperty(osReleaseCrLf, "VERSION", false));
+    EXPECT_STREQ("11 (bullseye)", value);
+    FREE_MEMORY(value);
+}
+
+TEST_F(CommonUtilsTest, GetListedProperty)
+{
+    const char cpuInfo[] =
+        "processor\t: 0\n"
+        "vendor_id\t: GenuineIntel\n"
+        "model\t\t: 85\n"
+        "model name\t: Intel(R) Xeon(R) Platinum 8272CL CPU @ 2.60GHz\n";
+    const char lshw[] = "server\r\n    description: Computer\r\n    product: Virtual Machine\r\n    vendor: Microsoft Corporation\r\n";
+    char* value = nullptr;
+
+    // 'model' is also the start of 'model name', the first line that contains the key wins like with 'grep -m 1'
+    EXPECT_NE(nullptr, value = GetListedProperty(cpuInfo, "model", false));
+    EXPECT_STREQ("85", value);
+    FREE_MEMORY(value);
+
+    EXPECT_NE(nullptr, value = GetListedProperty(cpuInfo, "model name", false));
+    EXPECT_STREQ("Intel(R) Xeon(R) Platinum 8272CL CPU @ 2.60GHz", value);
+    FREE_MEMORY(value);
+
+    EXPECT_NE(nullptr, value = GetListedProperty(cpuInfo, "model name", true));
+    EXPECT_STREQ("Intel(R)", value);
+    FREE_MEMORY(value);
+
+    EXPECT_NE(nullptr, value = GetListedProperty(cpuInfo, "vendor_id", false));
+    EXPECT_STREQ("GenuineIntel", value);
+    FREE_MEMORY(value);
+
+    EXPECT_EQ(nullptr, GetListedProperty(cpuInfo, "flags", false));
+    EXPECT_EQ(nullptr, GetListedProperty(nullptr, "flags", false));
+
+    EXPECT_NE(nullptr, value = GetListedProperty(lshw, "product:", false));
+    EXPECT_STREQ("Virtual Machine", value);
+    FREE_MEMORY(value);
+
+    EXPECT_NE(nullptr, value = GetListedProperty(lshw, "vendor:", true));
+    EXPECT_STREQ("Microsoft", value);
+    FREE_MEMORY(value);
+}
+
 char* AllocateAndCopyTestString(const char* source)
 {
     char* output = nullptr;
@@ -996,6 +1193,98 @@ TEST_F(CommonUtilsTest, HashCommand)
     FREE_MEMORY(hashOne);
     FREE_MEMORY(hashTwo);
     FREE_MEMORY(hashThree);
+
+    // Control characters are hashed as the command writes them, like 'printf ... | sha256sum' does
+    EXPECT_NE(nullptr, hashOne = HashCommand("printf 'a\\tb\\r\\n'", nullptr));
+    EXPECT_STREQ("5de247b2161b94cd384a0011bf87e8a98fd2825df1a5031db1bc9ed2388e7a82", hashOne);
+    FREE_MEMORY(hashOne);
+
+    EXPECT_EQ(nullptr, HashCommand("echo 'partial output'; false", nullptr));
+}
+
+TEST_F(CommonUtilsTest, HashBuffer)
+{
+    const char testOne[] = "abc";
+    const char testTwo[] = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    char* hash = nullptr;
+
+    EXPECT_NE(nullptr, hash = HashBuffer("", 0));
+    EXPECT_STREQ("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", hash);
+    FREE_MEMORY(hash);
+
+    EXPECT_NE(nullptr, hash = HashBuffer(testOne, strlen(testOne)));
+    EXPECT_STREQ("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", hash);
+    FREE_MEMORY(hash);
+
+    EXPECT_NE(nullptr, hash = HashBuffer(testTwo, strlen(testTwo)));
+    EXPECT_STREQ("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", hash);
+    FREE_MEMORY(hash);
+}
+
+TEST_F(CommonUtilsTest, HashIncrementally)
+{
+    std::string data(1000000, 'a');
+    unsigned char oneDigest[SHA256_DIGEST_SIZE] = {0};
+    unsigned char manyDigest[SHA256_DIGEST_SIZE] = {0};
+    SHA256_CONTEXT context;
+    char* hash = nullptr;
+    size_t size = 0;
+
+    EXPECT_NE(nullptr, hash = HashBuffer(data.c_str(), data.length()));
+    EXPECT_STREQ("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0", hash);
+    FREE_MEMORY(hash);
+
+    Sha256Initialize(&context);
+    Sha256Update(&context, data.c_str(), data.length());
+    Sha256Finalize(&context, oneDigest);
+
+    // Pieces of every size that straddle the 64 byte blocks differently
+    Sha256Initialize(&context);
+    for (size_t i = 0; i < data.length(); i += size)
+    {
+        size = std::min((i % 131) + 1, data.length() - i);
+        Sha256Update(&context, data.c_str() + i, size);
+    }
+    Sha256Finalize(&context, manyDigest);
+
+    EXPECT_EQ(0, memcmp(oneDigest, manyDigest, SHA256_DIGEST_SIZE));
+}
+
+TEST_F(CommonUtilsTest, HashFileAndDirectory)
+{
+    const char* directory = "/tmp/~osconfig-hash-test";
+    const char* fileOne = "/tmp/~osconfig-hash-test/one.list";
+    const char* fileTwo = "/tmp/~osconfig-hash-test/two.list";
+    const char* other = "/tmp/~osconfig-hash-test/other.txt";
+    std::string contents = std::string(m_data) + m_dataWithEol;
+    char* expected = nullptr;
+    char* hash = nullptr;
+
+    EXPECT_EQ(nullptr, HashFile(nullptr, nullptr));
+    EXPECT_EQ(nullptr, HashFile("/tmp/~osconfig-hash-test-missing", nullptr));
+
+    mkdir(directory, S_IRWXU);
+    EXPECT_TRUE(SavePayloadToFile(fileOne, m_data, strlen(m_data), nullptr));
+    EXPECT_TRUE(SavePayloadToFile(fileTwo, m_dataWithEol, strlen(m_dataWithEol), nullptr));
+    EXPECT_TRUE(SavePayloadToFile(other, m_data, strlen(m_data), nullptr));
+
+    EXPECT_NE(nullptr, expected = HashBuffer(m_data, strlen(m_data)));
+    EXPECT_NE(nullptr, hash = HashFile(fileOne, nullptr));
+    EXPECT_STREQ(expected, hash);
+    FREE_MEMORY(hash);
+    FREE_MEMORY(expected);
+
+    // Only the .list files, in name order
+    EXPECT_NE(nullptr, expected = HashBuffer(contents.c_str(), contents.length()));
+    EXPECT_NE(nullptr, hash = HashDirectory(directory, ".list", nullptr));
+    EXPECT_STREQ(expected, hash);
+    FREE_MEMORY(hash);
+    FREE_MEMORY(expected);
+
+    remove(fileOne);
+    remove(fileTwo);
+    remove(other);
+    rmdir(directory);
 }
 
 struct TestHttpHeader
@@ -1059,6 +1348,155 @@ TEST_F(CommonUtilsTest, ReadtHttpHeaderInfoFromSocket)
     }
 }
 
+TEST_F(CommonUtilsTest, ReadHttpPipelinedRequestsFromSocketBuffer)
+{
+    const char* testPath = "~socket.test";
+    const char* pipelinedRequests =
+        "POST /MpiGet/ HTTP/1.1\r\nHost: OSConfig\r\nContent-Length: 5\r\n\r\n\"abc\""
+        "POST /MpiSet/ HTTP/1.1\r\nHost: OSConfig\r\nconnection: Keep-Alive\r\nContent-Length: 3\r\n\r\n\"d\""
+        "POST /MpiClose/ HTTP/1.1\r\nConnection: close\r\nContent-Length: 2\r\n\r\n{}";
+
+    SOCKET_BUFFER socketBuffer = {0};
+    HTTP_HEADER header = {0};
+    char body[8] = {0};
+    int fileDescriptor = -1;
+
+    EXPECT_TRUE(CreateTestFile(testPath, pipelinedRequests));
+    EXPECT_NE(-1, fileDescriptor = open(testPath, O_RDONLY));
+    InitializeSocketBuffer(&socketBuffer, fileDescriptor);
+
+    EXPECT_EQ(0, ReadHttpHeaderFromSocketBuffer(&socketBuffer, &header, nullptr));
+    EXPECT_STREQ("MpiGet", header.uri);
+    EXPECT_EQ(0, header.status);
+    EXPECT_EQ(5, header.contentLength);
+    EXPECT_TRUE(header.keepAlive);
+    EXPECT_EQ(5, ReadHttpBodyFromSocketBuffer(&socketBuffer, body, header.contentLength, nullptr));
+    EXPECT_STREQ("\"abc\"", body);
+    EXPECT_FALSE(IsSocketBufferEmpty(&socketBuffer));
+
+    memset(body, 0, sizeof(body));
+    EXPECT_EQ(0, ReadHttpHeaderFromSocketBuffer(&socketBuffer, &header, nullptr));
+    EXPECT_STREQ("MpiSet", header.uri);
+    EXPECT_EQ(3, header.contentLength);
+    EXPECT_TRUE(header.keepAlive);
+    EXPECT_EQ(3, ReadHttpBodyFromSocketBuffer(&socketBuffer, body, header.contentLength, nullptr));
+    EXPECT_STREQ("\"d\"", body);
+
+    memset(body, 0, sizeof(body));
+    EXPECT_EQ(0, ReadHttpHeaderFromSocketBuffer(&socketBuffer, &header, nullptr));
+    EXPECT_STREQ("MpiClose", header.uri);
+    EXPECT_EQ(2, header.contentLength);
+    EXPECT_FALSE(header.keepAlive);
+    EXPECT_EQ(2, ReadHttpBodyFromSocketBuffer(&socketBuffer, body, 5, nullptr));
+    EXPECT_STREQ("{}", body);
+    EXPECT_TRUE(IsSocketBufferEmpty(&socketBuffer));
+
+    EXPECT_EQ(ECONNRESET, ReadHttpHeaderFromSocketBuffer(&socketBuffer, &header, nullptr));
+
+    EXPECT_EQ(0, close(fileDescriptor));
+    EXPECT_TRUE(Cleanup(testPath));
+}
+
+TEST_F(CommonUtilsTest, ReadHttpResponseFromSocketBuffer)
+{
+    const char* testPath = "~socket.test";
+
+    const char* validResponses[] = {
+        "HTTP/1.1 200 OK\r\nServer: OSConfig\r\nContent-Type: application/json\r\nContent-Length: 7\r\n\r\n\"12345\"",
+        "HTTP/1.1 400 Bad Request\r\nConnection: close\r\nContent-Length: 0\r\n\r\n",
+        "HTTP/1.0 404 Not Found\r\n\r\n"
+    };
+    int expectedStatus[] = { 200, 400, 404 };
+    int expectedContentLength[] = { 7, 0, 0 };
+    bool expectedKeepAlive[] = { true, false, false };
+
+    const char* invalidResponses[] = {
+        "HTTP/1.1 20 OK\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: -1\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: 99999999999\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length 12\r\n\r\n",
+        "POST / HTTP/1.1\r\n\r\n",
+        "POST /MpiOpen/\r\n\r\n",
+        "POST /ThisNameIsTooLongToBeTheNameOfAnyMpiCall/ HTTP/1.1\r\n\r\n"
+    };
+
+    SOCKET_BUFFER socketBuffer = {0};
+    HTTP_HEADER header = {0};
+    int fileDescriptor = -1;
+
+    for (int i = 0; i < (int)ARRAY_SIZE(validResponses); i++)
+    {
+        EXPECT_TRUE(CreateTestFile(testPath, validResponses[i]));
+        EXPECT_NE(-1, fileDescriptor = open(testPath, O_RDONLY));
+        InitializeSocketBuffer(&socketBuffer, fileDescriptor);
+        EXPECT_EQ(0, ReadHttpHeaderFromSocketBuffer(&socketBuffer, &header, nullptr));
+        EXPECT_EQ(expectedStatus[i], header.status);
+        EXPECT_EQ(expectedContentLength[i], header.contentLength);
+        EXPECT_EQ(expectedKeepAlive[i], header.keepAlive);
+        EXPECT_EQ(0, close(fileDescriptor));
+        EXPECT_TRUE(Cleanup(testPath));
+    }
+
+    for (int i = 0; i < (int)ARRAY_SIZE(invalidResponses); i++)
+    {
+        EXPECT_TRUE(CreateTestFile(testPath, invalidResponses[i]));
+        EXPECT_NE(-1, fileDescriptor = open(testPath, O_RDONLY));
+        InitializeSocketBuffer(&socketBuffer, fileDescriptor);
+        EXPECT_EQ(EINVAL, ReadHttpHeaderFromSocketBuffer(&socketBuffer, &header, nullptr));
+        EXPECT_EQ(0, close(fileDescriptor));
+        EXPECT_TRUE(Cleanup(testPath));
+    }
+
+    InitializeSocketBuffer(&socketBuffer, -1);
+    EXPECT_EQ(EINVAL, ReadHttpHeaderFromSocketBuffer(&socketBuffer, &header, nullptr));
+    EXPECT_EQ(EINVAL, ReadHttpHeaderFromSocketBuffer(nullptr, &header, nullptr));
+}
+
+TEST_F(CommonUtilsTest, ReadHttpPartialMessagesFromSocketBuffer)
+{
+    const char* request = "POST /MpiSetDesired/ HTTP/1.1\r\nHost: OSConfig\r\nContent-Length: 10\r\n\r\n1234567890";
+    SOCKET_BUFFER socketBuffer = {0};
+    HTTP_HEADER header = {0};
+    char body[16] = {0};
+    int sockets[2] = {-1, -1};
+    int length = (int)strlen(request);
+    int i = 0;
+
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+    InitializeSocketBuffer(&socketBuffer, sockets[0]);
+
+    // The message arrives in small pieces that split the header terminator and the body
+    thread writer([&]()
+    {
+        for (i = 0; i < length; i += 3)
+        {
+            EXPECT_LT(0, write(sockets[1], request + i, min(3, length - i)));
+            SleepMilliseconds(1);
+        }
+    });
+
+    EXPECT_EQ(0, ReadHttpHeaderFromSocketBuffer(&socketBuffer, &header, nullptr));
+    EXPECT_STREQ("MpiSetDesired", header.uri);
+    EXPECT_EQ(10, header.contentLength);
+    EXPECT_EQ(10, ReadHttpBodyFromSocketBuffer(&socketBuffer, body, header.contentLength, nullptr));
+    EXPECT_STREQ("1234567890", body);
+
+    writer.join();
+
+    // A header that does not fit the buffer is rejected instead of growing without bound
+    string tooLarge = "POST /MpiGet/ HTTP/1.1\r\nX-Padding: " + string(MAX_HTTP_HEADER_SIZE, 'x') + "\r\n\r\n";
+    thread flooder([&]()
+    {
+        EXPECT_EQ((ssize_t)tooLarge.length(), write(sockets[1], tooLarge.c_str(), tooLarge.length()));
+    });
+
+    EXPECT_EQ(EMSGSIZE, ReadHttpHeaderFromSocketBuffer(&socketBuffer, &header, nullptr));
+
+    flooder.join();
+    EXPECT_EQ(0, close(sockets[0]));
+    EXPECT_EQ(0, close(sockets[1]));
+}
+
 TEST_F(CommonUtilsTest, MillisecondsSleep)
 {
     long validValue = 100;
@@ -1068,4 +1506,82 @@ TEST_F(CommonUtilsTest, MillisecondsSleep)
     EXPECT_EQ(0, SleepMilliseconds(validValue));
     EXPECT_EQ(EINVAL, SleepMilliseconds(negativeValue));
     EXPECT_EQ(EINVAL, SleepMilliseconds(tooBigValue));
-}
\ No newline at end of file
+}
+
+TEST_F(CommonUtilsTest, AsyncLog)
+{
+    const char* logFile = "~osconfig_async_test.log";
+    const char* longText = "0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789";
+    const int threads = 4;
+    const int messages = 100;
+    OSCONFIG_LOG_HANDLE log = nullptr;
+    vector<thread> producers;
+    char* contents = nullptr;
+    string text;
+    size_t lines = 0;
+    size_t position = 0;
+
+    remove(logFile);
+
+    SetAsyncLogging(true);
+    EXPECT_NE(nullptr, log = OpenLog(logFile, nullptr));
+    SetAsyncLogging(false);
+    EXPECT_TRUE(IsAsyncLog(log));
+
+    for (int i = 0; i < threads; i++)
+    {
+        producers.push_back(thread([log, i, messages, longText]()
+        {
+            for (int j = 0; j < messages; j++)
+            {
+                OsConfigLogInfo(log, "Producer %d message %d %s%s%s", i, j, (0 == (j % 10)) ? longText : "", (0 == (j % 10)) ? longText : "", (0 == (j % 10)) ? longText : "");
+            }
+        }));
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+
+    // An error is written out without waiting for the writer's next tick
+    OsConfigLogError(log, "Async log error");
+    SleepMilliseconds(100);
+    EXPECT_NE(nullptr, contents = LoadStringFromFile(logFile, false, nullptr));
+    EXPECT_NE(nullptr, strstr(contents, "[ERROR] Async log error"));
+    FREE_MEMORY(contents);
+
+    // Flushing writes out what is queued even while the writer is busy with its own batch
+    for (int j = 0; j < messages; j++)
+    {
+        OsConfigLogInfo(log, "Flushed message %d", j);
+    }
+    FlushLog(log);
+    EXPECT_NE(nullptr, contents = LoadStringFromFile(logFile, false, nullptr));
+    EXPECT_NE(nullptr, strstr(contents, ("Flushed message " + to_string(messages - 1) + "\n").c_str()));
+    FREE_MEMORY(contents);
+
+    // Closing the log writes out everything queued, each producer's messages in the order they were logged
+    CloseLog(&log);
+    EXPECT_NE(nullptr, contents = LoadStringFromFile(logFile, false, nullptr));
+    text = contents;
+    FREE_MEMORY(contents);
+
+    for (position = text.find('\n'); string::npos != position; position = text.find('\n', position + 1))
+    {
+        lines += 1;
+    }
+    EXPECT_EQ((size_t)((threads + 1) * messages + 1), lines);
+
+    for (int i = 0; i < threads; i++)
+    {
+        position = 0;
+        for (int j = 0; j < messages; j++)
+        {
+            string message = "Producer " + to_string(i) + " message " + to_string(j) + " " + ((0 == (j % 10)) ? string(longText) + longText + longText : "") + "\n";
+            EXPECT_NE(string::npos, position = text.find(message, position));
+        }
+    }
+
+    EXPECT_EQ(0, remove(logFile));
+}
@@ -1,50 +1,40 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
-#include <ctime>
-#include <fstream>
+#include <algorithm>
+#include <cstdint>
 #include <unistd.h>
+#include <sys/eventfd.h>
 
 #include <Command.h>
 
-static const char alphanum[] = "0123456789"\
-    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"\
-    "abcdefghijklmnopqrstuvwxyz";
-
 OSCONFIG_LOG_HANDLE CommandRunnerLog::m_log = nullptr;
 
+const char CommandOutput::m_truncationMarker[] = " [...] ";
+
 template<typename T>
 int DeserializeMember(const rapidjson::Value& document, const std::string key, T& value);
 
-Command::Command(std::string id, std::string command, unsigned int timeout, bool replaceEol) :
+Command::Command(std::string id, std::string command, unsigned int timeout, bool replaceEol, Command::Priority priority) :
     m_arguments(command),
     m_timeout(timeout),
     m_replaceEol(replaceEol),
+    m_priority(priority),
     m_status(id, 0, "", Command::State::Unknown),
-    m_statusMutex()
+    m_statusMutex(),
+    m_canceled(false)
 {
-    std::string tmp;
-    std::string uniqueId;
-
-    char const* dir = getenv("TMPDIR");
-    tmp = (NULL == dir) ? "/tmp" : dir;
-
-    srand((unsigned)time(NULL) * getpid());
-    uniqueId.reserve(10);
-
-    for (int i = 0; i < 10; ++i)
+    if (-1 == (m_cancelDescriptor = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)))
     {
-        uniqueId += alphanum[rand() % (sizeof(alphanum) - 1)];
+        OsConfigLogError(CommandRunnerLog::Get(), "Failed to create the cancelation event of command %s, error: %d %s", id.c_str(), errno, strerror(errno));
     }
-
-    m_tmpFile = tmp + "/~osconfig-" + uniqueId;
 }
 
 Command::~Command()
 {
-    if (FileExists(m_tmpFile.c_str()) && (0 != remove(m_tmpFile.c_str())))
+    if (-1 != m_cancelDescriptor)
     {
-        OsConfigLogError(CommandRunnerLog::Get(), "Failed to remove file: %s", m_tmpFile.c_str());
+        close(m_cancelDescriptor);
     }
 }
 
@@ -60,8 +50,6 @@ int Command::Execute(unsigned int maxPayloadSizeBytes)
     }
     else
     {
-        char* textResult = nullptr;
-        void* context = reinterpret_cast<void*>(const_cast<char*>(m_tmpFile.c_str()));
         unsigned int maxTextResultSize = 0;
 
         if (maxPayloadSizeBytes > 0)
@@ -70,16 +58,24 @@ int Command::Execute(unsigned int maxPayloadSizeBytes)
             maxTextResultSize = (maxPayloadSizeBytes > estimatedSize) ? (maxPayloadSizeBytes - estimatedSize) : 1;
         }
 
-        SetStatus(0, "", Command::State::Running);
+        {
+            std::lock_guard<std::mutex> lock(m_statusMutex);
+            m_output = CommandOutput(maxTextResultSize);
+        }
 
-        exitCode = ExecuteCommand(context, m_arguments.c_str(), m_replaceEol, true, maxTextResultSize, m_timeout, &textResult, &Command::ExecutionCallback, CommandRunnerLog::Get());
+        SetStatus(0, "", Command::State::Running);
 
-        SetStatus(exitCode, (textResult != nullptr) ? std::string(textResult) : "");
+        // The output is collected as it comes so that the status of the running command shows it
+        exitCode = ExecuteCommandWithOutputCallback(this, m_arguments.c_str(), m_replaceEol, true, m_timeout, m_cancelDescriptor, &Command::OutputCallback, CommandRunnerLog::Get());
 
-        if (textResult != nullptr)
+        std::string textResult;
         {
-            free(textResult);
+            std::lock_guard<std::mutex> lock(m_statusMutex);
+            textResult = m_output.ToString();
+            m_output = CommandOutput();
         }
+
+        SetStatus(exitCode, textResult);
     }
 
     return exitCode;
@@ -90,10 +86,16 @@ int Command::Cancel()
     int status = 0;
     std::lock_guard<std::mutex> lock(m_statusMutex);
 
-    if ((Command::State::Canceled != m_status.m_state) && !FileExists(m_tmpFile.c_str()))
+    if ((Command::State::Canceled != m_status.m_state) && !m_canceled)
     {
-        std::ofstream output(m_tmpFile);
-        output.close();
+        // Wakes up the execution of the command right away, when it is running
+        uint64_t event = 1;
+        m_canceled = true;
+
+        if ((-1 != m_cancelDescriptor) && (sizeof(event) != write(m_cancelDescriptor, &event, sizeof(event))))
+        {
+            OsConfigLogError(CommandRunnerLog::Get(), "Failed to signal the cancelation of command %s, error: %d %s", m_status.m_id.c_str(), errno, strerror(errno));
+        }
     }
     else
     {
@@ -111,7 +113,8 @@ bool Command::IsComplete()
 
 bool Command::IsCanceled()
 {
-    return FileExists(m_tmpFile.c_str());
+    std::lock_guard<std::mutex> lock(m_statusMutex);
+    return m_canceled;
 }
 
 std::string Command::GetId()
@@ -123,7 +126,14 @@ std::string Command::GetId()
 Command::Status Command::GetStatus()
 {
     std::lock_guard<std::mutex> lock(m_statusMutex);
-    return m_status;
+    Command::Status status(m_status);
+
+    if (Command::State::Running == status.m_state)
+    {
+        status.m_textResult = m_output.ToString();
+    }
+
+    return status;
 }
 
 void Command::SetStatus(int exitCode, std::string textResult)
@@ -155,21 +165,100 @@ void Command::SetStatus(int exitCode, std::string textResult, Command::State sta
     m_status.m_state = state;
 }
 
-int Command::ExecutionCallback(void* context)
+void Command::OutputCallback(void* context, const char* output, size_t outputSize)
 {
-    int result = 0;
-
     if (nullptr != context)
     {
-        char* name = reinterpret_cast<char*>(context);
-        if (FileExists(name))
+        Command* command = reinterpret_cast<Command*>(context);
+        std::lock_guard<std::mutex> lock(command->m_statusMutex);
+        command->m_output.Append(output, outputSize);
+    }
+}
+
+CommandOutput::CommandOutput(unsigned int maxTextResultBytes) :
+    m_limited(maxTextResultBytes > 0),
+    m_headSize(0),
+    m_tailSize(0),
+    m_totalSize(0),
+    m_tailStart(0)
+{
+    size_t limit = m_limited ? (maxTextResultBytes - 1) : 0;
+    size_t markerSize = strlen(m_truncationMarker);
+
+    if (limit < (2 * markerSize))
+    {
+        // Too small to show both ends, the output is cut at the limit
+        m_headSize = limit;
+    }
+    else
+    {
+        // The tail also has room for the marker, so that output that fits within the limit is kept whole
+        m_headSize = (limit - markerSize) / 2;
+        m_tailSize = limit - m_headSize;
+    }
+}
+
+void CommandOutput::Append(const char* output, size_t outputSize)
+{
+    size_t size = 0;
+
+    m_totalSize += outputSize;
+
+    if (!m_limited || (m_head.size() < m_headSize))
+    {
+        size = m_limited ? std::min(outputSize, m_headSize - m_head.size()) : outputSize;
+        m_head.append(output, size);
+        output += size;
+        outputSize -= size;
+    }
+
+    if ((0 == m_tailSize) || (0 == outputSize))
+    {
+        return;
+    }
+
+    // Only the last m_tailSize bytes can remain
+    if (outputSize > m_tailSize)
+    {
+        output += outputSize - m_tailSize;
+        outputSize = m_tailSize;
+    }
+
+    while (outputSize > 0)
+    {
+        if (m_tail.size() < m_tailSize)
+        {
+            size = std::min(outputSize, m_tailSize - m_tail.size());
+            m_tail.append(output, size);
+        }
+        else
         {
-            remove(name);
-            result = 1;
+            size = std::min(outputSize, m_tailSize - m_tailStart);
+            m_tail.replace(m_tailStart, size, output, size);
+            m_tailStart = (m_tailStart + size) % m_tailSize;
         }
+
+        output += size;
+        outputSize -= size;
     }
+}
+
+std::string CommandOutput::ToString() const
+{
+    std::string tail = m_tail.substr(m_tailStart) + m_tail.substr(0, m_tailStart);
 
-    return result;
+    if (!m_limited || (m_totalSize <= (m_head.size() + tail.size())))
+    {
+        return m_head + tail;
+    }
+    else if (0 == m_tailSize)
+    {
+        return m_head;
+    }
+    else
+    {
+        return m_head + m_truncationMarker + tail.substr(strlen(m_truncationMarker));
+    }
 }
 
 ShutdownCommand::ShutdownCommand(std::string id, std::string command, unsigned int timeout, bool replaceEol) :
@@ -201,15 +290,16 @@ int ShutdownCommand::Execute(unsigned int maxPayloadSizeBytes)
 
 bool Command::operator ==(const Command& other) const
 {
-    return ((m_status.m_id == other.m_status.m_id) && (m_arguments == other.m_arguments) && (m_timeout == other.m_timeout) && (m_replaceEol == other.m_replaceEol));
+    return ((m_status.m_id == other.m_status.m_id) && (m_arguments == other.m_arguments) && (m_timeout == other.m_timeout) && (m_replaceEol == other.m_replaceEol) && (m_priority == other.m_priority));
 }
 
-Command::Arguments::Arguments(std::string id, std::string command, Command::Action action, unsigned int timeout, bool singleLineTextResult) :
+Command::Arguments::Arguments(std::string id, std::string command, Command::Action action, unsigned int timeout, bool singleLineTextResult, Command::Priority priority) :
     m_id(id),
     m_arguments(command),
     m_action(action),
     m_timeout(timeout),
-    m_singleLineTextResult(singleLineTextResult) { }
+    m_singleLineTextResult(singleLineTextResult),
+    m_priority(priority) { }
 
 std::string Command::Arguments::Serialize(const Command::Arguments& arguments)
 {
@@ -238,6 +328,9 @@ void Command::Arguments::Serialize(rapidjson::Writer<rapidjson::StringBuffer>& w
     writer.String(g_singleLineTextResult.c_str());
     writer.Bool(arguments.m_singleLineTextResult);
 
+    writer.String(g_priority.c_str());
+    writer.Int(static_cast<int>(arguments.m_priority));
+
     writer.EndObject();
 }
 
@@ -248,6 +341,7 @@ Command::Arguments Command::Arguments::Deserialize(const rapidjson::Value& value
     Command::Action action = Command::Action::None;
     unsigned int timeout = 0;
     bool singleLineTextResult = false;
+    Command::Priority priority = Command::Priority::Normal;
 
     if (value.IsObject())
     {
@@ -296,6 +390,13 @@ Command::Arguments Command::Arguments::Deserialize(const rapidjson::Value& value
                                         singleLineTextResult = true;
                                         OsConfigLogInfo(CommandRunnerLog::Get(), "%s.%s default value 'true' used for command id: %s", g_commandArguments.c_str(), g_singleLineTextResult.c_str(), id.c_str());
                                     }
+
+                                    // Priority is an optional field, there is no need to log when it is not set
+                                    int priorityValue = 0;
+                                    if ((0 == DeserializeMember(value, g_priority, priorityValue)) && (priorityValue >= Command::Priority::Normal) && (priorityValue <= Command::Priority::Low))
+                                    {
+                                        priority = static_cast<Command::Priority>(priorityValue);
+                                    }
                                 }
                                 else
                                 {
@@ -325,7 +426,7 @@ Command::Arguments Command::Arguments::Deserialize(const rapidjson::Value& value
         OsConfigLogError(CommandRunnerLog::Get(), "Invalid command arguments JSON value");
     }
 
-    return Command::Arguments(id, command, action, timeout, singleLineTextResult);
+    return Command::Arguments(id, command, action, timeout, singleLineTextResult, priority);
 }
 
 Command::Status::Status(const std::string id, int exitCode, std::string textResult, Command::State state) :
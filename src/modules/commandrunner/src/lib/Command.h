@@ -20,6 +20,7 @@ const std::string g_arguments = "arguments";
 const std::string g_action = "action";
 const std::string g_timeout = "timeout";
 const std::string g_singleLineTextResult = "singleLineTextResult";
+const std::string g_priority = "priority";
 
 const std::string g_commandStatus = "commandStatus";
 const std::string g_resultCode = "resultCode";
@@ -50,6 +51,32 @@ public:
     static OSCONFIG_LOG_HANDLE m_log;
 };
 
+// Output of a command as it runs, bounded like ExecuteCommand bounds a text result (the size counts a null terminator
+// and 0 means no limit). Past the limit the head and the tail of the output are kept, with a marker where output
+// was dropped in between
+class CommandOutput
+{
+public:
+    static const char m_truncationMarker[];
+
+    CommandOutput(unsigned int maxTextResultBytes = 0);
+
+    void Append(const char* output, size_t outputSize);
+    std::string ToString() const;
+
+private:
+    bool m_limited;
+    size_t m_headSize;
+    size_t m_tailSize;
+    size_t m_totalSize;
+
+    std::string m_head;
+
+    // Ring of the last m_tailSize bytes, the oldest at m_tailStart once it is full
+    std::string m_tail;
+    size_t m_tailStart;
+};
+
 class Command
 {
 public:
@@ -73,6 +100,14 @@ public:
         Canceled
     };
 
+    // Order in which queued commands get an execution slot, high first, first come first served within a class
+    enum Priority
+    {
+        Normal = 0,
+        High,
+        Low
+    };
+
     class Arguments
     {
     public:
@@ -81,8 +116,9 @@ public:
         const Command::Action m_action;
         const unsigned int m_timeout;
         const bool m_singleLineTextResult;
+        const Command::Priority m_priority;
 
-        Arguments(std::string id, std::string command, Command::Action action, unsigned int timeout, bool singleLineTextResult);
+        Arguments(std::string id, std::string command, Command::Action action, unsigned int timeout, bool singleLineTextResult, Command::Priority priority = Command::Priority::Normal);
 
         static std::string Serialize(const Command::Arguments& arguments);
         static void Serialize(rapidjson::Writer<rapidjson::StringBuffer>& writer, const Command::Arguments& arguments);
@@ -107,8 +143,9 @@ public:
     const std::string m_arguments;
     const unsigned int m_timeout;
     const bool m_replaceEol;
+    const Command::Priority m_priority;
 
-    Command(std::string id, std::string command, unsigned int timeout, bool replaceEol);
+    Command(std::string id, std::string command, unsigned int timeout, bool replaceEol, Command::Priority priority = Command::Priority::Normal);
     ~Command();
 
     virtual int Execute(unsigned int maxPayloadSizeBytes);
@@ -126,11 +163,14 @@ public:
 
 protected:
     Status m_status;
+    CommandOutput m_output;
     std::mutex m_statusMutex;
 
-    std::string m_tmpFile;
+    // Readable once the command is canceled, polled with the command while it runs
+    int m_cancelDescriptor;
+    bool m_canceled;
 
-    static int ExecutionCallback(void* context);
+    static void OutputCallback(void* context, const char* output, size_t outputSize);
 };
 
 class ShutdownCommand : public Command
@@ -0,0 +1,610 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <CommandJournal.h>
+
+const char CommandJournal::m_magic[] = "OSCJRNL1";
+const unsigned int CommandJournal::m_compactionRecords = 256;
+const std::chrono::milliseconds CommandJournal::m_syncDelay(100);
+
+static const char g_clientName[] = "clientName";
+
+// Length and CRC-32 of the payload, both little-endian
+static const size_t g_recordHeaderSize = 8;
+
+// Far larger than any status without its text result, anything bigger is a corrupted length
+static const size_t g_maxRecordSize = 64 * 1024;
+
+static unsigned int Crc32(const char* data, size_t length)
+{
+    static unsigned int table[256] = {0};
+    static std::once_flag tableFlag;
+
+    std::call_once(tableFlag, []()
+    {
+        for (unsigned int i = 0; i < 256; i++)
+        {
+            unsigned int crc = i;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 1) ? (0xEDB88320 ^ (crc >> 1)) : (crc >> 1);
+            }
+            table[i] = crc;
+        }
+    });
+
+    unsigned int crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+static void PutUint32(std::string& buffer, unsigned int value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+static unsigned int GetUint32(const char* data)
+{
+    unsigned int value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        value |= static_cast<unsigned int>(static_cast<unsigned char>(data[i])) << (8 * i);
+    }
+    return value;
+}
+
+static int WriteAll(int descriptor, const char* data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(descriptor, data, length);
+        if (written < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return errno ? errno : EIO;
+        }
+
+        data += written;
+        length -= written;
+    }
+
+    return 0;
+}
+
+CommandJournal::CommandJournal(const std::string& fileName, unsigned int maxStatusesPerClient) :
+    m_fileName(fileName),
+    m_maxStatusesPerClient(maxStatusesPerClient),
+    m_descriptor(-1),
+    m_opened(false),
+    m_size(0),
+    m_records(0),
+    m_dirty(false),
+    m_stopped(false),
+    m_compacting(false),
+    m_appendedCount(0) { }
+
+CommandJournal::~CommandJournal()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+        m_condition.notify_all();
+    }
+
+    if (m_workerThread.joinable())
+    {
+        m_workerThread.join();
+    }
+
+    if (-1 != m_descriptor)
+    {
+        fdatasync(m_descriptor);
+        close(m_descriptor);
+    }
+}
+
+int CommandJournal::Load(const std::string& clientName, std::vector<Command::Status>& statuses)
+{
+    int status = 0;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    statuses.clear();
+    if (0 == (status = Open()))
+    {
+        auto client = m_clients.find(clientName);
+        if (client != m_clients.end())
+        {
+            for (const Command::Status& commandStatus : client->second)
+            {
+                statuses.push_back(commandStatus);
+            }
+        }
+    }
+
+    return status;
+}
+
+int CommandJournal::Append(const std::string& clientName, const Command::Status& commandStatus)
+{
+    int status = 0;
+    std::string record = Frame(clientName, commandStatus);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (0 != (status = Open()))
+    {
+        return status;
+    }
+
+    if (0 != (status = WriteAll(m_descriptor, record.data(), record.size())))
+    {
+        OsConfigLogError(CommandRunnerLog::Get(), "Failed to append to %s, error: %d %s", m_fileName.c_str(), status, strerror(status));
+
+        // Drop a partially written record so that the records appended after it can still be replayed
+        if (0 != ftruncate(m_descriptor, m_size))
+        {
+            OsConfigLogError(CommandRunnerLog::Get(), "Failed to truncate %s, error: %d %s", m_fileName.c_str(), errno, strerror(errno));
+        }
+    }
+    else
+    {
+        // Text results are not persisted, keep what a replay would give back
+        Apply(clientName, Command::Status(commandStatus.m_id, commandStatus.m_exitCode, "", commandStatus.m_state));
+        m_size += record.size();
+        m_records++;
+        m_dirty = true;
+        m_condition.notify_all();
+
+        if (m_compacting)
+        {
+            // Missing from the journal being written, it is added there before that one replaces the current one
+            m_appendedRecords += record;
+            m_appendedCount++;
+        }
+    }
+
+    return status;
+}
+
+int CommandJournal::Sync()
+{
+    int descriptor = -1;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_dirty || (-1 == m_descriptor))
+        {
+            return 0;
+        }
+
+        // Synced through a duplicate so that appends and a compaction swapping the file are not held up
+        m_dirty = false;
+        descriptor = dup(m_descriptor);
+    }
+
+    int status = 0;
+    if ((-1 == descriptor) || (0 != fdatasync(descriptor)))
+    {
+        status = errno ? errno : EIO;
+        OsConfigLogError(CommandRunnerLog::Get(), "Failed to sync %s, error: %d %s", m_fileName.c_str(), status, strerror(status));
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_dirty = true;
+    }
+
+    if (-1 != descriptor)
+    {
+        close(descriptor);
+    }
+
+    return status;
+}
+
+int CommandJournal::Compact()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    int status = 0;
+
+    // The worker may be compacting already
+    m_condition.wait(lock, [this] { return !m_compacting; });
+
+    return (0 == (status = Open())) ? RewriteUnlocked(lock) : status;
+}
+
+unsigned int CommandJournal::GetRecordCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_records;
+}
+
+// Must be called with m_mutex held
+int CommandJournal::Open()
+{
+    int status = 0;
+
+    if (m_opened)
+    {
+        return 0;
+    }
+
+    std::string content;
+    m_clients.clear();
+
+    std::ifstream file(m_fileName, std::ios::binary);
+    if (file.good())
+    {
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        content = buffer.str();
+    }
+    file.close();
+
+    size_t magicSize = strlen(m_magic);
+    size_t validSize = 0;
+    bool rewrite = false;
+
+    if (content.empty())
+    {
+        rewrite = true;
+    }
+    else if (0 == content.compare(0, magicSize, m_magic))
+    {
+        Replay(content, validSize);
+    }
+    else
+    {
+        // Either the JSON cache of earlier versions or something unreadable, in both cases replaced by a new journal
+        ReplayLegacy(content);
+        rewrite = true;
+    }
+
+    if (rewrite)
+    {
+        status = Rewrite();
+    }
+    else if (-1 == (m_descriptor = open(m_fileName.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC)))
+    {
+        status = errno ? errno : EACCES;
+        OsConfigLogError(CommandRunnerLog::Get(), "Failed to open %s, error: %d %s", m_fileName.c_str(), status, strerror(status));
+    }
+    else if (validSize < content.size())
+    {
+        OsConfigLogError(CommandRunnerLog::Get(), "Dropping %d bytes of torn or corrupted records at the end of %s", (int)(content.size() - validSize), m_fileName.c_str());
+        if (0 != ftruncate(m_descriptor, validSize))
+        {
+            status = errno ? errno : EIO;
+            OsConfigLogError(CommandRunnerLog::Get(), "Failed to truncate %s, error: %d %s", m_fileName.c_str(), status, strerror(status));
+        }
+        m_size = validSize;
+    }
+    else
+    {
+        m_size = validSize;
+    }
+
+    if (0 == status)
+    {
+        m_opened = true;
+        if (!m_workerThread.joinable())
+        {
+            m_workerThread = std::thread(&CommandJournal::Worker, this);
+        }
+    }
+    else if (-1 != m_descriptor)
+    {
+        close(m_descriptor);
+        m_descriptor = -1;
+    }
+
+    return status;
+}
+
+// Applies the records up to the first torn or corrupted one, validSize is where that one starts
+int CommandJournal::Replay(const std::string& content, size_t& validSize)
+{
+    size_t offset = strlen(m_magic);
+    const char* data = content.data();
+
+    m_records = 0;
+
+    while ((offset + g_recordHeaderSize) <= content.size())
+    {
+        size_t length = GetUint32(data + offset);
+        unsigned int crc = GetUint32(data + offset + 4);
+
+        if ((length > g_maxRecordSize) || ((offset + g_recordHeaderSize + length) > content.size()) || (crc != Crc32(data + offset + g_recordHeaderSize, length)))
+        {
+            break;
+        }
+
+        rapidjson::Document document;
+        std::string payload(data + offset + g_recordHeaderSize, length);
+
+        if (document.Parse(payload.c_str()).HasParseError() || !document.IsObject() || !document.HasMember(g_clientName) || !document[g_clientName].IsString() || !document.HasMember(g_commandStatus.c_str()))
+        {
+            OsConfigLogError(CommandRunnerLog::Get(), "Skipping invalid record in %s", m_fileName.c_str());
+        }
+        else
+        {
+            Command::Status status = Command::Status::Deserialize(document[g_commandStatus.c_str()]);
+            if (!status.m_id.empty())
+            {
+                Apply(document[g_clientName].GetString(), status);
+            }
+        }
+
+        offset += g_recordHeaderSize + length;
+        m_records++;
+    }
+
+    validSize = offset;
+    return 0;
+}
+
+int CommandJournal::ReplayLegacy(const std::string& content)
+{
+    int status = 0;
+    rapidjson::Document document;
+
+    if (document.Parse(content.c_str()).HasParseError() || !document.IsObject())
+    {
+        OsConfigLogError(CommandRunnerLog::Get(), "Failed to parse cache file %s, starting a new one", m_fileName.c_str());
+        status = EINVAL;
+    }
+    else
+    {
+        for (auto client = document.MemberBegin(); client != document.MemberEnd(); client++)
+        {
+            if (client->value.IsArray())
+            {
+                for (auto& it : client->value.GetArray())
+                {
+                    Command::Status commandStatus = Command::Status::Deserialize(it);
+                    if (!commandStatus.m_id.empty())
+                    {
+                        Apply(client->name.GetString(), commandStatus);
+                    }
+                }
+            }
+        }
+    }
+
+    return status;
+}
+
+// Must be called with m_mutex held. The current status of each command, one record each
+std::string CommandJournal::Snapshot(unsigned int& records) const
+{
+    std::string content = m_magic;
+    records = 0;
+
+    for (const auto& client : m_clients)
+    {
+        for (const Command::Status& commandStatus : client.second)
+        {
+            content += Frame(client.first, commandStatus);
+            records++;
+        }
+    }
+
+    return content;
+}
+
+// Writes a new journal and renames it over the old one. Opened for appends before the rename so that once renamed
+// it is always the one appended to, on failure the old journal is left as it was
+int CommandJournal::WriteJournal(const std::string& content, int& descriptor) const
+{
+    int status = 0;
+    std::string tempFileName = m_fileName + ".tmp";
+
+    descriptor = open(tempFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (-1 == descriptor)
+    {
+        status = errno ? errno : EACCES;
+        OsConfigLogError(CommandRunnerLog::Get(), "Failed to open %s, error: %d %s", tempFileName.c_str(), status, strerror(status));
+        return status;
+    }
+
+    if ((0 != (status = WriteAll(descriptor, content.data(), content.size()))) || ((0 != fsync(descriptor)) && (0 != (status = errno ? errno : EIO))))
+    {
+        OsConfigLogError(CommandRunnerLog::Get(), "Failed to write %s, error: %d %s", tempFileName.c_str(), status, strerror(status));
+    }
+    else if (0 != rename(tempFileName.c_str(), m_fileName.c_str()))
+    {
+        status = errno ? errno : EACCES;
+        OsConfigLogError(CommandRunnerLog::Get(), "Failed to replace %s, error: %d %s", m_fileName.c_str(), status, strerror(status));
+    }
+
+    if (0 != status)
+    {
+        close(descriptor);
+        descriptor = -1;
+        unlink(tempFileName.c_str());
+        return status;
+    }
+
+    // Make the rename itself durable
+    size_t separator = m_fileName.find_last_of('/');
+    std::string directory = (std::string::npos == separator) ? "." : ((0 == separator) ? "/" : m_fileName.substr(0, separator));
+    int directoryDescriptor = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (-1 != directoryDescriptor)
+    {
+        fsync(directoryDescriptor);
+        close(directoryDescriptor);
+    }
+
+    RestrictFileAccessToCurrentAccountOnly(m_fileName.c_str());
+
+    return 0;
+}
+
+// Must be called with m_mutex held. Appends from now on go to the new journal
+void CommandJournal::Replace(int descriptor, size_t size, unsigned int records)
+{
+    if (-1 != m_descriptor)
+    {
+        close(m_descriptor);
+    }
+
+    m_descriptor = descriptor;
+    m_size = size;
+    m_records = records;
+    m_dirty = false;
+}
+
+// Must be called with m_mutex held. Writes the current statuses to a new journal and renames it over the old one
+int CommandJournal::Rewrite()
+{
+    int status = 0;
+    int descriptor = -1;
+    unsigned int records = 0;
+    std::string content = Snapshot(records);
+
+    if (0 == (status = WriteJournal(content, descriptor)))
+    {
+        Replace(descriptor, content.size(), records);
+    }
+
+    return status;
+}
+
+// Must be called with m_mutex held through lock. Same as Rewrite, without holding the lock while the new journal is
+// written, the records appended meanwhile go to the old journal and are copied to the new one before it replaces it
+int CommandJournal::RewriteUnlocked(std::unique_lock<std::mutex>& lock)
+{
+    int status = 0;
+    int descriptor = -1;
+    unsigned int records = 0;
+    std::string content = Snapshot(records);
+
+    m_compacting = true;
+    m_appendedRecords.clear();
+    m_appendedCount = 0;
+
+    lock.unlock();
+    status = WriteJournal(content, descriptor);
+    lock.lock();
+
+    m_compacting = false;
+    m_condition.notify_all();
+
+    if ((0 == status) && !m_appendedRecords.empty() && (0 != (status = WriteAll(descriptor, m_appendedRecords.data(), m_appendedRecords.size()))))
+    {
+        // The new journal is already in place, write it again with everything while holding the lock
+        OsConfigLogError(CommandRunnerLog::Get(), "Failed to append to %s, error: %d %s", m_fileName.c_str(), status, strerror(status));
+        close(descriptor);
+        status = Rewrite();
+    }
+    else if (0 == status)
+    {
+        Replace(descriptor, content.size() + m_appendedRecords.size(), records + m_appendedCount);
+
+        // Only the records copied from the old journal still need a sync
+        m_dirty = !m_appendedRecords.empty();
+    }
+
+    m_appendedRecords.clear();
+    m_appendedCount = 0;
+
+    return status;
+}
+
+// Same bookkeeping as the cache: a known command is updated in place, a new one evicts the oldest when full
+void CommandJournal::Apply(const std::string& clientName, const Command::Status& status)
+{
+    std::deque<Command::Status>& statuses = m_clients[clientName];
+
+    for (Command::Status& it : statuses)
+    {
+        if (it.m_id == status.m_id)
+        {
+            it.m_exitCode = status.m_exitCode;
+            it.m_textResult = status.m_textResult;
+            it.m_state = status.m_state;
+            return;
+        }
+    }
+
+    if ((m_maxStatusesPerClient > 0) && (statuses.size() >= m_maxStatusesPerClient))
+    {
+        statuses.pop_front();
+    }
+
+    statuses.push_back(status);
+}
+
+bool CommandJournal::NeedsCompaction() const
+{
+    unsigned int live = 0;
+    for (const auto& client : m_clients)
+    {
+        live += client.second.size();
+    }
+
+    return m_records >= (live + m_compactionRecords);
+}
+
+void CommandJournal::Worker()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_stopped)
+    {
+        m_condition.wait(lock, [this] { return m_stopped || m_dirty; });
+
+        // Let the records that follow closely share the same sync
+        m_condition.wait_for(lock, m_syncDelay, [this] { return m_stopped; });
+
+        if (m_opened && !m_compacting && NeedsCompaction())
+        {
+            RewriteUnlocked(lock);
+        }
+        else if (m_dirty)
+        {
+            lock.unlock();
+            Sync();
+            lock.lock();
+        }
+    }
+}
+
+std::string CommandJournal::Frame(const std::string& clientName, const Command::Status& status)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+    writer.StartObject();
+    writer.Key(g_clientName);
+    writer.String(clientName.c_str());
+    writer.Key(g_commandStatus.c_str());
+    Command::Status::Serialize(writer, status, false);
+    writer.EndObject();
+
+    std::string record;
+    record.reserve(g_recordHeaderSize + buffer.GetSize());
+    PutUint32(record, buffer.GetSize());
+    PutUint32(record, Crc32(buffer.GetString(), buffer.GetSize()));
+    record.append(buffer.GetString(), buffer.GetSize());
+
+    return record;
+}
@@ -0,0 +1,78 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef COMMANDJOURNAL_H
+#define COMMANDJOURNAL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Command.h>
+
+// Persisted command statuses of all clients, kept as an append-only journal of status transitions. Each record is
+// framed with its length and a CRC-32 so that a record torn by a crash is detected and dropped on replay. Records
+// reach the disk in batches from a background thread, which also compacts the journal down to the current status
+// of each command once enough records are outdated. A cache file in the earlier JSON format is converted on open
+class CommandJournal
+{
+public:
+    static const char m_magic[];
+    static const unsigned int m_compactionRecords;
+    static const std::chrono::milliseconds m_syncDelay;
+
+    CommandJournal(const std::string& fileName, unsigned int maxStatusesPerClient);
+    ~CommandJournal();
+
+    // Statuses persisted for the client, oldest first
+    int Load(const std::string& clientName, std::vector<Command::Status>& statuses);
+    int Append(const std::string& clientName, const Command::Status& status);
+
+    // Both normally run in the background, exposed to force them during shutdown and in tests
+    int Sync();
+    int Compact();
+
+    unsigned int GetRecordCount();
+
+private:
+    int Open();
+    int Replay(const std::string& content, size_t& validSize);
+    int ReplayLegacy(const std::string& content);
+    std::string Snapshot(unsigned int& records) const;
+    int WriteJournal(const std::string& content, int& descriptor) const;
+    void Replace(int descriptor, size_t size, unsigned int records);
+    int Rewrite();
+    int RewriteUnlocked(std::unique_lock<std::mutex>& lock);
+    void Apply(const std::string& clientName, const Command::Status& status);
+    bool NeedsCompaction() const;
+    void Worker();
+
+    static std::string Frame(const std::string& clientName, const Command::Status& status);
+
+    const std::string m_fileName;
+    const unsigned int m_maxStatusesPerClient;
+
+    std::map<std::string, std::deque<Command::Status>> m_clients;
+    int m_descriptor;
+    bool m_opened;
+    size_t m_size;
+    unsigned int m_records;
+    bool m_dirty;
+    bool m_stopped;
+
+    // Set while a compaction writes the new journal without the lock, the records appended meanwhile are kept here
+    bool m_compacting;
+    std::string m_appendedRecords;
+    unsigned int m_appendedCount;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::thread m_workerThread;
+};
+
+#endif // COMMANDJOURNAL_H
@@ -1,21 +1,20 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
-#include <fstream>
+#include <algorithm>
 #include <rapidjson/document.h>
-#include <rapidjson/istreamwrapper.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
-#include <rapidjson/prettywriter.h>
 
 #include <Command.h>
+#include <CommandJournal.h>
 #include <CommandRunner.h>
 #include <Mmi.h>
 
 const std::string CommandRunner::m_componentName = "CommandRunner";
 const unsigned int CommandRunner::m_maxCacheSize = 10;
+const unsigned int CommandRunner::m_defaultConcurrentCommands = 4;
 const char* CommandRunner::m_persistedCacheFile = "/etc/osconfig/osconfig_commandrunner.cache";
-const char* CommandRunner::m_defaultCacheTemplate = "{}";
 
 constexpr const char g_moduleInfo[] = R""""({
     "Name": "CommandRunner",
@@ -28,13 +27,12 @@ constexpr const char g_moduleInfo[] = R""""({
     "Lifetime": 1,
     "UserAccount": 0})"""";
 
-std::mutex CommandRunner::m_diskCacheMutex;
-
-CommandRunner::CommandRunner(std::string clientName, unsigned int maxPayloadSizeBytes, bool usePersistedCache) :
+CommandRunner::CommandRunner(std::string clientName, unsigned int maxPayloadSizeBytes, bool usePersistedCache, unsigned int concurrentCommands) :
     m_clientName(clientName),
     m_maxPayloadSizeBytes(maxPayloadSizeBytes),
     m_usePersistedCache(usePersistedCache),
-    m_lastPayloadHash(0)
+    m_lastPayloadHash(0),
+    m_commandQueue((concurrentCommands > 0) ? concurrentCommands : 1)
 {
     if (m_usePersistedCache)
     {
@@ -52,32 +50,30 @@ CommandRunner::CommandRunner(std::string clientName, unsigned int maxPayloadSize
         m_commandIdLoadedFromDisk = "";
     }
 
-    // Start the worker thread
-    m_workerThread = std::thread(&CommandRunner::WorkerThread, std::ref(*this));
+    // Start one worker thread per execution slot
+    for (unsigned int i = 0; i < ((concurrentCommands > 0) ? concurrentCommands : 1); i++)
+    {
+        m_workerThreads.push_back(std::thread(&CommandRunner::WorkerThread, std::ref(*this)));
+    }
 }
 
 CommandRunner::~CommandRunner()
 {
-    while (!m_commandQueue.Empty())
-    {
-        std::shared_ptr<Command> command = m_commandQueue.Pop().lock();
-        if (nullptr != command)
-        {
-            command->Cancel();
-        }
-    }
-
-    // Push nullptr to signal the worker thread to exit
-    m_commandQueue.Push(std::weak_ptr<Command>());
+    // Cancel the queued and running commands, then signal the worker threads to exit
+    m_commandQueue.CancelAll();
+    m_commandQueue.Stop();
 
-    try
+    for (std::thread& workerThread : m_workerThreads)
     {
-        if (m_workerThread.joinable())
+        try
         {
-            m_workerThread.join();
+            if (workerThread.joinable())
+            {
+                workerThread.join();
+            }
         }
+        catch (const std::exception& e) {}
     }
-    catch (const std::exception& e) {}
 
     Command::Status status = GetStatusToPersist();
     if (!status.m_id.empty() && (0 != PersistCommandStatus(status)))
@@ -156,7 +152,7 @@ int CommandRunner::Set(const char* componentName, const char* objectName, const
                         // Update the partial command loaded from the persisted cache
                         Command::Status currentStatus = m_commandMap[arguments.m_id]->GetStatus();
 
-                        std::shared_ptr<Command> command = std::make_shared<Command>(arguments.m_id, arguments.m_arguments, arguments.m_timeout, arguments.m_singleLineTextResult);
+                        std::shared_ptr<Command> command = std::make_shared<Command>(arguments.m_id, arguments.m_arguments, arguments.m_timeout, arguments.m_singleLineTextResult, arguments.m_priority);
                         command->SetStatus(currentStatus.m_exitCode, currentStatus.m_textResult, currentStatus.m_state);
 
                         m_commandMap[arguments.m_id] = command;
@@ -170,7 +166,7 @@ int CommandRunner::Set(const char* componentName, const char* objectName, const
                     switch (arguments.m_action)
                     {
                         case Command::Action::RunCommand:
-                            status = Run(arguments.m_id, arguments.m_arguments, arguments.m_timeout, arguments.m_singleLineTextResult);
+                            status = Run(arguments.m_id, arguments.m_arguments, arguments.m_timeout, arguments.m_singleLineTextResult, arguments.m_priority);
                             break;
                         case Command::Action::Reboot:
                             status = Reboot(arguments.m_id);
@@ -280,12 +276,12 @@ unsigned int CommandRunner::GetMaxPayloadSizeBytes() const
 
 void CommandRunner::WaitForCommands()
 {
-    m_commandQueue.WaitUntilEmpty();
+    m_commandQueue.WaitUntilIdle();
 }
 
-int CommandRunner::Run(const std::string id, std::string arguments, unsigned int timeout, bool singleLineTextResult)
+int CommandRunner::Run(const std::string id, std::string arguments, unsigned int timeout, bool singleLineTextResult, Command::Priority priority)
 {
-    std::shared_ptr<Command> command = std::make_shared<Command>(id, arguments, timeout, singleLineTextResult);
+    std::shared_ptr<Command> command = std::make_shared<Command>(id, arguments, timeout, singleLineTextResult, priority);
     return ScheduleCommand(command);
 }
 
@@ -402,15 +398,22 @@ int CommandRunner::CacheCommand(std::shared_ptr<Command> command)
             m_cacheBuffer.push_front(command);
             SetReportedStatusId(command->GetId());
 
-            // Remove any completed commands from the cache if the cache size is greater than the maximum size
+            // Remove the oldest completed commands from the cache if the cache size is greater than the maximum size,
+            // commands still running stay cached (over the maximum size if needed) until they complete
             while (m_cacheBuffer.size() > m_maxCacheSize)
             {
-                std::shared_ptr<Command> oldestCommand = m_cacheBuffer.back();
-                if ((nullptr != oldestCommand) && (oldestCommand->IsComplete()))
+                auto oldestCompleted = std::find_if(m_cacheBuffer.rbegin(), m_cacheBuffer.rend(), [](const std::shared_ptr<Command>& cached)
+                {
+                    return (nullptr != cached) && cached->IsComplete();
+                });
+
+                if (oldestCompleted == m_cacheBuffer.rend())
                 {
-                    m_cacheBuffer.pop_back();
-                    m_commandMap.erase(oldestCommand->GetId());
+                    break;
                 }
+
+                m_commandMap.erase((*oldestCompleted)->GetId());
+                m_cacheBuffer.erase(std::next(oldestCompleted).base());
             }
         }
         else
@@ -460,7 +463,7 @@ void CommandRunner::WorkerThread(CommandRunner& instance)
     OsConfigLogInfo(CommandRunnerLog::Get(), "Starting worker thread for session: %s", instance.m_clientName.c_str());
 
     std::shared_ptr<Command> command;
-    while (nullptr != (command = instance.m_commandQueue.Front().lock()))
+    while (nullptr != (command = instance.m_commandQueue.Start()))
     {
         int exitCode = command->Execute(instance.m_maxPayloadSizeBytes);
 
@@ -474,7 +477,7 @@ void CommandRunner::WorkerThread(CommandRunner& instance)
         }
 
         instance.PersistCommandStatus(command->GetStatus());
-        instance.m_commandQueue.Pop();
+        instance.m_commandQueue.Complete(command);
     }
 
     OsConfigLogInfo(CommandRunnerLog::Get(), "Worker thread stopped for session: %s", instance.m_clientName.c_str());
@@ -496,44 +499,23 @@ Command::Status CommandRunner::GetStatusToPersist()
 int CommandRunner::LoadPersistedCommandStatus(const std::string& clientName)
 {
     int status = 0;
+    std::vector<Command::Status> statuses;
 
-    std::lock_guard<std::mutex> lock(m_diskCacheMutex);
-    std::ifstream file(m_persistedCacheFile);
-
-    if (file.good())
+    if (0 == (status = GetJournal().Load(clientName, statuses)))
     {
-        rapidjson::IStreamWrapper isw(file);
-        rapidjson::Document document;
-
-        if (document.ParseStream(isw).HasParseError())
-        {
-            OsConfigLogError(CommandRunnerLog::Get(), "Failed to parse cache file");
-            status = EINVAL;
-        }
-        else if (!document.IsObject())
+        for (const Command::Status& commandStatus : statuses)
         {
-            OsConfigLogError(CommandRunnerLog::Get(), "Cache file JSON is not an array");
-            status = EINVAL;
-        }
-        else if (document.HasMember(clientName.c_str()))
-        {
-            const rapidjson::Value& client = document[clientName.c_str()];
+            std::shared_ptr<Command> command = std::make_shared<Command>(commandStatus.m_id, "", 0, "");
+            command->SetStatus(commandStatus.m_exitCode, commandStatus.m_textResult, commandStatus.m_state);
 
-            for (auto& it : client.GetArray())
+            if (0 != CacheCommand(command))
             {
-                Command::Status commandStatus = Command::Status::Deserialize(it);
-
-                std::shared_ptr<Command> command = std::make_shared<Command>(commandStatus.m_id, "", 0, "");
-                command->SetStatus(commandStatus.m_exitCode, commandStatus.m_textResult, commandStatus.m_state);
-
-                if (0 != CacheCommand(command))
-                {
-                    OsConfigLogError(CommandRunnerLog::Get(), "Failed to cache command: %s", commandStatus.m_id.c_str());
-                    status = -1;
-                }
+                OsConfigLogError(CommandRunnerLog::Get(), "Failed to cache command: %s", commandStatus.m_id.c_str());
+                status = -1;
             }
         }
-        else if (IsFullLoggingEnabled())
+
+        if (statuses.empty() && IsFullLoggingEnabled())
         {
             OsConfigLogInfo(CommandRunnerLog::Get(), "Cache file does not contain a status for client: %s", clientName.c_str());
         }
@@ -549,145 +531,169 @@ int CommandRunner::PersistCommandStatus(const Command::Status& status)
 
 int CommandRunner::PersistCommandStatus(const std::string& clientName, const Command::Status commandStatus)
 {
-    int status = 0;
-    rapidjson::Document document;
-    rapidjson::Document statusDocument;
-    statusDocument.Parse(Command::Status::Serialize(commandStatus, false).c_str());
-    std::lock_guard<std::mutex> lock(m_diskCacheMutex);
+    return GetJournal().Append(clientName, commandStatus);
+}
+
+// One journal for the sessions of all clients, opened and replayed on first use
+CommandJournal& CommandRunner::GetJournal()
+{
+    static CommandJournal journal(m_persistedCacheFile, m_maxCacheSize);
+    return journal;
+}
+
+CommandScheduler::CommandScheduler(unsigned int slots) :
+    m_slots(slots),
+    m_runningLowPriority(0),
+    m_runningBarrier(false),
+    m_stopped(false) { }
+
+bool CommandScheduler::IsBarrier(const std::shared_ptr<Command>& command)
+{
+    return (nullptr != std::dynamic_pointer_cast<ShutdownCommand>(command));
+}
 
-    std::ifstream file(m_persistedCacheFile);
-    if (file.good())
+void CommandScheduler::Push(std::shared_ptr<Command> command)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.push_back(command);
+    m_condition.notify_all();
+}
+
+// Must be called with m_mutex held, returns m_queue.end() when no queued command can start now
+std::deque<std::shared_ptr<Command>>::iterator CommandScheduler::Next()
+{
+    std::deque<std::shared_ptr<Command>>::iterator next = m_queue.end();
+
+    if (m_stopped || m_runningBarrier || m_queue.empty() || (m_running.size() >= m_slots))
     {
-        rapidjson::IStreamWrapper isw(file);
-        if (document.ParseStream(isw).HasParseError() || (!document.IsObject()))
-        {
-            document.Parse(m_defaultCacheTemplate);
-        }
+        return next;
     }
-    else
+
+    if (IsBarrier(m_queue.front()))
     {
-        document.Parse(m_defaultCacheTemplate);
+        return m_running.empty() ? m_queue.begin() : next;
     }
 
-    rapidjson::Document::AllocatorType& allocator = document.GetAllocator();
-
-    if (document.HasMember(clientName.c_str()))
+    // Only the commands ahead of the first barrier can start, the highest priority first
+    bool lowPriorityAllowed = (1 == m_slots) || ((m_runningLowPriority + 1) < m_slots);
+    for (std::deque<std::shared_ptr<Command>>::iterator it = m_queue.begin(); (it != m_queue.end()) && !IsBarrier(*it); it++)
     {
-        bool updated = false;
-        rapidjson::Value& client = document[clientName.c_str()];
-
-        if (!client.IsArray())
+        Command::Priority priority = (*it)->m_priority;
+        if ((Command::Priority::Low == priority) && !lowPriorityAllowed)
         {
-            client.SetArray();
+            continue;
         }
 
-        for (auto& it : client.GetArray())
+        if (Command::Priority::High == priority)
         {
-            if (it.HasMember(g_commandId.c_str()) && it[g_commandId.c_str()].IsString() && (it[g_commandId.c_str()].GetString() == commandStatus.m_id))
-            {
-                it.CopyFrom(statusDocument, allocator);
-                updated = true;
-                break;
-            }
+            next = it;
+            break;
         }
-
-        if (!updated)
+        else if ((m_queue.end() == next) || ((Command::Priority::Normal == priority) && (Command::Priority::Low == (*next)->m_priority)))
         {
-            if (client.Size() >= m_maxCacheSize)
-            {
-                client.Erase(client.Begin());
-            }
-
-            client.PushBack(statusDocument, allocator);
+            next = it;
         }
     }
-    else
-    {
-        rapidjson::Value object(rapidjson::kArrayType);
-        object.PushBack(statusDocument, allocator);
-        document.AddMember(rapidjson::Value(clientName.c_str(), allocator), object, allocator);
-    }
 
-    rapidjson::StringBuffer buffer;
-    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
-    document.Accept(writer);
+    return next;
+}
+
+std::shared_ptr<Command> CommandScheduler::TryStart()
+{
+    std::shared_ptr<Command> command;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::deque<std::shared_ptr<Command>>::iterator next = Next();
 
-    if (buffer.GetSize() > 0)
+    if (m_queue.end() != next)
     {
-        std::FILE* file = std::fopen(m_persistedCacheFile, "w+");
-        if (nullptr == file)
+        command = *next;
+        m_queue.erase(next);
+        m_running.push_back(command);
+
+        if (IsBarrier(command))
         {
-            OsConfigLogError(CommandRunnerLog::Get(), "Failed to open file: %s", m_persistedCacheFile);
-            status = EACCES;
+            m_runningBarrier = true;
         }
-        else
+        else if (Command::Priority::Low == command->m_priority)
         {
-            int rc = std::fputs(buffer.GetString(), file);
+            m_runningLowPriority++;
+        }
+    }
 
-            if ((0 > rc) || (EOF == rc))
-            {
-                status = errno ? errno : EINVAL;
-                OsConfigLogError(CommandRunnerLog::Get(), "Failed write to file %s, error: %d %s", m_persistedCacheFile, status, errno ? strerror(errno) : "-");
-            }
+    return command;
+}
 
-            fflush(file);
-            std::fclose(file);
+std::shared_ptr<Command> CommandScheduler::Start()
+{
+    std::shared_ptr<Command> command;
 
-            RestrictFileAccessToCurrentAccountOnly(m_persistedCacheFile);
+    while (nullptr == (command = TryStart()))
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_stopped)
+        {
+            break;
         }
+
+        m_condition.wait(lock, [this] { return m_stopped || (m_queue.end() != Next()); });
     }
 
-    return status;
+    return command;
 }
 
-template<class T>
-CommandRunner::SafeQueue<T>::SafeQueue() :
-    m_queue(),
-    m_mutex(),
-    m_condition() { }
-
-template<class T>
-void CommandRunner::SafeQueue<T>::Push(T value)
+void CommandScheduler::Complete(std::shared_ptr<Command> command)
 {
     std::lock_guard<std::mutex> lock(m_mutex);
-    m_queue.push(value);
-    m_condition.notify_one();
-}
-
-template<class T>
-T CommandRunner::SafeQueue<T>::Pop()
-{
-    std::unique_lock<std::mutex> lock(m_mutex);
-    m_condition.wait(lock, [this] { return !m_queue.empty(); });
-    T value = m_queue.front();
-    m_queue.pop();
+    std::vector<std::shared_ptr<Command>>::iterator running = std::find(m_running.begin(), m_running.end(), command);
 
-    if (m_queue.empty())
+    if (m_running.end() != running)
     {
-        m_conditionEmpty.notify_one();
+        m_running.erase(running);
+
+        if (IsBarrier(command))
+        {
+            m_runningBarrier = false;
+        }
+        else if (Command::Priority::Low == command->m_priority)
+        {
+            m_runningLowPriority--;
+        }
     }
 
-    return value;
+    m_condition.notify_all();
+
+    if (m_queue.empty() && m_running.empty())
+    {
+        m_conditionIdle.notify_all();
+    }
 }
 
-template<class T>
-T CommandRunner::SafeQueue<T>::Front()
+void CommandScheduler::CancelAll()
 {
-    std::unique_lock<std::mutex> lock(m_mutex);
-    m_condition.wait(lock, [this] { return !m_queue.empty(); });
-    return m_queue.front();
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (std::shared_ptr<Command>& command : m_queue)
+    {
+        command->Cancel();
+    }
+
+    for (std::shared_ptr<Command>& command : m_running)
+    {
+        command->Cancel();
+    }
 }
 
-template<class T>
-bool CommandRunner::SafeQueue<T>::Empty()
+void CommandScheduler::Stop()
 {
     std::lock_guard<std::mutex> lock(m_mutex);
-    return m_queue.empty();
+    m_stopped = true;
+    m_queue.clear();
+    m_condition.notify_all();
+    m_conditionIdle.notify_all();
 }
 
-template<class T>
-void CommandRunner::SafeQueue<T>::WaitUntilEmpty()
+void CommandScheduler::WaitUntilIdle()
 {
     std::unique_lock<std::mutex> lock(m_mutex);
-    m_conditionEmpty.wait(lock, [this] { return m_queue.empty(); });
-}
\ No newline at end of file
+    m_conditionIdle.wait(lock, [this] { return m_stopped || (m_queue.empty() && m_running.empty()); });
+}
\ No newline at end of file
@@ -5,28 +5,71 @@
 #define COMMANDRUNNER_H
 
 #include <condition_variable>
+#include <deque>
 #include <map>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <rapidjson/document.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <Command.h>
+#include <CommandJournal.h>
 #include <Mmi.h>
 
+// Hands queued commands to a fixed number of execution slots. Higher priority commands start first, in arrival
+// order within a priority, and one slot is kept for commands that are not low priority so that short queries do
+// not wait behind long jobs. A reboot or shutdown keeps its place: it starts once everything queued before it has
+// completed and nothing queued after it starts before it has run
+class CommandScheduler
+{
+public:
+    CommandScheduler(unsigned int slots);
+
+    void Push(std::shared_ptr<Command> command);
+
+    // Returns the next command that can start now and takes a slot for it, nullptr when there is none
+    std::shared_ptr<Command> TryStart();
+
+    // Waits for a command to start, nullptr once stopped
+    std::shared_ptr<Command> Start();
+
+    // Gives back the slot of a command returned by TryStart or Start
+    void Complete(std::shared_ptr<Command> command);
+
+    void CancelAll();
+    void Stop();
+    void WaitUntilIdle();
+
+private:
+    static bool IsBarrier(const std::shared_ptr<Command>& command);
+    std::deque<std::shared_ptr<Command>>::iterator Next();
+
+    const unsigned int m_slots;
+    std::deque<std::shared_ptr<Command>> m_queue;
+    std::vector<std::shared_ptr<Command>> m_running;
+    unsigned int m_runningLowPriority;
+    bool m_runningBarrier;
+    bool m_stopped;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::condition_variable m_conditionIdle;
+};
+
 class CommandRunner
 {
 public:
     static const std::string m_componentName;
 
     static const unsigned int m_maxCacheSize;
+    static const unsigned int m_defaultConcurrentCommands;
     static const char* m_persistedCacheFile;
-    static const char* m_defaultCacheTemplate;
 
-    CommandRunner(std::string name, unsigned int maxSizeInBytes = 0, bool usePersistedCache = true);
+    CommandRunner(std::string name, unsigned int maxSizeInBytes = 0, bool usePersistedCache = true, unsigned int concurrentCommands = m_defaultConcurrentCommands);
     ~CommandRunner();
 
     static int GetInfo(const char* clientName, MMI_JSON_STRING* payload, int* payloadSizeBytes);
@@ -36,30 +79,10 @@ public:
     const std::string& GetClientName() const;
     unsigned int GetMaxPayloadSizeBytes() const;
 
-    // Helper method to wait for the worker thread during unit tests
+    // Helper method to wait for the worker threads during unit tests
     void WaitForCommands();
 
 private:
-    template<class T>
-    class SafeQueue
-    {
-    public:
-        SafeQueue();
-        ~SafeQueue() { }
-
-        void Push(T element);
-        T Pop();
-        T Front();
-        bool Empty();
-        void WaitUntilEmpty();
-
-    private:
-        std::queue<T> m_queue;
-        mutable std::mutex m_mutex;
-        std::condition_variable m_condition;
-        std::condition_variable m_conditionEmpty;
-    };
-
     const std::string m_clientName;
     const unsigned int m_maxPayloadSizeBytes;
     const bool m_usePersistedCache;
@@ -67,8 +90,8 @@ private:
     std::string m_commandIdLoadedFromDisk;
     size_t m_lastPayloadHash;
 
-    std::thread m_workerThread;
-    SafeQueue<std::weak_ptr<Command>> m_commandQueue;
+    std::vector<std::thread> m_workerThreads;
+    CommandScheduler m_commandQueue;
 
     std::deque<std::shared_ptr<Command>> m_cacheBuffer;
     std::map<std::string, std::shared_ptr<Command>> m_commandMap;
@@ -77,9 +100,7 @@ private:
     std::string m_reportedStatusId;
     std::mutex m_reportedStatusIdMutex;
 
-    static std::mutex m_diskCacheMutex;
-
-    int Run(const std::string id, std::string arguments, unsigned int timeout, bool singleLineTextResult);
+    int Run(const std::string id, std::string arguments, unsigned int timeout, bool singleLineTextResult, Command::Priority priority);
     int Reboot(const std::string id);
     int Shutdown(const std::string id);
     int Cancel(const std::string id);
@@ -96,14 +117,13 @@ private:
     Command::Status GetReportedStatus();
 
     static void WorkerThread(CommandRunner& instance);
-    void Execute(Command command);
 
     Command::Status GetStatusToPersist();
     int LoadPersistedCommandStatus(const std::string& clientName);
     int PersistCommandStatus(const Command::Status& status);
     static int PersistCommandStatus(const std::string& clientName, const Command::Status status);
+    static CommandJournal& GetJournal();
 
-    static int WriteFile(const std::string& fileName, const rapidjson::StringBuffer& buffer);
     static int CopyJsonPayload(MMI_JSON_STRING* payload, int* payloadSizeBytes, const rapidjson::StringBuffer& buffer);
 };
 
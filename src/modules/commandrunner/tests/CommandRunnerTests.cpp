@@ -1,10 +1,14 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
+#include <atomic>
+#include <fstream>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <sstream>
 
 #include <Command.h>
+#include <CommandJournal.h>
 #include <CommandRunner.h>
 #include <Mmi.h>
 #include <TestUtils.h>
@@ -192,6 +196,59 @@ namespace Tests
         EXPECT_TRUE(IsJsonEq(Command::Status::Serialize(status), std::string(reportedPayload, payloadSizeBytes)));
     }
 
+    TEST_F(CommandRunnerTests, RunCommandTruncatedTextResult)
+    {
+        std::string id = Id();
+        Command::Arguments arguments(id, "printf '0123456789abcdefghijklmnopqrstuvwxyz'", Command::Action::RunCommand, 0, false);
+
+        // The head and the tail of the output around the truncation marker
+        std::string expectedTextResult = "0123456 [...] tuvwxyz";
+        Command::Status status(id, 0, expectedTextResult, Command::State::Succeeded);
+        std::string desiredPayload = Command::Arguments::Serialize(arguments);
+
+        Command::Status emptyStatus(id, 0, "", Command::State::Succeeded);
+        unsigned int limitedPayloadSize = Command::Status::Serialize(emptyStatus).length() + expectedTextResult.size() + 1;
+
+        CommandRunner commandRunner("Limited_Payload_Client", limitedPayloadSize, false);
+        MMI_JSON_STRING reportedPayload = nullptr;
+        int payloadSizeBytes = 0;
+
+        EXPECT_EQ(MMI_OK, commandRunner.Set(m_component, m_desiredObject, (MMI_JSON_STRING)(desiredPayload.c_str()), desiredPayload.size()));
+
+        commandRunner.WaitForCommands();
+
+        EXPECT_EQ(MMI_OK, commandRunner.Get(m_component, m_reportedObject, &reportedPayload, &payloadSizeBytes));
+        EXPECT_TRUE(IsJsonEq(Command::Status::Serialize(status), std::string(reportedPayload, payloadSizeBytes)));
+    }
+
+    TEST_F(CommandRunnerTests, RunCommandPartialTextResult)
+    {
+        std::string id = Id();
+        Command::Arguments arguments(id, "echo 'started'; sleep 2; echo 'done'", Command::Action::RunCommand, 0, false);
+        Command::Status runningStatus(id, 0, "started\n", Command::State::Running);
+        Command::Status status(id, 0, "started\ndone\n", Command::State::Succeeded);
+
+        std::string desiredPayload = Command::Arguments::Serialize(arguments);
+        MMI_JSON_STRING reportedPayload = nullptr;
+        int payloadSizeBytes = 0;
+        bool partial = false;
+
+        EXPECT_EQ(MMI_OK, m_commandRunner->Set(m_component, m_desiredObject, (MMI_JSON_STRING)(desiredPayload.c_str()), desiredPayload.size()));
+
+        for (int i = 0; (i < 100) && !partial; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            EXPECT_EQ(MMI_OK, m_commandRunner->Get(m_component, m_reportedObject, &reportedPayload, &payloadSizeBytes));
+            partial = IsJsonEq(Command::Status::Serialize(runningStatus), std::string(reportedPayload, payloadSizeBytes));
+        }
+        EXPECT_TRUE(partial);
+
+        m_commandRunner->WaitForCommands();
+
+        EXPECT_EQ(MMI_OK, m_commandRunner->Get(m_component, m_reportedObject, &reportedPayload, &payloadSizeBytes));
+        EXPECT_TRUE(IsJsonEq(Command::Status::Serialize(status), std::string(reportedPayload, payloadSizeBytes)));
+    }
+
     TEST_F(CommandRunnerTests, RunCommandMaximumCacheSize)
     {
         std::vector<std::pair<std::string, Command::Status>> expectedResults;
@@ -308,6 +365,40 @@ namespace Tests
         EXPECT_TRUE(IsJsonEq(Command::Status::Serialize(status), std::string(reportedPayload, payloadSizeBytes)));
     }
 
+    TEST_F(CommandRunnerTests, CancelRunningCommandPromptly)
+    {
+        std::string id = Id();
+        Command::Arguments arguments(id, "echo 'started'; sleep 10s", Command::Action::RunCommand, 0, false);
+        Command::Arguments cancelCommand(id, "", Command::Action::CancelCommand, 0, false);
+        Command::Status runningStatus(id, 0, "started\n", Command::State::Running);
+        Command::Status status(id, ECANCELED, "started\n", Command::State::Canceled);
+
+        std::string desiredPayload = Command::Arguments::Serialize(arguments);
+        std::string cancelPayload = Command::Arguments::Serialize(cancelCommand);
+
+        MMI_JSON_STRING reportedPayload = nullptr;
+        int payloadSizeBytes = 0;
+        bool running = false;
+
+        EXPECT_EQ(MMI_OK, m_commandRunner->Set(m_component, m_desiredObject, (MMI_JSON_STRING)(desiredPayload.c_str()), desiredPayload.size()));
+
+        for (int i = 0; (i < 100) && !running; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            EXPECT_EQ(MMI_OK, m_commandRunner->Get(m_component, m_reportedObject, &reportedPayload, &payloadSizeBytes));
+            running = IsJsonEq(Command::Status::Serialize(runningStatus), std::string(reportedPayload, payloadSizeBytes));
+        }
+        EXPECT_TRUE(running);
+
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_EQ(MMI_OK, m_commandRunner->Set(m_component, m_desiredObject, (MMI_JSON_STRING)(cancelPayload.c_str()), cancelPayload.size()));
+        m_commandRunner->WaitForCommands();
+        EXPECT_GT(1000, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+
+        EXPECT_EQ(MMI_OK, m_commandRunner->Get(m_component, m_reportedObject, &reportedPayload, &payloadSizeBytes));
+        EXPECT_TRUE(IsJsonEq(Command::Status::Serialize(status), std::string(reportedPayload, payloadSizeBytes)));
+    }
+
     TEST_F(CommandRunnerTests, RepeatCommandId)
     {
         std::string id = Id();
@@ -396,6 +487,33 @@ namespace Tests
         EXPECT_EQ(Command::State::Succeeded, m_command->GetStatus().m_state);
     }
 
+    TEST_F(CommandRunnerTests, CommandOutput)
+    {
+        CommandOutput unlimited;
+        unlimited.Append("hello ", 6);
+        unlimited.Append("world", 5);
+        EXPECT_EQ("hello world", unlimited.ToString());
+
+        CommandOutput fits(22);
+        fits.Append("0123456789", 10);
+        fits.Append("abcdefghijk", 11);
+        EXPECT_EQ("0123456789abcdefghijk", fits.ToString());
+
+        CommandOutput truncated(22);
+        for (const char* it = "0123456789abcdefghijklmnopqrstuvwxyz"; *it; it++)
+        {
+            truncated.Append(it, 1);
+        }
+        EXPECT_EQ("0123456 [...] tuvwxyz", truncated.ToString());
+
+        truncated.Append("ABCDEFGHIJKLMNOPQRSTUVWXYZ", 26);
+        EXPECT_EQ("0123456 [...] TUVWXYZ", truncated.ToString());
+
+        CommandOutput small(6);
+        small.Append("hello world", 11);
+        EXPECT_EQ("hello", small.ToString());
+    }
+
     TEST_F(CommandRunnerTests, CommandEquality)
     {
         std::shared_ptr<Command> command1 = std::make_shared<Command>(m_id, "echo 'test'", 0, false);
@@ -488,5 +606,379 @@ namespace Tests
         EXPECT_EQ(Command::State::Succeeded, status.m_state);
     }
 
+    TEST_F(CommandRunnerTests, DeserializePriority)
+    {
+        const std::string json = R"""({
+            "commandId": "id",
+            "arguments": "echo 'hello world'",
+            "action": 3,
+            "timeout": 10,
+            "singleLineTextResult": true,
+            "priority": 1
+        })""";
+
+        rapidjson::Document document;
+        document.Parse(json.c_str());
+
+        Command::Arguments arguments = Command::Arguments::Deserialize(document);
+        EXPECT_EQ(Command::Priority::High, arguments.m_priority);
+
+        document.Parse(R"""({"commandId": "id", "arguments": "echo 'hello world'", "action": 3})""");
+        EXPECT_EQ(Command::Priority::Normal, Command::Arguments::Deserialize(document).m_priority);
+    }
+
+    TEST_F(CommandRunnerTests, SchedulerPriority)
+    {
+        CommandScheduler scheduler(1);
+        std::shared_ptr<Command> normal = std::make_shared<Command>(Id(), "echo 'normal'", 0, false);
+        std::shared_ptr<Command> low = std::make_shared<Command>(Id(), "echo 'low'", 0, false, Command::Priority::Low);
+        std::shared_ptr<Command> high = std::make_shared<Command>(Id(), "echo 'high'", 0, false, Command::Priority::High);
+
+        scheduler.Push(normal);
+        scheduler.Push(low);
+        scheduler.Push(high);
+
+        std::shared_ptr<Command> started = scheduler.TryStart();
+        EXPECT_EQ(high, started);
+        EXPECT_EQ(nullptr, scheduler.TryStart());
+        scheduler.Complete(started);
+
+        started = scheduler.TryStart();
+        EXPECT_EQ(normal, started);
+        scheduler.Complete(started);
+
+        started = scheduler.TryStart();
+        EXPECT_EQ(low, started);
+        scheduler.Complete(started);
+
+        EXPECT_EQ(nullptr, scheduler.TryStart());
+    }
+
+    TEST_F(CommandRunnerTests, SchedulerReservesSlotForNonLowPriority)
+    {
+        CommandScheduler scheduler(2);
+        std::shared_ptr<Command> low1 = std::make_shared<Command>(Id(), "echo 'low'", 0, false, Command::Priority::Low);
+        std::shared_ptr<Command> low2 = std::make_shared<Command>(Id(), "echo 'low'", 0, false, Command::Priority::Low);
+        std::shared_ptr<Command> normal = std::make_shared<Command>(Id(), "echo 'normal'", 0, false);
+
+        scheduler.Push(low1);
+        scheduler.Push(low2);
+
+        EXPECT_EQ(low1, scheduler.TryStart());
+        EXPECT_EQ(nullptr, scheduler.TryStart());
+
+        scheduler.Push(normal);
+        EXPECT_EQ(normal, scheduler.TryStart());
+
+        scheduler.Complete(low1);
+        EXPECT_EQ(low2, scheduler.TryStart());
+        scheduler.Complete(normal);
+        scheduler.Complete(low2);
+        EXPECT_EQ(nullptr, scheduler.TryStart());
+    }
+
+    TEST_F(CommandRunnerTests, SchedulerShutdownIsBarrier)
+    {
+        CommandScheduler scheduler(4);
+        std::shared_ptr<Command> first = std::make_shared<Command>(Id(), "echo 'first'", 0, false);
+        std::shared_ptr<Command> second = std::make_shared<Command>(Id(), "echo 'second'", 0, false);
+        std::shared_ptr<Command> shutdown = std::make_shared<ShutdownCommand>(Id(), "echo 'shutdown'", 0, false);
+        std::shared_ptr<Command> third = std::make_shared<Command>(Id(), "echo 'third'", 0, false, Command::Priority::High);
+
+        scheduler.Push(first);
+        scheduler.Push(second);
+        scheduler.Push(shutdown);
+        scheduler.Push(third);
+
+        EXPECT_EQ(first, scheduler.TryStart());
+        EXPECT_EQ(second, scheduler.TryStart());
+        EXPECT_EQ(nullptr, scheduler.TryStart());
+
+        scheduler.Complete(first);
+        EXPECT_EQ(nullptr, scheduler.TryStart());
+        scheduler.Complete(second);
+
+        EXPECT_EQ(shutdown, scheduler.TryStart());
+        EXPECT_EQ(nullptr, scheduler.TryStart());
+        scheduler.Complete(shutdown);
+
+        EXPECT_EQ(third, scheduler.TryStart());
+        scheduler.Complete(third);
+    }
+
+    TEST_F(CommandRunnerTests, RunCommandMaximumCacheSizeWithRunningCommand)
+    {
+        std::string runningId = Id();
+        Command::Arguments runningCommand(runningId, "sleep 10s", Command::Action::RunCommand, 0, false);
+        Command::Arguments cancelCommand(runningId, "", Command::Action::CancelCommand, 0, false);
+        std::vector<std::string> ids;
+
+        MMI_JSON_STRING reportedPayload = nullptr;
+        int payloadSizeBytes = 0;
+
+        std::string desiredPayload = Command::Arguments::Serialize(runningCommand);
+        EXPECT_EQ(MMI_OK, m_commandRunner->Set(m_component, m_desiredObject, (MMI_JSON_STRING)(desiredPayload.c_str()), desiredPayload.size()));
+
+        // Fill the rest of the cache with commands that complete while the oldest one is still running
+        for (unsigned int i = 1; i < CommandRunner::m_maxCacheSize; i++)
+        {
+            ids.push_back(Id());
+            Command::Arguments arguments(ids.back(), "echo '" + ids.back() + "'", Command::Action::RunCommand, 0, false);
+            desiredPayload = Command::Arguments::Serialize(arguments);
+            EXPECT_EQ(MMI_OK, m_commandRunner->Set(m_component, m_desiredObject, (MMI_JSON_STRING)(desiredPayload.c_str()), desiredPayload.size()));
+        }
+
+        for (const std::string& id : ids)
+        {
+            Command::Arguments arguments(id, "", Command::Action::RefreshCommandStatus, 0, false);
+            Command::Status status(id, 0, id + "\n", Command::State::Succeeded);
+            std::string refresh = Command::Arguments::Serialize(arguments);
+            bool complete = false;
+
+            for (int i = 0; (i < 100) && !complete; i++)
+            {
+                EXPECT_EQ(MMI_OK, m_commandRunner->Set(m_component, m_desiredObject, (MMI_JSON_STRING)(refresh.c_str()), refresh.size()));
+                EXPECT_EQ(MMI_OK, m_commandRunner->Get(m_component, m_reportedObject, &reportedPayload, &payloadSizeBytes));
+                complete = IsJsonEq(Command::Status::Serialize(status), std::string(reportedPayload, payloadSizeBytes));
+                if (!complete)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            }
+            EXPECT_TRUE(complete);
+        }
+
+        // One more command evicts the oldest completed command instead of waiting for the running one
+        std::string id = Id();
+        Command::Arguments extraCommand(id, "echo '" + id + "'", Command::Action::RunCommand, 0, false);
+        desiredPayload = Command::Arguments::Serialize(extraCommand);
+        EXPECT_EQ(MMI_OK, m_commandRunner->Set(m_component, m_desiredObject, (MMI_JSON_STRING)(desiredPayload.c_str()), desiredPayload.size()));
+
+        Command::Arguments refreshFirstCompleted(ids.front(), "", Command::Action::RefreshCommandStatus, 0, false);
+        std::string refresh = Command::Arguments::Serialize(refreshFirstCompleted);
+        EXPECT_EQ(EINVAL, m_commandRunner->Set(m_component, m_desiredObject, (MMI_JSON_STRING)(refresh.c_str()), refresh.size()));
+
+        Command::Arguments refreshRunning(runningId, "", Command::Action::RefreshCommandStatus, 0, false);
+        refresh = Command::Arguments::Serialize(refreshRunning);
+        EXPECT_EQ(MMI_OK, m_commandRunner->Set(m_component, m_desiredObject, (MMI_JSON_STRING)(refresh.c_str()), refresh.size()));
+
+        std::string cancelPayload = Command::Arguments::Serialize(cancelCommand);
+        EXPECT_EQ(MMI_OK, m_commandRunner->Set(m_component, m_desiredObject, (MMI_JSON_STRING)(cancelPayload.c_str()), cancelPayload.size()));
+        m_commandRunner->WaitForCommands();
+    }
+
+    TEST_F(CommandRunnerTests, RunCommandsConcurrently)
+    {
+        std::shared_ptr<CommandRunner> commandRunner = std::make_shared<CommandRunner>("CommandRunner_Test_Client", 0, false, 3);
+        std::vector<std::string> ids;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 3; i++)
+        {
+            ids.push_back(Id());
+            Command::Arguments arguments(ids.back(), "sleep 1", Command::Action::RunCommand, 0, false);
+            std::string desiredPayload = Command::Arguments::Serialize(arguments);
+            EXPECT_EQ(MMI_OK, commandRunner->Set(m_component, m_desiredObject, (MMI_JSON_STRING)(desiredPayload.c_str()), desiredPayload.size()));
+        }
+
+        commandRunner->WaitForCommands();
+        EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count(), 2500);
+
+        for (const std::string& id : ids)
+        {
+            Command::Arguments arguments(id, "", Command::Action::RefreshCommandStatus, 0, false);
+            std::string desiredPayload = Command::Arguments::Serialize(arguments);
+            MMI_JSON_STRING reportedPayload = nullptr;
+            int payloadSizeBytes = 0;
+
+            EXPECT_EQ(MMI_OK, commandRunner->Set(m_component, m_desiredObject, (MMI_JSON_STRING)(desiredPayload.c_str()), desiredPayload.size()));
+            EXPECT_EQ(MMI_OK, commandRunner->Get(m_component, m_reportedObject, &reportedPayload, &payloadSizeBytes));
+            EXPECT_TRUE(IsJsonEq(Command::Status::Serialize(Command::Status(id, 0, "", Command::State::Succeeded)), std::string(reportedPayload, payloadSizeBytes)));
+        }
+    }
+
+    static std::string ReadJournal(const std::string& fileName)
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    }
+
+    static void WriteJournal(const std::string& fileName, const std::string& content)
+    {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file << content;
+    }
+
+    TEST_F(CommandRunnerTests, JournalReplay)
+    {
+        const std::string fileName = "/tmp/osconfig_commandrunner_test.journal";
+        std::vector<Command::Status> statuses;
+        remove(fileName.c_str());
+
+        {
+            CommandJournal journal(fileName, 2);
+            EXPECT_EQ(0, journal.Append("client1", Command::Status("1", 0, "text result...", Command::State::Running)));
+            EXPECT_EQ(0, journal.Append("client2", Command::Status("2", 0, "", Command::State::Running)));
+            EXPECT_EQ(0, journal.Append("client1", Command::Status("3", 0, "", Command::State::Running)));
+            EXPECT_EQ(0, journal.Append("client1", Command::Status("1", 123, "", Command::State::Failed)));
+            EXPECT_EQ(0, journal.Append("client1", Command::Status("4", 0, "", Command::State::Succeeded)));
+            EXPECT_EQ(5, journal.GetRecordCount());
+        }
+
+        CommandJournal journal(fileName, 2);
+        EXPECT_EQ(0, journal.Load("client1", statuses));
+        ASSERT_EQ(2, statuses.size());
+        EXPECT_EQ("3", statuses[0].m_id);
+        EXPECT_EQ("4", statuses[1].m_id);
+        EXPECT_EQ(Command::State::Succeeded, statuses[1].m_state);
+
+        EXPECT_EQ(0, journal.Load("client2", statuses));
+        ASSERT_EQ(1, statuses.size());
+        EXPECT_EQ("2", statuses[0].m_id);
+        EXPECT_EQ("", statuses[0].m_textResult);
+
+        EXPECT_EQ(0, journal.Load("client3", statuses));
+        EXPECT_TRUE(statuses.empty());
+
+        remove(fileName.c_str());
+    }
+
+    TEST_F(CommandRunnerTests, JournalTornRecord)
+    {
+        const std::string fileName = "/tmp/osconfig_commandrunner_test.journal";
+        std::vector<Command::Status> statuses;
+        remove(fileName.c_str());
+
+        {
+            CommandJournal journal(fileName, 10);
+            EXPECT_EQ(0, journal.Append("client", Command::Status("1", 0, "", Command::State::Succeeded)));
+            EXPECT_EQ(0, journal.Append("client", Command::Status("2", 0, "", Command::State::Succeeded)));
+        }
+
+        // A crash in the middle of the last write
+        std::string content = ReadJournal(fileName);
+        WriteJournal(fileName, content.substr(0, content.size() - 3));
+
+        {
+            CommandJournal journal(fileName, 10);
+            EXPECT_EQ(0, journal.Load("client", statuses));
+            ASSERT_EQ(1, statuses.size());
+            EXPECT_EQ("1", statuses[0].m_id);
+            EXPECT_EQ(0, journal.Append("client", Command::Status("3", 0, "", Command::State::Succeeded)));
+        }
+
+        // A record that does not match its checksum ends the replay
+        content = ReadJournal(fileName);
+        content[content.size() - 5] ^= 0x20;
+        WriteJournal(fileName, content);
+
+        CommandJournal journal(fileName, 10);
+        EXPECT_EQ(0, journal.Load("client", statuses));
+        ASSERT_EQ(1, statuses.size());
+        EXPECT_EQ("1", statuses[0].m_id);
+        EXPECT_EQ(1, journal.GetRecordCount());
+
+        remove(fileName.c_str());
+    }
+
+    TEST_F(CommandRunnerTests, JournalCompaction)
+    {
+        const std::string fileName = "/tmp/osconfig_commandrunner_test.journal";
+        std::vector<Command::Status> statuses;
+        remove(fileName.c_str());
+
+        {
+            CommandJournal journal(fileName, 10);
+            for (unsigned int i = 0; i < CommandJournal::m_compactionRecords; i++)
+            {
+                EXPECT_EQ(0, journal.Append("client", Command::Status("1", i, "", Command::State::Running)));
+            }
+            EXPECT_EQ(0, journal.Append("client", Command::Status("2", 0, "", Command::State::Succeeded)));
+
+            size_t size = ReadJournal(fileName).size();
+            EXPECT_EQ(0, journal.Compact());
+            EXPECT_EQ(2, journal.GetRecordCount());
+            EXPECT_GT(size / 16, ReadJournal(fileName).size());
+        }
+
+        CommandJournal journal(fileName, 10);
+        EXPECT_EQ(0, journal.Load("client", statuses));
+        ASSERT_EQ(2, statuses.size());
+        EXPECT_EQ("1", statuses[0].m_id);
+        EXPECT_EQ((int)CommandJournal::m_compactionRecords - 1, statuses[0].m_exitCode);
+        EXPECT_EQ("2", statuses[1].m_id);
+
+        remove(fileName.c_str());
+    }
+
+    TEST_F(CommandRunnerTests, JournalAppendDuringCompaction)
+    {
+        const std::string fileName = "/tmp/osconfig_commandrunner_test.journal";
+        const int count = 1000;
+        std::vector<Command::Status> statuses;
+        std::atomic<bool> done(false);
+        remove(fileName.c_str());
+
+        {
+            CommandJournal journal(fileName, count);
+            std::thread appender([&]()
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    EXPECT_EQ(0, journal.Append("client", Command::Status(std::to_string(i), i, "", Command::State::Succeeded)));
+                }
+                done = true;
+            });
+
+            // Records appended while the new journal is being written must end up in it
+            while (!done)
+            {
+                EXPECT_EQ(0, journal.Compact());
+            }
+
+            appender.join();
+        }
+
+        CommandJournal journal(fileName, count);
+        EXPECT_EQ(0, journal.Load("client", statuses));
+        ASSERT_EQ(count, statuses.size());
+        for (int i = 0; i < count; i++)
+        {
+            EXPECT_EQ(std::to_string(i), statuses[i].m_id);
+        }
+
+        remove(fileName.c_str());
+    }
+
+    TEST_F(CommandRunnerTests, JournalLegacyCache)
+    {
+        const std::string fileName = "/tmp/osconfig_commandrunner_test.journal";
+        std::vector<Command::Status> statuses;
+
+        WriteJournal(fileName, R"""({
+            "client": [
+                { "commandId": "1", "resultCode": 0, "currentState": 2 },
+                { "commandId": "2", "resultCode": 1, "currentState": 3 }
+            ]
+        })""");
+
+        {
+            CommandJournal journal(fileName, 10);
+            EXPECT_EQ(0, journal.Load("client", statuses));
+            ASSERT_EQ(2, statuses.size());
+            EXPECT_EQ("2", statuses[1].m_id);
+            EXPECT_EQ(Command::State::Failed, statuses[1].m_state);
+        }
+
+        EXPECT_EQ(0, ReadJournal(fileName).compare(0, strlen(CommandJournal::m_magic), CommandJournal::m_magic));
+
+        CommandJournal journal(fileName, 10);
+        EXPECT_EQ(0, journal.Load("client", statuses));
+        EXPECT_EQ(2, statuses.size());
+
+        remove(fileName.c_str());
+    }
 
 } // namespace Tests
\ No newline at end of file
@@ -3,17 +3,15 @@
 
 #include <CommonUtils.h>
 #include <Mmi.h>
-#include <sstream>
 #include <bits/stdc++.h>
 #include "Firewall.h"
 
 OSCONFIG_LOG_HANDLE FirewallLog::m_logFirewall = nullptr;
 const string g_iptablesUtility = "iptables";
-const string g_queryTableCommand = g_iptablesUtility + " -L -n -v --line-number -t ";
-const string g_fingerprintPattern = R"""(\"([a-z0-9]{64})\")""";
+const string g_queryRulesetCommand = "iptables-save 2>/dev/null";
+const unsigned int g_fingerprintLength = 64;
 const char g_firewallState[] = "firewallState";
 const char g_firewallFingerprint[] = "firewallFingerprint";
-const vector<string> g_tableNames = {"filter", "nat", "raw", "mangle", "security"};
 
 FirewallObject::FirewallObject(unsigned int maxPayloadSizeBytes)
 {
@@ -41,10 +39,9 @@ int FirewallObjectBase::Get(
     int status = MMI_OK;
     *payloadSizeBytes = 0;
     string payloadString = "";
-    ClearTableObjects();
-    vector<pair<string, string>> allTableStrings;
-    GetAllTables(g_tableNames, allTableStrings);
-    ParseAllTables(allTableStrings);
+    string rulesetString;
+    CaptureRuleset(rulesetString);
+    ParseRuleset(std::move(rulesetString));
     if ((objectName != nullptr) && (strcmp(objectName, g_firewallState) == 0))
     {
         int state = GetFirewallState();
@@ -88,12 +85,9 @@ string FirewallObjectBase::CreateStatePayload(int state)
 string FirewallObjectBase::CreateFingerprintPayload(string fingerprint)
 {
     string payloadString = "";
-    string fingerprintString = char('"') + fingerprint + char('"');
-    std::regex fingerprintPattern(g_fingerprintPattern);
-    std::smatch pieces;
-    if (std::regex_match(fingerprintString, pieces, fingerprintPattern) == true)
+    if ((fingerprint.length() == g_fingerprintLength) && (std::all_of(fingerprint.begin(), fingerprint.end(), [](char c) { return ((c >= 'a') && (c <= 'z')) || ((c >= '0') && (c <= '9')); })))
     {
-        payloadString = fingerprintString;
+        payloadString = char('"') + fingerprint + char('"');
     }
 
     return payloadString;
@@ -107,7 +101,8 @@ int FirewallObject::DetectUtility(string utility)
     int status = utilityStatusCodeUnknown;
     if (utility == g_iptablesUtility)
     {
-        string commandString = "iptables -L";
+        // Numeric listing of one chain, without -n every rule in the filter table costs a reverse DNS lookup
+        string commandString = "iptables -n -L INPUT";
         char* char_output = nullptr;
         int tempStatus = ExecuteCommand(nullptr, commandString.c_str(), false, true, 0, 0, &char_output, nullptr, FirewallLog::Get());
         if (tempStatus == commandSuccessExitCode)
@@ -128,395 +123,303 @@ int FirewallObject::DetectUtility(string utility)
     return status;
 }
 
-void FirewallObject::GetTable(string tableName, string& tableString)
+void FirewallObject::CaptureRuleset(string& rulesetString)
 {
-    string commandString = g_queryTableCommand + tableName;
-    tableString = "";
     char* output = nullptr;
-    ExecuteCommand(nullptr, commandString.c_str(), false, true, 0, 0, &output, nullptr, FirewallLog::Get());
-    tableString = (output != nullptr) ? string(output) : "";
+    ExecuteCommand(nullptr, g_queryRulesetCommand.c_str(), false, false, 0, 0, &output, nullptr, FirewallLog::Get());
+    rulesetString = (output != nullptr) ? string(output) : "";
     if (output != nullptr)
     {
         free(output);
     }
 }
 
-void FirewallObject::GetAllTables(vector<string> tableNames, vector<pair<string, string>>& allTableStrings)
+bool TextSpan::IsEmpty() const
 {
-    for (unsigned int i = 0; i < tableNames.size(); i++)
-    {
-        string tableString = "";
-        GetTable(tableNames[i], tableString);
-        if (!tableString.empty())
-        {
-            allTableStrings.push_back(make_pair(tableNames[i], tableString));
-        }
-    }
-}
-
-Rule* FirewallObjectBase::ParseRule(string ruleString)
-{
-    Rule* rule = nullptr;
-    // Rules without target value are not parsed since we take no action on packets that match these rules
-    std::regex rulePattern(R"""(\s*(\d+)\s+(\w+)\s+(\w+)\s+(\w+)\s+(\w+)\s+([\w-]+)\s+([\w+\*]+)\s+([\w+\*]+)\s+([0-9\.\!\/]+)\s+([0-9\.\!\/]+)\s+(.*))""" );
-    std::smatch pieces;
-
-    if (std::regex_match(ruleString, pieces, rulePattern))
-    {
-        if (pieces.size() != (ruleTokenRawOptionsIndex + 1))
-        {
-            return rule;
-        }
-
-        rule = new Rule();
-        if (rule != nullptr)
-        {
-            rule->SetRuleNum(std::stoi(pieces.str(ruleTokenNumIndex)));
-            rule->SetTarget(pieces.str(ruleTokenTargetIndex));
-            rule->SetProtocol(pieces.str(ruleTokenProtocolIndex));
-            rule->SetInInterface(pieces.str(ruleTokenInIndex));
-            rule->SetOutInterface(pieces.str(ruleTokenOutIndex));
-            rule->SetSource(pieces.str(ruleTokenSourceIndex));
-            rule->SetDestination(pieces.str(ruleTokenDestinationIndex));
-            rule->SetRawOptions(pieces.str(ruleTokenRawOptionsIndex));
-        }
-    }
-
-    return rule;
-}
-
-Rule::Rule(int ruleNum, string target, string protocol, string source, string destination, string sourcePort, string destinationPort, string inInterface, string outInterface, string rawOptions)
-{
-    m_ruleNum = ruleNum;
-    m_target = target;
-    m_protocol = protocol;
-    m_source = source;
-    m_destination = destination;
-    m_sourcePort = sourcePort;
-    m_destinationPort = destinationPort;
-    m_inInterface = inInterface;
-    m_outInterface = outInterface;
-    m_rawOptions = rawOptions;
-}
-
-Rule::Rule()
-{
-    Rule(0, "", "", "", "", "", "", "", "", "");
-}
-
-int Rule::GetRuleNum()
-{
-    return m_ruleNum;
-}
-
-string Rule::GetTarget()
-{
-    return m_target;
-}
-
-string Rule::GetProtocol()
-{
-    return m_protocol;
-}
-
-string Rule::GetSource()
-{
-    return m_source;
-}
-
-string Rule::GetDestination()
-{
-    return m_destination;
-}
-
-string Rule::GetSourcePort()
-{
-    return m_sourcePort;
-}
-
-string Rule::GetDestinationPort()
-{
-    return m_destinationPort;
-}
-
-string Rule::GetInInterface()
-{
-    return m_inInterface;
-}
-
-string Rule::GetOutInterface()
-{
-    return m_outInterface;
-}
-
-string Rule::GetRawOptions()
-{
-    return m_rawOptions;
-}
-
-void Rule::SetRuleNum(int ruleNum)
-{
-    m_ruleNum = ruleNum;
-}
-
-void Rule::SetTarget(string target)
-{
-    m_target = target;
+    return (length == 0);
 }
 
-void Rule::SetProtocol(string protocol)
+bool TextSpan::Equals(const char* value) const
 {
-    m_protocol = protocol;
+    return (strlen(value) == length) && ((length == 0) || (memcmp(data, value, length) == 0));
 }
 
-void Rule::SetSource(string source)
+string TextSpan::ToString() const
 {
-    m_source = source;
+    return (length > 0) ? string(data, length) : string();
 }
 
-void Rule::SetDestination(string destination)
+static bool IsBlank(char c)
 {
-    m_destination = destination;
+    return (c == ' ') || (c == '\t') || (c == '\r');
 }
 
-void Rule::SetSourcePort(string sourcePort)
+// Returns the next token of a line and moves past it. Quoted tokens such as comments and log prefixes
+// are returned with their quotes, escaped quotes do not end them
+static TextSpan NextToken(const char*& position, const char* end)
 {
-    m_sourcePort = sourcePort;
-}
-
-void Rule::SetDestinationPort(string destinationPort)
-{
-    m_destinationPort = destinationPort;
-}
+    TextSpan token = {nullptr, 0};
+    const char* start = nullptr;
 
-void Rule::SetInInterface(string inInterface)
-{
-    m_inInterface = inInterface;
-}
-
-void Rule::SetOutInterface(string outInterface)
-{
-    m_outInterface = outInterface;
-}
-
-void Rule::SetRawOptions(string rawOptions)
-{
-    m_rawOptions = rawOptions;
-}
-
-Chain::Chain(string chainName)
-{
-    m_chainName = chainName;
-    m_chainPolicy = "";
-    m_rules = {};
-}
-
-Chain::Chain()
-{
-    Chain("");
-}
-
-void Chain::SetChainName(string chainName)
-{
-    m_chainName = chainName;
-}
-
-void Chain::SetChainPolicy(string chainPolicy)
-{
-    m_chainPolicy = chainPolicy;
-}
+    while ((position < end) && IsBlank(*position))
+    {
+        position++;
+    }
 
-string Chain::GetChainName()
-{
-    return m_chainName;
-}
+    start = position;
+    if ((position < end) && (*position == '"'))
+    {
+        for (position++; (position < end) && (*position != '"'); position++)
+        {
+            if ((*position == '\\') && ((position + 1) < end))
+            {
+                position++;
+            }
+        }
 
-string Chain::GetChainPolicy()
-{
-    return m_chainPolicy;
-}
+        if (position < end)
+        {
+            position++;
+        }
+    }
+    else
+    {
+        while ((position < end) && !IsBlank(*position))
+        {
+            position++;
+        }
+    }
 
-int Chain::GetRuleCount()
-{
-    return (int) m_rules.size();
+    token.data = start;
+    token.length = position - start;
+    return token;
 }
 
-void Chain::Append(Rule* rule)
+static TextSpan TrimSpan(const char* start, const char* end)
 {
-    m_rules.push_back(rule);
-}
+    TextSpan span = {start, 0};
+    while ((start < end) && IsBlank(*start))
+    {
+        span.data = ++start;
+    }
 
-Table::Table(string tableName)
-{
-    m_tableName = tableName;
-    m_chains = {};
-}
+    while ((end > start) && IsBlank(*(end - 1)))
+    {
+        end--;
+    }
 
-Table::Table()
-{
-    Table("");
+    span.length = end - start;
+    return span;
 }
 
-void Table::SetTableName(string tableName)
+void Ruleset::Parse(string text)
 {
-    m_tableName = tableName;
-}
+    unordered_map<string, unsigned int> chainIndexes;
+    const char* position = nullptr;
+    const char* end = nullptr;
+    bool inTable = false;
 
-string Table::GetTableName()
-{
-    return m_tableName;
-}
+    Clear();
+    m_text = std::move(text);
 
-int Table::GetChainCount()
-{
-    return (int) m_chains.size();
-}
+    // Everything below points into m_text, which is not changed until the next parse
+    position = m_text.data();
+    end = position + m_text.length();
+    while (position < end)
+    {
+        const char* line = position;
+        const char* lineEnd = static_cast<const char*>(memchr(position, '\n', end - position));
+        lineEnd = (lineEnd != nullptr) ? lineEnd : end;
+        position = (lineEnd < end) ? (lineEnd + 1) : end;
 
-void Table::Append(Chain* chain)
-{
-    m_chains.push_back(chain);
-}
+        while ((line < lineEnd) && IsBlank(*line))
+        {
+            line++;
+        }
 
-Chain* FirewallObjectBase::ParseChain(string chainString)
-{
-    Chain* chain = nullptr;
-    const unsigned int chainNameIndex = 1;
-    const unsigned int chainPolicyIndex = 2;
-    std::regex userChainPattern(R"""(\s*Chain\s+([^\s]+)\s+.*references.*)""");
-    std::regex chainPattern(R"""(\s*Chain\s+([^\s]+)\s+\(policy\s+([^\s]+)\s+.*)""");
-    std::smatch pieces;
-    std::istringstream iss(chainString);
-    std::string row;
-    bool foundPolicy = false;
-    if (getline(iss, row, '\n'))
-    {
-        if (std::regex_match(row, pieces, chainPattern))
+        if ((line == lineEnd) || (*line == '#'))
         {
-            foundPolicy = true;
-            chain = new Chain();
+            continue;
         }
-        else if (std::regex_match(row, pieces, userChainPattern))
+        else if (*line == '*')
         {
-            chain = new Chain();
+            // *<table>
+            Table table = {TrimSpan(line + 1, lineEnd), static_cast<unsigned int>(m_chains.size()), 0};
+            if (!table.name.IsEmpty())
+            {
+                m_tables.push_back(table);
+                chainIndexes.clear();
+                inTable = true;
+            }
+        }
+        else if (!inTable)
+        {
+            continue;
+        }
+        else if (*line == ':')
+        {
+            // :<chain> <policy> [<packets>:<bytes>]
+            const char* cursor = line + 1;
+            Chain chain = {NextToken(cursor, lineEnd), NextToken(cursor, lineEnd), 0};
+            if (!chain.name.IsEmpty())
+            {
+                if (chain.policy.Equals("-"))
+                {
+                    chain.policy.length = 0;
+                }
+
+                chainIndexes[chain.name.ToString()] = static_cast<unsigned int>(m_chains.size());
+                m_chains.push_back(chain);
+                m_tables.back().chainCount++;
+            }
+        }
+        else if ((lineEnd - line > 3) && (line[0] == '-') && (line[1] == 'A') && IsBlank(line[2]))
+        {
+            ParseRule(line + 3, lineEnd, chainIndexes);
+        }
+        else if (TrimSpan(line, lineEnd).Equals("COMMIT"))
+        {
+            inTable = false;
         }
     }
+}
 
-    if (chain == nullptr)
+void Ruleset::ParseRule(const char* line, const char* end, unordered_map<string, unsigned int>& chainIndexes)
+{
+    Rule rule = {};
+    const char* position = line;
+    TextSpan chainName = NextToken(position, end);
+    unsigned int chain = 0;
+
+    // iptables-save lists the rules chain by chain, only look the chain up when it changes
+    if (chainName.IsEmpty())
     {
-        return chain;
+        return;
     }
-
-    chain->SetChainName(pieces.str(chainNameIndex));
-    if (foundPolicy)
+    else if (!m_rules.empty() && (m_rules.back().chain >= m_tables.back().firstChain) && (m_chains[m_rules.back().chain].name.length == chainName.length) &&
+        (memcmp(m_chains[m_rules.back().chain].name.data, chainName.data, chainName.length) == 0))
     {
-        chain->SetChainPolicy(pieces.str(chainPolicyIndex));
+        chain = m_rules.back().chain;
     }
-
-    while (getline(iss, row, '\n'))
+    else
     {
-        Rule* rule = ParseRule(row);
-        if (rule != nullptr)
+        unordered_map<string, unsigned int>::const_iterator found = chainIndexes.find(chainName.ToString());
+        if (found == chainIndexes.end())
         {
-            chain->Append(rule);
+            return;
         }
-    }
 
-    return chain;
-}
-
-Table* FirewallObjectBase::ParseTable(string tableName, string tableString)
-{
-    Table* table = tableName.empty() ? (new Table()) : (new Table(tableName));
-    if (table == nullptr)
-    {
-        return table;
+        chain = found->second;
     }
 
-    std::regex simpleChainPattern(R"""(\s*Chain\s+([^\s]+)\s+.*)""");
-    std::smatch pieces;
-    std::istringstream iss(tableString);
-    std::string row;
-    std::string chainString = "";
-    // A table string contains several chain strings
-    // A chain row (found by simpleChainPattern) is the beginning of a new chain
-    // When a chain row is found, convert current chain string to a chain object
-    while (getline(iss, row, '\n'))
+    rule.text = TrimSpan(position, end);
+    rule.chain = chain;
+    while (position < end)
     {
-        if (std::regex_match(row, pieces, simpleChainPattern) && (!chainString.empty()))
+        TextSpan option = NextToken(position, end);
+        TextSpan* field = nullptr;
+
+        if (option.Equals("-j") || option.Equals("--jump") || option.Equals("-g") || option.Equals("--goto"))
         {
-            Chain* chain = ParseChain(chainString);
-            chainString = "";
-            if (chain != nullptr)
-            {
-                table->Append(chain);
-            }
+            field = &rule.target;
+        }
+        else if (option.Equals("-p") || option.Equals("--protocol"))
+        {
+            field = &rule.protocol;
+        }
+        else if (option.Equals("-s") || option.Equals("--source"))
+        {
+            field = &rule.source;
+        }
+        else if (option.Equals("-d") || option.Equals("--destination"))
+        {
+            field = &rule.destination;
+        }
+        else if (option.Equals("-i") || option.Equals("--in-interface"))
+        {
+            field = &rule.inInterface;
+        }
+        else if (option.Equals("-o") || option.Equals("--out-interface"))
+        {
+            field = &rule.outInterface;
         }
 
-        chainString += row + char('\n');
-    }
-
-    // Get the last chain in the table
-    if (!chainString.empty())
-    {
-        Chain* chain = ParseChain(chainString);
-        if (chain != nullptr)
+        if ((field != nullptr) && field->IsEmpty())
         {
-            table->Append(chain);
+            *field = NextToken(position, end);
         }
     }
 
-    return table;
-}
-
-template <typename T>
-void ClearVector(vector<T*> myVector)
-{
-    for (T* t : myVector)
+    // Rules without a target are not kept, no action is taken on the packets they match
+    if (!rule.target.IsEmpty())
     {
-        if (t != nullptr)
-        {
-            delete t;
-        }
+        m_rules.push_back(rule);
+        m_chains[chain].ruleCount++;
     }
-    myVector.clear();
 }
 
-Chain::~Chain()
+void Ruleset::Clear()
 {
-    ClearVector(m_rules);
+    m_tables.clear();
+    m_chains.clear();
+    m_rules.clear();
+    m_text.clear();
 }
 
-Table::~Table()
+const vector<Table>& Ruleset::GetTables() const
 {
-    ClearVector(m_chains);
+    return m_tables;
 }
 
-vector<Chain*> Table::GetChains()
+const vector<Chain>& Ruleset::GetChains() const
 {
     return m_chains;
 }
 
-void FirewallObjectBase::AppendTable(Table* table)
+const vector<Rule>& Ruleset::GetRules() const
 {
-    m_tables.push_back(table);
+    return m_rules;
 }
 
-vector<Table*> FirewallObjectBase::GetTableObjects()
+string Ruleset::ToString() const
 {
-    return m_tables;
+    string result = "";
+    const char whitespace = ' ';
+    size_t rule = 0;
+
+    result.reserve(m_text.length());
+    for (const Table& table : m_tables)
+    {
+        result.append(table.name.data, table.name.length) += whitespace;
+        for (unsigned int chain = table.firstChain; chain < table.firstChain + table.chainCount; chain++)
+        {
+            result.append(m_chains[chain].name.data, m_chains[chain].name.length) += whitespace;
+            result.append(m_chains[chain].policy.data, m_chains[chain].policy.length) += whitespace;
+        }
+
+        for (; (rule < m_rules.size()) && (m_rules[rule].chain < table.firstChain + table.chainCount); rule++)
+        {
+            result.append(m_rules[rule].text.data, m_rules[rule].text.length) += whitespace;
+        }
+    }
+
+    return result;
 }
 
-int FirewallObjectBase::GetTableCount()
+void FirewallObjectBase::ParseRuleset(string rulesetString)
 {
-    return (int)m_tables.size();
+    m_ruleset.Parse(std::move(rulesetString));
+}
+
+const Ruleset& FirewallObjectBase::GetRuleset()
+{
+    return m_ruleset;
 }
 
 int FirewallObjectBase::GetFirewallState()
 {
     int state = firewallStateCodeDisabled;
     int utilityStatus = utilityStatusCodeUnknown;
-    bool isPolicyChanged = false;
-    bool hasRules = false;
     utilityStatus = DetectUtility(g_iptablesUtility);
     if (utilityStatus == utilityStatusCodeNotInstalled)
     {
@@ -529,130 +432,39 @@ int FirewallObjectBase::GetFirewallState()
         return state;
     }
 
-    vector<Table*> tableVector = GetTableObjects();
-    for (Table* table : tableVector)
+    // Enabled when any chain has rules or a policy other than ACCEPT
+    for (const Chain& chain : m_ruleset.GetChains())
     {
-        vector<Chain*> chainVector = table->GetChains();
-        for (Chain* chain : chainVector)
+        if (((!chain.policy.IsEmpty()) && (!chain.policy.Equals("ACCEPT"))) || (chain.ruleCount > 0))
         {
-            string policy = "";
-            string acceptPolicy = "ACCEPT";
-            policy = chain->GetChainPolicy();
-            if ((!policy.empty()) && (policy != acceptPolicy))
-            {
-                isPolicyChanged = true;
-            }
-            int ruleCount = chain->GetRuleCount();
-            if (ruleCount > 0)
-            {
-                hasRules = true;
-            }
-
-            if ((isPolicyChanged == true) || (hasRules == true))
-            {
-                state = firewallStateCodeEnabled;
-                return state;
-            }
+            state = firewallStateCodeEnabled;
+            return state;
         }
     }
 
     return state;
 }
 
-vector<Rule*> Chain::GetRules()
-{
-    return m_rules;
-}
-
-string FirewallObjectBase::RulesToString(vector<Rule*> rules)
-{
-    string result = "";
-    string whitespace = " ";
-    for (Rule* rule : rules)
-    {
-        if (rule != nullptr)
-        {
-            result += to_string(rule->GetRuleNum()) + whitespace;
-            result += rule->GetTarget() + whitespace;
-            result += rule->GetProtocol()+ whitespace;
-            result += rule->GetSource() + whitespace;
-            result += rule->GetDestination() + whitespace;
-            result += rule->GetInInterface() + whitespace;
-            result += rule->GetOutInterface() + whitespace;
-            result += rule->GetRawOptions() + whitespace;
-        }
-    }
-
-    return result;
-}
-
-string FirewallObjectBase::ChainsToString(vector<Chain*> chains)
-{
-    string result = "";
-    string whitespace = " ";
-    for (Chain* chain : chains)
-    {
-        if (chain != nullptr)
-        {
-            result += chain->GetChainName() + whitespace;
-            result += chain->GetChainPolicy() + whitespace;
-            result += RulesToString(chain->GetRules());
-            result += whitespace;
-        }
-    }
-
-    return result;
-}
-
-string FirewallObjectBase::TablesToString(vector<Table*> tables)
-{
-    string result = "";
-    string whitespace = " ";
-    for (Table* table : tables)
-    {
-        if (table != nullptr)
-        {
-            result += table->GetTableName() + whitespace;
-            result += ChainsToString(table->GetChains());
-            result += whitespace;
-        }
-    }
-
-    return result;
-}
-
 string FirewallObjectBase::FirewallRulesToString()
 {
-    return TablesToString(GetTableObjects());
+    return m_ruleset.ToString();
 }
 
 string FirewallObjectBase::GetFingerprint()
 {
     string firewallRulesString = FirewallRulesToString();
-    string hashCommand = "echo \"" + firewallRulesString + "\"";
-    string hashString = HashCommand(hashCommand.c_str(), FirewallLog::Get());
+    char* hash = HashBuffer(firewallRulesString.c_str(), firewallRulesString.length());
+    string hashString = hash ? hash : "";
+    FREE_MEMORY(hash);
     return hashString;
 }
 
-void FirewallObjectBase::ParseAllTables(vector<pair<string, string>>& allTableStrings)
-{
-    for (pair<string, string>& pair : allTableStrings)
-    {
-        Table* table = ParseTable(pair.first, pair.second);
-        if (table != nullptr)
-        {
-            AppendTable(table);
-        }
-    }
-}
-
-void FirewallObjectBase::ClearTableObjects()
+void FirewallObjectBase::ClearRuleset()
 {
-    ClearVector(m_tables);
-    m_tables = {};
+    m_ruleset.Clear();
 }
 
 FirewallObject::~FirewallObject()
 {
-    ClearTableObjects();
+    ClearRuleset();
 }
\ No newline at end of file
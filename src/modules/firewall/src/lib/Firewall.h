@@ -9,7 +9,7 @@
 #include <rapidjson/document.h>
 #include <rapidjson/writer.h>
 #include <rapidjson/schema.h>
-#include <regex>
+#include <unordered_map>
 using namespace std;
 
 #define FIREWALL_LOGFILE "/var/log/osconfig_firewall.log"
@@ -34,45 +34,44 @@ private:
     static OSCONFIG_LOG_HANDLE m_logFirewall;
 };
 
-class Rule
+// Part of the captured ruleset text, valid for as long as the ruleset holding the text
+struct TextSpan
 {
-public:
-    Rule(int ruleNum, string target, string protocol, string source, string destination, string sourcePort, string destinationPort, string inInterface, string outInterface, string rawOptions);
-    Rule();
-    void SetRuleNum(int ruleNum);
-    void SetTarget(string target);
-    void SetProtocol(string protocol);
-    void SetSource(string source);
-    void SetDestination(string destination);
-    void SetSourcePort(string sourcePort);
-    void SetDestinationPort(string destinationPort);
-    void SetInInterface(string inInterface);
-    void SetOutInterface(string outInterface);
-    void SetRawOptions(string rawOptions);
-
-    int GetRuleNum();
-    string GetTarget();
-    string GetProtocol();
-    string GetSource();
-    string GetDestination();
-    string GetSourcePort();
-    string GetDestinationPort();
-    string GetInInterface();
-    string GetOutInterface();
-    string GetRawOptions();
+    const char* data;
+    size_t length;
 
-private:
-    int m_ruleNum;
-    string m_policy;
-    string m_target;
-    string m_protocol;
-    string m_source;
-    string m_destination;
-    string m_sourcePort;
-    string m_destinationPort;
-    string m_inInterface;
-    string m_outInterface;
-    string m_rawOptions;
+    bool IsEmpty() const;
+    bool Equals(const char* value) const;
+    string ToString() const;
+};
+
+struct Rule
+{
+    // The rule as iptables-save prints it after '-A <chain> '
+    TextSpan text;
+    TextSpan target;
+    TextSpan protocol;
+    TextSpan source;
+    TextSpan destination;
+    TextSpan inInterface;
+    TextSpan outInterface;
+    unsigned int chain;
+};
+
+struct Chain
+{
+    TextSpan name;
+
+    // Empty for user defined chains, which have no policy
+    TextSpan policy;
+    unsigned int ruleCount;
+};
+
+struct Table
+{
+    TextSpan name;
+    unsigned int firstChain;
+    unsigned int chainCount;
 };
 
 enum FirewallStateCode
@@ -89,56 +88,28 @@ enum UtilityStatusCode
     utilityStatusCodeNotInstalled
 };
 
-enum RuleToken
-{
-    ruleTokenNumIndex = 1,
-    ruleTokenPacketsIndex,
-    ruleTokenBytesIndex,
-    ruleTokenTargetIndex,
-    ruleTokenProtocolIndex,
-    ruleTokenOptIndex,
-    ruleTokenInIndex,
-    ruleTokenOutIndex,
-    ruleTokenSourceIndex,
-    ruleTokenDestinationIndex,
-    ruleTokenRawOptionsIndex
-};
-
-class Chain
+// Tables, chains and rules of an iptables-save capture, parsed in one pass. The entries are kept in contiguous
+// arrays and point into the captured text, which the ruleset owns
+class Ruleset
 {
 public:
-    Chain();
-    Chain(string chainName);
-    ~Chain();
-    void SetChainName(string chainName);
-    void SetChainPolicy(string chainPolicy);
-    string GetChainName();
-    string GetChainPolicy();
-    int GetRuleCount();
-    vector<Rule*> GetRules();
-    void Append(Rule* rule);
+    void Parse(string text);
+    void Clear();
 
-private:
-    string m_chainName;
-    string m_chainPolicy;
-    vector<Rule*> m_rules;
-};
+    const vector<Table>& GetTables() const;
+    const vector<Chain>& GetChains() const;
+    const vector<Rule>& GetRules() const;
 
-class Table
-{
-public:
-    Table();
-    Table(string tableName);
-    ~Table();
-    void SetTableName(string tableName);
-    string GetTableName();
-    int GetChainCount();
-    void Append(Chain* chain);
-    vector<Chain*> GetChains();
+    // Table, chain and rule text without packet counters, what the fingerprint is computed over
+    string ToString() const;
 
 private:
-    string m_tableName;
-    vector<Chain*> m_chains;
+    void ParseRule(const char* line, const char* end, unordered_map<string, unsigned int>& chainIndexes);
+
+    string m_text;
+    vector<Table> m_tables;
+    vector<Chain> m_chains;
+    vector<Rule> m_rules;
 };
 
 class FirewallObjectBase
@@ -148,28 +119,19 @@ public:
     int Get(MMI_HANDLE clientSession, const char* componentName, const char* objectName, MMI_JSON_STRING*  payload, int* payloadSizeBytes);
     int Set(MMI_HANDLE clientSession, const char* componentName, const char* objectName, const MMI_JSON_STRING payload, const int payloadSizeBytes);
     virtual int DetectUtility(string utility) = 0;
-    virtual void GetTable(string tableName, string& tableString) = 0;
-    virtual void GetAllTables(vector<string> tableNames, vector<pair<string, string>>& allTableStrings) = 0;
-    Rule* ParseRule(string ruleString);
-    Chain* ParseChain(string chainString);
-    Table* ParseTable(string tableName, string tableString);
-    void ParseAllTables(vector<pair<string, string>>& allTableStrings);
-    void AppendTable(Table* table);
-    vector<Table*> GetTableObjects();
-    int GetTableCount();
+    virtual void CaptureRuleset(string& rulesetString) = 0;
+    void ParseRuleset(string rulesetString);
+    const Ruleset& GetRuleset();
     int GetFirewallState();
-    string RulesToString(vector<Rule*> rules);
-    string ChainsToString(vector<Chain*> chains);
-    string TablesToString(vector<Table*> tables);
     string FirewallRulesToString();
     string GetFingerprint();
     string CreateStatePayload(int state);
     string CreateFingerprintPayload(string fingerprint);
-    void ClearTableObjects();
+    void ClearRuleset();
     unsigned int m_maxPayloadSizeBytes;
 
 private:
-    vector<Table*> m_tables;
+    Ruleset m_ruleset;
 };
 
 class FirewallObject : public FirewallObjectBase
@@ -178,6 +140,5 @@ public:
     FirewallObject(unsigned int maxPayloadSizeBytes);
     ~FirewallObject();
     int DetectUtility(string utility);
-    void GetTable(string tableName, string& tableString);
-    void GetAllTables(vector<string> tableNames, vector<pair<string, string>>& allTableStrings);
+    void CaptureRuleset(string& rulesetString);
 };
\ No newline at end of file
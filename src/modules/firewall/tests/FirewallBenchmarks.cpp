@@ -0,0 +1,91 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <string>
+#include <benchmark/benchmark.h>
+#include <CommonUtils.h>
+#include <Firewall.h>
+
+// Run on a release build with: firewallbenchmarks --benchmark_repetitions=5
+
+class FirewallObjectBenchmark : public FirewallObjectBase
+{
+public:
+    string rulesetString;
+
+    int DetectUtility(string utility)
+    {
+        UNUSED(utility);
+        return utilityStatusCodeInstalled;
+    }
+
+    void CaptureRuleset(string& capturedRuleset)
+    {
+        capturedRuleset = rulesetString;
+    }
+};
+
+// A Docker/Kubernetes node style capture: a few filter chains and one user chain per hundred rules, mostly in nat
+static string CreateRuleset(int ruleCount)
+{
+    string ruleset = "# Generated by iptables-save v1.8.7 on Tue Mar  1 10:00:00 2022\n*filter\n:INPUT ACCEPT [705:76237]\n:FORWARD DROP [0:0]\n:OUTPUT ACCEPT [0:0]\n";
+    for (int i = 0; i < ruleCount / 10; i++)
+    {
+        ruleset += "-A INPUT -s 10." + to_string((i >> 8) & 0xFF) + "." + to_string(i & 0xFF) + ".0/24 -p tcp -m tcp --dport " + to_string(1024 + i % 60000) + " -m conntrack --ctstate NEW,ESTABLISHED -j ACCEPT\n";
+    }
+
+    ruleset += "COMMIT\n*nat\n:PREROUTING ACCEPT [0:0]\n:INPUT ACCEPT [0:0]\n:OUTPUT ACCEPT [0:0]\n:POSTROUTING ACCEPT [0:0]\n";
+    for (int i = 0; i < ruleCount / 100; i++)
+    {
+        ruleset += ":KUBE-SVC-" + to_string(100000000 + i) + " - [0:0]\n";
+    }
+
+    for (int i = 0; i < ruleCount - ruleCount / 10; i++)
+    {
+        ruleset += "-A KUBE-SVC-" + to_string(100000000 + i / 90) + " -d 172.20." + to_string((i >> 8) & 0xFF) + "." + to_string(i & 0xFF) +
+            "/32 -p tcp -m comment --comment \"default/service-" + to_string(i) + ":http cluster IP\" -m tcp --dport 80 -j DNAT --to-destination 10.244.1." + to_string(i & 0xFF) + ":8080\n";
+    }
+
+    ruleset += "COMMIT\n";
+    return ruleset;
+}
+
+static void BM_ParseRuleset(benchmark::State& state)
+{
+    FirewallObjectBenchmark firewall;
+    string ruleset = CreateRuleset(static_cast<int>(state.range(0)));
+
+    for (auto _ : state)
+    {
+        firewall.ParseRuleset(ruleset);
+        benchmark::DoNotOptimize(firewall.GetRuleset().GetRules().size());
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * ruleset.length());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+BENCHMARK(BM_ParseRuleset)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+// What a firewallState and a firewallFingerprint Get cost once the ruleset is captured
+static void BM_GetFirewallStateAndFingerprint(benchmark::State& state)
+{
+    FirewallObjectBenchmark firewall;
+    MMI_JSON_STRING payload = nullptr;
+    int payloadSizeBytes = 0;
+    firewall.rulesetString = CreateRuleset(static_cast<int>(state.range(0)));
+
+    for (auto _ : state)
+    {
+        firewall.Get(nullptr, "Firewall", "firewallState", &payload, &payloadSizeBytes);
+        delete[] payload;
+        firewall.Get(nullptr, "Firewall", "firewallFingerprint", &payload, &payloadSizeBytes);
+        delete[] payload;
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+BENCHMARK(BM_GetFirewallStateAndFingerprint)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
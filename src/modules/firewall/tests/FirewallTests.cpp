@@ -13,29 +13,36 @@ using namespace std;
 class FirewallObjectTest : public FirewallObjectBase
 {
 public:
-    std::vector <std::string> testTableStrings;
+    std::vector <std::string> testRulesetStrings;
     unsigned int runCommandCount = 0;
     unsigned int utilityCount = 0;
     int DetectUtility(string utility);
-    void GetTable(string tableName, string &tableString);
-    void GetAllTables(vector<string> tableNames, vector<pair<string, string>>& allTableStrings);
+    void CaptureRuleset(string& rulesetString);
     FirewallObjectTest(unsigned int maxPayloadSizeBytes);
     ~FirewallObjectTest();
 };
 
-vector<string> g_testTableStrings =
+vector<string> g_testRulesetStrings =
 {
-    R"""(Chain INPUT (policy ACCEPT 705 packets, 76237 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination
-    1        0     0 DROP       all  --  *      *       3.3.3.3              0.0.0.0/0           )""",
-    R"""(Chain PREROUTING (policy ACCEPT 0 packets, 0 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination)""",
-    R"""(Chain PREROUTING (policy ACCEPT 0 packets, 0 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination
-
-    Chain OUTPUT (policy ACCEPT 0 packets, 0 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination)""",
-    R"""()""",
+    R"""(# Generated by iptables-save v1.8.7 on Tue Mar  1 10:00:00 2022
+*filter
+:INPUT ACCEPT [705:76237]
+:FORWARD ACCEPT [0:0]
+:OUTPUT ACCEPT [0:0]
+COMMIT
+# Completed on Tue Mar  1 10:00:00 2022
+)""",
+    R"""(*filter
+:INPUT ACCEPT [705:76237]
+:FORWARD ACCEPT [0:0]
+:OUTPUT ACCEPT [0:0]
+-A INPUT -s 3.3.3.3/32 -j DROP
+COMMIT
+*nat
+:PREROUTING ACCEPT [0:0]
+:OUTPUT ACCEPT [0:0]
+COMMIT
+)""",
     R"""()"""
 };
 
@@ -46,7 +53,7 @@ FirewallObjectTest::FirewallObjectTest(unsigned int maxPayloadSizeBytes)
 
 FirewallObjectTest::~FirewallObjectTest()
 {
-    ClearTableObjects();
+    ClearRuleset();
 }
 
 int  FirewallObjectTest::DetectUtility(string utility)
@@ -74,42 +81,10 @@ int  FirewallObjectTest::DetectUtility(string utility)
     return status;
 }
 
-void FirewallObjectTest::GetTable(string tableName, string& tableString)
+void FirewallObjectTest::CaptureRuleset(string& rulesetString)
 {
-    UNUSED(tableName);
-    tableString = "";
-    char* output = nullptr;
-    unsigned int size = testTableStrings.size();
-    string currentTable = testTableStrings[(runCommandCount++) % size];
-    if (!currentTable.empty())
-    {
-        size_t tableSize = (currentTable.length() + 1) * sizeof(currentTable[0]);
-        output = new (std::nothrow) char[tableSize];
-        if (nullptr != output)
-        {
-            std::fill(output, output + tableSize, 0);
-            std::memcpy(output, currentTable.c_str(), currentTable.length());
-        }
-    }
-
-    tableString = (output != nullptr) ? string(output) : "";
-    if (output != nullptr)
-    {
-        free(output);
-    }
-}
-
-void FirewallObjectTest::GetAllTables(vector<string> tableNames, vector<pair<string, string>>& allTableStrings)
-{
-    for (unsigned int i = 0; i < tableNames.size(); i++)
-    {
-        string tableString = "";
-        GetTable(tableNames[i], tableString);
-        if (!tableString.empty())
-        {
-            allTableStrings.push_back(make_pair(tableNames[i], tableString));
-        }
-    }
+    unsigned int size = testRulesetStrings.size();
+    rulesetString = (size > 0) ? testRulesetStrings[(runCommandCount++) % size] : "";
 }
 
 TEST (FirewallTests, DetectUtility)
@@ -128,41 +103,25 @@ TEST (FirewallTests, DetectUtility)
     }
 }
 
-TEST (FirewallTests, GetTable)
+TEST (FirewallTests, CaptureRuleset)
 {
     unsigned int maxPayloadSizeBytes = 0;
     FirewallObjectTest testModule(maxPayloadSizeBytes);
-    testModule.testTableStrings =
+    testModule.testRulesetStrings =
     {
         R"""(abc)""",
-        R"""(Chain INPUT (policy ACCEPT 180K packets, 24M bytes)
-        num   pkts bytes target     prot opt in     out     source               destination
-        1        0     0 ACCEPT     all  --  *      *       1.1.1.1              0.0.0.0/0           )""",
+        R"""(*filter
+:INPUT ACCEPT [180000:24000000]
+-A INPUT -s 1.1.1.1/32 -j ACCEPT
+COMMIT)""",
         R"""()"""
     };
 
     string testOutputString = "";
-    for (unsigned int i = 0; i < testModule.testTableStrings.size(); i++)
+    for (unsigned int i = 0; i < testModule.testRulesetStrings.size(); i++)
     {
-        testModule.GetTable("", testOutputString);
-        ASSERT_TRUE(testOutputString == testModule.testTableStrings[i]);
-    }
-}
-
-TEST (FirewallTests, GetAllTables)
-{
-    unsigned int maxPayloadSizeBytes = 0;
-    FirewallObjectTest testModule(maxPayloadSizeBytes);
-    const vector<string> testTableNames = {"filter", "nat", "mangle", "raw", "security"};
-    testModule.testTableStrings = g_testTableStrings;
-    vector<pair<string, string>> tableStrings;
-    testModule.GetAllTables(testTableNames, tableStrings);
-
-    ASSERT_TRUE(tableStrings.size() == 3);
-    for (unsigned int i = 0; i < 3; i++)
-    {
-        ASSERT_TRUE(tableStrings[i].first == testTableNames[i]);
-        ASSERT_TRUE(tableStrings[i].second == testModule.testTableStrings[i]);
+        testModule.CaptureRuleset(testOutputString);
+        ASSERT_TRUE(testOutputString == testModule.testRulesetStrings[i]);
     }
 }
 
@@ -170,13 +129,18 @@ TEST (FirewallTests, ParseRule)
 {
     unsigned int maxPayloadSizeBytes = 0;
     FirewallObjectTest testModule(maxPayloadSizeBytes);
+    const string tableStart = "*filter\n:INPUT ACCEPT [0:0]\n:OUTPUT ACCEPT [0:0]\n";
     vector<string> testRuleStrings
     {
-        R"""(     11   ACCEPT   tcp  --  0.0.0.0/0            0.0.0.0/0           tcp dpt:8044 state NEW  )""",
-        R"""( 1        0     0 ACCEPT     all  --  in      *       1.1.1.1        )""",
-        R"""(2        0     12     all  --  *      *       198.1.1.1        )""",
-        R"""(3        0     0 ACCEPT     tcp  --      *       77.66.55.44          0.0.0.0/0            tcp dpt:22)""",
-        R"""(abc)"""
+        // Without a target, in a chain that is not declared, outside of a table and malformed
+        R"""(-A INPUT -s 198.1.1.1/32)""",
+        R"""(-A INPUT -p tcp -m tcp --dport 8044 -m state --state NEW)""",
+        R"""(-A FORWARD -s 1.1.1.1/32 -j ACCEPT)""",
+        R"""(-A)""",
+        R"""(-A   )""",
+        R"""(-I INPUT -s 1.1.1.1/32 -j ACCEPT)""",
+        R"""(A INPUT -s 1.1.1.1/32 -j ACCEPT)""",
+        R"""(abc)""",
         R"""(
 
           )""",
@@ -186,42 +150,44 @@ TEST (FirewallTests, ParseRule)
 
     for (unsigned int i = 0; i < testRuleStrings.size(); i++)
     {
-        Rule* rule = testModule.ParseRule(testRuleStrings[i]);
-        ASSERT_TRUE(rule == nullptr);
+        testModule.ParseRuleset(tableStart + testRuleStrings[i] + "\nCOMMIT\n");
+        ASSERT_TRUE(testModule.GetRuleset().GetRules().size() == 0);
     }
 
+    testModule.ParseRuleset("-A INPUT -s 1.1.1.1/32 -j ACCEPT\n" + tableStart + "COMMIT\n-A INPUT -s 1.1.1.1/32 -j ACCEPT\n");
+    ASSERT_TRUE(testModule.GetRuleset().GetRules().size() == 0);
+
     vector<string> testStrings =
     {
-        R"""(   1        0     0 DROP     tcp  --  *      *       203.0.113.0/24       0.0.0.0/0            tcp dpt:22 ctstate NEW,ESTABLISHED )""",
-        R"""(2       64 63884 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp spt:22 ctstate ESTABLISHED)""",
-        R"""(   3        0     0 ACCEPT     tcp  --  *      *       77.66.55.44          0.0.0.0/0            tcp dpt:22)""",
-        R"""(4        0     0 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            MAC 00:E0:4C:F1:41:6B tcp dpt:22 )""",
-        R"""(5        0     0 REJECT     tcp  --  *      *      !222.111.111.222      0.0.0.0/0            tcp dpt:23 reject-with icmp-port-unreachable  )""",
-        R"""( 6        0     0 ACCEPT     all  --  *      eth1    1.1.1.0/24            0.0.0.0/0 )""",
-        R"""( 234     9494 1795K ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp spt:22 ctstate ESTABLISHED)""",
-        R"""(100       70 16854 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp dpt:22 ctstate NEW,ESTABLISHED)""",
-        R"""(16        0     0 MASQUERADE  all  --  *      eth0    0.0.0.0/0            0.0.0.0/0 )"""
+        R"""(-A INPUT -s 203.0.113.0/24 -p tcp -m tcp --dport 22 -m conntrack --ctstate NEW,ESTABLISHED -j DROP)""",
+        R"""(-A OUTPUT -p tcp -m tcp --sport 22 -m conntrack --ctstate ESTABLISHED -j ACCEPT)""",
+        R"""(-A INPUT -s 77.66.55.44/32 -p tcp -m tcp --dport 22 -j ACCEPT)""",
+        R"""(-A INPUT -p tcp -m mac --mac-source 00:E0:4C:F1:41:6B -m tcp --dport 22 -j ACCEPT )""",
+        R"""(-A INPUT ! -s 222.111.111.222/32 -p tcp -m tcp --dport 23 -j REJECT --reject-with icmp-port-unreachable)""",
+        R"""(  -A OUTPUT -s 1.1.1.0/24 -o eth1 -j ACCEPT)""",
+        R"""(-A INPUT -p tcp -m comment --comment "allow -j DROP -s everything" -j ACCEPT)""",
+        R"""(-A INPUT -j LOG --log-prefix "IPtables dropped packets:")""",
+        R"""(-A OUTPUT -o eth0 -g MASQUERADE-CHAIN)"""
     };
 
     for (unsigned int i = 0; i < testStrings.size(); i++)
     {
-        Rule* rule = testModule.ParseRule(testStrings[i]);
-        ASSERT_TRUE(rule != nullptr);
-        free(rule);
+        testModule.ParseRuleset(tableStart + testStrings[i] + "\nCOMMIT\n");
+        ASSERT_TRUE(testModule.GetRuleset().GetRules().size() == 1);
     }
 
-    string newTestString = R"""(  123       0     0 REJECT     tcp  --  eth0   *       1.1.1.1              2.2.2.2              tcp dpt:3306 state NEW,ESTABLISHED reject-with icmp-port-unreachable)""";
-    Rule* rule = testModule.ParseRule(newTestString);
-    ASSERT_TRUE(rule != nullptr);
-    ASSERT_TRUE(rule->GetRuleNum() == 123);
-    ASSERT_TRUE(rule->GetTarget() == "REJECT");
-    ASSERT_TRUE(rule->GetProtocol() == "tcp");
-    ASSERT_TRUE(rule->GetInInterface() == "eth0");
-    ASSERT_TRUE(rule->GetOutInterface() == "*");
-    ASSERT_TRUE(rule->GetSource() == "1.1.1.1");
-    ASSERT_TRUE(rule->GetDestination() == "2.2.2.2");
-    ASSERT_TRUE(rule->GetRawOptions() == "tcp dpt:3306 state NEW,ESTABLISHED reject-with icmp-port-unreachable");
-    free(rule);
+    testModule.ParseRuleset(tableStart +
+        R"""(-A INPUT -i eth0 ! -d 2.2.2.2/32 -s 1.1.1.1/32 -p tcp -m tcp --dport 3306 -m comment --comment "\"-j\" ACCEPT" -m state --state NEW,ESTABLISHED -j REJECT --reject-with icmp-port-unreachable)""" "\r\nCOMMIT\n");
+    ASSERT_TRUE(testModule.GetRuleset().GetRules().size() == 1);
+    const Rule& rule = testModule.GetRuleset().GetRules()[0];
+    ASSERT_TRUE(rule.chain == 0);
+    ASSERT_TRUE(rule.target.ToString() == "REJECT");
+    ASSERT_TRUE(rule.protocol.ToString() == "tcp");
+    ASSERT_TRUE(rule.inInterface.ToString() == "eth0");
+    ASSERT_TRUE(rule.outInterface.IsEmpty());
+    ASSERT_TRUE(rule.source.ToString() == "1.1.1.1/32");
+    ASSERT_TRUE(rule.destination.ToString() == "2.2.2.2/32");
+    ASSERT_TRUE(rule.text.ToString() == R"""(-i eth0 ! -d 2.2.2.2/32 -s 1.1.1.1/32 -p tcp -m tcp --dport 3306 -m comment --comment "\"-j\" ACCEPT" -m state --state NEW,ESTABLISHED -j REJECT --reject-with icmp-port-unreachable)""");
 }
 
 TEST (FirewallTests, ParseChain)
@@ -230,22 +196,21 @@ TEST (FirewallTests, ParseChain)
     FirewallObjectTest testModule(maxPayloadSizeBytes);
     vector<string> testInvalidStrings =
     {
-        R"""(Chain INPUT ( policy ACCEPT 484 packets, 144K bytes)
-        num   pkts bytes target     prot opt in     out     source               destination         
-        1        0     0 ACCEPT     tcp  --  eth0   *       0.0.0.0/0            0.0.0.0/0            tcp dpt:80 state NEW,ESTABLISHED
-        2        0     0 ACCEPT     icmp --  *      *       1.1.1.1/24           0.0.0.0/0            icmptype 8)""",
-        R"""(16        0     0 MASQUERADE  all  --  *      eth0    0.0.0.0/0            0.0.0.0/0 )""",
-        R"""(   OUTPUT (policy ACCEPT 38 packets, 3134 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination         
-        1     4289  362K ACCEPT     all  --  *      lo      0.0.0.0/0            0.0.0.0/0           )""",
-        R"""( Chain invalidUserChain (0 ref
-        num   pkts bytes target     prot opt in     out     source               destination         
-        1        0     0 ACCEPT       all  --  *      *       3.3.3.3              5.5.5.5 
-
-        )""",
+        R"""(:INPUT ACCEPT [484:144000]
+-A INPUT -i eth0 -p tcp -m tcp --dport 80 -m state --state NEW,ESTABLISHED -j ACCEPT)""",
+        R"""(*filter
+-A POSTROUTING -o eth0 -j MASQUERADE
+COMMIT)""",
+        R"""(*filter
+INPUT ACCEPT [38:3134]
+-A INPUT -o lo -j ACCEPT
+COMMIT)""",
+        R"""(*filter
+:
+COMMIT)""",
         R"""( abc)""",
-        R"""( 
-        
+        R"""(
+
           )""",
         R"""(  )""",
         R"""()"""
@@ -253,92 +218,83 @@ TEST (FirewallTests, ParseChain)
 
     for (unsigned int i = 0; i < testInvalidStrings.size(); i++)
     {
-        Chain* chain = testModule.ParseChain(testInvalidStrings[i]);
-        ASSERT_TRUE(chain == nullptr);
+        testModule.ParseRuleset(testInvalidStrings[i]);
+        ASSERT_TRUE(testModule.GetRuleset().GetChains().size() == 0);
+        ASSERT_TRUE(testModule.GetRuleset().GetRules().size() == 0);
     }
 
-    vector<string> testValidChainStrings =
-    {
-        R"""( Chain INPUT (policy DROP 0 packets, 0 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination         
-        1     4405  371K ACCEPT     all  --  lo     *       0.0.0.0/0            0.0.0.0/0           
-        2     2292  451K ACCEPT     all  --  *      *       0.0.0.0/0            0.0.0.0/0            ctstate RELATED,ESTABLISHED
-        3        0     0 DROP       all  --  *      *       0.0.0.0/0            0.0.0.0/0            ctstate INVALID
-        4        0     0 DROP       all  --  *      *       203.0.113.51         0.0.0.0/0           
-        5        0     0 REJECT     all  --  *      *       203.0.113.51         0.0.0.0/0            reject-with icmp-port-unreachable
-        6        0     0 DROP       all  --  eth0   *       203.0.113.51         0.0.0.0/0           
-        7        0     0 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp dpt:22 ctstate NEW,ESTABLISHED
-        8        0     0 ACCEPT     tcp  --  *      *       203.0.113.0/24       0.0.0.0/0            tcp dpt:22 ctstate NEW,ESTABLISHED
-        9        0     0 ACCEPT     tcp  --  *      *       203.0.113.0/24       0.0.0.0/0            tcp dpt:873 ctstate NEW,ESTABLISHED
-        10       0     0 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp dpt:80 ctstate NEW,ESTABLISHED
-        11       0     0 ACCEPT     tcp  --  *      *       203.0.113.0/24       0.0.0.0/0            tcp dpt:3306 ctstate NEW,ESTABLISHED     
-        
-        )""",
-        R"""(Chain FORWARD (policy DROP 0 packets, 0 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination         
-        1        0     0 ACCEPT     all  --  eth1   eth0    0.0.0.0/0            0.0.0.0/0    )""",
-        R"""( Chain OUTPUT (policy ACCEPT 38 packets, 3134 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination         
-        1     4289  362K ACCEPT     all  --  *      lo      0.0.0.0/0            0.0.0.0/0           
-        2     2434  308K ACCEPT     all  --  *      *       0.0.0.0/0            0.0.0.0/0            ctstate ESTABLISHED
-        3        0     0 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp spt:22 ctstate ESTABLISHED
-        4        0     0 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp spt:22 ctstate ESTABLISHED
-        5        0     0 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp spt:873 ctstate ESTABLISHED
-        6        0     0 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp spt:80 ctstate ESTABLISHED
-        7        0     0 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp spt:3306 ctstate ESTABLISHED)""",
-        R"""(      Chain PREROUTING (policy ACCEPT 0 packets, 0 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination         
-        
-        )""",
-        R"""( Chain userChain (0 references)
-        num   pkts bytes target     prot opt in     out     source               destination         
-        1        0     0 DROP       all  --  *      *       3.3.3.3              5.5.5.5       
-        )"""
-        };
-
-    vector<string> expectedNameValues = {"INPUT", "FORWARD", "OUTPUT", "PREROUTING", "userChain"};
-    vector<string> expectedPolicyValues = {"DROP", "DROP", "ACCEPT", "ACCEPT", ""};
-    vector<int> expectedRuleCounts = {11, 1, 7, 0, 1};
-    for (unsigned int i = 0; i < testValidChainStrings.size(); i++)
-    {
-        Chain* chain = testModule.ParseChain(testValidChainStrings[i]);
-        ASSERT_TRUE(chain != nullptr);
-        ASSERT_TRUE(chain->GetChainName() == expectedNameValues[i]);
-        ASSERT_TRUE(chain->GetChainPolicy() == expectedPolicyValues[i]);
-        ASSERT_TRUE(chain->GetRuleCount() == expectedRuleCounts[i]);
-        if (chain != nullptr)
-        {
-            free(chain);
-        }
+    string testValidChainsString =
+        R"""(# Generated by iptables-save v1.8.7 on Tue Mar  1 10:00:00 2022
+        *filter
+        :INPUT DROP [0:0]
+        :FORWARD DROP [0:0]
+        :OUTPUT ACCEPT [38:3134]
+        :userChain - [0:0]
+        -A INPUT -i lo -j ACCEPT
+        -A INPUT -m conntrack --ctstate RELATED,ESTABLISHED -j ACCEPT
+        -A INPUT -m conntrack --ctstate INVALID -j DROP
+        -A INPUT -s 203.0.113.51/32 -j DROP
+        -A INPUT -s 203.0.113.51/32 -j REJECT --reject-with icmp-port-unreachable
+        -A INPUT -s 203.0.113.51/32 -i eth0 -j DROP
+        -A INPUT -p tcp -m tcp --dport 22 -m conntrack --ctstate NEW,ESTABLISHED -j ACCEPT
+        -A INPUT -s 203.0.113.0/24 -p tcp -m tcp --dport 22 -m conntrack --ctstate NEW,ESTABLISHED -j ACCEPT
+        -A INPUT -s 203.0.113.0/24 -p tcp -m tcp --dport 873 -m conntrack --ctstate NEW,ESTABLISHED -j ACCEPT
+        -A INPUT -p tcp -m tcp --dport 80 -m conntrack --ctstate NEW,ESTABLISHED -j ACCEPT
+        -A INPUT -s 203.0.113.0/24 -p tcp -m tcp --dport 3306 -m conntrack --ctstate NEW,ESTABLISHED -j ACCEPT
+        -A FORWARD -i eth1 -o eth0 -j ACCEPT
+        -A OUTPUT -o lo -j ACCEPT
+        -A OUTPUT -m conntrack --ctstate ESTABLISHED -j ACCEPT
+        -A OUTPUT -p tcp -m tcp --sport 22 -m conntrack --ctstate ESTABLISHED -j ACCEPT
+        -A OUTPUT -p tcp -m tcp --sport 22 -m conntrack --ctstate ESTABLISHED -j ACCEPT
+        -A OUTPUT -p tcp -m tcp --sport 873 -m conntrack --ctstate ESTABLISHED -j ACCEPT
+        -A OUTPUT -p tcp -m tcp --sport 80 -m conntrack --ctstate ESTABLISHED -j ACCEPT
+        -A OUTPUT -p tcp -m tcp --sport 3306 -m conntrack --ctstate ESTABLISHED -j ACCEPT
+        -A userChain -s 3.3.3.3/32 -d 5.5.5.5/32 -j DROP
+        COMMIT
+        *nat
+        :PREROUTING ACCEPT [0:0]
+        COMMIT
+        )""";
+
+    vector<string> expectedNameValues = {"INPUT", "FORWARD", "OUTPUT", "userChain", "PREROUTING"};
+    vector<string> expectedPolicyValues = {"DROP", "DROP", "ACCEPT", "", "ACCEPT"};
+    vector<unsigned int> expectedRuleCounts = {11, 1, 7, 1, 0};
+    testModule.ParseRuleset(testValidChainsString);
+    const vector<Chain>& chains = testModule.GetRuleset().GetChains();
+    ASSERT_TRUE(chains.size() == expectedNameValues.size());
+    for (unsigned int i = 0; i < chains.size(); i++)
+    {
+        ASSERT_TRUE(chains[i].name.ToString() == expectedNameValues[i]);
+        ASSERT_TRUE(chains[i].policy.ToString() == expectedPolicyValues[i]);
+        ASSERT_TRUE(chains[i].ruleCount == expectedRuleCounts[i]);
     }
 
-    // Chains contain invalid rules, skip them
-    vector<string> partialValidChains =
-    {
-        R"""( Chain OUTPUT (policy ACCEPT 38 packets, 3134 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination         
-        xxx     4289  362K ACCEPT     all  --  *      lo      0.0.0.0/0            0.0.0.0/0           
-        2     2434  308K ACCEPT     all  --  *      *       0.0.0.0/0            0.0.0.0/0            ctstate ESTABLISHED   )""",
-        R"""(Chain INPUT (policy ACCEPT 1166 packets, 142K bytes)
-        num   pkts bytes target     prot opt in     out     source               destination         
-        1        0     0 LOG        all  --     *       0.0.0.0/0            0.0.0.0/0            LOG flags 0 level 4 prefix "IPtables dropped packets:"
-        2      505 39708ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            multiport dports 22,80,443)"""
-    };
+    const vector<Rule>& rules = testModule.GetRuleset().GetRules();
+    ASSERT_TRUE(rules.size() == 20);
+    ASSERT_TRUE(rules[11].chain == 1);
+    ASSERT_TRUE(rules[19].chain == 3);
+
+    // Chains contain rules without a target, skip them
+    string partialValidChainsString =
+        R"""(*filter
+:OUTPUT ACCEPT [38:3134]
+:INPUT ACCEPT [1166:142000]
+-A OUTPUT -o lo
+-A OUTPUT -m conntrack --ctstate ESTABLISHED -j ACCEPT
+-A INPUT -p tcp -m multiport --dports 22,80,443
+COMMIT
+)""";
 
     expectedNameValues = {"OUTPUT", "INPUT"};
     expectedPolicyValues = {"ACCEPT", "ACCEPT"};
     expectedRuleCounts = {1, 0};
-    for (unsigned int i = 0; i < partialValidChains.size(); i++)
+    testModule.ParseRuleset(partialValidChainsString);
+    ASSERT_TRUE(chains.size() == expectedNameValues.size());
+    for (unsigned int i = 0; i < chains.size(); i++)
     {
-        Chain* chain = testModule.ParseChain(partialValidChains[i]);
-        ASSERT_TRUE(chain != nullptr);
-        ASSERT_TRUE(chain->GetChainName() == expectedNameValues[i]);
-        ASSERT_TRUE(chain->GetChainPolicy() == expectedPolicyValues[i]);
-        ASSERT_TRUE(chain->GetRuleCount() == expectedRuleCounts[i]);
-        if (chain != nullptr)
-        {
-            free(chain);
-        }
+        ASSERT_TRUE(chains[i].name.ToString() == expectedNameValues[i]);
+        ASSERT_TRUE(chains[i].policy.ToString() == expectedPolicyValues[i]);
+        ASSERT_TRUE(chains[i].ruleCount == expectedRuleCounts[i]);
     }
 }
 
@@ -346,67 +302,50 @@ TEST (FirewallTests, ParseTable)
 {
     unsigned int maxPayloadSizeBytes = 0;
     FirewallObjectTest testModule(maxPayloadSizeBytes);
-    vector<string> testTableStrings =
-    {
-        R"""(Chain INPUT (policy ACCEPT 353 packets, 23920 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination
-        1        0     0 ACCEPT     all  --  *      *       1.1.1.1              0.0.0.0/0
-        2        0     0 DROP       all  --  *      *       202.0.222.22         0.0.0.0/0
-        3        0     0 REJECT     all  --  *      *       203.0.113.51         0.0.0.0/0            reject-with icmp-port-unreachable
-        4        0     0 ACCEPT     tcp  --  *      *       203.0.111.0/24       0.0.0.0/0            tcp dpt:22 ctstate NEW,ESTABLISHED
-        5        0     0 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp dpt:80 ctstate NEW,ESTABLISHED
-
-        Chain FORWARD (policy ACCEPT 0 packets, 0 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination
-        1        0     0 ACCEPT     all  --  eth1   eth0    0.0.0.0/0            0.0.0.0/0
-
-        Chain OUTPUT (policy ACCEPT 244 packets, 15920 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination
-        1      162 13872 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp spt:22 ctstate ESTABLISHED
-        2        0     0 ACCEPT     tcp  --  *      *       0.0.0.0/0            0.0.0.0/0            tcp spt:80 ctstate ESTABLISHED
-
-        )""",
-        R"""(
-            Chain INPUT (policy ACCEPT 399 packets, 26482 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination
-
-        Chain FORWARD (policy ACCEPT 0 packets, 0 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination
-
-        Chain OUTPUT (policy ACCEPT 401 packets, 27934 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination
-
-        )""",
-        R"""(
-            Chain INPUT (policy ACCEPT 399 packets, 26482 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination         )""",
-        R"""(abc123 INPUT (policy ACCEPT 399 packets, 26482 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination
-        )""",
-        R"""(Chain InvalidChain (0 referenc
-        num   pkts bytes target     prot opt in     out     source               destination
-        1        0     0 DROP       all  --  *      *       3.3.3.3              5.5.5.5
-
-        )""",
-        R"""(        num   pkts bytes target     prot opt in     out     source               destination
-        1        0     0 ACCEPT     all  --  *      *       1.1.1.1              0.0.0.0/0
-        2        0     0 DROP       all  --  *      *       202.0.222.22         0.0.0.0/0
+    string testTablesString =
+        R"""(# Generated by iptables-save v1.8.7 on Tue Mar  1 10:00:00 2022
+*filter
+:INPUT ACCEPT [353:23920]
+:FORWARD ACCEPT [0:0]
+:OUTPUT ACCEPT [244:15920]
+-A INPUT -s 1.1.1.1/32 -j ACCEPT
+-A INPUT -s 202.0.222.22/32 -j DROP
+-A FORWARD -i eth1 -o eth0 -j ACCEPT
+-A OUTPUT -p tcp -m tcp --sport 22 -m conntrack --ctstate ESTABLISHED -j ACCEPT
+COMMIT
+# Completed on Tue Mar  1 10:00:00 2022
+*mytable
+:INPUT ACCEPT [399:26482]
+:FORWARD ACCEPT [0:0]
+:OUTPUT ACCEPT [401:27934]
+COMMIT
+abc123 INPUT ACCEPT [399:26482]
+:INPUT ACCEPT [399:26482]
+*
+COMMIT
+*test_table
+:INPUT ACCEPT [399:26482]
+)""";
+
+    vector<string> expectedTableNames = {"filter", "mytable", "test_table"};
+    vector<unsigned int> expectedChainCounts = {3, 3, 1};
+    testModule.ParseRuleset(testTablesString);
+    const vector<Table>& tables = testModule.GetRuleset().GetTables();
+    ASSERT_TRUE(tables.size() == expectedTableNames.size());
+    for (unsigned int i = 0; i < tables.size(); i++)
+    {
+        ASSERT_TRUE(tables[i].name.ToString() == expectedTableNames[i]);
+        ASSERT_TRUE(tables[i].chainCount == expectedChainCounts[i]);
+    }
 
-        Chain FORWARD (policy ACCEPT 0 packets, 0 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination
-        1        0     0 ACCEPT     all  --  eth1   eth0    0.0.0.0/0            0.0.0.0/0  )"""
-    };
+    ASSERT_TRUE(tables[1].firstChain == 3);
+    ASSERT_TRUE(testModule.GetRuleset().GetRules().size() == 4);
 
-    vector<string> tableNames = {"filter", "mytable", "test_table", "", "TableWithInvalidChain", "TableWithOneInvalidChain"};
-    vector<int> expectedChainCounts = {3, 3, 1, 0, 0, 1};
-    for (unsigned int i = 0; i < testTableStrings.size(); i++)
-    {
-        Table* table = testModule.ParseTable(tableNames[i], testTableStrings[i]);
-        ASSERT_TRUE(table != nullptr);
-        ASSERT_TRUE(table->GetTableName() == tableNames[i]);
-        ASSERT_TRUE(table->GetChainCount() == expectedChainCounts[i]);
-        free(table);
-    }
+    // The same chain names in another table are other chains
+    testModule.ParseRuleset("*filter\n:INPUT ACCEPT [0:0]\nCOMMIT\n*mangle\n:INPUT ACCEPT [0:0]\n-A INPUT -j MARK --set-mark 1\nCOMMIT\n");
+    ASSERT_TRUE(testModule.GetRuleset().GetChains()[0].ruleCount == 0);
+    ASSERT_TRUE(testModule.GetRuleset().GetChains()[1].ruleCount == 1);
+    ASSERT_TRUE(testModule.GetRuleset().GetRules()[0].chain == 1);
 
     vector<string> testInvalidTableStrings =
     {
@@ -415,33 +354,18 @@ TEST (FirewallTests, ParseTable)
 
         )""",
         R"""()""",
-        R"""(chain Invalid (0 references)"""
+        R"""(:INPUT ACCEPT [0:0])""",
+        R"""(  *  )"""
     };
 
-    tableNames = {"invalidTable", "mytable", "test_invalid_table", ""};
     for (unsigned int i = 0; i < testInvalidTableStrings.size(); i++)
     {
-        Table* table = testModule.ParseTable(tableNames[i], testInvalidTableStrings[i]);
-        ASSERT_TRUE(table != nullptr);
-        ASSERT_TRUE(table->GetTableName() == tableNames[i]);
-        ASSERT_TRUE(table->GetChainCount() == 0);
-        free(table);
+        testModule.ParseRuleset(testInvalidTableStrings[i]);
+        ASSERT_TRUE(testModule.GetRuleset().GetTables().size() == 0);
+        ASSERT_TRUE(testModule.GetRuleset().GetChains().size() == 0);
     }
 }
 
-TEST (FirewallTests, AppendTable)
-{
-    unsigned int maxPayloadSizeBytes = 0;
-    FirewallObjectTest testModule(maxPayloadSizeBytes);
-    Table* table0 = new Table("testTable0");
-    testModule.AppendTable(table0);
-    ASSERT_TRUE(testModule.GetTableCount() == 1);
-
-    Table* table1 = new Table("testTable1");
-    testModule.AppendTable(table1);
-    ASSERT_TRUE(testModule.GetTableCount() == 2);
-}
-
 TEST (FirewallTests, GetFirewallState)
 {
     int firewallStatuCode = firewallStateCodeUnknown;
@@ -455,205 +379,123 @@ TEST (FirewallTests, GetFirewallState)
         firewallStatuCode = testModule.GetFirewallState();
         ASSERT_TRUE(firewallStatuCode == expectedStatusCode[i]);
     }
-    string tableString =
-    R"""(Chain INPUT (policy ACCEPT 0 packets, 0 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination  
 
-    Chain FORWARD (policy DROP 0 packets, 0 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination       
+    string rulesetString =
+    R"""(*filter
+    :INPUT ACCEPT [0:0]
+    :FORWARD DROP [0:0]
+    COMMIT
      )""";
 
-    Table* table = testModule.ParseTable("testTable", tableString);
-    ASSERT_TRUE(table != nullptr);
-    ASSERT_TRUE(table->GetChainCount() == 2);
-    vector<Chain*> chainVector = table->GetChains();
-    vector<string> expectedChainPolicies = {"ACCEPT", "DROP"};
-    vector<int> expectedRuleCounts = {0, 0};
-    for (unsigned int i = 0; i < chainVector.size(); i++)
-    {
-        ASSERT_TRUE(chainVector[i] != nullptr);
-        ASSERT_TRUE(chainVector[i]->GetChainPolicy() == expectedChainPolicies[i]);
-        ASSERT_TRUE(chainVector[i]->GetRuleCount() == expectedRuleCounts[i]);
-    }
-    testModule.AppendTable(table);
-    ASSERT_TRUE(testModule.GetTableCount() == 1);
+    testModule.ParseRuleset(rulesetString);
+    ASSERT_TRUE(testModule.GetRuleset().GetTables().size() == 1);
+    ASSERT_TRUE(testModule.GetRuleset().GetChains().size() == 2);
+    ASSERT_TRUE(testModule.GetRuleset().GetRules().size() == 0);
 
     // When utilityCount is 1, detect utility returns installed
     testModule.utilityCount = 1;
     firewallStatuCode = testModule.GetFirewallState();
     ASSERT_TRUE(firewallStatuCode == firewallStateCodeEnabled);
 
-    tableString =
-    R"""(Chain INPUT (policy ACCEPT 353 packets, 23920 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination         
-           
-
-    Chain FORWARD (policy ACCEPT 0 packets, 0 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination         
-    1        0     0 ACCEPT     all  --  eth1   eth0    0.0.0.0/0            0.0.0.0/0           
+    rulesetString =
+    R"""(*filter
+    :INPUT ACCEPT [353:23920]
+    :FORWARD ACCEPT [0:0]
+    -A FORWARD -i eth1 -o eth0 -j ACCEPT
+    COMMIT
     )""";
     FirewallObjectTest testModule2(maxPayloadSizeBytes);
-    table = testModule2.ParseTable("filter", tableString);
-    ASSERT_TRUE(table != nullptr);
-    testModule2.AppendTable(table);
-    ASSERT_TRUE(testModule2.GetTableCount() == 1);
-    ASSERT_TRUE(table->GetChainCount() == 2);
-    chainVector = table->GetChains();
-    expectedChainPolicies = {"ACCEPT", "ACCEPT"};
-    expectedRuleCounts = {0, 1};
-    for (unsigned int i = 0; i < chainVector.size(); i++)
-    {
-        ASSERT_TRUE(chainVector[i] != nullptr);
-        ASSERT_TRUE(chainVector[i]->GetChainPolicy() == expectedChainPolicies[i]);
-        ASSERT_TRUE(chainVector[i]->GetRuleCount() == expectedRuleCounts[i]);
-    }
+    testModule2.ParseRuleset(rulesetString);
+    ASSERT_TRUE(testModule2.GetRuleset().GetChains().size() == 2);
+    ASSERT_TRUE(testModule2.GetRuleset().GetChains()[1].ruleCount == 1);
 
     testModule2.utilityCount = 1;
     firewallStatuCode = testModule2.GetFirewallState();
     ASSERT_TRUE(firewallStatuCode == firewallStateCodeEnabled);
 
-    tableString =
-    R"""(Chain INPUT (policy ACCEPT 0 packets, 0 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination         
-
-    Chain FORWARD (policy ACCEPT 0 packets, 0 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination         
-
-    Chain OUTPUT (policy ACCEPT 0 packets, 0 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination             
+    rulesetString =
+    R"""(*filter
+    :INPUT ACCEPT [0:0]
+    :FORWARD ACCEPT [0:0]
+    :OUTPUT ACCEPT [0:0]
+    :userChain - [0:0]
+    -A userChain -s 3.3.3.3/32
+    COMMIT
     )""";
     FirewallObjectTest testModule3(maxPayloadSizeBytes);
-    table = testModule3.ParseTable("filter", tableString);
-    ASSERT_TRUE(table != nullptr);
-    testModule3.AppendTable(table);
-    ASSERT_TRUE(testModule3.GetTableCount() == 1);
-    ASSERT_TRUE(table->GetChainCount() == 3);
-    chainVector = table->GetChains();
-    expectedChainPolicies = {"ACCEPT", "ACCEPT", "ACCEPT"};
-    expectedRuleCounts = {0, 0, 0};
-
-    for (unsigned int i = 0; i < chainVector.size(); i++)
-    {
-        ASSERT_TRUE(chainVector[i] != nullptr);
-        ASSERT_TRUE(chainVector[i]->GetChainPolicy() == expectedChainPolicies[i]);
-        ASSERT_TRUE(chainVector[i]->GetRuleCount() == expectedRuleCounts[i]);
-    }
-    testModule3.utilityCount = 1;
-    firewallStatuCode = testModule2.GetFirewallState();
-    ASSERT_TRUE(firewallStatuCode == firewallStateCodeDisabled); 
-}
+    testModule3.ParseRuleset(rulesetString);
+    ASSERT_TRUE(testModule3.GetRuleset().GetChains().size() == 4);
+    ASSERT_TRUE(testModule3.GetRuleset().GetRules().size() == 0);
 
-TEST (FirewallTests, RulesToString)
-{
-    unsigned int maxPayloadSizeBytes = 0;
-    FirewallObjectTest testModule(maxPayloadSizeBytes);
-    vector<string> ruleStrings =
-    {
-        R"""(
-        1     4205  371K ACCEPT     all  --  lo     *       1.1.1.2/0            0.0.0.0/0 )""",
-        R"""(        2     2292  400K ACCEPT     all  --  *      *       0.0.0.0/0            0.0.0.0/0            ctstate RELATED,ESTABLISHED  )"""
-    };
-    const char expectedString[] =
-        "1 ACCEPT all 1.1.1.2/0 0.0.0.0/0 lo *  "
-        "2 ACCEPT all 0.0.0.0/0 0.0.0.0/0 * * ctstate RELATED,ESTABLISHED   ";
-    vector<Rule*> testRules;
-    for (unsigned int i = 0; i < ruleStrings.size(); ++i)
-    {
-        Rule* rule = testModule.ParseRule(ruleStrings[i]);
-        if (rule != nullptr)
-        {
-            testRules.push_back(rule);
-        }
-    }
-    string resultString = testModule.RulesToString(testRules);
-    ASSERT_TRUE(resultString == expectedString);
-}
-
-TEST (FirewallTests, ChainsToString)
-{
-    unsigned int maxPayloadSizeBytes = 0;
-    FirewallObjectTest testModule(maxPayloadSizeBytes);
-    vector<string> chainStrings =
-    {
-        R"""(Chain INPUT (policy ACCEPT 353 packets, 23920 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination         )""",
-        R"""( Chain FORWARD (policy ACCEPT 0 packets, 0 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination
-        1        0     0 ACCEPT     all  --  eth1   eth0    0.0.0.0/0            0.0.0.0/0           )"""
-    };
-    const char expectedString[] =
-        "INPUT ACCEPT  "
-        "FORWARD ACCEPT "
-        "1 ACCEPT all 0.0.0.0/0 0.0.0.0/0 eth1 eth0   ";
-    vector<Chain*> testChains;
-    for (unsigned int i = 0; i < chainStrings.size(); ++i)
-    {
-        Chain* chain = testModule.ParseChain(chainStrings[i]);
-        if (chain != nullptr)
-        {
-            testChains.push_back(chain);
-        }
-    }
-    string resultString = testModule.ChainsToString(testChains);
-    ASSERT_TRUE(resultString == expectedString);
+    testModule3.utilityCount = 1;
+    firewallStatuCode = testModule3.GetFirewallState();
+    ASSERT_TRUE(firewallStatuCode == firewallStateCodeDisabled);
 }
 
-TEST (FirewallTests, TablesToString)
+TEST (FirewallTests, FirewallRulesToString)
 {
     unsigned int maxPayloadSizeBytes = 0;
     FirewallObjectTest testModule(maxPayloadSizeBytes);
-    vector<string> tableStrings =
-    {
-        R"""(Chain INPUT (policy ACCEPT 353 packets, 23920 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination
-        Chain FORWARD (policy ACCEPT 0 packets, 0 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination
-        1        0     0 ACCEPT     all  --  eth1   eth0    0.0.0.0/0            0.0.0.0/0           )""",
-        R"""(Chain PREROUTING (policy ACCEPT 0 packets, 0 bytes)
-        num   pkts bytes target     prot opt in     out     source               destination          )"""
-    };
+    string rulesetString =
+        R"""(# Generated by iptables-save v1.8.7 on Tue Mar  1 10:00:00 2022
+*filter
+:INPUT ACCEPT [353:23920]
+:FORWARD ACCEPT [0:0]
+:userChain - [0:0]
+-A INPUT -s 1.1.1.2/32 -i lo -j ACCEPT
+-A FORWARD -i eth1 -o eth0 -j ACCEPT
+-A userChain -m conntrack --ctstate RELATED,ESTABLISHED -j ACCEPT
+COMMIT
+# Completed on Tue Mar  1 10:00:00 2022
+*nat
+:PREROUTING ACCEPT [0:0]
+COMMIT
+)""";
     const char expectedString[] =
         "filter "
-        "INPUT ACCEPT  "
+        "INPUT ACCEPT "
         "FORWARD ACCEPT "
-        "1 ACCEPT all 0.0.0.0/0 0.0.0.0/0 eth1 eth0    "
+        "userChain  "
+        "-s 1.1.1.2/32 -i lo -j ACCEPT "
+        "-i eth1 -o eth0 -j ACCEPT "
+        "-m conntrack --ctstate RELATED,ESTABLISHED -j ACCEPT "
         "nat "
-        "PREROUTING ACCEPT   ";
-    vector<Table*> testTables;
-    vector<string> tableNames = {"filter", "nat"};
-    for (unsigned int i = 0; i < tableStrings.size(); ++i)
-    {
-        Table* table = testModule.ParseTable(tableNames[i], tableStrings[i]);
-        if (table != nullptr)
-        {
-            testTables.push_back(table);
-        }
-    }
-    string resultString = testModule.TablesToString(testTables);
-    ASSERT_TRUE(resultString == expectedString);
+        "PREROUTING ACCEPT ";
+
+    testModule.ParseRuleset(rulesetString);
+    ASSERT_TRUE(testModule.FirewallRulesToString() == expectedString);
 }
 
 TEST (FirewallTests, GetFingerprint)
 {
     unsigned int maxPayloadSizeBytes = 0;
     FirewallObjectTest testModule(maxPayloadSizeBytes);
-    string tableString =
-    R"""(Chain INPUT (policy ACCEPT 353 packets, 23920 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination
-
-
-    Chain FORWARD (policy ACCEPT 0 packets, 0 bytes)
-    num   pkts bytes target     prot opt in     out     source               destination
-    1        0     0 ACCEPT     all  --  eth1   eth0    0.0.0.0/0            0.0.0.0/0
+    string rulesetString =
+    R"""(# Generated by iptables-save v1.8.7 on Tue Mar  1 10:00:00 2022
+    *filter
+    :INPUT ACCEPT [353:23920]
+    :FORWARD ACCEPT [0:0]
+    -A FORWARD -i eth1 -o eth0 -j ACCEPT
+    COMMIT
     )""";
-    Table* table = testModule.ParseTable("filter", tableString);
-    testModule.AppendTable(table);
+    testModule.ParseRuleset(rulesetString);
     string fingerprint = testModule.GetFingerprint();
+    ASSERT_TRUE(fingerprint.length() == 64);
     unsigned int numberOfTests = 10;
     for (unsigned int i = 0; i < numberOfTests; i++)
     {
         ASSERT_TRUE(testModule.GetFingerprint() == fingerprint);
     }
+
+    // Packet counters and comments do not change the fingerprint, rules and policies do
+    testModule.ParseRuleset("# Generated at another time\n*filter\n:INPUT ACCEPT [1000:90000]\n:FORWARD ACCEPT [5:300]\n-A FORWARD -i eth1 -o eth0 -j ACCEPT\nCOMMIT\n");
+    ASSERT_TRUE(testModule.GetFingerprint() == fingerprint);
+
+    testModule.ParseRuleset("*filter\n:INPUT DROP [353:23920]\n:FORWARD ACCEPT [0:0]\n-A FORWARD -i eth1 -o eth0 -j ACCEPT\nCOMMIT\n");
+    ASSERT_TRUE(testModule.GetFingerprint() != fingerprint);
+
+    testModule.ParseRuleset("*filter\n:INPUT ACCEPT [353:23920]\n:FORWARD ACCEPT [0:0]\n-A FORWARD -i eth1 -o eth2 -j ACCEPT\nCOMMIT\n");
+    ASSERT_TRUE(testModule.GetFingerprint() != fingerprint);
 }
 
 TEST (FirewallTests, Get)
@@ -663,7 +505,7 @@ TEST (FirewallTests, Get)
     const string testFirewallState = "firewallState";
     const string testFirewallFingerprint = "firewallFingerprint";
     const string testWrongObjectName = "abc";
-    testModule.testTableStrings = g_testTableStrings;
+    testModule.testRulesetStrings = g_testRulesetStrings;
     MMI_JSON_STRING payload;
     int payloadSizeBytes;
     int status = 0;
@@ -0,0 +1,447 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/if.h>
+#include <linux/if_addr.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <CommonUtils.h>
+#include <Logging.h>
+#include <Networking.h>
+
+// Large enough for the biggest message the kernel sends in one datagram
+static const size_t g_netlinkBufferSize = 65536;
+
+// How long to wait for each part of a dump
+static const int g_netlinkDumpTimeoutMilliseconds = 1000;
+
+static std::string FormatMacAddress(const unsigned char* address, size_t length)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    std::string result;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (i > 0)
+        {
+            result += ':';
+        }
+        result += hexDigits[address[i] >> 4];
+        result += hexDigits[address[i] & 0x0F];
+    }
+
+    return result;
+}
+
+bool NetlinkSnapshot::Apply(const void* buffer, size_t length)
+{
+    const struct nlmsghdr* message = (const struct nlmsghdr*)buffer;
+    unsigned int remaining = (unsigned int)length;
+    bool done = false;
+
+    for (; NLMSG_OK(message, remaining); message = NLMSG_NEXT(message, remaining))
+    {
+        switch (message->nlmsg_type)
+        {
+            case NLMSG_DONE:
+            case NLMSG_ERROR:
+                done = true;
+                break;
+            case RTM_NEWLINK:
+            case RTM_DELLINK:
+                ApplyLink(message);
+                break;
+            case RTM_NEWADDR:
+            case RTM_DELADDR:
+                ApplyAddress(message);
+                break;
+            case RTM_NEWROUTE:
+            case RTM_DELROUTE:
+                ApplyRoute(message);
+                break;
+            default:
+                break;
+        }
+    }
+
+    return done;
+}
+
+void NetlinkSnapshot::ApplyLink(const struct nlmsghdr* message)
+{
+    const struct ifinfomsg* link = (const struct ifinfomsg*)NLMSG_DATA(message);
+    const struct rtattr* attribute = IFLA_RTA(link);
+    int remaining = (int)IFLA_PAYLOAD(message);
+    NetlinkInterface* entry = nullptr;
+    std::string name;
+
+    // Bridge port notifications describe the port, not the link, a port leaving its bridge comes as RTM_DELLINK
+    if ((message->nlmsg_len < NLMSG_LENGTH(sizeof(*link))) || (AF_BRIDGE == link->ifi_family))
+    {
+        return;
+    }
+
+    if (RTM_DELLINK == message->nlmsg_type)
+    {
+        if (0 < m_interfaces.erase(link->ifi_index))
+        {
+            m_linkGeneration++;
+        }
+        return;
+    }
+
+    if (m_interfaces.end() == m_interfaces.find(link->ifi_index))
+    {
+        m_linkGeneration++;
+    }
+
+    entry = &m_interfaces[link->ifi_index];
+    entry->index = link->ifi_index;
+    entry->lowerUp = (0 != (link->ifi_flags & IFF_LOWER_UP));
+
+    for (; RTA_OK(attribute, remaining); attribute = RTA_NEXT(attribute, remaining))
+    {
+        switch (attribute->rta_type)
+        {
+            case IFLA_IFNAME:
+                name.assign((const char*)RTA_DATA(attribute), strnlen((const char*)RTA_DATA(attribute), RTA_PAYLOAD(attribute)));
+                if (entry->name != name)
+                {
+                    entry->name = name;
+                    m_linkGeneration++;
+                }
+                break;
+            case IFLA_ADDRESS:
+                entry->macAddress = FormatMacAddress((const unsigned char*)RTA_DATA(attribute), RTA_PAYLOAD(attribute));
+                break;
+            case IFLA_OPERSTATE:
+                entry->operationalState = *(const unsigned char*)RTA_DATA(attribute);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void NetlinkSnapshot::ApplyAddress(const struct nlmsghdr* message)
+{
+    const struct ifaddrmsg* addressMessage = (const struct ifaddrmsg*)NLMSG_DATA(message);
+    const struct rtattr* attribute = IFA_RTA(addressMessage);
+    int remaining = (int)IFA_PAYLOAD(message);
+    const void* local = nullptr;
+    const void* address = nullptr;
+    unsigned int flags = 0;
+    char text[INET6_ADDRSTRLEN] = {0};
+    NetlinkAddress entry;
+
+    if ((message->nlmsg_len < NLMSG_LENGTH(sizeof(*addressMessage))) || ((AF_INET != addressMessage->ifa_family) && (AF_INET6 != addressMessage->ifa_family)))
+    {
+        return;
+    }
+
+    std::map<int, NetlinkInterface>::iterator netlinkInterface = m_interfaces.find((int)addressMessage->ifa_index);
+    if (m_interfaces.end() == netlinkInterface)
+    {
+        return;
+    }
+
+    flags = addressMessage->ifa_flags;
+    for (; RTA_OK(attribute, remaining); attribute = RTA_NEXT(attribute, remaining))
+    {
+        switch (attribute->rta_type)
+        {
+            case IFA_LOCAL:
+                local = RTA_DATA(attribute);
+                break;
+            case IFA_ADDRESS:
+                address = RTA_DATA(attribute);
+                break;
+            case IFA_FLAGS:
+                flags = *(const unsigned int*)RTA_DATA(attribute);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // On point to point links IFA_ADDRESS is the peer, 'ip addr' shows the local address
+    if ((nullptr == (local ? local : address)) || (nullptr == inet_ntop(addressMessage->ifa_family, local ? local : address, text, sizeof(text))))
+    {
+        return;
+    }
+
+    entry.family = addressMessage->ifa_family;
+    entry.address = text;
+    entry.prefixLength = addressMessage->ifa_prefixlen;
+    entry.dynamic = (0 == (flags & IFA_F_PERMANENT));
+
+    std::vector<NetlinkAddress>& addresses = netlinkInterface->second.addresses;
+    std::vector<NetlinkAddress>::iterator existing = std::find_if(addresses.begin(), addresses.end(), [&entry](const NetlinkAddress& item)
+    {
+        return (item.family == entry.family) && (item.address == entry.address) && (item.prefixLength == entry.prefixLength);
+    });
+
+    if (RTM_DELADDR == message->nlmsg_type)
+    {
+        if (addresses.end() != existing)
+        {
+            addresses.erase(existing);
+        }
+    }
+    else if (addresses.end() != existing)
+    {
+        *existing = entry;
+    }
+    else if (AF_INET == entry.family)
+    {
+        // IPv4 addresses ahead of IPv6 ones, in the order 'ip addr' lists them
+        addresses.insert(std::find_if(addresses.begin(), addresses.end(), [](const NetlinkAddress& item) { return AF_INET6 == item.family; }), entry);
+    }
+    else
+    {
+        addresses.push_back(entry);
+    }
+}
+
+void NetlinkSnapshot::ApplyRoute(const struct nlmsghdr* message)
+{
+    const struct rtmsg* route = (const struct rtmsg*)NLMSG_DATA(message);
+    const struct rtattr* attribute = RTM_RTA(route);
+    int remaining = (int)RTM_PAYLOAD(message);
+    unsigned int table = 0;
+    int outputInterface = 0;
+    const void* gateway = nullptr;
+    char text[INET_ADDRSTRLEN] = {0};
+
+    if ((message->nlmsg_len < NLMSG_LENGTH(sizeof(*route))) || (AF_INET != route->rtm_family) || (0 != route->rtm_dst_len) || (RTN_UNICAST != route->rtm_type))
+    {
+        return;
+    }
+
+    table = route->rtm_table;
+    for (; RTA_OK(attribute, remaining); attribute = RTA_NEXT(attribute, remaining))
+    {
+        switch (attribute->rta_type)
+        {
+            case RTA_TABLE:
+                table = *(const unsigned int*)RTA_DATA(attribute);
+                break;
+            case RTA_OIF:
+                outputInterface = *(const int*)RTA_DATA(attribute);
+                break;
+            case RTA_GATEWAY:
+                gateway = RTA_DATA(attribute);
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::map<int, NetlinkInterface>::iterator netlinkInterface = m_interfaces.find(outputInterface);
+    if ((RT_TABLE_MAIN != table) || (nullptr == gateway) || (m_interfaces.end() == netlinkInterface) || (nullptr == inet_ntop(AF_INET, gateway, text, sizeof(text))))
+    {
+        return;
+    }
+
+    std::vector<std::string>& gateways = netlinkInterface->second.defaultGateways;
+    std::vector<std::string>::iterator existing = std::find(gateways.begin(), gateways.end(), text);
+
+    if (RTM_DELROUTE == message->nlmsg_type)
+    {
+        if (gateways.end() != existing)
+        {
+            gateways.erase(existing);
+        }
+    }
+    else if (gateways.end() == existing)
+    {
+        gateways.push_back(text);
+    }
+}
+
+void NetlinkSnapshot::Clear()
+{
+    m_interfaces.clear();
+    m_linkGeneration++;
+}
+
+const std::map<int, NetlinkInterface>& NetlinkSnapshot::GetInterfaces() const
+{
+    return m_interfaces;
+}
+
+unsigned long long NetlinkSnapshot::GetLinkGeneration() const
+{
+    return m_linkGeneration;
+}
+
+NetlinkMonitor::NetlinkMonitor() : m_socket(-1), m_sequence(0), m_dumped(false)
+{
+}
+
+NetlinkMonitor::~NetlinkMonitor()
+{
+    Close();
+}
+
+bool NetlinkMonitor::Open()
+{
+    struct sockaddr_nl address;
+    int receiveBufferSize = 1024 * 1024;
+
+    if (0 > (m_socket = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE)))
+    {
+        OsConfigLogError(NetworkingLog::Get(), "NetlinkMonitor: cannot open a rtnetlink socket (%d)", errno);
+        return false;
+    }
+
+    // Subscribed before the dump so that no change made while dumping is missed
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR | RTMGRP_IPV4_ROUTE;
+
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof(receiveBufferSize));
+
+    if (0 != bind(m_socket, (struct sockaddr*)&address, sizeof(address)))
+    {
+        OsConfigLogError(NetworkingLog::Get(), "NetlinkMonitor: cannot subscribe to rtnetlink notifications (%d)", errno);
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void NetlinkMonitor::Close()
+{
+    if (0 <= m_socket)
+    {
+        close(m_socket);
+        m_socket = -1;
+    }
+    m_dumped = false;
+}
+
+bool NetlinkMonitor::Request(int type, int family)
+{
+    struct
+    {
+        struct nlmsghdr header;
+        struct rtgenmsg message;
+    } request;
+
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(request.message));
+    request.header.nlmsg_type = type;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++m_sequence;
+    request.message.rtgen_family = family;
+
+    return (ssize_t)request.header.nlmsg_len == send(m_socket, &request, request.header.nlmsg_len, 0);
+}
+
+// Receives one datagram and applies it, returns its size, 0 when nothing is queued, or -1 with errno set.
+// ENOBUFS means notifications were lost and the snapshot has to be dumped again
+int NetlinkMonitor::Receive(bool wait, bool& done)
+{
+    std::vector<char> buffer(g_netlinkBufferSize);
+    struct pollfd descriptor = {m_socket, POLLIN, 0};
+    ssize_t length = 0;
+
+    done = false;
+
+    if (wait && (1 != poll(&descriptor, 1, g_netlinkDumpTimeoutMilliseconds)))
+    {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    if (0 > (length = recv(m_socket, buffer.data(), buffer.size(), 0)))
+    {
+        return ((EAGAIN == errno) || (EWOULDBLOCK == errno) || (EINTR == errno)) ? 0 : -1;
+    }
+
+    done = m_snapshot.Apply(buffer.data(), (size_t)length);
+
+    return (int)length;
+}
+
+// Links first so that addresses and routes find their interface, one dump at a time as the socket allows
+bool NetlinkMonitor::Dump()
+{
+    const int requests[][2] = {{RTM_GETLINK, AF_UNSPEC}, {RTM_GETADDR, AF_UNSPEC}, {RTM_GETROUTE, AF_INET}};
+    bool done = false;
+
+    m_snapshot.Clear();
+
+    for (size_t i = 0; i < ARRAY_SIZE(requests); i++)
+    {
+        if (!Request(requests[i][0], requests[i][1]))
+        {
+            OsConfigLogError(NetworkingLog::Get(), "NetlinkMonitor: dump request %d failed (%d)", requests[i][0], errno);
+            return false;
+        }
+
+        do
+        {
+            if (0 > Receive(true, done))
+            {
+                OsConfigLogError(NetworkingLog::Get(), "NetlinkMonitor: dump %d failed (%d)", requests[i][0], errno);
+                return false;
+            }
+        }
+        while (!done);
+    }
+
+    m_dumped = true;
+
+    return true;
+}
+
+bool NetlinkMonitor::Refresh()
+{
+    bool done = false;
+    int received = 0;
+
+    if ((0 > m_socket) && !Open())
+    {
+        return false;
+    }
+
+    while (m_dumped && (0 < (received = Receive(false, done))));
+
+    if (0 > received)
+    {
+        if (IsFullLoggingEnabled())
+        {
+            OsConfigLogInfo(NetworkingLog::Get(), "NetlinkMonitor: notifications lost (%d), dumping again", errno);
+        }
+
+        // The socket may still hold the rest of a lost stream, a new one starts clean
+        Close();
+        if (!Open())
+        {
+            return false;
+        }
+    }
+
+    if (!m_dumped && !Dump())
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+const NetlinkSnapshot& NetlinkMonitor::GetSnapshot() const
+{
+    return m_snapshot;
+}
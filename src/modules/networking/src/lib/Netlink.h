@@ -0,0 +1,87 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef NETLINK_H
+#define NETLINK_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+struct NetlinkAddress
+{
+    int family;
+    std::string address;
+    unsigned int prefixLength;
+
+    // Not permanent, what 'ip addr' shows as dynamic
+    bool dynamic;
+};
+
+struct NetlinkInterface
+{
+    int index;
+    std::string name;
+    std::string macAddress;
+
+    // IF_OPER_* from IFLA_OPERSTATE and the IFF_LOWER_UP flag (carrier)
+    unsigned int operationalState;
+    bool lowerUp;
+
+    std::vector<NetlinkAddress> addresses;
+
+    // IPv4 default routes of the main table through this interface, like 'ip route' lists them
+    std::vector<std::string> defaultGateways;
+};
+
+// Interfaces with their addresses and default gateways built from rtnetlink link, address and route messages,
+// either dumped or received as notifications
+class NetlinkSnapshot
+{
+public:
+    // Applies the messages in the buffer, returns true when the buffer ends a dump (NLMSG_DONE or NLMSG_ERROR)
+    bool Apply(const void* buffer, size_t length);
+    void Clear();
+
+    const std::map<int, NetlinkInterface>& GetInterfaces() const;
+
+    // Changes when an interface is added, removed or renamed
+    unsigned long long GetLinkGeneration() const;
+
+private:
+    void ApplyLink(const struct nlmsghdr* message);
+    void ApplyAddress(const struct nlmsghdr* message);
+    void ApplyRoute(const struct nlmsghdr* message);
+
+    std::map<int, NetlinkInterface> m_interfaces;
+    unsigned long long m_linkGeneration = 0;
+};
+
+// Keeps a snapshot current over a rtnetlink socket subscribed to link, address and route notifications.
+// Nothing runs in the background: each refresh applies the notifications queued on the socket since the last one
+class NetlinkMonitor
+{
+public:
+    NetlinkMonitor();
+    ~NetlinkMonitor();
+
+    // Dumps links, addresses and routes the first time (and after the socket overran), applies the queued notifications
+    // otherwise. False when rtnetlink cannot be used
+    bool Refresh();
+
+    const NetlinkSnapshot& GetSnapshot() const;
+
+private:
+    bool Open();
+    void Close();
+    bool Dump();
+    bool Request(int type, int family);
+    int Receive(bool wait, bool& done);
+
+    int m_socket;
+    unsigned int m_sequence;
+    bool m_dumped;
+    NetlinkSnapshot m_snapshot;
+};
+
+#endif // NETLINK_H
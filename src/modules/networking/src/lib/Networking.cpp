@@ -11,6 +11,7 @@
 #include <sstream>
 #include <unordered_map>
 #include <stdio.h>
+#include <linux/if.h>
 #include <Networking.h>
 #include <CommonUtils.h>
 
@@ -126,6 +127,11 @@ std::string NetworkingObject::RunCommand(const char* command)
     return commandOutputToReturn;
 }
 
+const NetlinkSnapshot* NetworkingObject::GetNetlinkSnapshot()
+{
+    return m_netlinkMonitor.Refresh() ? &m_netlinkMonitor.GetSnapshot() : nullptr;
+}
+
 void NetworkingObjectBase::ParseInterfaceDataForSettings(bool hasPrefix, const char* flag, std::stringstream& data, std::vector<std::string>& settings)
 {
     std::string token = g_emptyString;
@@ -156,7 +162,15 @@ void NetworkingObjectBase::GetInterfaceTypes(const std::string& interfaceName, s
 
 void NetworkingObjectBase::GetMacAddresses(const std::string& interfaceName, std::vector<std::string>& interfaceSettings)
 {
-    if (this->m_ipSettingsMap.find(interfaceName) != this->m_ipSettingsMap.end())
+    std::map<std::string, NetlinkInterface>::iterator netlinkInterface = this->m_netlinkInterfaces.find(interfaceName);
+    if (netlinkInterface != this->m_netlinkInterfaces.end())
+    {
+        if (!netlinkInterface->second.macAddress.empty())
+        {
+            interfaceSettings.push_back(netlinkInterface->second.macAddress);
+        }
+    }
+    else if (this->m_ipSettingsMap.find(interfaceName) != this->m_ipSettingsMap.end())
     {
         std::stringstream ipSettingsData(this->m_ipSettingsMap[interfaceName]);
         ParseInterfaceDataForSettings(true, g_macAddressesPrefix, ipSettingsData, interfaceSettings);
@@ -165,7 +179,15 @@ void NetworkingObjectBase::GetMacAddresses(const std::string& interfaceName, std
 
 void NetworkingObjectBase::GetIpAddresses(const std::string& interfaceName, std::vector<std::string>& interfaceSettings)
 {
-    if (this->m_ipSettingsMap.find(interfaceName) != this->m_ipSettingsMap.end())
+    std::map<std::string, NetlinkInterface>::iterator netlinkInterface = this->m_netlinkInterfaces.find(interfaceName);
+    if (netlinkInterface != this->m_netlinkInterfaces.end())
+    {
+        for (const NetlinkAddress& address : netlinkInterface->second.addresses)
+        {
+            interfaceSettings.push_back(address.address);
+        }
+    }
+    else if (this->m_ipSettingsMap.find(interfaceName) != this->m_ipSettingsMap.end())
     {
         std::stringstream ipSettingsData(this->m_ipSettingsMap[interfaceName]);
         ParseInterfaceDataForSettings(true, g_ipAddressesPrefix, ipSettingsData, interfaceSettings);  
@@ -187,7 +209,15 @@ void NetworkingObjectBase::GetIpAddresses(const std::string& interfaceName, std:
 
 void NetworkingObjectBase::GetSubnetMasks(const std::string& interfaceName, std::vector<std::string>& interfaceSettings)
 {
-    if (this->m_ipSettingsMap.find(interfaceName) != this->m_ipSettingsMap.end())
+    std::map<std::string, NetlinkInterface>::iterator netlinkInterface = this->m_netlinkInterfaces.find(interfaceName);
+    if (netlinkInterface != this->m_netlinkInterfaces.end())
+    {
+        for (const NetlinkAddress& address : netlinkInterface->second.addresses)
+        {
+            interfaceSettings.push_back(g_slash + std::to_string(address.prefixLength));
+        }
+    }
+    else if (this->m_ipSettingsMap.find(interfaceName) != this->m_ipSettingsMap.end())
     {
         std::stringstream ipSettingsData(this->m_ipSettingsMap[interfaceName]);
         ParseInterfaceDataForSettings(true, g_subnetMasksPrefix, ipSettingsData, interfaceSettings);
@@ -231,7 +261,13 @@ void NetworkingObjectBase::GetDnsServers(const std::string& interfaceName, std::
 
 void NetworkingObjectBase::GetDhcpEnabled(const std::string& interfaceName, std::vector<std::string>& interfaceSettings)
 {
-    if (this->m_ipSettingsMap.find(interfaceName) != this->m_ipSettingsMap.end())
+    std::map<std::string, NetlinkInterface>::iterator netlinkInterface = this->m_netlinkInterfaces.find(interfaceName);
+    if (netlinkInterface != this->m_netlinkInterfaces.end())
+    {
+        const std::vector<NetlinkAddress>& addresses = netlinkInterface->second.addresses;
+        interfaceSettings.push_back(std::any_of(addresses.begin(), addresses.end(), [](const NetlinkAddress& address) { return address.dynamic; }) ? g_true : g_false);
+    }
+    else if (this->m_ipSettingsMap.find(interfaceName) != this->m_ipSettingsMap.end())
     {
         std::stringstream ipSettingsData(this->m_ipSettingsMap[interfaceName]);
         ParseInterfaceDataForSettings(false, g_dhcpEnabledFlag, ipSettingsData, interfaceSettings);
@@ -253,7 +289,20 @@ void NetworkingObjectBase::GetDhcpEnabled(const std::string& interfaceName, std:
 
 void NetworkingObjectBase::GetEnabled(const std::string& interfaceName, std::vector<std::string>& interfaceSettings)
 {
-    if (this->m_ipSettingsMap.find(interfaceName) != this->m_ipSettingsMap.end())
+    std::map<std::string, NetlinkInterface>::iterator netlinkInterface = this->m_netlinkInterfaces.find(interfaceName);
+    if (netlinkInterface != this->m_netlinkInterfaces.end())
+    {
+        // 'ip addr' shows these as state UP and state DOWN, any other state is unknown
+        if (IF_OPER_UP == netlinkInterface->second.operationalState)
+        {
+            interfaceSettings.push_back(g_true);
+        }
+        else if (IF_OPER_DOWN == netlinkInterface->second.operationalState)
+        {
+            interfaceSettings.push_back(g_false);
+        }
+    }
+    else if (this->m_ipSettingsMap.find(interfaceName) != this->m_ipSettingsMap.end())
     {
         std::stringstream ipSettingsData(this->m_ipSettingsMap[interfaceName]);
         ParseInterfaceDataForSettings(true, g_enabledPrefix, ipSettingsData, interfaceSettings);
@@ -280,7 +329,12 @@ void NetworkingObjectBase::GetEnabled(const std::string& interfaceName, std::vec
 
 void NetworkingObjectBase::GetConnected(const std::string& interfaceName, std::vector<std::string>& interfaceSettings)
 {
-    if (this->m_ipSettingsMap.find(interfaceName) != this->m_ipSettingsMap.end())
+    std::map<std::string, NetlinkInterface>::iterator netlinkInterface = this->m_netlinkInterfaces.find(interfaceName);
+    if (netlinkInterface != this->m_netlinkInterfaces.end())
+    {
+        interfaceSettings.push_back(netlinkInterface->second.lowerUp ? g_true : g_false);
+    }
+    else if (this->m_ipSettingsMap.find(interfaceName) != this->m_ipSettingsMap.end())
     {
         std::stringstream ipSettingsData(this->m_ipSettingsMap[interfaceName]);
         ParseInterfaceDataForSettings(false, g_connectedFlag, ipSettingsData, interfaceSettings);
@@ -742,12 +796,64 @@ void NetworkingObjectBase::RefreshInterfaceData()
     GenerateDnsServersMap();
 }
 
+void NetworkingObjectBase::RefreshInterfaceDataFromNetlink(const NetlinkSnapshot& snapshot)
+{
+    this->m_interfaceNames.clear();
+    this->m_netlinkInterfaces.clear();
+    this->m_ipSettingsMap.clear();
+    this->m_defaultGatewaysMap.clear();
+
+    for (const std::pair<const int, NetlinkInterface>& netlinkInterface : snapshot.GetInterfaces())
+    {
+        if (!netlinkInterface.second.name.empty())
+        {
+            this->m_netlinkInterfaces[netlinkInterface.second.name] = netlinkInterface.second;
+
+            if (!netlinkInterface.second.defaultGateways.empty())
+            {
+                this->m_defaultGatewaysMap[netlinkInterface.second.name] = netlinkInterface.second.defaultGateways;
+            }
+        }
+    }
+
+    // In name order like the command path lists them, not in ifindex order, so the reported values do not depend on the source
+    for (const std::pair<const std::string, NetlinkInterface>& netlinkInterface : this->m_netlinkInterfaces)
+    {
+        this->m_interfaceNames.push_back(netlinkInterface.first);
+    }
+
+    if (!this->m_interfaceNames.empty())
+    {
+        if (this->m_interfaceTypesMap.empty() || (this->m_interfaceTypesGeneration != snapshot.GetLinkGeneration()))
+        {
+            GenerateInterfaceTypesMap();
+            this->m_interfaceTypesGeneration = snapshot.GetLinkGeneration();
+        }
+
+        // DNS servers are not known to rtnetlink
+        GenerateDnsServersMap();
+    }
+}
+
 void NetworkingObjectBase::RefreshSettingsStrings()
 {
-    RefreshInterfaceNames(this->m_interfaceNames);
+    const NetlinkSnapshot* snapshot = GetNetlinkSnapshot();
+    if (nullptr != snapshot)
+    {
+        RefreshInterfaceDataFromNetlink(*snapshot);
+    }
+    else
+    {
+        this->m_netlinkInterfaces.clear();
+        RefreshInterfaceNames(this->m_interfaceNames);
+        if (this->m_interfaceNames.size() > 0)
+        {
+            RefreshInterfaceData();
+        }
+    }
+
     if (this->m_interfaceNames.size() > 0)
     {
-        RefreshInterfaceData();
         UpdateSettingsString(NetworkingSettingType::InterfaceTypes, this->m_settings.interfaceTypes);
         UpdateSettingsString(NetworkingSettingType::MacAddresses, this->m_settings.macAddresses);
         UpdateSettingsString(NetworkingSettingType::IpAddresses, this->m_settings.ipAddresses);
@@ -6,6 +6,7 @@
 #include <rapidjson/writer.h>
 #include <Logging.h>
 #include <Mmi.h>
+#include <Netlink.h>
 
 #define NETWORKING_LOGFILE "/var/log/osconfig_networking.log"
 #define NETWORKING_ROLLEDLOGFILE "/var/log/osconfig_networking.bak"
@@ -73,6 +74,9 @@ public:
     virtual ~NetworkingObjectBase() {};
     virtual std::string RunCommand(const char* command) = 0;
 
+    // Current interfaces, addresses and routes from rtnetlink, null when not available and the output of commands is parsed instead
+    virtual const NetlinkSnapshot* GetNetlinkSnapshot() { return nullptr; }
+
     int Get(
         const char* componentName,
         const char* objectName,
@@ -106,6 +110,7 @@ private:
     void GetGlobalDnsServers(std::string dnsServersData, std::vector<std::string>& globalDnsServers);
     void RefreshInterfaceNames(std::vector<std::string>& interfaceNames);
     void RefreshInterfaceData();
+    void RefreshInterfaceDataFromNetlink(const NetlinkSnapshot& snapshot);
     void RefreshSettingsStrings();
     bool IsKnownInterfaceName(std::string str);
     virtual int WriteJsonElement(rapidjson::Writer<rapidjson::StringBuffer>* writer, const char* key, const char* value) = 0;
@@ -117,13 +122,23 @@ private:
     std::map<std::string, std::string> m_ipSettingsMap;
     std::map<std::string, std::vector<std::string>> m_defaultGatewaysMap;
     std::map<std::string, std::vector<std::string>> m_dnsServersMap;
+
+    // Interfaces of the netlink snapshot by name, empty when the commands are parsed
+    std::map<std::string, NetlinkInterface> m_netlinkInterfaces;
+
+    // Interface types only change with the interfaces, they are queried again when the snapshot's links change
+    unsigned long long m_interfaceTypesGeneration = 0;
 };
 
 class NetworkingObject : public NetworkingObjectBase
 {
 public:
     std::string RunCommand(const char* command) override;
+    const NetlinkSnapshot* GetNetlinkSnapshot() override;
     int WriteJsonElement(rapidjson::Writer<rapidjson::StringBuffer>* writer, const char* key, const char* value) override;
     NetworkingObject(unsigned int maxPayloadSizeBytes);
     ~NetworkingObject();
+
+private:
+    NetlinkMonitor m_netlinkMonitor;
 };
\ No newline at end of file
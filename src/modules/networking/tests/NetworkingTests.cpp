@@ -5,6 +5,11 @@
 #include <cstdio>
 #include <gtest/gtest.h>
 #include <string>
+#include <arpa/inet.h>
+#include <linux/if.h>
+#include <linux/if_addr.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 #include <CommonUtils.h>
 #include <Mmi.h>
 #include <Networking.h>
@@ -20,6 +25,8 @@ public:
     std::string RunCommand(const char* command);
     bool isTestWriteJsonElement = false;
     int WriteJsonElement(rapidjson::Writer<rapidjson::StringBuffer>* writer, const char* key, const char* value);
+    const NetlinkSnapshot* netlinkSnapshot = nullptr;
+    const NetlinkSnapshot* GetNetlinkSnapshot() override;
 };
 
 NetworkingObjectTest::NetworkingObjectTest(unsigned int maxPayloadSizeBytes)
@@ -42,6 +49,109 @@ std::string NetworkingObjectTest::RunCommand(const char* command)
     return commandResult;
 }
 
+const NetlinkSnapshot* NetworkingObjectTest::GetNetlinkSnapshot()
+{
+    return netlinkSnapshot;
+}
+
+// Builds rtnetlink messages as the kernel sends them, in dumps and notifications
+class NetlinkMessages
+{
+public:
+    std::vector<char> buffer;
+
+    void Link(int type, int index, const char* name, const unsigned char* macAddress, unsigned char operationalState, unsigned int flags, unsigned char family = AF_UNSPEC)
+    {
+        struct ifinfomsg link = {};
+        link.ifi_family = family;
+        link.ifi_index = index;
+        link.ifi_flags = flags;
+
+        size_t message = Begin(type, &link, sizeof(link));
+        Attribute(IFLA_IFNAME, name, strlen(name) + 1);
+        Attribute(IFLA_ADDRESS, macAddress, 6);
+        Attribute(IFLA_OPERSTATE, &operationalState, sizeof(operationalState));
+        End(message);
+    }
+
+    void Address(int type, int index, int family, const char* address, unsigned char prefixLength, unsigned int flags)
+    {
+        struct ifaddrmsg addressMessage = {};
+        unsigned char bytes[16] = {0};
+        addressMessage.ifa_family = family;
+        addressMessage.ifa_prefixlen = prefixLength;
+        addressMessage.ifa_index = index;
+        inet_pton(family, address, bytes);
+
+        size_t message = Begin(type, &addressMessage, sizeof(addressMessage));
+        Attribute(IFA_ADDRESS, bytes, (AF_INET == family) ? 4 : 16);
+        if (AF_INET == family)
+        {
+            Attribute(IFA_LOCAL, bytes, 4);
+        }
+        Attribute(IFA_FLAGS, &flags, sizeof(flags));
+        End(message);
+    }
+
+    void Route(int type, int index, unsigned char destinationLength, const char* gateway)
+    {
+        struct rtmsg route = {};
+        unsigned char bytes[4] = {0};
+        unsigned int table = RT_TABLE_MAIN;
+        route.rtm_family = AF_INET;
+        route.rtm_dst_len = destinationLength;
+        route.rtm_table = RT_TABLE_MAIN;
+        route.rtm_type = RTN_UNICAST;
+        inet_pton(AF_INET, gateway, bytes);
+
+        size_t message = Begin(type, &route, sizeof(route));
+        Attribute(RTA_TABLE, &table, sizeof(table));
+        Attribute(RTA_GATEWAY, bytes, sizeof(bytes));
+        Attribute(RTA_OIF, &index, sizeof(index));
+        End(message);
+    }
+
+    void Done()
+    {
+        int status = 0;
+        End(Begin(NLMSG_DONE, &status, sizeof(status)));
+    }
+
+private:
+    size_t Begin(int type, const void* data, size_t size)
+    {
+        struct nlmsghdr header = {};
+        size_t message = buffer.size();
+        header.nlmsg_type = type;
+        header.nlmsg_flags = NLM_F_MULTI;
+        buffer.resize(message + NLMSG_HDRLEN);
+        memcpy(&buffer[message], &header, sizeof(header));
+        Append(data, size);
+        return message;
+    }
+
+    void Attribute(unsigned short type, const void* data, size_t size)
+    {
+        struct rtattr attribute = {};
+        attribute.rta_type = type;
+        attribute.rta_len = RTA_LENGTH(size);
+        Append(&attribute, sizeof(attribute));
+        Append(data, size);
+    }
+
+    void Append(const void* data, size_t size)
+    {
+        size_t offset = buffer.size();
+        buffer.resize(offset + NLMSG_ALIGN(size), 0);
+        memcpy(&buffer[offset], data, size);
+    }
+
+    void End(size_t message)
+    {
+        reinterpret_cast<struct nlmsghdr*>(&buffer[message])->nlmsg_len = buffer.size() - message;
+    }
+};
+
 int NetworkingObjectTest::WriteJsonElement(rapidjson::Writer<rapidjson::StringBuffer>* writer, const char* key, const char* value)
 {
     int result = MMI_OK;
@@ -775,6 +885,129 @@ namespace OSConfig::Platform::Tests
         delete payload;
     }
     
+    TEST(NetworkingTests, NetlinkSnapshotDump)
+    {
+        const unsigned char docker0Mac[] = {0x02, 0x42, 0x65, 0xb3, 0xac, 0x5a};
+        const unsigned char eth0Mac[] = {0x00, 0x15, 0x5d, 0x26, 0xcf, 0x89};
+
+        const char* payloadExpected =
+            "{\"interfaceTypes\":\"docker0=bridge;eth0=ethernet\","
+            "\"macAddresses\":\"docker0=02:42:65:b3:ac:5a;eth0=00:15:5d:26:cf:89\","
+            "\"ipAddresses\":\"docker0=172.32.233.234,::1;eth0=172.27.181.213,10.1.1.2,fe80::5e42:4bf7:dddd:9b0f\","
+            "\"subnetMasks\":\"docker0=/8,/128;eth0=/20,/16,/64\","
+            "\"defaultGateways\":\"docker0=172.17.128.1;eth0=172.13.145.1\","
+            "\"dnsServers\":\"docker0=8.8.8.8,172.29.64.1;eth0=172.29.64.1\","
+            "\"dhcpEnabled\":\"docker0=true;eth0=false\","
+            "\"enabled\":\"docker0=true;eth0=false\","
+            "\"connected\":\"docker0=true;eth0=false\"}";
+
+        // Kernel indexes, eth0 comes before docker0 in ifindex order but is reported after it
+        NetlinkMessages links;
+        links.Link(RTM_NEWLINK, 3, "docker0", docker0Mac, IF_OPER_UP, IFF_UP | IFF_LOWER_UP);
+        links.Link(RTM_NEWLINK, 2, "eth0", eth0Mac, IF_OPER_DOWN, IFF_UP);
+        links.Done();
+
+        NetlinkMessages addresses;
+        addresses.Address(RTM_NEWADDR, 3, AF_INET, "172.32.233.234", 8, 0);
+        addresses.Address(RTM_NEWADDR, 2, AF_INET, "172.27.181.213", 20, IFA_F_PERMANENT);
+        addresses.Address(RTM_NEWADDR, 2, AF_INET, "10.1.1.2", 16, IFA_F_PERMANENT);
+        addresses.Address(RTM_NEWADDR, 3, AF_INET6, "::1", 128, IFA_F_PERMANENT);
+        addresses.Address(RTM_NEWADDR, 2, AF_INET6, "fe80::5e42:4bf7:dddd:9b0f", 64, IFA_F_PERMANENT);
+        addresses.Done();
+
+        NetlinkMessages routes;
+        routes.Route(RTM_NEWROUTE, 3, 0, "172.17.128.1");
+        routes.Route(RTM_NEWROUTE, 2, 20, "172.29.78.164");
+        routes.Route(RTM_NEWROUTE, 2, 0, "172.13.145.1");
+        routes.Done();
+
+        NetlinkSnapshot snapshot;
+        EXPECT_TRUE(snapshot.Apply(links.buffer.data(), links.buffer.size()));
+        EXPECT_TRUE(snapshot.Apply(addresses.buffer.data(), addresses.buffer.size()));
+        EXPECT_TRUE(snapshot.Apply(routes.buffer.data(), routes.buffer.size()));
+        EXPECT_EQ(2, (int)snapshot.GetInterfaces().size());
+
+        // Only the interface types and DNS servers are left to commands
+        MMI_JSON_STRING payload;
+        int payloadSizeBytes;
+        NetworkingObjectTest testModule(g_maxPayloadSizeBytes);
+        testModule.netlinkSnapshot = &snapshot;
+        testModule.returnValues = {g_testCommandOutputInterfaceTypesNmcli, g_testCommandOutputDnsServers, g_testCommandOutputDnsServers};
+        int result = testModule.Get(NETWORKING, NETWORK_CONFIGURATION, &payload, &payloadSizeBytes);
+
+        EXPECT_EQ(result, MMI_OK);
+        EXPECT_EQ(2, (int)testModule.runCommandCount);
+
+        std::string resultString(payload, payloadSizeBytes);
+        EXPECT_STREQ(resultString.c_str(), payloadExpected);
+        delete payload;
+
+        // The interface types are kept while the links do not change
+        result = testModule.Get(NETWORKING, NETWORK_CONFIGURATION, &payload, &payloadSizeBytes);
+
+        EXPECT_EQ(result, MMI_OK);
+        EXPECT_EQ(3, (int)testModule.runCommandCount);
+
+        resultString = std::string(payload, payloadSizeBytes);
+        EXPECT_STREQ(resultString.c_str(), payloadExpected);
+        delete payload;
+    }
+
+    TEST(NetworkingTests, NetlinkSnapshotNotifications)
+    {
+        const unsigned char docker0Mac[] = {0x02, 0x42, 0x65, 0xb3, 0xac, 0x5a};
+        const unsigned char eth0Mac[] = {0x00, 0x15, 0x5d, 0x26, 0xcf, 0x89};
+
+        NetlinkMessages dump;
+        dump.Link(RTM_NEWLINK, 3, "docker0", docker0Mac, IF_OPER_UP, IFF_UP | IFF_LOWER_UP);
+        dump.Link(RTM_NEWLINK, 2, "eth0", eth0Mac, IF_OPER_UP, IFF_UP | IFF_LOWER_UP);
+        dump.Address(RTM_NEWADDR, 2, AF_INET6, "fe80::5e42:4bf7:dddd:9b0f", 64, IFA_F_PERMANENT);
+        dump.Address(RTM_NEWADDR, 2, AF_INET, "10.1.1.2", 16, IFA_F_PERMANENT);
+        dump.Route(RTM_NEWROUTE, 2, 0, "10.1.0.1");
+        dump.Done();
+
+        NetlinkSnapshot snapshot;
+        EXPECT_TRUE(snapshot.Apply(dump.buffer.data(), dump.buffer.size()));
+        unsigned long long generation = snapshot.GetLinkGeneration();
+
+        const NetlinkInterface& eth0 = snapshot.GetInterfaces().at(2);
+        ASSERT_EQ(2, (int)eth0.addresses.size());
+        EXPECT_STREQ("10.1.1.2", eth0.addresses[0].address.c_str());
+        EXPECT_STREQ("fe80::5e42:4bf7:dddd:9b0f", eth0.addresses[1].address.c_str());
+        EXPECT_FALSE(eth0.addresses[0].dynamic);
+
+        // A lease replacing the address, the carrier going down and the gateway going away
+        NetlinkMessages changes;
+        changes.Address(RTM_DELADDR, 2, AF_INET, "10.1.1.2", 16, IFA_F_PERMANENT);
+        changes.Address(RTM_NEWADDR, 2, AF_INET, "10.1.1.3", 16, 0);
+        changes.Link(RTM_NEWLINK, 2, "eth0", eth0Mac, IF_OPER_DOWN, IFF_UP);
+        changes.Route(RTM_DELROUTE, 2, 0, "10.1.0.1");
+        EXPECT_FALSE(snapshot.Apply(changes.buffer.data(), changes.buffer.size()));
+
+        ASSERT_EQ(2, (int)eth0.addresses.size());
+        EXPECT_STREQ("10.1.1.3", eth0.addresses[0].address.c_str());
+        EXPECT_TRUE(eth0.addresses[0].dynamic);
+        EXPECT_EQ(IF_OPER_DOWN, (int)eth0.operationalState);
+        EXPECT_FALSE(eth0.lowerUp);
+        EXPECT_TRUE(eth0.defaultGateways.empty());
+        EXPECT_EQ(generation, snapshot.GetLinkGeneration());
+
+        // A bridge port leaving its bridge is not the link going away, a rename and a removal are link changes
+        NetlinkMessages links;
+        links.Link(RTM_DELLINK, 2, "eth0", eth0Mac, IF_OPER_DOWN, IFF_UP, AF_BRIDGE);
+        EXPECT_FALSE(snapshot.Apply(links.buffer.data(), links.buffer.size()));
+        EXPECT_EQ(2, (int)snapshot.GetInterfaces().size());
+        EXPECT_EQ(generation, snapshot.GetLinkGeneration());
+
+        links.buffer.clear();
+        links.Link(RTM_NEWLINK, 2, "lan0", eth0Mac, IF_OPER_DOWN, IFF_UP);
+        links.Link(RTM_DELLINK, 3, "docker0", docker0Mac, IF_OPER_DOWN, 0);
+        EXPECT_FALSE(snapshot.Apply(links.buffer.data(), links.buffer.size()));
+        ASSERT_EQ(1, (int)snapshot.GetInterfaces().size());
+        EXPECT_STREQ("lan0", snapshot.GetInterfaces().at(2).name.c_str());
+        EXPECT_NE(generation, snapshot.GetLinkGeneration());
+    }
+
     TEST(NetworkingTests, MmiGetInfo)
     {
         MMI_JSON_STRING payload = nullptr;
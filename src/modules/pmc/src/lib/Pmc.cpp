@@ -11,7 +11,6 @@ static const std::string g_requiredTools[] = {"apt-get", "apt-cache", "dpkg-quer
 
 constexpr const char* g_commandCheckToolPresence = "command -v $value";
 constexpr const char* g_commandGetInstalledPackages = "dpkg-query --showformat='${Package} (=${Version})\n' --show";
-constexpr const char* g_commandGetSourcesContent = "find $value -type f -name '*.list' -exec cat {} \\;";
 
 Pmc::Pmc(unsigned int maxPayloadSizeBytes)
     : PmcBase(maxPayloadSizeBytes)
@@ -51,8 +50,7 @@ std::string Pmc::GetSourcesFingerprint(const char* sourcesDirectory)
     char* hash = nullptr;
     if (FileExists(sourcesDirectory))
     {
-        std::string command = std::regex_replace(g_commandGetSourcesContent, std::regex("\\$value"), sourcesDirectory);
-        hash = HashCommand(command.c_str(), PmcLog::Get());
+        hash = HashDirectory(sourcesDirectory, ".list", PmcLog::Get());
     }
     else if (IsFullLoggingEnabled())
     {
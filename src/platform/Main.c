@@ -3,6 +3,7 @@
 
 #include <PlatformCommon.h>
 #include <MpiServer.h>
+#include <MpiMetrics.h>
 
 // 100 milliseconds
 #define DOWORK_SLEEP 100
@@ -23,12 +24,15 @@
 
 #define COMMAND_LOGGING "CommandLogging"
 #define FULL_LOGGING "FullLogging"
+#define ASYNC_LOGGING "AsyncLogging"
+#define SAVE_METRICS "SaveMetrics"
 
 static unsigned int g_lastTime = 0;
+static bool g_saveMetrics = false;
 
 extern OSCONFIG_LOG_HANDLE g_platformLog;
 
-extern char g_mpiCall[MPI_CALL_MESSAGE_LENGTH];
+extern __thread char g_mpiCall[MPI_CALL_MESSAGE_LENGTH];
 
 // All signals on which we want the agent to cleanup before terminating process.
 // SIGKILL is omitted to allow a clean and immediate process kill if needed.
@@ -94,6 +98,9 @@ static void SignalInterrupt(int signal)
 
     if (NULL != errorMessage)
     {
+        // Write out what the asynchronous log still holds ahead of the crash message
+        FlushLog(g_platformLog);
+
         if (0 < (logDescriptor = open(LOG_FILE, O_APPEND | O_WRONLY | O_NONBLOCK)))
         {
             if (0 < (writeResult = write(logDescriptor, (const void*)errorMessage, strlen(errorMessage))))
@@ -160,6 +167,12 @@ static void PlatformDoWork(void)
     if (timeInterval <= (currentTime - g_lastTime))
     {
         MpiDoWork();
+
+        if (g_saveMetrics)
+        {
+            SaveMpiMetrics(MPI_METRICS_FILE);
+        }
+
         g_lastTime = (unsigned int)time(NULL);
     }
 }
@@ -195,6 +208,16 @@ bool IsFullLoggingEnabledInJsonConfig(const char* jsonString)
     return IsLoggingEnabledInJsonConfig(jsonString, FULL_LOGGING);
 }
 
+static bool IsAsyncLoggingEnabledInJsonConfig(const char* jsonString)
+{
+    return IsLoggingEnabledInJsonConfig(jsonString, ASYNC_LOGGING);
+}
+
+static bool IsSaveMetricsEnabledInJsonConfig(const char* jsonString)
+{
+    return IsLoggingEnabledInJsonConfig(jsonString, SAVE_METRICS);
+}
+
 int main(int argc, char *argv[])
 {
     UNUSED(argc);
@@ -208,6 +231,8 @@ int main(int argc, char *argv[])
     {
         SetCommandLogging(IsCommandLoggingEnabledInJsonConfig(jsonConfiguration));
         SetFullLogging(IsFullLoggingEnabledInJsonConfig(jsonConfiguration));
+        SetAsyncLogging(IsAsyncLoggingEnabledInJsonConfig(jsonConfiguration));
+        g_saveMetrics = IsSaveMetricsEnabledInJsonConfig(jsonConfiguration);
         FREE_MEMORY(jsonConfiguration);
     }
 
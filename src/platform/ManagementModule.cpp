@@ -5,6 +5,7 @@
 #include <ManagementModule.h>
 #include <ModulesManager.h>
 #include <MpiServer.h>
+#include <MpiMetrics.h>
 
 static const std::string g_mmiFuncMmiGetInfo = "MmiGetInfo";
 static const std::string g_mmiFuncMmiOpen = "MmiOpen";
@@ -33,18 +34,37 @@ ManagementModule::ManagementModule() : ManagementModule("") {}
 
 ManagementModule::ManagementModule(const std::string path) :
     m_modulePath(path),
-    m_handle(nullptr)
+    m_handle(nullptr),
+    m_mmiGetInfo(nullptr),
+    m_mmiOpen(nullptr),
+    m_mmiClose(nullptr),
+    m_mmiSet(nullptr),
+    m_mmiGet(nullptr),
+    m_mmiFree(nullptr),
+    m_loadCount(0)
 {
     m_info.lifetime = Lifetime::Undefined;
     m_info.userAccount= 0;
 }
 
+ManagementModule::ManagementModule(const std::string path, const Info& info) :
+    ManagementModule(path)
+{
+    m_info = info;
+}
+
 ManagementModule::~ManagementModule()
 {
     Unload();
 }
 
 int ManagementModule::Load()
+{
+    std::lock_guard<std::mutex> lock(m_mmiMutex);
+    return LoadLibrary();
+}
+
+int ManagementModule::LoadLibrary()
 {
     int status = 0;
 
@@ -53,7 +73,7 @@ int ManagementModule::Load()
         return status;
     }
 
-    void* m_handle = dlopen(m_modulePath.c_str(), RTLD_LAZY);
+    m_handle = dlopen(m_modulePath.c_str(), RTLD_LAZY);
     if (nullptr != m_handle)
     {
         const std::vector<std::string> symbols = {g_mmiFuncMmiGetInfo, g_mmiFuncMmiOpen, g_mmiFuncMmiClose, g_mmiFuncMmiSet, g_mmiFuncMmiGet, g_mmiFuncMmiFree};
@@ -77,27 +97,33 @@ int ManagementModule::Load()
             m_mmiGet = reinterpret_cast<Mmi_Get>(dlsym(m_handle, g_mmiFuncMmiGet.c_str()));
             m_mmiFree = reinterpret_cast<Mmi_Free>(dlsym(m_handle, g_mmiFuncMmiFree.c_str()));
 
-            MMI_JSON_STRING payload = nullptr;
-            int payloadSizeBytes = 0;
-
-            if (MMI_OK == CallMmiGetInfo("Azure OsConfig", &payload, &payloadSizeBytes))
+            // The info comes from the module on its first load only, a reload or a module known from the cache just binds the MMI
+            if (m_info.name.empty())
             {
-                rapidjson::Document document;
-                if (document.Parse(payload, payloadSizeBytes).HasParseError())
+                MMI_JSON_STRING payload = nullptr;
+                int payloadSizeBytes = 0;
+
+                if (MMI_OK == CallMmiGetInfo("Azure OsConfig", &payload, &payloadSizeBytes))
                 {
-                    OsConfigLogError(GetPlatformLog(), "Failed to parse info JSON for module '%s'", m_modulePath.c_str());
-                    status = EINVAL;
+                    rapidjson::Document document;
+                    if (document.Parse(payload, payloadSizeBytes).HasParseError())
+                    {
+                        OsConfigLogError(GetPlatformLog(), "Failed to parse info JSON for module '%s'", m_modulePath.c_str());
+                        status = EINVAL;
+                    }
+                    else if (0 != Info::Deserialize(document, m_info))
+                    {
+                        status = EINVAL;
+                    }
+
+                    m_mmiFree(payload);
                 }
-                else if (0 != Info::Deserialize(document, m_info))
+                else
                 {
+                    OsConfigLogError(GetPlatformLog(), "Failed to get info for module '%s'", m_modulePath.c_str());
                     status = EINVAL;
                 }
             }
-            else
-            {
-                OsConfigLogError(GetPlatformLog(), "Failed to get info for module '%s'", m_modulePath.c_str());
-                status = EINVAL;
-            }
         }
     }
     else
@@ -116,28 +142,73 @@ int ManagementModule::Load()
         }
         ss << "]";
 
+        m_lastCallTime = std::chrono::steady_clock::now();
         OsConfigLogInfo(GetPlatformLog(), "Loaded '%s' module (v%s) from '%s', supported components: %s", m_info.name.c_str(), m_info.version.ToString().c_str(), m_modulePath.c_str(), ss.str().c_str());
     }
     else
     {
         OsConfigLogError(GetPlatformLog(), "Failed to load module '%s'", m_modulePath.c_str());
-        if (nullptr != m_handle)
-        {
-            dlclose(m_handle);
-            m_handle = nullptr;
-        }
+        UnloadLibrary();
     }
 
     return status;
 }
 
 void ManagementModule::Unload()
+{
+    // A call that outlived its caller (see MpiSession::GetReportedPayload) must return before the module goes away
+    std::lock_guard<std::mutex> lock(m_mmiMutex);
+    UnloadLibrary();
+}
+
+void ManagementModule::UnloadLibrary()
 {
     if (nullptr != m_handle)
     {
+        // Sessions still open on this library are closed here, their next call opens a new one (see MmiSession::AcquireHandle)
+        for (auto& handle : m_mmiHandles)
+        {
+            CallMmiClose(handle);
+        }
+        m_mmiHandles.clear();
+
         dlclose(m_handle);
         m_handle = nullptr;
+        m_loadCount += 1;
+
+        m_mmiGetInfo = nullptr;
+        m_mmiOpen = nullptr;
+        m_mmiClose = nullptr;
+        m_mmiSet = nullptr;
+        m_mmiGet = nullptr;
+        m_mmiFree = nullptr;
+    }
+}
+
+bool ManagementModule::UnloadIfIdle(std::chrono::seconds idleTimeout)
+{
+    // A module in the middle of a call is not idle
+    std::unique_lock<std::mutex> lock(m_mmiMutex, std::try_to_lock);
+
+    if (lock.owns_lock() && (nullptr != m_handle) && ((m_lastCallTime + idleTimeout) <= std::chrono::steady_clock::now()))
+    {
+        UnloadLibrary();
+        return true;
     }
+
+    return false;
+}
+
+bool ManagementModule::IsLoaded()
+{
+    std::lock_guard<std::mutex> lock(m_mmiMutex);
+    return IsLibraryLoaded();
+}
+
+bool ManagementModule::IsLibraryLoaded() const
+{
+    // Mocks bind the MMI directly without a library
+    return (nullptr != m_handle) || (nullptr != m_mmiOpen);
 }
 
 ManagementModule::Info ManagementModule::GetInfo() const
@@ -145,42 +216,51 @@ ManagementModule::Info ManagementModule::GetInfo() const
     return m_info;
 }
 
+// Calls that are not about a component are recorded under the module, named by its library until MmiGetInfo named it
+const char* ManagementModule::GetMetricsName() const
+{
+    const char* fileName = nullptr;
+    return m_info.name.empty() ? ((nullptr != (fileName = std::strrchr(m_modulePath.c_str(), '/'))) ? fileName + 1 : m_modulePath.c_str()) : m_info.name.c_str();
+}
+
 int ManagementModule::CallMmiGetInfo(const char* clientName, MMI_JSON_STRING* payload, int* payloadSizeBytes)
 {
-    return (nullptr != m_mmiGetInfo) ? m_mmiGetInfo(clientName, payload, payloadSizeBytes) : EINVAL;
+    unsigned long long startTime = GetMpiMetricsTime();
+    int status = (nullptr != m_mmiGetInfo) ? m_mmiGetInfo(clientName, payload, payloadSizeBytes) : EINVAL;
+    RecordMpiMetrics(MPI_METRICS_MODULE, g_mmiFuncMmiGetInfo.c_str(), GetMetricsName(), nullptr, status, startTime);
+    return status;
 }
 
 MMI_HANDLE ManagementModule::CallMmiOpen(const char* clientName, unsigned int maxPayloadSizeBytes)
 {
-    return (nullptr != m_mmiOpen) ? m_mmiOpen(clientName, maxPayloadSizeBytes) : nullptr;
+    unsigned long long startTime = GetMpiMetricsTime();
+    MMI_HANDLE handle = (nullptr != m_mmiOpen) ? m_mmiOpen(clientName, maxPayloadSizeBytes) : nullptr;
+    RecordMpiMetrics(MPI_METRICS_MODULE, g_mmiFuncMmiOpen.c_str(), GetMetricsName(), nullptr, (nullptr != handle) ? MMI_OK : EINVAL, startTime);
+    return handle;
 }
 
 void ManagementModule::CallMmiClose(MMI_HANDLE handle)
 {
+    unsigned long long startTime = GetMpiMetricsTime();
+
     if (nullptr != m_mmiClose)
     {
         m_mmiClose(handle);
+        RecordMpiMetrics(MPI_METRICS_MODULE, g_mmiFuncMmiClose.c_str(), GetMetricsName(), nullptr, MMI_OK, startTime);
     }
 }
 
 int ManagementModule::CallMmiSet(MMI_HANDLE handle, const char* componentName, const char* objectName, const MMI_JSON_STRING payload, const int payloadSizeBytes)
 {
-    int status = MMI_OK;
-
-    if (nullptr != m_mmiSet && IsValidMimObjectPayload(payload, payloadSizeBytes, GetPlatformLog()))
-    {
-        status = m_mmiSet(handle, componentName, objectName, payload, payloadSizeBytes);
-    }
-    else
-    {
-        status = EINVAL;
-    }
-
+    unsigned long long startTime = GetMpiMetricsTime();
+    int status = (nullptr != m_mmiSet) ? m_mmiSet(handle, componentName, objectName, payload, payloadSizeBytes) : EINVAL;
+    RecordMpiMetrics(MPI_METRICS_MODULE, g_mmiFuncMmiSet.c_str(), componentName, objectName, status, startTime);
     return status;
 }
 
 int ManagementModule::CallMmiGet(MMI_HANDLE handle, const char* componentName, const char* objectName, MMI_JSON_STRING *payload, int *payloadSizeBytes)
 {
+    unsigned long long startTime = GetMpiMetricsTime();
     int status = MMI_OK;
 
     if ((nullptr != m_mmiGet) && (MMI_OK == (status = m_mmiGet(handle, componentName, objectName, payload, payloadSizeBytes))))
@@ -189,6 +269,8 @@ int ManagementModule::CallMmiGet(MMI_HANDLE handle, const char* componentName, c
         status = IsValidMimObjectPayload(*payload, *payloadSizeBytes, GetPlatformLog()) ? MMI_OK : EINVAL;
     }
 
+    RecordMpiMetrics(MPI_METRICS_MODULE, g_mmiFuncMmiGet.c_str(), componentName, objectName, status, startTime);
+
     return status;
 }
 
@@ -444,11 +526,55 @@ int ManagementModule::Info::Deserialize(const rapidjson::Value& object, Manageme
     return status;
 }
 
+void ManagementModule::Info::Serialize(rapidjson::Writer<rapidjson::StringBuffer>& writer) const
+{
+    writer.StartObject();
+
+    writer.Key(g_mmiGetInfoName);
+    writer.String(name.c_str());
+    writer.Key(g_mmiGetInfoDescription);
+    writer.String(description.c_str());
+    writer.Key(g_mmiGetInfoManufacturer);
+    writer.String(manufacturer.c_str());
+    writer.Key(g_mmiGetInfoVersionMajor);
+    writer.Uint(version.major);
+    writer.Key(g_mmiGetInfoVersionMinor);
+    writer.Uint(version.minor);
+    writer.Key(g_mmiGetInfoVersionPatch);
+    writer.Uint(version.patch);
+    writer.Key(g_mmiGetInfoVersionTweak);
+    writer.Uint(version.tweak);
+    writer.Key(g_mmiGetInfoVersionInfo);
+    writer.String(versionInfo.c_str());
+
+    writer.Key(g_mmiGetInfoComponents);
+    writer.StartArray();
+    for (auto& component : components)
+    {
+        writer.String(component.c_str());
+    }
+    writer.EndArray();
+
+    writer.Key(g_mmiGetInfoLifetime);
+    writer.Int(static_cast<int>(lifetime));
+    writer.Key(g_mmiGetInfoLicenseUri);
+    writer.String(licenseUri.c_str());
+    writer.Key(g_mmiGetInfoProjectUri);
+    writer.String(projectUri.c_str());
+    writer.Key(g_mmiGetInfoUserAccount);
+    writer.Uint(userAccount);
+
+    writer.EndObject();
+}
+
 MmiSession::MmiSession(std::shared_ptr<ManagementModule> module, const std::string& clientName, unsigned int maxPayloadSizeBytes) :
     m_clientName(clientName),
     m_maxPayloadSizeBytes(maxPayloadSizeBytes),
     m_module(module),
-    m_mmiHandle(nullptr) {}
+    m_mmiHandle(nullptr),
+    m_isOpen(false),
+    m_isHandleOpen(false),
+    m_loadCount(0) {}
 
 MmiSession::~MmiSession()
 {
@@ -461,11 +587,16 @@ int MmiSession::Open()
 
     if (nullptr != m_module)
     {
-        if (nullptr == m_mmiHandle)
+        std::lock_guard<std::mutex> lock(m_module->m_mmiMutex);
+
+        if (!m_isOpen)
         {
-            if (nullptr == (m_mmiHandle = m_module->CallMmiOpen(m_clientName.c_str(), m_maxPayloadSizeBytes)))
+            m_isOpen = true;
+
+            // A module that is not loaded gets its MMI session with the first call, see AcquireHandle
+            if (m_module->IsLibraryLoaded())
             {
-                OsConfigLogError(GetPlatformLog(), "Failed to open MMI session for client '%s'", m_clientName.c_str());
+                OpenHandle();
             }
         }
         else
@@ -493,22 +624,82 @@ void MmiSession::Close()
 {
     if (nullptr != m_module)
     {
-        if (nullptr != m_mmiHandle)
+        std::lock_guard<std::mutex> lock(m_module->m_mmiMutex);
+
+        // A handle from an earlier load of the module was already closed when that load was unloaded
+        if ((nullptr != m_mmiHandle) && m_isHandleOpen && (m_loadCount == m_module->m_loadCount))
         {
             m_module->CallMmiClose(m_mmiHandle);
-            m_mmiHandle = nullptr;
+            m_module->m_mmiHandles.erase(m_mmiHandle);
         }
+
+        m_mmiHandle = nullptr;
+        m_isHandleOpen = false;
+        m_isOpen = false;
     }
 }
 
-int MmiSession::Set(const char* componentName, const char* objectName, const MMI_JSON_STRING payload, const int payloadSizeBytes)
+void MmiSession::OpenHandle()
 {
-    return (nullptr != m_module) ? m_module->CallMmiSet(m_mmiHandle, componentName, objectName, payload, payloadSizeBytes) : EINVAL;
+    m_isHandleOpen = true;
+    m_loadCount = m_module->m_loadCount;
+
+    if (nullptr != (m_mmiHandle = m_module->CallMmiOpen(m_clientName.c_str(), m_maxPayloadSizeBytes)))
+    {
+        m_module->m_mmiHandles.insert(m_mmiHandle);
+    }
+    else
+    {
+        OsConfigLogError(GetPlatformLog(), "Failed to open MMI session for client '%s'", m_clientName.c_str());
+    }
+}
+
+int MmiSession::AcquireHandle()
+{
+    int status = 0;
+
+    if (!m_module->IsLibraryLoaded() && (0 != (status = m_module->LoadLibrary())))
+    {
+        return status;
+    }
+
+    if (!m_isHandleOpen || (m_loadCount != m_module->m_loadCount))
+    {
+        OpenHandle();
+    }
+
+    m_module->m_lastCallTime = std::chrono::steady_clock::now();
+    return status;
+}
+
+int MmiSession::Set(const char* componentName, const char* objectName, const MMI_JSON_STRING payload, const int payloadSizeBytes, bool isValidated)
+{
+    int status = 0;
+
+    if (nullptr == m_module)
+    {
+        return EINVAL;
+    }
+    else if (!isValidated && !IsValidMimObjectPayload(payload, payloadSizeBytes, GetPlatformLog()))
+    {
+        return EINVAL;
+    }
+
+    std::lock_guard<std::mutex> lock(m_module->m_mmiMutex);
+    return (0 == (status = AcquireHandle())) ? m_module->CallMmiSet(m_mmiHandle, componentName, objectName, payload, payloadSizeBytes) : status;
 }
 
 int MmiSession::Get(const char* componentName, const char* objectName, MMI_JSON_STRING *payload, int *payloadSizeBytes)
 {
-    return (nullptr != m_module) ? m_module->CallMmiGet(m_mmiHandle, componentName, objectName, payload, payloadSizeBytes) : EINVAL;
+    int status = 0;
+
+    if (nullptr == m_module)
+    {
+        return EINVAL;
+    }
+
+    std::lock_guard<std::mutex> lock(m_module->m_mmiMutex);
+    return (0 == (status = AcquireHandle())) ? m_module->CallMmiGet(m_mmiHandle, componentName, objectName, payload, payloadSizeBytes) : status;
 }
 
 ManagementModule::Info MmiSession::GetInfo()
@@ -5,6 +5,7 @@
 #include <ManagementModule.h>
 #include <ModulesManager.h>
 #include <MpiServer.h>
+#include <MpiMetrics.h>
 
 static const std::string g_moduleDir = "/usr/lib/osconfig";
 static const std::string g_moduleExtension = ".so";
@@ -13,31 +14,249 @@ static const std::string g_configJson = "/etc/osconfig/osconfig.json";
 static const char g_configReported[] = "Reported";
 static const char g_configComponentName[] = "ComponentName";
 static const char g_configObjectName[] = "ObjectName";
+static const char g_configCacheTtl[] = "CacheTtl";
+static const char g_configModuleIdleTimeout[] = "ModuleIdleTimeout";
 
-#define UUID_LENGTH 36
+static const std::string g_moduleInfoCache = "/etc/osconfig/osconfig_modules.cache";
+static const char g_moduleInfoCacheModules[] = "Modules";
+static const char g_moduleInfoCachePath[] = "Path";
+static const char g_moduleInfoCacheSize[] = "Size";
+static const char g_moduleInfoCacheModifiedTime[] = "ModifiedTime";
+static const char g_moduleInfoCacheInfo[] = "Info";
+
+// Time a short lived module stays loaded after its last call when the configuration does not say otherwise
+static const std::chrono::seconds g_defaultModuleIdleTimeout(300);
+
+// Handle of a session as given to clients: slot index, slot generation and a random token, all hexadecimal
+#define SESSION_HANDLE_FORMAT "%08" PRIx32 "-%08" PRIx32 "-%016" PRIx64
+#define SESSION_HANDLE_LENGTH 34
+
+// Workers reading reported objects from modules, shared by all sessions
+static const size_t g_maxReportedWorkers = 8;
+
+// Time each module has to return its reported objects before the snapshot is sent without them
+static const std::chrono::seconds g_reportedModuleTimeout(30);
+
+static int GetRandomBytes(void* buffer, size_t size)
+{
+    size_t total = 0;
+    ssize_t bytes = 0;
+
+    while (total < size)
+    {
+        if (0 < (bytes = getrandom(static_cast<char*>(buffer) + total, size - total, 0)))
+        {
+            total += bytes;
+        }
+        else if (EINTR != errno)
+        {
+            OsConfigLogError(GetPlatformLog(), "getrandom failed (%d)", errno);
+            return errno;
+        }
+    }
+
+    return 0;
+}
+
+// Table of the open sessions, indexed by the slot of a handle so a lookup is one bounds check and one compare.
+// A slot is reused once its session is closed, with a new generation and token so the handles of closed sessions stay invalid.
+// Lookups only take the lock shared, opening and closing a session take it exclusive.
+class SessionTable
+{
+public:
+    SessionTable()
+    {
+        pthread_rwlock_init(&m_lock, nullptr);
+    }
+
+    ~SessionTable()
+    {
+        pthread_rwlock_destroy(&m_lock);
+    }
+
+    // Returns the handle of the session, allocated with malloc, or null
+    char* Add(std::shared_ptr<MpiSession> session)
+    {
+        char* handle = nullptr;
+        uint64_t token = 0;
+        uint32_t index = 0;
+
+        if ((0 != GetRandomBytes(&token, sizeof(token))) || (nullptr == (handle = static_cast<char*>(malloc(SESSION_HANDLE_LENGTH + 1)))))
+        {
+            return nullptr;
+        }
+
+        pthread_rwlock_wrlock(&m_lock);
+
+        if (!m_freeSlots.empty())
+        {
+            index = m_freeSlots.back();
+            m_freeSlots.pop_back();
+        }
+        else
+        {
+            index = static_cast<uint32_t>(m_slots.size());
+            m_slots.emplace_back();
+        }
+
+        SessionSlot& slot = m_slots[index];
+        slot.session = session;
+        slot.generation += 1;
+        slot.token = token;
+        snprintf(handle, SESSION_HANDLE_LENGTH + 1, SESSION_HANDLE_FORMAT, index, slot.generation, slot.token);
+
+        pthread_rwlock_unlock(&m_lock);
+        return handle;
+    }
+
+    // The returned reference keeps the session alive for the duration of a call even if it is concurrently closed
+    std::shared_ptr<MpiSession> Find(MPI_HANDLE handle)
+    {
+        std::shared_ptr<MpiSession> session;
+        uint32_t index = 0;
+        uint32_t generation = 0;
+        uint64_t token = 0;
+
+        if (ParseHandle(handle, index, generation, token))
+        {
+            pthread_rwlock_rdlock(&m_lock);
+            if ((index < m_slots.size()) && (m_slots[index].generation == generation) && (m_slots[index].token == token))
+            {
+                session = m_slots[index].session;
+            }
+            pthread_rwlock_unlock(&m_lock);
+        }
+
+        return session;
+    }
+
+    std::shared_ptr<MpiSession> Remove(MPI_HANDLE handle)
+    {
+        std::shared_ptr<MpiSession> session;
+        uint32_t index = 0;
+        uint32_t generation = 0;
+        uint64_t token = 0;
+
+        if (ParseHandle(handle, index, generation, token))
+        {
+            pthread_rwlock_wrlock(&m_lock);
+            if ((index < m_slots.size()) && (nullptr != m_slots[index].session) && (m_slots[index].generation == generation) && (m_slots[index].token == token))
+            {
+                session.swap(m_slots[index].session);
+                m_slots[index].token = 0;
+                m_freeSlots.push_back(index);
+            }
+            pthread_rwlock_unlock(&m_lock);
+        }
+
+        return session;
+    }
+
+    std::vector<std::shared_ptr<MpiSession>> RemoveAll()
+    {
+        std::vector<std::shared_ptr<MpiSession>> sessions;
+
+        pthread_rwlock_wrlock(&m_lock);
+        for (uint32_t index = 0; index < m_slots.size(); index++)
+        {
+            if (nullptr != m_slots[index].session)
+            {
+                sessions.push_back(nullptr);
+                sessions.back().swap(m_slots[index].session);
+                m_slots[index].token = 0;
+                m_freeSlots.push_back(index);
+            }
+        }
+        pthread_rwlock_unlock(&m_lock);
+
+        return sessions;
+    }
+
+private:
+    struct SessionSlot
+    {
+        std::shared_ptr<MpiSession> session;
+        uint32_t generation = 0;
+        uint64_t token = 0;
+    };
+
+    pthread_rwlock_t m_lock;
+    std::vector<SessionSlot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+
+    // Accepts exactly SESSION_HANDLE_FORMAT, reading no further than the first character that does not fit it
+    static bool ParseHandle(MPI_HANDLE handle, uint32_t& index, uint32_t& generation, uint64_t& token)
+    {
+        const char* text = reinterpret_cast<const char*>(handle);
+        const int digits[] = {8, 8, 16};
+        uint64_t fields[] = {0, 0, 0};
+        int position = 0;
+
+        if (nullptr == text)
+        {
+            return false;
+        }
+
+        for (int field = 0; field < 3; field++)
+        {
+            if ((0 < field) && ('-' != text[position++]))
+            {
+                return false;
+            }
+
+            for (int digit = 0; digit < digits[field]; digit++, position++)
+            {
+                char c = text[position];
+                int value = ((c >= '0') && (c <= '9')) ? (c - '0') : (((c >= 'a') && (c <= 'f')) ? (c - 'a' + 10) : -1);
+
+                if (0 > value)
+                {
+                    return false;
+                }
+                fields[field] = (fields[field] << 4) | static_cast<uint64_t>(value);
+            }
+        }
+
+        if (0 != text[position])
+        {
+            return false;
+        }
+
+        index = static_cast<uint32_t>(fields[0]);
+        generation = static_cast<uint32_t>(fields[1]);
+        token = fields[2];
+        return true;
+    }
+};
 
 static ModulesManager modulesManager;
-static std::map<std::string, std::shared_ptr<MpiSession>> g_sessions;
+static SessionTable g_sessions;
 
+// Serializes loading and unloading of the modules
+static std::mutex g_modulesMutex;
 static bool g_modulesLoaded = false;
 
 void AreModulesLoadedAndLoadIfNot()
 {
+    std::lock_guard<std::mutex> lock(g_modulesMutex);
+
     if (false == g_modulesLoaded)
     {
-        g_modulesLoaded = (bool)(0 == modulesManager.LoadModules(g_moduleDir, g_configJson));
+        g_modulesLoaded = (bool)(0 == modulesManager.LoadModules(g_moduleDir, g_configJson, g_moduleInfoCache));
     }
 }
 
 void UnloadModules()
 {
-    for (auto& session : g_sessions)
+    std::lock_guard<std::mutex> lock(g_modulesMutex);
+
+    for (auto& session : g_sessions.RemoveAll())
     {
-        session.second->Close();
+        session->Close();
     }
 
-    g_sessions.clear();
     modulesManager.UnloadModules();
+    g_modulesLoaded = false;
 }
 
 void MpiInitialize(void)
@@ -50,7 +269,15 @@ void MpiShutdown(void)
     MpiServerShutdown();
 }
 
-void MpiDoWork() {}
+void MpiDoWork()
+{
+    std::lock_guard<std::mutex> lock(g_modulesMutex);
+
+    if (g_modulesLoaded)
+    {
+        modulesManager.UnloadIdleModules();
+    }
+}
 
 MPI_HANDLE MpiOpen(
     const char* clientName,
@@ -75,9 +302,10 @@ MPI_HANDLE MpiOpen(
         std::shared_ptr<MpiSession> session = std::make_shared<MpiSession>(modulesManager, clientName, maxPayloadSizeBytes);
         if ((nullptr != session) && (0 == session->Open()))
         {
-            char* uuid = session->GetUuid();
-            g_sessions[uuid] = session;
-            handle = reinterpret_cast<MPI_HANDLE>(uuid);
+            if (nullptr == (handle = reinterpret_cast<MPI_HANDLE>(g_sessions.Add(session))))
+            {
+                session->Close();
+            }
         }
         else
         {
@@ -96,12 +324,11 @@ void MpiClose(MPI_HANDLE handle)
 {
     if (nullptr != handle)
     {
-        std::string uuid = reinterpret_cast<const char*>(handle);
+        std::shared_ptr<MpiSession> session = g_sessions.Remove(handle);
 
-        if (g_sessions.find(uuid) != g_sessions.end())
+        if (nullptr != session)
         {
-            g_sessions[uuid]->Close();
-            g_sessions.erase(uuid);
+            session->Close();
         }
     }
     else
@@ -121,11 +348,11 @@ int MpiSet(
 
     if (nullptr != handle)
     {
-        std::string uuid = reinterpret_cast<const char*>(handle);
+        std::shared_ptr<MpiSession> session = g_sessions.Find(handle);
 
-        if (g_sessions.find(uuid) != g_sessions.end())
+        if (nullptr != session)
         {
-            status = g_sessions[uuid]->Set(componentName, objectName, payload, payloadSizeBytes);
+            status = session->Set(componentName, objectName, payload, payloadSizeBytes);
         }
         else
         {
@@ -153,11 +380,11 @@ int MpiGet(
 
     if (nullptr != handle)
     {
-        std::string uuid = reinterpret_cast<const char*>(handle);
+        std::shared_ptr<MpiSession> session = g_sessions.Find(handle);
 
-        if (g_sessions.find(uuid) != g_sessions.end())
+        if (nullptr != session)
         {
-            status = g_sessions[uuid]->Get(componentName, objectName, payload, payloadSizeBytes);
+            status = session->Get(componentName, objectName, payload, payloadSizeBytes);
         }
         else
         {
@@ -183,11 +410,11 @@ int MpiSetDesired(
 
     if (nullptr != handle)
     {
-        std::string uuid = reinterpret_cast<const char*>(handle);
+        std::shared_ptr<MpiSession> session = g_sessions.Find(handle);
 
-        if (g_sessions.find(uuid) != g_sessions.end())
+        if (nullptr != session)
         {
-            status = g_sessions[uuid]->SetDesired(payload, payloadSizeBytes);
+            status = session->SetDesired(payload, payloadSizeBytes);
         }
         else
         {
@@ -213,11 +440,11 @@ int MpiGetReported(
 
     if (nullptr != handle)
     {
-        std::string uuid = reinterpret_cast<const char*>(handle);
+        std::shared_ptr<MpiSession> session = g_sessions.Find(handle);
 
-        if (g_sessions.find(uuid) != g_sessions.end())
+        if (nullptr != session)
         {
-            status = g_sessions[uuid]->GetReported(payload, payloadSizeBytes);
+            status = session->GetReported(payload, payloadSizeBytes);
         }
         else
         {
@@ -239,14 +466,223 @@ void MpiFree(MPI_JSON_STRING payload)
     delete[] payload;
 }
 
-ModulesManager::ModulesManager() {}
+ComponentRoutes::ComponentRoutes() {}
+
+ComponentRoutes::ComponentRoutes(const std::map<std::string, std::shared_ptr<ManagementModule>>& modules, const std::map<std::string, std::string>& moduleComponentName)
+{
+    std::map<std::string, int> moduleIndexes;
+    size_t capacity = 2;
+
+    for (auto& module : modules)
+    {
+        moduleIndexes[module.first] = static_cast<int>(m_modules.size());
+        m_modules.push_back(module.second);
+        m_moduleNames.push_back(module.first);
+    }
+
+    while (capacity < (2 * moduleComponentName.size()))
+    {
+        capacity *= 2;
+    }
+    m_routes.resize(capacity);
+
+    for (auto& component : moduleComponentName)
+    {
+        auto moduleIndex = moduleIndexes.find(component.second);
+        size_t length = 0;
+        size_t hash = Hash(component.first.c_str(), length);
+
+        if (moduleIndex != moduleIndexes.end())
+        {
+            size_t slot = hash & (capacity - 1);
+            while (-1 != m_routes[slot].moduleIndex)
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+
+            m_routes[slot].componentName = component.first;
+            m_routes[slot].hash = hash;
+            m_routes[slot].moduleIndex = moduleIndex->second;
+        }
+    }
+}
+
+size_t ComponentRoutes::Hash(const char* name, size_t& length)
+{
+    // FNV-1a, the length comes out of the same pass
+    size_t hash = static_cast<size_t>(14695981039346656037ULL);
+
+    for (length = 0; 0 != name[length]; length++)
+    {
+        hash = (hash ^ static_cast<unsigned char>(name[length])) * static_cast<size_t>(1099511628211ULL);
+    }
+
+    return hash;
+}
+
+int ComponentRoutes::Find(const char* componentName) const
+{
+    size_t length = 0;
+    size_t hash = 0;
+
+    if ((nullptr == componentName) || m_routes.empty())
+    {
+        return -1;
+    }
+
+    hash = Hash(componentName, length);
+    for (size_t slot = hash & (m_routes.size() - 1); -1 != m_routes[slot].moduleIndex; slot = (slot + 1) & (m_routes.size() - 1))
+    {
+        const Route& route = m_routes[slot];
+        if ((route.hash == hash) && (route.componentName.size() == length) && (0 == std::memcmp(route.componentName.data(), componentName, length)))
+        {
+            return route.moduleIndex;
+        }
+    }
+
+    return -1;
+}
+
+size_t ComponentRoutes::GetModuleCount() const
+{
+    return m_modules.size();
+}
+
+const std::shared_ptr<ManagementModule>& ComponentRoutes::GetModule(size_t index) const
+{
+    return m_modules[index];
+}
+
+const std::string& ComponentRoutes::GetModuleName(size_t index) const
+{
+    return m_moduleNames[index];
+}
+
+ModulesManager::ModulesManager() :
+    m_moduleIdleTimeout(g_defaultModuleIdleTimeout),
+    m_componentRoutes(std::make_shared<ComponentRoutes>()),
+    m_reportedCacheHits(0),
+    m_reportedCacheMisses(0) {}
 
 ModulesManager::~ModulesManager()
 {
     UnloadModules();
 }
 
-int ModulesManager::LoadModules(std::string modulePath, std::string configJson)
+// MmiGetInfo result of a module, valid as long as the module file keeps the size and modification time it had when the result was cached
+struct CachedModuleInfo
+{
+    long long size;
+    long long modifiedTime;
+    ManagementModule::Info info;
+};
+
+// A module file found by LoadModules, loaded on its own thread
+struct ModuleCandidate
+{
+    std::shared_ptr<ManagementModule> module;
+    struct stat fileStat = {};
+    bool hasStat = false;
+    bool isCached = false;
+    int status = 0;
+};
+
+static std::map<std::string, CachedModuleInfo> ReadModuleInfoCache(const std::string& moduleInfoCache)
+{
+    std::map<std::string, CachedModuleInfo> modules;
+    std::ifstream ifs(moduleInfoCache);
+
+    if (moduleInfoCache.empty() || !ifs.good())
+    {
+        return modules;
+    }
+
+    rapidjson::IStreamWrapper isw(ifs);
+    rapidjson::Document document;
+    if (document.ParseStream(isw).HasParseError() || !document.IsObject() || !document.HasMember(g_moduleInfoCacheModules) || !document[g_moduleInfoCacheModules].IsArray())
+    {
+        OsConfigLogError(GetPlatformLog(), "Ignoring invalid module info cache: %s", moduleInfoCache.c_str());
+        return modules;
+    }
+
+    for (auto& module : document[g_moduleInfoCacheModules].GetArray())
+    {
+        CachedModuleInfo cached;
+
+        if (module.IsObject() && module.HasMember(g_moduleInfoCachePath) && module[g_moduleInfoCachePath].IsString() &&
+            module.HasMember(g_moduleInfoCacheSize) && module[g_moduleInfoCacheSize].IsInt64() &&
+            module.HasMember(g_moduleInfoCacheModifiedTime) && module[g_moduleInfoCacheModifiedTime].IsInt64() &&
+            module.HasMember(g_moduleInfoCacheInfo) && (0 == ManagementModule::Info::Deserialize(module[g_moduleInfoCacheInfo], cached.info)))
+        {
+            cached.size = module[g_moduleInfoCacheSize].GetInt64();
+            cached.modifiedTime = module[g_moduleInfoCacheModifiedTime].GetInt64();
+            modules[module[g_moduleInfoCachePath].GetString()] = cached;
+        }
+    }
+
+    return modules;
+}
+
+static void WriteModuleInfoCache(const std::string& moduleInfoCache, const std::map<std::string, CachedModuleInfo>& modules)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+    writer.StartObject();
+    writer.Key(g_moduleInfoCacheModules);
+    writer.StartArray();
+    for (auto& module : modules)
+    {
+        writer.StartObject();
+        writer.Key(g_moduleInfoCachePath);
+        writer.String(module.first.c_str());
+        writer.Key(g_moduleInfoCacheSize);
+        writer.Int64(module.second.size);
+        writer.Key(g_moduleInfoCacheModifiedTime);
+        writer.Int64(module.second.modifiedTime);
+        writer.Key(g_moduleInfoCacheInfo);
+        module.second.info.Serialize(writer);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    // Renamed over the cache once complete so a reader never sees a partial file
+    std::string tempPath = moduleInfoCache + ".tmp";
+    std::ofstream ofs(tempPath, std::ios::trunc);
+    ofs.write(buffer.GetString(), buffer.GetSize());
+    ofs.close();
+
+    if (!ofs.good() || (0 != rename(tempPath.c_str(), moduleInfoCache.c_str())))
+    {
+        OsConfigLogError(GetPlatformLog(), "Unable to write module info cache: %s", moduleInfoCache.c_str());
+        remove(tempPath.c_str());
+    }
+}
+
+static std::chrono::seconds ReadModuleIdleTimeout(const std::string& configJson)
+{
+    std::chrono::seconds idleTimeout = g_defaultModuleIdleTimeout;
+    std::ifstream ifs(configJson);
+    rapidjson::IStreamWrapper isw(ifs);
+    rapidjson::Document document;
+
+    if (ifs.good() && !document.ParseStream(isw).HasParseError() && document.IsObject() && document.HasMember(g_configModuleIdleTimeout))
+    {
+        if (document[g_configModuleIdleTimeout].IsUint())
+        {
+            idleTimeout = std::chrono::seconds(document[g_configModuleIdleTimeout].GetUint());
+        }
+        else
+        {
+            OsConfigLogError(GetPlatformLog(), "'%s' is not a positive integer, using %d seconds", g_configModuleIdleTimeout, static_cast<int>(g_defaultModuleIdleTimeout.count()));
+        }
+    }
+
+    return idleTimeout;
+}
+
+int ModulesManager::LoadModules(std::string modulePath, std::string configJson, std::string moduleInfoCache)
 {
     int status = 0;
 
@@ -271,39 +707,112 @@ int ModulesManager::LoadModules(std::string modulePath, std::string configJson)
 
         sort(fileList.begin(), fileList.end());
 
-        // Build map for module name -> ManagementModule
-        for (auto &filePath : fileList)
+        std::map<std::string, CachedModuleInfo> cachedModules = ReadModuleInfoCache(moduleInfoCache);
+        std::map<std::string, CachedModuleInfo> currentModules;
+        bool isCacheStale = false;
+
+        std::vector<ModuleCandidate> candidates(fileList.size());
+        std::vector<std::future<void>> loads;
+
+        // Modules are loaded concurrently, several of them do expensive work as soon as they are loaded
+        for (size_t i = 0; i < fileList.size(); i++)
         {
-            std::shared_ptr<ManagementModule> mm = std::make_shared<ManagementModule>(filePath);
-            if (0 == mm->Load())
+            ModuleCandidate& candidate = candidates[i];
+            candidate.hasStat = (0 == stat(fileList[i].c_str(), &candidate.fileStat));
+            auto cached = cachedModules.find(fileList[i]);
+
+            if (candidate.hasStat && (cached != cachedModules.end()) && (cached->second.size == candidate.fileStat.st_size) && (cached->second.modifiedTime == candidate.fileStat.st_mtime))
+            {
+                candidate.module = std::make_shared<ManagementModule>(fileList[i], cached->second.info);
+                candidate.isCached = true;
+            }
+            else
             {
-                ManagementModule::Info info = mm->GetInfo();
+                candidate.module = std::make_shared<ManagementModule>(fileList[i]);
+            }
 
-                if (m_modules.find(info.name) != m_modules.end())
+            // A module known from the cache is only loaded when it is going to stay loaded
+            if (!candidate.isCached || (ManagementModule::Lifetime::Short != candidate.module->GetInfo().lifetime))
+            {
+                try
                 {
-                    auto currentInfo = m_modules[info.name]->GetInfo();
+                    loads.push_back(std::async(std::launch::async, [&candidate]() { candidate.status = candidate.module->Load(); }));
+                }
+                catch (const std::system_error& e)
+                {
+                    OsConfigLogError(GetPlatformLog(), "Unable to load '%s' on its own thread (%s)", fileList[i].c_str(), e.what());
+                    candidate.status = candidate.module->Load();
+                }
+            }
+        }
 
-                    // Use the module with the latest version
-                    if (currentInfo.version < info.version)
-                    {
-                        OsConfigLogInfo(GetPlatformLog(), "Found newer version of '%s' module (v%s), loading newer version from '%s'", info.name.c_str(), info.version.ToString().c_str(), filePath.c_str());
-                        m_modules[info.name] = mm;
+        for (auto& load : loads)
+        {
+            load.wait();
+        }
 
-                        RegisterModuleComponents(info.name, info.components, true);
-                    }
-                    else
-                    {
-                        OsConfigLogInfo(GetPlatformLog(), "Newer version of '%s' module already loaded (v%s), skipping '%s'", info.name.c_str(), currentInfo.version.ToString().c_str(), filePath.c_str());
-                    }
+        // Build map for module name -> ManagementModule, in file order so the outcome does not depend on which load finished first
+        for (size_t i = 0; i < fileList.size(); i++)
+        {
+            const std::string& filePath = fileList[i];
+            ModuleCandidate& candidate = candidates[i];
+            std::shared_ptr<ManagementModule> mm = candidate.module;
+
+            if (0 != candidate.status)
+            {
+                continue;
+            }
+
+            isCacheStale = isCacheStale || !candidate.isCached;
+
+            ManagementModule::Info info = mm->GetInfo();
+
+            if (candidate.hasStat)
+            {
+                currentModules[filePath] = {static_cast<long long>(candidate.fileStat.st_size), static_cast<long long>(candidate.fileStat.st_mtime), info};
+            }
+
+            if (m_modules.find(info.name) != m_modules.end())
+            {
+                auto currentInfo = m_modules[info.name]->GetInfo();
+
+                // Use the module with the latest version
+                if (currentInfo.version < info.version)
+                {
+                    OsConfigLogInfo(GetPlatformLog(), "Found newer version of '%s' module (v%s), loading newer version from '%s'", info.name.c_str(), info.version.ToString().c_str(), filePath.c_str());
+                    m_modules[info.name] = mm;
+
+                    RegisterModuleComponents(info.name, info.components, true);
                 }
                 else
                 {
-                    m_modules[info.name] = mm;
-                    RegisterModuleComponents(info.name, info.components);
+                    OsConfigLogInfo(GetPlatformLog(), "Newer version of '%s' module already loaded (v%s), skipping '%s'", info.name.c_str(), currentInfo.version.ToString().c_str(), filePath.c_str());
                 }
             }
+            else
+            {
+                m_modules[info.name] = mm;
+                RegisterModuleComponents(info.name, info.components);
+            }
+        }
+
+        // Short lived modules wait for their first call, the others stay loaded for as long as the platform runs
+        for (auto& module : m_modules)
+        {
+            if (ManagementModule::Lifetime::Short == module.second->GetInfo().lifetime)
+            {
+                module.second->Unload();
+            }
+        }
+
+        BuildComponentRoutes();
+
+        if (!moduleInfoCache.empty() && (isCacheStale || (currentModules.size() != cachedModules.size())))
+        {
+            WriteModuleInfoCache(moduleInfoCache, currentModules);
         }
 
+        m_moduleIdleTimeout = ReadModuleIdleTimeout(configJson);
         status = SetReportedObjects(configJson);
     }
     else
@@ -371,6 +880,19 @@ int ModulesManager::SetReportedObjects(const std::string& configJson)
                         objects.insert({componentName, objectName});
                         m_reportedComponents[componentName].push_back(objectName);
                     }
+
+                    // Optional, seconds a reported value can be served from the cache before the module is asked again
+                    if (reported.HasMember(g_configCacheTtl))
+                    {
+                        if (reported[g_configCacheTtl].IsUint())
+                        {
+                            m_reportedCacheTtl[componentName][objectName] = std::chrono::seconds(reported[g_configCacheTtl].GetUint());
+                        }
+                        else
+                        {
+                            OsConfigLogError(GetPlatformLog(), "'%s' is not a positive integer at index %d, %s.%s is not cached", g_configCacheTtl, index, componentName.c_str(), objectName.c_str());
+                        }
+                    }
                 }
                 else
                 {
@@ -404,6 +926,12 @@ void ModulesManager::RegisterModuleComponents(const std::string& moduleName, con
     }
 }
 
+void ModulesManager::BuildComponentRoutes()
+{
+    std::shared_ptr<const ComponentRoutes> componentRoutes = std::make_shared<ComponentRoutes>(m_modules, m_moduleComponentName);
+    std::atomic_store(&m_componentRoutes, componentRoutes);
+}
+
 void ModulesManager::UnloadModules()
 {
     for (auto& module : m_modules)
@@ -413,88 +941,110 @@ void ModulesManager::UnloadModules()
     }
 
     m_modules.clear();
+    BuildComponentRoutes();
+
+    std::lock_guard<std::mutex> lock(m_reportedCacheMutex);
+    m_reportedCache.clear();
 }
 
-static char* GenerateUuid()
+void ModulesManager::UnloadIdleModules()
 {
-    char* uuid = NULL;
-    static const char uuidTemplate[] = "xxxxxxxx-xxxx-Mxxx-Nxxx-xxxxxxxxxxxx";
-    const char* hex = "0123456789ABCDEF-";
-
-    uuid = (char*)malloc(UUID_LENGTH + 1);
-    if (uuid == NULL)
-    {
-        return NULL;
-    }
-
-    srand(clock());
-
-    for (int i = 0; i < UUID_LENGTH + 1; i++)
+    for (auto& module : m_modules)
     {
-        int random = rand() % 16;
-        char c = ' ';
-
-        switch (uuidTemplate[i])
+        if ((ManagementModule::Lifetime::Short == module.second->GetInfo().lifetime) && module.second->UnloadIfIdle(m_moduleIdleTimeout))
         {
-            case 'x':
-                c = hex[random];
-                break;
-            case '-':
-                c = '-';
-                break;
-            case 'M':
-                c = hex[(random & 0x03) | 0x08];
-                break;
-            case 'N':
-                c = '4';
-                break;
+            OsConfigLogInfo(GetPlatformLog(), "Unloaded '%s' module after %d seconds without a call", module.first.c_str(), static_cast<int>(m_moduleIdleTimeout.count()));
         }
-        uuid[i] = (i < UUID_LENGTH) ? c : 0x00;
     }
+}
 
-    return uuid;
+unsigned long long ModulesManager::GetReportedCacheHits() const
+{
+    return m_reportedCacheHits;
 }
 
-MpiSession::MpiSession(ModulesManager& modulesManager, std::string clientName, unsigned int maxPayloadSizeBytes) :
-    m_modulesManager(modulesManager),
-    m_uuid(GenerateUuid()),
-    m_clientName(clientName),
-    m_maxPayloadSizeBytes(maxPayloadSizeBytes) {}
+unsigned long long ModulesManager::GetReportedCacheMisses() const
+{
+    return m_reportedCacheMisses;
+}
 
-MpiSession::~MpiSession()
+bool ModulesManager::GetCachedObject(const std::string& componentName, const std::string& objectName, unsigned int maxPayloadSizeBytes, std::string& payload, unsigned long long& generation)
 {
-    Close();
+    std::lock_guard<std::mutex> lock(m_reportedCacheMutex);
+    auto component = m_reportedCacheTtl.find(componentName);
+
+    if ((component == m_reportedCacheTtl.end()) || (component->second.find(objectName) == component->second.end()))
+    {
+        return false;
+    }
+
+    auto entry = m_reportedCache.find({componentName, objectName});
+    if ((entry != m_reportedCache.end()) && (entry->second.maxPayloadSizeBytes == maxPayloadSizeBytes) && (std::chrono::steady_clock::now() < entry->second.expiry))
+    {
+        payload = entry->second.payload;
+        m_reportedCacheHits += 1;
+        RecordMpiCacheMetrics(true);
+        return true;
+    }
+
+    generation = m_componentGenerations[componentName];
+    m_reportedCacheMisses += 1;
+    RecordMpiCacheMetrics(false);
+    return false;
 }
 
-char* MpiSession::GetUuid()
+void ModulesManager::CacheObject(const std::string& componentName, const std::string& objectName, unsigned int maxPayloadSizeBytes, const std::string& payload, unsigned long long generation)
 {
-    char* uuid = new (std::nothrow) char[m_uuid.size() + 1];
+    std::lock_guard<std::mutex> lock(m_reportedCacheMutex);
+    auto component = m_reportedCacheTtl.find(componentName);
 
-    if (uuid != NULL)
+    if ((component != m_reportedCacheTtl.end()) && (component->second.find(objectName) != component->second.end()) && (generation == m_componentGenerations[componentName]))
     {
-        std::copy(m_uuid.begin(), m_uuid.end(), uuid);
-        uuid[m_uuid.size()] = '\0';
+        m_reportedCache[{componentName, objectName}] = {payload, maxPayloadSizeBytes, std::chrono::steady_clock::now() + component->second[objectName]};
     }
+}
+
+void ModulesManager::InvalidateCachedObjects(const std::string& componentName)
+{
+    std::lock_guard<std::mutex> lock(m_reportedCacheMutex);
 
-    return uuid;
+    m_componentGenerations[componentName] += 1;
+    for (auto entry = m_reportedCache.begin(); entry != m_reportedCache.end();)
+    {
+        entry = (entry->first.first == componentName) ? m_reportedCache.erase(entry) : std::next(entry);
+    }
+}
+
+MpiSession::MpiSession(ModulesManager& modulesManager, std::string clientName, unsigned int maxPayloadSizeBytes) :
+    m_modulesManager(modulesManager),
+    m_clientName(clientName),
+    m_maxPayloadSizeBytes(maxPayloadSizeBytes) {}
+
+MpiSession::~MpiSession()
+{
+    Close();
 }
 
 int MpiSession::Open()
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
     int status = 0;
 
-    for (auto& module : m_modulesManager.m_modules)
+    m_componentRoutes = std::atomic_load(&m_modulesManager.m_componentRoutes);
+    m_mmiSessions.assign(m_componentRoutes->GetModuleCount(), nullptr);
+
+    for (size_t i = 0; i < m_componentRoutes->GetModuleCount(); i++)
     {
         int mmiStatus = 0;
-        std::shared_ptr<MmiSession> mmiSession = std::make_shared<MmiSession>(module.second, m_clientName, m_maxPayloadSizeBytes);
+        std::shared_ptr<MmiSession> mmiSession = std::make_shared<MmiSession>(m_componentRoutes->GetModule(i), m_clientName, m_maxPayloadSizeBytes);
 
         if (0 == (mmiStatus = mmiSession->Open()))
         {
-            m_mmiSessions[module.first] = mmiSession;
+            m_mmiSessions[i] = mmiSession;
         }
         else
         {
-            OsConfigLogError(GetPlatformLog(), "Unable to open MMI session for module '%s'", module.first.c_str());
+            OsConfigLogError(GetPlatformLog(), "Unable to open MMI session for module '%s'", m_componentRoutes->GetModuleName(i).c_str());
             status = EINVAL;
         }
     }
@@ -504,34 +1054,32 @@ int MpiSession::Open()
 
 void MpiSession::Close()
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
     for (auto& mmiSession : m_mmiSessions)
     {
-        mmiSession.second->Close();
-        mmiSession.second.reset();
+        if (nullptr != mmiSession)
+        {
+            mmiSession->Close();
+            mmiSession.reset();
+        }
     }
 
     m_mmiSessions.clear();
 }
 
-std::shared_ptr<MmiSession> MpiSession::GetSession(const std::string& componentName)
+std::shared_ptr<MmiSession> MpiSession::GetSession(const char* componentName)
 {
     std::shared_ptr<MmiSession> mmiSession;
+    int moduleIndex = (nullptr != m_componentRoutes) ? m_componentRoutes->Find(componentName) : -1;
 
-    if (m_modulesManager.m_moduleComponentName.find(componentName) != m_modulesManager.m_moduleComponentName.end())
+    if (0 > moduleIndex)
     {
-        std::string moduleName = m_modulesManager.m_moduleComponentName[componentName];
-        if (m_mmiSessions.find(moduleName) != m_mmiSessions.end())
-        {
-            mmiSession = m_mmiSessions[moduleName];
-        }
-        else
-        {
-            OsConfigLogError(GetPlatformLog(), "Unable to find MMI session for component '%s'", componentName.c_str());
-        }
+        OsConfigLogError(GetPlatformLog(), "Unable to find module for component '%s'", componentName);
     }
-    else
+    else if ((static_cast<size_t>(moduleIndex) >= m_mmiSessions.size()) || (nullptr == (mmiSession = m_mmiSessions[moduleIndex])))
     {
-        OsConfigLogError(GetPlatformLog(), "Unable to find module for component '%s'", componentName.c_str());
+        OsConfigLogError(GetPlatformLog(), "Unable to find MMI session for component '%s'", componentName);
     }
 
     return mmiSession;
@@ -539,10 +1087,14 @@ std::shared_ptr<MmiSession> MpiSession::GetSession(const std::string& componentN
 
 int MpiSession::Set(const char* componentName, const char* objectName, const MPI_JSON_STRING payload, const int payloadSizeBytes)
 {
+    unsigned long long startTime = GetMpiMetricsTime();
+    std::lock_guard<std::mutex> lock(m_mutex);
     int status = MPI_OK;
 
     ScopeGuard sg{[&]()
     {
+        RecordMpiMetrics(MPI_METRICS_SESSION, "MpiSet", componentName, objectName, status, startTime);
+
         if (MPI_OK == status)
         {
             if (IsFullLoggingEnabled())
@@ -593,6 +1145,7 @@ int MpiSession::Set(const char* componentName, const char* objectName, const MPI
         if (nullptr != (moduleSession = GetSession(componentName)))
         {
             status = moduleSession->Set(componentName, objectName, (MMI_JSON_STRING)payload, payloadSizeBytes);
+            m_modulesManager.InvalidateCachedObjects(componentName);
         }
         else
         {
@@ -606,10 +1159,14 @@ int MpiSession::Set(const char* componentName, const char* objectName, const MPI
 
 int MpiSession::Get(const char* componentName, const char* objectName, MPI_JSON_STRING* payload, int* payloadSizeBytes)
 {
+    unsigned long long startTime = GetMpiMetricsTime();
+    std::lock_guard<std::mutex> lock(m_mutex);
     int status = MPI_OK;
 
     ScopeGuard sg{[&]()
     {
+        RecordMpiMetrics(MPI_METRICS_SESSION, "MpiGet", componentName, objectName, status, startTime);
+
         if ((MMI_OK == status) && (nullptr != *payload) && (nullptr != payloadSizeBytes) && (0 != *payloadSizeBytes))
         {
             if (IsFullLoggingEnabled())
@@ -649,14 +1206,35 @@ int MpiSession::Get(const char* componentName, const char* objectName, MPI_JSON_
     else
     {
         std::shared_ptr<MmiSession> moduleSession;
-        if (nullptr != (moduleSession = GetSession(componentName)))
+        std::string cachedPayload;
+        unsigned long long generation = 0;
+
+        if (nullptr == (moduleSession = GetSession(componentName)))
         {
-            status = moduleSession->Get(componentName, objectName, payload, payloadSizeBytes);
+            OsConfigLogError(GetPlatformLog(), "MpiSet componentName %s not found", componentName);
+            status = EINVAL;
+        }
+        else if (m_modulesManager.GetCachedObject(componentName, objectName, m_maxPayloadSizeBytes, cachedPayload, generation))
+        {
+            *payloadSizeBytes = static_cast<int>(cachedPayload.size());
+            if (nullptr != (*payload = new (std::nothrow) char[cachedPayload.size()]))
+            {
+                std::memcpy(*payload, cachedPayload.data(), cachedPayload.size());
+            }
+            else
+            {
+                OsConfigLogError(GetPlatformLog(), "MpiGet unable to allocate %d bytes", *payloadSizeBytes);
+                *payloadSizeBytes = 0;
+                status = ENOMEM;
+            }
         }
         else
         {
-            OsConfigLogError(GetPlatformLog(), "MpiSet componentName %s not found", componentName);
-            status = EINVAL;
+            status = moduleSession->Get(componentName, objectName, payload, payloadSizeBytes);
+            if ((MMI_OK == status) && (nullptr != *payload) && (0 < *payloadSizeBytes))
+            {
+                m_modulesManager.CacheObject(componentName, objectName, m_maxPayloadSizeBytes, std::string(*payload, *payloadSizeBytes), generation);
+            }
         }
     }
 
@@ -665,10 +1243,14 @@ int MpiSession::Get(const char* componentName, const char* objectName, MPI_JSON_
 
 int MpiSession::SetDesired(const MPI_JSON_STRING payload, int payloadSizeBytes)
 {
+    unsigned long long startTime = GetMpiMetricsTime();
+    std::lock_guard<std::mutex> lock(m_mutex);
     int status = MPI_OK;
 
     ScopeGuard sg{[&]()
     {
+        RecordMpiMetrics(MPI_METRICS_SESSION, "MpiSetDesired", nullptr, nullptr, status, startTime);
+
         if (IsFullLoggingEnabled())
         {
             if (MPI_OK == status)
@@ -687,70 +1269,274 @@ int MpiSession::SetDesired(const MPI_JSON_STRING payload, int payloadSizeBytes)
         OsConfigLogError(GetPlatformLog(), "MpiSetDesired invalid payload: %s", payload);
         status = EINVAL;
     }
-    else if (0 == payloadSizeBytes)
+    else if (0 >= payloadSizeBytes)
     {
         OsConfigLogError(GetPlatformLog(), "MpiSetDesired invalid payloadSizeBytes: %d", payloadSizeBytes);
         status = EINVAL;
     }
     else
     {
-        rapidjson::Document document;
-        document.Parse(payload, payloadSizeBytes);
+        // The only copy of the payload, the objects are handed to the modules as spans of it
+        std::vector<char> buffer(payload, payload + payloadSizeBytes);
+        buffer.push_back(0);
+
+        status = SetDesiredPayload(buffer.data(), payloadSizeBytes);
+    }
+
+    return status;
+}
+
+typedef rapidjson::EncodedInputStream<rapidjson::UTF8<>, rapidjson::MemoryStream> DesiredPayloadStream;
+
+// One object of a desired payload, a span of the payload buffer
+struct DesiredObject
+{
+    std::string objectName;
+    size_t start = 0;
+    size_t end = 0;
+    bool isValid = false;
+};
 
-        if (document.HasParseError())
+struct DesiredComponent
+{
+    std::string componentName;
+    bool isObject = false;
+    std::vector<DesiredObject> objects;
+};
+
+// SAX handler that splits a desired payload into the spans of its objects in one pass, validating each object against the MIM schema on the way.
+// Depth 1 holds the components, depth 2 the objects, anything deeper belongs to an object value and only goes to the validator.
+class DesiredPayloadHandler
+{
+public:
+    DesiredPayloadHandler(const char* buffer, DesiredPayloadStream& stream) : m_buffer(buffer), m_stream(stream), m_validator(GetMimObjectSchema()) {}
+
+    std::vector<DesiredComponent> components;
+
+    bool Null() { return Scalar([](rapidjson::SchemaValidator& validator) { return validator.Null(); }); }
+    bool Bool(bool b) { return Scalar([b](rapidjson::SchemaValidator& validator) { return validator.Bool(b); }); }
+    bool Int(int i) { return Scalar([i](rapidjson::SchemaValidator& validator) { return validator.Int(i); }); }
+    bool Uint(unsigned u) { return Scalar([u](rapidjson::SchemaValidator& validator) { return validator.Uint(u); }); }
+    bool Int64(int64_t i) { return Scalar([i](rapidjson::SchemaValidator& validator) { return validator.Int64(i); }); }
+    bool Uint64(uint64_t u) { return Scalar([u](rapidjson::SchemaValidator& validator) { return validator.Uint64(u); }); }
+    bool Double(double d) { return Scalar([d](rapidjson::SchemaValidator& validator) { return validator.Double(d); }); }
+    bool RawNumber(const char* str, rapidjson::SizeType length, bool copy) { return Scalar([&](rapidjson::SchemaValidator& validator) { return validator.RawNumber(str, length, copy); }); }
+    bool String(const char* str, rapidjson::SizeType length, bool copy) { return Scalar([&](rapidjson::SchemaValidator& validator) { return validator.String(str, length, copy); }); }
+
+    bool StartObject()
+    {
+        return StartContainer(true, [](rapidjson::SchemaValidator& validator) { return validator.StartObject(); });
+    }
+
+    bool EndObject(rapidjson::SizeType memberCount)
+    {
+        return EndContainer([memberCount](rapidjson::SchemaValidator& validator) { return validator.EndObject(memberCount); });
+    }
+
+    bool StartArray()
+    {
+        return StartContainer(false, [](rapidjson::SchemaValidator& validator) { return validator.StartArray(); });
+    }
+
+    bool EndArray(rapidjson::SizeType elementCount)
+    {
+        return EndContainer([elementCount](rapidjson::SchemaValidator& validator) { return validator.EndArray(elementCount); });
+    }
+
+    bool Key(const char* str, rapidjson::SizeType length, bool copy)
+    {
+        if (1 == m_depth)
         {
-            if (IsFullLoggingEnabled())
+            components.emplace_back();
+            components.back().componentName.assign(str, length);
+        }
+        else if ((2 == m_depth) && !m_skipComponent)
+        {
+            components.back().objects.emplace_back();
+            components.back().objects.back().objectName.assign(str, length);
+            m_keyEnd = m_stream.Tell();
+        }
+        else if ((m_depth > 2) && !m_skipComponent)
+        {
+            m_validator.Key(str, length, copy);
+        }
+
+        return true;
+    }
+
+private:
+    const char* m_buffer;
+    DesiredPayloadStream& m_stream;
+    rapidjson::SchemaValidator m_validator;
+    int m_depth = 0;
+    size_t m_keyEnd = 0;
+
+    // Set while inside a component value that is not an object, such a component has no objects to set
+    bool m_skipComponent = false;
+
+    template <typename Forward>
+    bool Scalar(Forward forward)
+    {
+        if (0 == m_depth)
+        {
+            // The root of a desired payload must be an object
+            return false;
+        }
+        else if (1 == m_depth)
+        {
+            components.back().isObject = false;
+        }
+        else if (!m_skipComponent)
+        {
+            if (2 == m_depth)
             {
-                OsConfigLogError(GetPlatformLog(), "MpiSetDesired invalid payload: %.*s", payloadSizeBytes, payload);
+                BeginObjectValue();
             }
 
-            status = EINVAL;
+            forward(m_validator);
+
+            if (2 == m_depth)
+            {
+                EndObjectValue();
+            }
+        }
+
+        return true;
+    }
+
+    template <typename Forward>
+    bool StartContainer(bool isObject, Forward forward)
+    {
+        if (0 == m_depth)
+        {
+            if (!isObject)
+            {
+                return false;
+            }
         }
-        else if (!document.IsObject())
+        else if (1 == m_depth)
         {
-            if (IsFullLoggingEnabled())
+            components.back().isObject = isObject;
+            m_skipComponent = !isObject;
+        }
+        else if (!m_skipComponent)
+        {
+            if (2 == m_depth)
             {
-                OsConfigLogError(GetPlatformLog(), "MpiSetDesired invalid payload: %.*s", payloadSizeBytes, payload);
+                BeginObjectValue();
             }
 
-            status = EINVAL;
+            forward(m_validator);
         }
-        else
+
+        m_depth += 1;
+        return true;
+    }
+
+    template <typename Forward>
+    bool EndContainer(Forward forward)
+    {
+        m_depth -= 1;
+
+        if (1 == m_depth)
+        {
+            m_skipComponent = false;
+        }
+        else if ((m_depth >= 2) && !m_skipComponent)
+        {
+            forward(m_validator);
+
+            if (2 == m_depth)
+            {
+                EndObjectValue();
+            }
+        }
+
+        return true;
+    }
+
+    void BeginObjectValue()
+    {
+        // The value starts after the separator that follows the object name
+        size_t start = m_keyEnd;
+        while ((':' == m_buffer[start]) || (' ' == m_buffer[start]) || ('\t' == m_buffer[start]) || ('\r' == m_buffer[start]) || ('\n' == m_buffer[start]))
         {
-            status = SetDesiredPayload(document);
+            start += 1;
         }
+
+        components.back().objects.back().start = start;
+        m_validator.Reset();
     }
 
-    return status;
-}
+    void EndObjectValue()
+    {
+        components.back().objects.back().end = m_stream.Tell();
+        components.back().objects.back().isValid = m_validator.IsValid();
+    }
+};
 
-int MpiSession::SetDesiredPayload(rapidjson::Document& document)
+int MpiSession::SetDesiredPayload(char* payload, int payloadSizeBytes)
 {
     int status = MPI_OK;
 
-    for (auto& component : document.GetObject())
+    rapidjson::MemoryStream memoryStream(payload, payloadSizeBytes);
+    DesiredPayloadStream stream(memoryStream);
+    DesiredPayloadHandler handler(payload, stream);
+    rapidjson::Reader reader;
+
+    if (reader.Parse(stream, handler).IsError())
+    {
+        if (IsFullLoggingEnabled())
+        {
+            OsConfigLogError(GetPlatformLog(), "MpiSetDesired invalid payload: %.*s", payloadSizeBytes, payload);
+        }
+
+        return EINVAL;
+    }
+
+    // Parsing is over, each object value can be terminated in place: the character after it is a separator of the enclosing object
+    for (auto& component : handler.components)
+    {
+        for (auto& object : component.objects)
+        {
+            payload[object.end] = 0;
+        }
+    }
+
+    for (auto& component : handler.components)
     {
-        if (component.value.IsObject())
+        const std::string& componentName = component.componentName;
+
+        if (component.isObject)
         {
-            std::string componentName = component.name.GetString();
             std::shared_ptr<MmiSession> module;
 
-            if (nullptr != (module = GetSession(componentName)))
+            if (nullptr != (module = GetSession(componentName.c_str())))
             {
-                for (auto& object : component.value.GetObject())
+                for (auto& object : component.objects)
                 {
                     int moduleStatus = MMI_OK;
-                    std::string objectName = object.name.GetString();
+                    const std::string& objectName = object.objectName;
+                    char* objectPayload = payload + object.start;
+                    int objectPayloadSizeBytes = static_cast<int>(object.end - object.start);
 
-                    rapidjson::StringBuffer buffer;
-                    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-                    object.value.Accept(writer);
-
-                    moduleStatus = module->Set(componentName.c_str(), objectName.c_str(), (MMI_JSON_STRING)buffer.GetString(), buffer.GetSize());
+                    if (!object.isValid)
+                    {
+                        moduleStatus = EINVAL;
+                        if (IsFullLoggingEnabled())
+                        {
+                            OsConfigLogError(GetPlatformLog(), "MIM object JSON payload is invalid according to the schema");
+                        }
+                    }
+                    else
+                    {
+                        moduleStatus = module->Set(componentName.c_str(), objectName.c_str(), (MMI_JSON_STRING)objectPayload, objectPayloadSizeBytes, true);
+                        m_modulesManager.InvalidateCachedObjects(componentName);
+                    }
 
                     if ((moduleStatus != MMI_OK) && IsFullLoggingEnabled())
                     {
-                        OsConfigLogError(GetPlatformLog(), "MmiSet(%s, %s, %s, %d) to %s returned %d", componentName.c_str(), objectName.c_str(), buffer.GetString(), static_cast<int>(buffer.GetSize()), module->GetInfo().name.c_str(), moduleStatus);
+                        OsConfigLogError(GetPlatformLog(), "MmiSet(%s, %s, %s, %d) to %s returned %d", componentName.c_str(), objectName.c_str(), objectPayload, objectPayloadSizeBytes, module->GetInfo().name.c_str(), moduleStatus);
                     }
                 }
             }
@@ -778,10 +1564,14 @@ int MpiSession::SetDesiredPayload(rapidjson::Document& document)
 
 int MpiSession::GetReported(MPI_JSON_STRING* payload, int* payloadSizeBytes)
 {
+    unsigned long long startTime = GetMpiMetricsTime();
+    std::lock_guard<std::mutex> lock(m_mutex);
     int status = MPI_OK;
 
     ScopeGuard sg{[&]()
     {
+        RecordMpiMetrics(MPI_METRICS_SESSION, "MpiGetReported", nullptr, nullptr, status, startTime);
+
         if (IsFullLoggingEnabled())
         {
             if (MPI_OK == status)
@@ -815,6 +1605,185 @@ int MpiSession::GetReported(MPI_JSON_STRING* payload, int* payloadSizeBytes)
     return status;
 }
 
+// Reported objects of one module, read by a single worker since calls into a module are serialized anyway
+struct ReportedModuleJob
+{
+    std::shared_ptr<MmiSession> session;
+    std::string moduleName;
+    std::vector<std::pair<std::string, std::string>> objects;
+    std::vector<int> statuses;
+    std::vector<std::string> payloads;
+    std::chrono::steady_clock::time_point deadline;
+    bool started = false;
+    bool done = false;
+    bool abandoned = false;
+    bool skipped = false;
+};
+
+// Where the value of one reported object comes from, the cache or a module job
+struct ReportedObjectSlot
+{
+    std::string objectName;
+    bool cached = false;
+    std::string payload;
+    unsigned long long generation = 0;
+    size_t jobIndex = 0;
+    size_t objectIndex = 0;
+};
+
+// Shared between GetReportedPayload and the workers, a worker past its deadline keeps it alive until the module returns
+struct ReportedSnapshot
+{
+    std::condition_variable changed;
+    std::vector<ReportedModuleJob> jobs;
+    size_t completed = 0;
+};
+
+// Workers reading reported objects for all sessions, started once and never stopped. A worker whose job was abandoned
+// stays in its module until the module returns and that module is not given new jobs meanwhile
+class ReportedWorkers
+{
+public:
+    static ReportedWorkers& Get();
+
+    // Guards the workers and the state of every snapshot, callers of the methods below hold it
+    std::mutex m_mutex;
+
+    void Schedule(std::shared_ptr<ReportedSnapshot> snapshot, size_t jobIndex);
+    void Abandon(ReportedModuleJob& job);
+
+    // All workers are blocked in abandoned jobs, queued jobs would never start
+    bool IsExhausted() const;
+
+private:
+    ReportedWorkers();
+    void Run();
+    void Skip(ReportedSnapshot& snapshot, ReportedModuleJob& job);
+
+    std::condition_variable m_queued;
+    std::queue<std::pair<std::shared_ptr<ReportedSnapshot>, size_t>> m_queue;
+    std::set<std::string> m_abandonedModules;
+    size_t m_workers = 0;
+    size_t m_blocked = 0;
+};
+
+ReportedWorkers& ReportedWorkers::Get()
+{
+    // Never destroyed since workers may still be blocked in a module when the process exits
+    static ReportedWorkers* workers = new ReportedWorkers();
+    return *workers;
+}
+
+ReportedWorkers::ReportedWorkers()
+{
+    for (size_t i = 0; i < g_maxReportedWorkers; i++)
+    {
+        try
+        {
+            std::thread(&ReportedWorkers::Run, this).detach();
+            m_workers += 1;
+        }
+        catch (const std::system_error& e)
+        {
+            OsConfigLogError(GetPlatformLog(), "Unable to start a worker for reported objects (%s)", e.what());
+        }
+    }
+}
+
+void ReportedWorkers::Schedule(std::shared_ptr<ReportedSnapshot> snapshot, size_t jobIndex)
+{
+    ReportedModuleJob& job = snapshot->jobs[jobIndex];
+
+    if (m_abandonedModules.end() != m_abandonedModules.find(job.moduleName))
+    {
+        Skip(*snapshot, job);
+    }
+    else
+    {
+        m_queue.emplace(snapshot, jobIndex);
+        m_queued.notify_one();
+    }
+}
+
+void ReportedWorkers::Abandon(ReportedModuleJob& job)
+{
+    job.abandoned = true;
+    m_abandonedModules.insert(job.moduleName);
+    m_blocked += 1;
+}
+
+bool ReportedWorkers::IsExhausted() const
+{
+    return m_blocked >= m_workers;
+}
+
+void ReportedWorkers::Skip(ReportedSnapshot& snapshot, ReportedModuleJob& job)
+{
+    OsConfigLogError(GetPlatformLog(), "MpiGetReported: module '%s' has not returned from an abandoned request, its reported objects are left out", job.moduleName.c_str());
+
+    job.skipped = true;
+    snapshot.completed += 1;
+    snapshot.changed.notify_all();
+}
+
+void ReportedWorkers::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_queued.wait(lock, [this]() { return !m_queue.empty(); });
+
+        std::shared_ptr<ReportedSnapshot> snapshot = m_queue.front().first;
+        ReportedModuleJob& job = snapshot->jobs[m_queue.front().second];
+        m_queue.pop();
+
+        if (job.skipped)
+        {
+            // Given up by GetReportedPayload while queued
+            continue;
+        }
+        else if (m_abandonedModules.end() != m_abandonedModules.find(job.moduleName))
+        {
+            // Queued before another job of the same module was abandoned
+            Skip(*snapshot, job);
+            continue;
+        }
+
+        job.started = true;
+        job.deadline = std::chrono::steady_clock::now() + g_reportedModuleTimeout;
+        snapshot->changed.notify_all();
+
+        for (size_t i = 0; (i < job.objects.size()) && !job.abandoned; i++)
+        {
+            char* objectPayload = nullptr;
+            int objectPayloadSizeBytes = 0;
+
+            lock.unlock();
+            job.statuses[i] = job.session->Get(job.objects[i].first.c_str(), job.objects[i].second.c_str(), &objectPayload, &objectPayloadSizeBytes);
+            if ((MMI_OK == job.statuses[i]) && (nullptr != objectPayload) && (0 < objectPayloadSizeBytes))
+            {
+                job.payloads[i].assign(objectPayload, objectPayloadSizeBytes);
+            }
+            lock.lock();
+        }
+
+        job.done = true;
+
+        if (job.abandoned)
+        {
+            // The snapshot went out without this module, it can take new jobs again
+            m_abandonedModules.erase(job.moduleName);
+            m_blocked -= 1;
+        }
+        else
+        {
+            snapshot->completed += 1;
+            snapshot->changed.notify_all();
+        }
+    }
+}
+
 int MpiSession::GetReportedPayload(MPI_JSON_STRING* payload, int* payloadSizeBytes)
 {
     int status = MPI_OK;
@@ -822,47 +1791,159 @@ int MpiSession::GetReportedPayload(MPI_JSON_STRING* payload, int* payloadSizeByt
     rapidjson::Document::AllocatorType& allocator = document.GetAllocator();
     document.SetObject();
 
-    for (auto reported : m_modulesManager.m_reportedComponents)
+    std::shared_ptr<ReportedSnapshot> snapshot = std::make_shared<ReportedSnapshot>();
+    std::map<MmiSession*, size_t> moduleJobs;
+    std::vector<std::pair<std::string, std::vector<ReportedObjectSlot>>> components;
+
+    // One job per module for the objects not in the cache, each slot remembers where its value lands so the document keeps the component order
+    for (auto& reported : m_modulesManager.m_reportedComponents)
     {
-        std::string componentName = reported.first;
-        std::vector<std::string> objectNames = reported.second;
-        std::shared_ptr<MmiSession> module = GetSession(componentName);
+        const std::string& componentName = reported.first;
+        const std::vector<std::string>& objectNames = reported.second;
+        std::shared_ptr<MmiSession> module = GetSession(componentName.c_str());
 
         if ((nullptr != module) && !objectNames.empty())
         {
-            rapidjson::Value component(rapidjson::kObjectType);
+            components.emplace_back(componentName, std::vector<ReportedObjectSlot>());
             for (auto& objectName : objectNames)
             {
-                char* objectPayload = nullptr;
-                int objectPayloadSizeBytes = 0;
-                int moduleStatus = MMI_OK;
-
-                moduleStatus = module->Get(componentName.c_str(), objectName.c_str(), &objectPayload, &objectPayloadSizeBytes);
+                ReportedObjectSlot slot;
+                slot.objectName = objectName;
+                slot.cached = m_modulesManager.GetCachedObject(componentName, objectName, m_maxPayloadSizeBytes, slot.payload, slot.generation);
 
-                if ((MMI_OK == moduleStatus) && (nullptr != objectPayload) && (0 < objectPayloadSizeBytes))
+                if (!slot.cached)
                 {
-                    std::string objectPayloadString(objectPayload, objectPayloadSizeBytes);
-                    rapidjson::Document objectDocument;
-                    objectDocument.Parse(objectPayloadString.c_str());
-
-                    if (!objectDocument.HasParseError())
-                    {
-                        rapidjson::Value object(rapidjson::kObjectType);
-                        object.CopyFrom(objectDocument, allocator);
-                        component.AddMember(rapidjson::Value(objectName.c_str(), allocator), object, allocator);
-                    }
-                    else if (IsFullLoggingEnabled())
+                    if (moduleJobs.find(module.get()) == moduleJobs.end())
                     {
-                        OsConfigLogError(GetPlatformLog(), "MmiGet(%s, %s) returned invalid payload: %s", componentName.c_str(), objectName.c_str(), objectPayloadString.c_str());
+                        moduleJobs[module.get()] = snapshot->jobs.size();
+                        snapshot->jobs.emplace_back();
+                        snapshot->jobs.back().session = module;
+                        snapshot->jobs.back().moduleName = module->GetInfo().name;
                     }
+
+                    slot.jobIndex = moduleJobs[module.get()];
+                    slot.objectIndex = snapshot->jobs[slot.jobIndex].objects.size();
+                    snapshot->jobs[slot.jobIndex].objects.emplace_back(componentName, objectName);
+                }
+
+                components.back().second.push_back(slot);
+            }
+        }
+    }
+
+    for (auto& job : snapshot->jobs)
+    {
+        job.statuses.resize(job.objects.size(), MMI_OK);
+        job.payloads.resize(job.objects.size());
+    }
+
+    // Modules run concurrently on the shared workers, the snapshot takes as long as the slowest module
+    ReportedWorkers& workers = ReportedWorkers::Get();
+    std::unique_lock<std::mutex> lock(workers.m_mutex);
+    for (size_t i = 0; i < snapshot->jobs.size(); i++)
+    {
+        workers.Schedule(snapshot, i);
+    }
+
+    while (snapshot->completed < snapshot->jobs.size())
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+        for (auto& job : snapshot->jobs)
+        {
+            if (job.started && !job.done && !job.abandoned)
+            {
+                if (job.deadline <= now)
+                {
+                    OsConfigLogError(GetPlatformLog(), "MpiGetReported: module '%s' did not return its reported objects within %d seconds",
+                        job.moduleName.c_str(), static_cast<int>(g_reportedModuleTimeout.count()));
+
+                    // Leave the worker in the module, it stops at the next object and the remaining jobs go to the other workers
+                    workers.Abandon(job);
+                    snapshot->completed += 1;
+                }
+                else
+                {
+                    deadline = std::min(deadline, job.deadline);
+                }
+            }
+            else if (!job.started && !job.skipped && workers.IsExhausted())
+            {
+                OsConfigLogError(GetPlatformLog(), "MpiGetReported: no worker is left to read the reported objects of module '%s'", job.moduleName.c_str());
+
+                job.skipped = true;
+                snapshot->completed += 1;
+            }
+        }
+
+        if (snapshot->completed >= snapshot->jobs.size())
+        {
+            break;
+        }
+        else if (deadline == std::chrono::steady_clock::time_point::max())
+        {
+            snapshot->changed.wait(lock);
+        }
+        else
+        {
+            snapshot->changed.wait_until(lock, deadline);
+        }
+    }
+
+    // Only workers of abandoned jobs may still write into the snapshot, their results are never read
+    lock.unlock();
+
+    for (auto& component : components)
+    {
+        const std::string& componentName = component.first;
+        rapidjson::Value componentValue(rapidjson::kObjectType);
+
+        for (auto& slot : component.second)
+        {
+            const std::string& objectName = slot.objectName;
+            int moduleStatus = MMI_OK;
+
+            if (!slot.cached)
+            {
+                const ReportedModuleJob& job = snapshot->jobs[slot.jobIndex];
+                if (job.abandoned || job.skipped)
+                {
+                    continue;
+                }
+
+                slot.payload = job.payloads[slot.objectIndex];
+                moduleStatus = job.statuses[slot.objectIndex];
+
+                if ((MMI_OK == moduleStatus) && !slot.payload.empty())
+                {
+                    m_modulesManager.CacheObject(componentName, objectName, m_maxPayloadSizeBytes, slot.payload, slot.generation);
+                }
+            }
+
+            const std::string& objectPayloadString = slot.payload;
+            if ((MMI_OK == moduleStatus) && !objectPayloadString.empty())
+            {
+                rapidjson::Document objectDocument;
+                objectDocument.Parse(objectPayloadString.c_str());
+
+                if (!objectDocument.HasParseError())
+                {
+                    rapidjson::Value object(rapidjson::kObjectType);
+                    object.CopyFrom(objectDocument, allocator);
+                    componentValue.AddMember(rapidjson::Value(objectName.c_str(), allocator), object, allocator);
                 }
                 else if (IsFullLoggingEnabled())
                 {
-                    OsConfigLogError(GetPlatformLog(), "MmiGet(%s, %s) returned %d", componentName.c_str(), objectName.c_str(), moduleStatus);
+                    OsConfigLogError(GetPlatformLog(), "MmiGet(%s, %s) returned invalid payload: %s", componentName.c_str(), objectName.c_str(), objectPayloadString.c_str());
                 }
             }
-            document.AddMember(rapidjson::Value(componentName.c_str(), allocator), component, allocator);
+            else if (IsFullLoggingEnabled())
+            {
+                OsConfigLogError(GetPlatformLog(), "MmiGet(%s, %s) returned %d", componentName.c_str(), objectName.c_str(), moduleStatus);
+            }
         }
+        document.AddMember(rapidjson::Value(componentName.c_str(), allocator), componentValue, allocator);
     }
 
     try
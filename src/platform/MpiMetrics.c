@@ -0,0 +1,320 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <PlatformCommon.h>
+#include <stdatomic.h>
+#include <MpiMetrics.h>
+
+// Distinct calls that can be recorded, a power of two, calls beyond these are counted as dropped
+#define MPI_METRICS_SLOTS 512
+
+#define MPI_METRICS_CALL_LENGTH 32
+#define MPI_METRICS_NAME_LENGTH 64
+
+// Bucket 0 counts calls under 1 microsecond, bucket i calls under 2^i microseconds, the last one everything slower
+#define MPI_METRICS_BUCKETS 28
+
+#define MPI_METRICS_SLOT_EMPTY 0
+#define MPI_METRICS_SLOT_CLAIMED 1
+#define MPI_METRICS_SLOT_READY 2
+
+typedef struct MPI_METRICS_SLOT
+{
+    atomic_int state;
+    unsigned int hash;
+    MPI_METRICS_LAYER layer;
+    char call[MPI_METRICS_CALL_LENGTH];
+    char componentName[MPI_METRICS_NAME_LENGTH];
+    char objectName[MPI_METRICS_NAME_LENGTH];
+
+    atomic_ullong count;
+    atomic_ullong errors;
+    atomic_ullong totalTime;
+    atomic_ullong maxTime;
+    atomic_ullong buckets[MPI_METRICS_BUCKETS];
+} MPI_METRICS_SLOT;
+
+static MPI_METRICS_SLOT g_metrics[MPI_METRICS_SLOTS];
+static atomic_ullong g_droppedMetrics;
+static atomic_ullong g_reportedCacheHits;
+static atomic_ullong g_reportedCacheMisses;
+
+static const char* g_layerNames[] = { "Server", "Session", "Module" };
+
+static const char* g_calls = "Calls";
+static const char* g_dropped = "Dropped";
+static const char* g_reportedCache = "ReportedCache";
+static const char* g_hits = "Hits";
+static const char* g_misses = "Misses";
+static const char* g_layer = "Layer";
+static const char* g_call = "Call";
+static const char* g_componentName = "ComponentName";
+static const char* g_objectName = "ObjectName";
+static const char* g_count = "Count";
+static const char* g_errors = "Errors";
+static const char* g_totalMicroseconds = "TotalMicroseconds";
+static const char* g_maxMicroseconds = "MaxMicroseconds";
+static const char* g_latencyMicroseconds = "LatencyMicroseconds";
+
+unsigned long long GetMpiMetricsTime(void)
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((unsigned long long)now.tv_sec * 1000000ULL) + ((unsigned long long)now.tv_nsec / 1000ULL);
+}
+
+// FNV-1a over the names as they are stored, truncated to their slot fields
+static unsigned int HashName(unsigned int hash, const char* name, size_t maxLength)
+{
+    size_t i = 0;
+
+    for (i = 0; (i < maxLength) && name[i]; i++)
+    {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619U;
+    }
+
+    return (hash ^ 0xFF) * 16777619U;
+}
+
+static bool IsSlotFor(const MPI_METRICS_SLOT* slot, unsigned int hash, MPI_METRICS_LAYER layer, const char* call, const char* componentName, const char* objectName)
+{
+    return (slot->hash == hash) && (slot->layer == layer) &&
+        (0 == strncmp(slot->call, call, MPI_METRICS_CALL_LENGTH - 1)) &&
+        (0 == strncmp(slot->componentName, componentName, MPI_METRICS_NAME_LENGTH - 1)) &&
+        (0 == strncmp(slot->objectName, objectName, MPI_METRICS_NAME_LENGTH - 1));
+}
+
+// Finds the slot of the call or claims an empty one for it, null once the table is full
+static MPI_METRICS_SLOT* FindMetricsSlot(MPI_METRICS_LAYER layer, const char* call, const char* componentName, const char* objectName)
+{
+    MPI_METRICS_SLOT* slot = NULL;
+    unsigned int hash = 2166136261U;
+    unsigned int probe = 0;
+    int state = MPI_METRICS_SLOT_EMPTY;
+
+    hash = (hash ^ (unsigned int)layer) * 16777619U;
+    hash = HashName(hash, call, MPI_METRICS_CALL_LENGTH - 1);
+    hash = HashName(hash, componentName, MPI_METRICS_NAME_LENGTH - 1);
+    hash = HashName(hash, objectName, MPI_METRICS_NAME_LENGTH - 1);
+
+    for (probe = 0; probe < MPI_METRICS_SLOTS; probe++)
+    {
+        slot = &g_metrics[(hash + probe) & (MPI_METRICS_SLOTS - 1)];
+        state = atomic_load_explicit(&slot->state, memory_order_acquire);
+
+        if (MPI_METRICS_SLOT_EMPTY == state)
+        {
+            if (atomic_compare_exchange_strong_explicit(&slot->state, &state, MPI_METRICS_SLOT_CLAIMED, memory_order_acquire, memory_order_acquire))
+            {
+                slot->hash = hash;
+                slot->layer = layer;
+                strncpy(slot->call, call, MPI_METRICS_CALL_LENGTH - 1);
+                strncpy(slot->componentName, componentName, MPI_METRICS_NAME_LENGTH - 1);
+                strncpy(slot->objectName, objectName, MPI_METRICS_NAME_LENGTH - 1);
+                atomic_store_explicit(&slot->state, MPI_METRICS_SLOT_READY, memory_order_release);
+                return slot;
+            }
+        }
+
+        // Another caller is naming this slot, its name is needed to know whether to probe on
+        while (MPI_METRICS_SLOT_CLAIMED == state)
+        {
+            state = atomic_load_explicit(&slot->state, memory_order_acquire);
+        }
+
+        if (IsSlotFor(slot, hash, layer, call, componentName, objectName))
+        {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+void RecordMpiMetrics(MPI_METRICS_LAYER layer, const char* call, const char* componentName, const char* objectName, int status, unsigned long long startTime)
+{
+    MPI_METRICS_SLOT* slot = NULL;
+    unsigned long long elapsed = GetMpiMetricsTime() - startTime;
+    unsigned long long maxTime = 0;
+    int bucket = 0;
+
+    if ((layer > MPI_METRICS_MODULE) || (NULL == call))
+    {
+        return;
+    }
+
+    if (NULL == (slot = FindMetricsSlot(layer, call, componentName ? componentName : "", objectName ? objectName : "")))
+    {
+        atomic_fetch_add_explicit(&g_droppedMetrics, 1, memory_order_relaxed);
+        return;
+    }
+
+    bucket = (0 == elapsed) ? 0 : (64 - __builtin_clzll(elapsed));
+    bucket = (bucket < MPI_METRICS_BUCKETS) ? bucket : (MPI_METRICS_BUCKETS - 1);
+
+    atomic_fetch_add_explicit(&slot->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&slot->totalTime, elapsed, memory_order_relaxed);
+    atomic_fetch_add_explicit(&slot->buckets[bucket], 1, memory_order_relaxed);
+
+    if (0 != status)
+    {
+        atomic_fetch_add_explicit(&slot->errors, 1, memory_order_relaxed);
+    }
+
+    maxTime = atomic_load_explicit(&slot->maxTime, memory_order_relaxed);
+    while ((elapsed > maxTime) && (false == atomic_compare_exchange_weak_explicit(&slot->maxTime, &maxTime, elapsed, memory_order_relaxed, memory_order_relaxed)));
+}
+
+void RecordMpiCacheMetrics(bool hit)
+{
+    atomic_fetch_add_explicit(hit ? &g_reportedCacheHits : &g_reportedCacheMisses, 1, memory_order_relaxed);
+}
+
+static JSON_Value* SerializeMetricsSlot(MPI_METRICS_SLOT* slot)
+{
+    JSON_Value* slotValue = NULL;
+    JSON_Object* slotObject = NULL;
+    JSON_Value* histogramValue = NULL;
+    JSON_Object* histogramObject = NULL;
+    unsigned long long count = 0;
+    char bucketName[32] = {0};
+    int i = 0;
+
+    if ((NULL == (slotValue = json_value_init_object())) || (NULL == (histogramValue = json_value_init_object())))
+    {
+        json_value_free(slotValue);
+        return NULL;
+    }
+
+    slotObject = json_value_get_object(slotValue);
+    histogramObject = json_value_get_object(histogramValue);
+
+    json_object_set_string(slotObject, g_layer, g_layerNames[slot->layer]);
+    json_object_set_string(slotObject, g_call, slot->call);
+    if (0 != slot->componentName[0])
+    {
+        json_object_set_string(slotObject, g_componentName, slot->componentName);
+    }
+    if (0 != slot->objectName[0])
+    {
+        json_object_set_string(slotObject, g_objectName, slot->objectName);
+    }
+    json_object_set_number(slotObject, g_count, (double)atomic_load_explicit(&slot->count, memory_order_relaxed));
+    json_object_set_number(slotObject, g_errors, (double)atomic_load_explicit(&slot->errors, memory_order_relaxed));
+    json_object_set_number(slotObject, g_totalMicroseconds, (double)atomic_load_explicit(&slot->totalTime, memory_order_relaxed));
+    json_object_set_number(slotObject, g_maxMicroseconds, (double)atomic_load_explicit(&slot->maxTime, memory_order_relaxed));
+
+    // Only the buckets that counted calls, named by the latency they are under
+    for (i = 0; i < MPI_METRICS_BUCKETS; i++)
+    {
+        if (0 != (count = atomic_load_explicit(&slot->buckets[i], memory_order_relaxed)))
+        {
+            if (i < (MPI_METRICS_BUCKETS - 1))
+            {
+                snprintf(bucketName, sizeof(bucketName), "<%llu", 1ULL << i);
+            }
+            else
+            {
+                snprintf(bucketName, sizeof(bucketName), ">=%llu", 1ULL << (i - 1));
+            }
+            json_object_set_number(histogramObject, bucketName, (double)count);
+        }
+    }
+
+    json_object_set_value(slotObject, g_latencyMicroseconds, histogramValue);
+
+    return slotValue;
+}
+
+char* GetMpiMetrics(void)
+{
+    JSON_Value* rootValue = NULL;
+    JSON_Object* rootObject = NULL;
+    JSON_Value* callsValue = NULL;
+    JSON_Array* callsArray = NULL;
+    JSON_Value* slotValue = NULL;
+    JSON_Value* cacheValue = NULL;
+    JSON_Object* cacheObject = NULL;
+    char* metrics = NULL;
+    int i = 0;
+
+    if ((NULL == (rootValue = json_value_init_object())) || (NULL == (callsValue = json_value_init_array())) || (NULL == (cacheValue = json_value_init_object())))
+    {
+        OsConfigLogError(GetPlatformLog(), "GetMpiMetrics: failed to allocate memory");
+        json_value_free(callsValue);
+        json_value_free(rootValue);
+        return NULL;
+    }
+
+    rootObject = json_value_get_object(rootValue);
+    callsArray = json_value_get_array(callsValue);
+
+    for (i = 0; i < MPI_METRICS_SLOTS; i++)
+    {
+        if ((MPI_METRICS_SLOT_READY == atomic_load_explicit(&g_metrics[i].state, memory_order_acquire)) && (NULL != (slotValue = SerializeMetricsSlot(&g_metrics[i]))))
+        {
+            json_array_append_value(callsArray, slotValue);
+        }
+    }
+
+    json_object_set_value(rootObject, g_calls, callsValue);
+    json_object_set_number(rootObject, g_dropped, (double)atomic_load_explicit(&g_droppedMetrics, memory_order_relaxed));
+
+    cacheObject = json_value_get_object(cacheValue);
+    json_object_set_number(cacheObject, g_hits, (double)atomic_load_explicit(&g_reportedCacheHits, memory_order_relaxed));
+    json_object_set_number(cacheObject, g_misses, (double)atomic_load_explicit(&g_reportedCacheMisses, memory_order_relaxed));
+    json_object_set_value(rootObject, g_reportedCache, cacheValue);
+
+    if (NULL == (metrics = json_serialize_to_string(rootValue)))
+    {
+        OsConfigLogError(GetPlatformLog(), "GetMpiMetrics: failed to serialize metrics");
+    }
+
+    json_value_free(rootValue);
+
+    return metrics;
+}
+
+// Written to a temporary file renamed over the previous one, readers never see a partial file
+int SaveMpiMetrics(const char* fileName)
+{
+    char* metrics = NULL;
+    char* tempFileName = NULL;
+    size_t tempFileNameLength = 0;
+    int status = 0;
+
+    if (NULL == fileName)
+    {
+        return EINVAL;
+    }
+
+    tempFileNameLength = strlen(fileName) + 5;
+    if ((NULL == (metrics = GetMpiMetrics())) || (NULL == (tempFileName = (char*)malloc(tempFileNameLength))))
+    {
+        status = ENOMEM;
+    }
+    else
+    {
+        snprintf(tempFileName, tempFileNameLength, "%s.tmp", fileName);
+
+        if (false == SavePayloadToFile(tempFileName, metrics, (int)strlen(metrics), GetPlatformLog()))
+        {
+            status = EIO;
+        }
+        else if (0 != rename(tempFileName, fileName))
+        {
+            status = errno ? errno : EIO;
+            remove(tempFileName);
+        }
+
+        if (0 != status)
+        {
+            OsConfigLogError(GetPlatformLog(), "SaveMpiMetrics: failed to save metrics to '%s' (%d)", fileName, status);
+        }
+    }
+
+    FREE_MEMORY(tempFileName);
+    json_free_serialized_string(metrics);
+
+    return status;
+}
@@ -1,16 +1,37 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <PlatformCommon.h>
 #include <MpiServer.h>
-
-// 500 milliseconds
-#define MPI_WORKER_SLEEP 500
+#include <MpiMetrics.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #define MAX_CONTENTLENGTH_LENGTH 16
 #define MAX_REASONSTRING_LENGTH 32
 #define MAX_STATUS_CODE_LENGTH 3
-#define MAX_QUEUED_CONNECTIONS 5
+#define MAX_QUEUED_CONNECTIONS 16
+#define MAX_CONNECTION_LENGTH 16
+#define MAX_OPEN_CONNECTIONS 64
+#define MAX_EPOLL_EVENTS 16
+#define MAX_PIPELINED_REQUESTS 16
+
+// Nesting accepted in a request body, deeper bodies are rejected before the stack is at risk
+#define MAX_JSON_DEPTH 64
+
+// Idle keep-alive connections are closed after 5 minutes, checked every 30 seconds
+#define MPI_CONNECTION_IDLE_TIMEOUT 300
+#define MPI_CONNECTION_IDLE_CHECK 30000
+
+// Seconds a worker waits for the rest of a request that has started to arrive
+#define MPI_REQUEST_READ_TIMEOUT 10
+
+// Number of threads concurrently serving MPI requests
+#define MPI_WORKER_THREADS 4
 
 static const char* g_socketPrefix = "/run/osconfig";
 static const char* g_mpiSocket = "/run/osconfig/mpid.sock";
@@ -21,15 +42,80 @@ static const char* g_clientSession = "ClientSession";
 static const char* g_componentName = "ComponentName";
 static const char* g_objectName = "ObjectName";
 static const char* g_payload = "Payload";
+static const char* g_objects = "Objects";
+static const char* g_status = "Status";
+
+typedef enum MPI_CALL
+{
+    MPI_CALL_UNKNOWN = 0,
+    MPI_CALL_OPEN,
+    MPI_CALL_CLOSE,
+    MPI_CALL_SET,
+    MPI_CALL_GET,
+    MPI_CALL_SET_DESIRED,
+    MPI_CALL_GET_REPORTED,
+    MPI_CALL_GET_MANY,
+    MPI_CALL_SET_MANY,
+    MPI_CALL_GET_METRICS
+} MPI_CALL;
+
+typedef struct MPI_CALL_ROUTE
+{
+    const char* uri;
+    MPI_CALL call;
+} MPI_CALL_ROUTE;
+
+// The most frequent calls first, a request URI is resolved once and the handlers switch on the result
+static const MPI_CALL_ROUTE g_mpiCallRoutes[] = {
+    { MPI_GET_URI, MPI_CALL_GET },
+    { MPI_SET_URI, MPI_CALL_SET },
+    { MPI_GET_MANY_URI, MPI_CALL_GET_MANY },
+    { MPI_SET_MANY_URI, MPI_CALL_SET_MANY },
+    { MPI_GET_REPORTED_URI, MPI_CALL_GET_REPORTED },
+    { MPI_SET_DESIRED_URI, MPI_CALL_SET_DESIRED },
+    { MPI_OPEN_URI, MPI_CALL_OPEN },
+    { MPI_CLOSE_URI, MPI_CALL_CLOSE },
+    { MPI_GET_METRICS_URI, MPI_CALL_GET_METRICS }
+};
 
 static int g_socketfd = -1;
 static struct sockaddr_un g_socketaddr = {0};
 static socklen_t g_socketlen = 0;
 
-static pthread_t g_mpiServerWorker = 0;
-static bool g_serverActive = false;
-
-char g_mpiCall[MPI_CALL_MESSAGE_LENGTH] = {0};
+typedef struct MPI_CONNECTION
+{
+    int socketHandle;
+    bool inUse;
+
+    // Set while the connection is queued or being served, clear while it is idle in the epoll set
+    bool busy;
+    time_t lastActivity;
+
+    // Bytes read ahead of the request being served, the start of the next pipelined request
+    SOCKET_BUFFER buffer;
+} MPI_CONNECTION;
+
+static MPI_CONNECTION g_connections[MAX_OPEN_CONNECTIONS] = {{0}};
+static pthread_mutex_t g_connectionsLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Connections with a pending request, waiting for a worker
+static MPI_CONNECTION* g_readyQueue[MAX_OPEN_CONNECTIONS] = {0};
+static int g_readyHead = 0;
+static int g_readyCount = 0;
+static pthread_mutex_t g_readyLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_readyNotEmpty = PTHREAD_COND_INITIALIZER;
+
+static int g_epollfd = -1;
+static int g_wakeupfd = -1;
+
+static pthread_t g_mpiServerListener = 0;
+static bool g_mpiServerListenerStarted = false;
+static pthread_t g_mpiServerWorkers[MPI_WORKER_THREADS] = {0};
+static int g_mpiServerWorkerCount = 0;
+static volatile bool g_serverActive = false;
+
+// Per thread, so that a crash reports the call that was executing on the crashing thread
+__thread char g_mpiCall[MPI_CALL_MESSAGE_LENGTH] = {0};
 static const char g_mpiCallObjectTemplate[] = " during %s to %s.%s\n";
 static const char g_mpiCallModelTemplate[] = " during %s\n";
 
@@ -155,6 +241,415 @@ static int CallMpiGetReported(MPI_HANDLE handle, MPI_JSON_STRING* payload, int*
     return status;
 }
 
+static MPI_CALL GetMpiCall(const char* uri)
+{
+    size_t i = 0;
+
+    for (i = 0; i < ARRAY_SIZE(g_mpiCallRoutes); i++)
+    {
+        if (0 == strcmp(uri, g_mpiCallRoutes[i].uri))
+        {
+            return g_mpiCallRoutes[i].call;
+        }
+    }
+
+    return MPI_CALL_UNKNOWN;
+}
+
+// Serves MpiGetMany and MpiSetMany: one request carries a list of objects, the response lists each object with its own status
+static HTTP_STATUS HandleMpiManyCall(const char* uri, bool isSet, const char* client, JSON_Object* rootObject, char** response, int* responseSize, MPI_CALLS handlers)
+{
+    JSON_Array* requestArray = NULL;
+    JSON_Object* requestItem = NULL;
+    JSON_Value* responseValue = NULL;
+    JSON_Array* responseArray = NULL;
+    JSON_Value* itemValue = NULL;
+    JSON_Object* responseItem = NULL;
+    JSON_Value* payloadValue = NULL;
+    const char* component = NULL;
+    const char* object = NULL;
+    char* payload = NULL;
+    char* itemPayload = NULL;
+    int itemPayloadSize = 0;
+    int mpiStatus = MPI_OK;
+    size_t count = 0;
+    size_t i = 0;
+    HTTP_STATUS status = HTTP_OK;
+
+    if (NULL == (requestArray = json_object_get_array(rootObject, g_objects)))
+    {
+        OsConfigLogError(GetPlatformLog(), "%s: failed to parse '%s' array from request body", uri, g_objects);
+        return HTTP_BAD_REQUEST;
+    }
+
+    if ((NULL == (responseValue = json_value_init_array())) || (NULL == (responseArray = json_value_get_array(responseValue))))
+    {
+        OsConfigLogError(GetPlatformLog(), "%s: failed to allocate memory for response", uri);
+        json_value_free(responseValue);
+        return HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    count = json_array_get_count(requestArray);
+
+    for (i = 0; (i < count) && (HTTP_OK == status); i++)
+    {
+        payloadValue = NULL;
+        responseItem = NULL;
+
+        if ((NULL == (requestItem = json_array_get_object(requestArray, i))) ||
+            (NULL == (component = json_object_get_string(requestItem, g_componentName))) ||
+            (NULL == (object = json_object_get_string(requestItem, g_objectName))) ||
+            (isSet && (NULL == (payloadValue = json_object_get_value(requestItem, g_payload)))))
+        {
+            OsConfigLogError(GetPlatformLog(), "%s: '%s' item %d is not an object with string '%s' and '%s'%s", uri, g_objects, (int)i, g_componentName, g_objectName, isSet ? " and a payload" : "");
+            status = HTTP_BAD_REQUEST;
+            break;
+        }
+
+        if (isSet)
+        {
+            if (NULL == (payload = json_serialize_to_string(payloadValue)))
+            {
+                mpiStatus = ENOMEM;
+            }
+            else
+            {
+                mpiStatus = handlers.mpiSet((MPI_HANDLE)client, component, object, (MPI_JSON_STRING)payload, strlen(payload));
+                json_free_serialized_string(payload);
+            }
+            payloadValue = NULL;
+        }
+        else if (MPI_OK == (mpiStatus = handlers.mpiGet((MPI_HANDLE)client, component, object, &itemPayload, &itemPayloadSize)))
+        {
+            // MPI payloads are not null terminated
+            if (NULL != (payload = (char*)malloc(itemPayloadSize + 1)))
+            {
+                memcpy(payload, itemPayload, itemPayloadSize);
+                payload[itemPayloadSize] = 0;
+
+                if (NULL == (payloadValue = json_parse_string(payload)))
+                {
+                    OsConfigLogError(GetPlatformLog(), "%s(%s, %s): payload is not valid JSON", uri, component, object);
+                    mpiStatus = EINVAL;
+                }
+            }
+            else
+            {
+                mpiStatus = ENOMEM;
+            }
+
+            FREE_MEMORY(payload);
+        }
+
+        FREE_MEMORY(itemPayload);
+        itemPayloadSize = 0;
+
+        if ((MPI_OK != mpiStatus) && IsFullLoggingEnabled())
+        {
+            OsConfigLogError(GetPlatformLog(), "%s(%s, %s): failed for client '%s', status %d", uri, component, object, client, mpiStatus);
+        }
+
+        if ((NULL == (itemValue = json_value_init_object())) ||
+            (NULL == (responseItem = json_value_get_object(itemValue))) ||
+            (JSONSuccess != json_object_set_string(responseItem, g_componentName, component)) ||
+            (JSONSuccess != json_object_set_string(responseItem, g_objectName, object)) ||
+            (JSONSuccess != json_object_set_number(responseItem, g_status, mpiStatus)) ||
+            ((NULL != payloadValue) && (JSONSuccess != json_object_set_value(responseItem, g_payload, payloadValue))) ||
+            (JSONSuccess != json_array_append_value(responseArray, itemValue)))
+        {
+            OsConfigLogError(GetPlatformLog(), "%s(%s, %s): failed to add object to response", uri, component, object);
+            if ((NULL == responseItem) || (payloadValue != json_object_get_value(responseItem, g_payload)))
+            {
+                json_value_free(payloadValue);
+            }
+            json_value_free(itemValue);
+            status = HTTP_INTERNAL_SERVER_ERROR;
+        }
+    }
+
+    if (HTTP_OK == status)
+    {
+        if (NULL != (*response = json_serialize_to_string(responseValue)))
+        {
+            *responseSize = (int)strlen(*response);
+        }
+        else
+        {
+            OsConfigLogError(GetPlatformLog(), "%s: failed to serialize response", uri);
+            status = HTTP_INTERNAL_SERVER_ERROR;
+        }
+    }
+
+    json_value_free(responseValue);
+
+    return status;
+}
+
+static const char* SkipJsonWhitespace(const char* json)
+{
+    while ((' ' == *json) || ('\t' == *json) || ('\r' == *json) || ('\n' == *json))
+    {
+        json += 1;
+    }
+    return json;
+}
+
+// Returns the first character after the string that starts at json, NULL when the string is not terminated
+static const char* SkipJsonString(const char* json)
+{
+    for (json += 1; (0 != *json) && ('"' != *json); json++)
+    {
+        if (('\\' == *json) && (0 == *(++json)))
+        {
+            return NULL;
+        }
+    }
+
+    return (0 != *json) ? (json + 1) : NULL;
+}
+
+static const char* SkipJsonNumber(const char* json)
+{
+    const char* digits = NULL;
+
+    json += ('-' == *json) ? 1 : 0;
+    for (digits = json; (('0' <= *json) && ('9' >= *json)); json++);
+    if (json == digits)
+    {
+        return NULL;
+    }
+
+    if ('.' == *json)
+    {
+        for (digits = ++json; (('0' <= *json) && ('9' >= *json)); json++);
+        if (json == digits)
+        {
+            return NULL;
+        }
+    }
+
+    if (('e' == *json) || ('E' == *json))
+    {
+        json += 1;
+        json += (('+' == *json) || ('-' == *json)) ? 1 : 0;
+        for (digits = json; (('0' <= *json) && ('9' >= *json)); json++);
+        if (json == digits)
+        {
+            return NULL;
+        }
+    }
+
+    return json;
+}
+
+// Returns the first character after the value that starts at json, NULL when the value is malformed or not terminated.
+// The whole value is checked (balanced objects and arrays, members, separators, literals) but not built, the value
+// itself is parsed by whoever receives it.
+static const char* SkipJsonValue(const char* json, int depth)
+{
+    char closing = 0;
+    bool isObject = false;
+
+    if (depth > MAX_JSON_DEPTH)
+    {
+        return NULL;
+    }
+
+    if ('"' == *json)
+    {
+        return SkipJsonString(json);
+    }
+    else if (0 == strncmp(json, "true", 4))
+    {
+        return json + 4;
+    }
+    else if (0 == strncmp(json, "false", 5))
+    {
+        return json + 5;
+    }
+    else if (0 == strncmp(json, "null", 4))
+    {
+        return json + 4;
+    }
+    else if (('{' != *json) && ('[' != *json))
+    {
+        return SkipJsonNumber(json);
+    }
+
+    isObject = ('{' == *json);
+    closing = isObject ? '}' : ']';
+
+    json = SkipJsonWhitespace(json + 1);
+    if (closing == *json)
+    {
+        return json + 1;
+    }
+
+    while (NULL != json)
+    {
+        if (isObject)
+        {
+            if (('"' != *json) || (NULL == (json = SkipJsonString(json))) || (':' != *(json = SkipJsonWhitespace(json))))
+            {
+                return NULL;
+            }
+            json = SkipJsonWhitespace(json + 1);
+        }
+
+        if (NULL == (json = SkipJsonValue(json, depth + 1)))
+        {
+            return NULL;
+        }
+
+        json = SkipJsonWhitespace(json);
+        if (closing == *json)
+        {
+            return json + 1;
+        }
+        else if (',' != *json)
+        {
+            return NULL;
+        }
+
+        json = SkipJsonWhitespace(json + 1);
+    }
+
+    return NULL;
+}
+
+// Finds the values of the named top level members of a JSON object without building them. Each value is returned
+// as a span of the object text, or NULL when the member is not present. Returns 0 or EINVAL when the object is malformed.
+static int FindJsonMembers(const char* json, int count, const char** names, const char** values, int* valueLengths)
+{
+    const char* name = NULL;
+    const char* value = NULL;
+    int nameLength = 0;
+    int i = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        values[i] = NULL;
+        valueLengths[i] = 0;
+    }
+
+    json = SkipJsonWhitespace(json);
+    if ('{' != *json)
+    {
+        return EINVAL;
+    }
+
+    json = SkipJsonWhitespace(json + 1);
+    while ('}' != *json)
+    {
+        if (('"' != *json) || (NULL == (value = SkipJsonString(json))))
+        {
+            return EINVAL;
+        }
+
+        name = json + 1;
+        nameLength = (int)(value - name) - 1;
+
+        json = SkipJsonWhitespace(value);
+        if (':' != *json)
+        {
+            return EINVAL;
+        }
+
+        value = SkipJsonWhitespace(json + 1);
+        if (NULL == (json = SkipJsonValue(value, 1)))
+        {
+            return EINVAL;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            if ((NULL == values[i]) && ((int)strlen(names[i]) == nameLength) && (0 == strncmp(name, names[i], nameLength)))
+            {
+                values[i] = value;
+                valueLengths[i] = (int)(json - value);
+            }
+        }
+
+        json = SkipJsonWhitespace(json);
+        if (',' == *json)
+        {
+            json = SkipJsonWhitespace(json + 1);
+        }
+        else if ('}' != *json)
+        {
+            return EINVAL;
+        }
+    }
+
+    return (0 == *SkipJsonWhitespace(json + 1)) ? 0 : EINVAL;
+}
+
+// The desired payload is most of an MpiSetDesired request. It is located in the request body and handed over as it came in,
+// instead of being parsed here and serialized again, MpiSetDesired parses it once.
+static HTTP_STATUS HandleMpiSetDesiredCall(const char* uri, const char* requestBody, MPI_CALLS handlers)
+{
+    const char* names[] = {g_clientSession, g_payload};
+    const char* values[] = {NULL, NULL};
+    int valueLengths[] = {0, 0};
+    char* client = NULL;
+    char* payload = NULL;
+    int mpiStatus = MPI_OK;
+    HTTP_STATUS status = HTTP_OK;
+
+    if (0 != FindJsonMembers(requestBody, ARRAY_SIZE(names), names, values, valueLengths))
+    {
+        OsConfigLogError(GetPlatformLog(), "HandleMpiCall(%s): failed to parse request body", uri);
+        status = HTTP_BAD_REQUEST;
+    }
+    else if (NULL == values[0])
+    {
+        OsConfigLogError(GetPlatformLog(), "%s: failed to parse '%s' from request body", uri, g_clientSession);
+        status = HTTP_BAD_REQUEST;
+    }
+    else if (('"' != values[0][0]) || (NULL != memchr(values[0], '\\', valueLengths[0])))
+    {
+        OsConfigLogError(GetPlatformLog(), "%s: '%s' is not a string", uri, g_clientSession);
+        status = HTTP_BAD_REQUEST;
+    }
+    else if (NULL == values[1])
+    {
+        OsConfigLogError(GetPlatformLog(), "%s: failed to parse '%s' from request body", uri, g_payload);
+        status = HTTP_BAD_REQUEST;
+    }
+    else if ((NULL == (client = strndup(values[0] + 1, valueLengths[0] - 2))) || (NULL == (payload = strndup(values[1], valueLengths[1]))))
+    {
+        OsConfigLogError(GetPlatformLog(), "%s: failed to get payload string", uri);
+        status = HTTP_INTERNAL_SERVER_ERROR;
+    }
+    else if (MPI_OK != (mpiStatus = handlers.mpiSetDesired((MPI_HANDLE)client, (MPI_JSON_STRING)payload, valueLengths[1])))
+    {
+        OsConfigLogError(GetPlatformLog(), "%s: failed for client %s, status %d", uri, client, mpiStatus);
+        status = HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    FREE_MEMORY(client);
+    FREE_MEMORY(payload);
+
+    return status;
+}
+
+static HTTP_STATUS HandleMpiGetMetricsCall(const char* uri, char** response, int* responseSize)
+{
+    HTTP_STATUS status = HTTP_OK;
+
+    if (NULL != (*response = GetMpiMetrics()))
+    {
+        *responseSize = (int)strlen(*response);
+    }
+    else
+    {
+        OsConfigLogError(GetPlatformLog(), "%s: failed to get metrics", uri);
+        status = HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    return status;
+}
+
 HTTP_STATUS HandleMpiCall(const char* uri, const char* requestBody, char** response, int* responseSize, MPI_CALLS handlers)
 {
     JSON_Value* rootValue = NULL;
@@ -173,6 +668,8 @@ HTTP_STATUS HandleMpiCall(const char* uri, const char* requestBody, char** respo
     int maxPayloadSizeBytes = 0;
     int estimatedSize = 0;
     const char* responseFormat = "\"%s\"";
+    MPI_CALL call = MPI_CALL_UNKNOWN;
+    unsigned long long startTime = GetMpiMetricsTime();
     HTTP_STATUS status = HTTP_OK;
 
     if (NULL == uri)
@@ -195,6 +692,14 @@ HTTP_STATUS HandleMpiCall(const char* uri, const char* requestBody, char** respo
         OsConfigLogError(GetPlatformLog(), "HandleMpiCall(%s): called with invalid null response size", uri);
         status = HTTP_BAD_REQUEST;
     }
+    else if (MPI_CALL_SET_DESIRED == (call = GetMpiCall(uri)))
+    {
+        status = HandleMpiSetDesiredCall(uri, requestBody, handlers);
+    }
+    else if (MPI_CALL_GET_METRICS == call)
+    {
+        status = HandleMpiGetMetricsCall(uri, response, responseSize);
+    }
     else if (NULL == (rootValue = json_parse_string(requestBody)))
     {
         OsConfigLogError(GetPlatformLog(), "HandleMpiCall(%s): failed to parse request body", uri);
@@ -207,7 +712,7 @@ HTTP_STATUS HandleMpiCall(const char* uri, const char* requestBody, char** respo
     }
     else
     {
-        if (0 == strcmp(uri, MPI_OPEN_URI))
+        if (MPI_CALL_OPEN == call)
         {
             if (NULL == (clientValue = json_object_get_value(rootObject, g_clientName)))
             {
@@ -266,11 +771,7 @@ HTTP_STATUS HandleMpiCall(const char* uri, const char* requestBody, char** respo
                 }
             }
         }
-        else if ((0 == strcmp(uri, MPI_CLOSE_URI)) ||
-            (0 == strcmp(uri, MPI_SET_URI)) ||
-            (0 == strcmp(uri, MPI_GET_URI)) ||
-            (0 == strcmp(uri, MPI_SET_DESIRED_URI)) ||
-            (0 == strcmp(uri, MPI_GET_REPORTED_URI)))
+        else if (MPI_CALL_UNKNOWN != call)
         {
             if (NULL == (clientValue = json_object_get_value(rootObject, g_clientSession)))
             {
@@ -287,12 +788,12 @@ HTTP_STATUS HandleMpiCall(const char* uri, const char* requestBody, char** respo
                 OsConfigLogError(GetPlatformLog(), "%s: failed to get string from '%s'", uri, g_clientSession);
                 status = HTTP_BAD_REQUEST;
             }
-            else if (0 == strcmp(uri, MPI_CLOSE_URI))
+            else if (MPI_CALL_CLOSE == call)
             {
                 handlers.mpiClose((MPI_HANDLE)client);
                 status = HTTP_OK;
             }
-            else if ((0 == strcmp(uri, MPI_SET_URI)) || (0 == strcmp(uri, MPI_GET_URI)))
+            else if ((MPI_CALL_SET == call) || (MPI_CALL_GET == call))
             {
                 if (NULL == (componentValue = json_object_get_value(rootObject, g_componentName)))
                 {
@@ -326,7 +827,7 @@ HTTP_STATUS HandleMpiCall(const char* uri, const char* requestBody, char** respo
                 }
                 else
                 {
-                    if (0 == strcmp(uri, MPI_SET_URI))
+                    if (MPI_CALL_SET == call)
                     {
                         if (NULL == (payloadValue = json_object_get_value(rootObject, g_payload)))
                         {
@@ -360,25 +861,11 @@ HTTP_STATUS HandleMpiCall(const char* uri, const char* requestBody, char** respo
                     }
                 }
             }
-            else if (0 == strcmp(uri, MPI_SET_DESIRED_URI))
+            else if ((MPI_CALL_GET_MANY == call) || (MPI_CALL_SET_MANY == call))
             {
-                if (NULL == (payloadValue = json_object_get_value(rootObject, g_payload)))
-                {
-                    OsConfigLogError(GetPlatformLog(), "%s: failed to parse '%s' from request body", uri, g_payload);
-                    status = HTTP_BAD_REQUEST;
-                }
-                else if (NULL == (payload = json_serialize_to_string(payloadValue)))
-                {
-                    OsConfigLogError(GetPlatformLog(), "%s: failed to get payload string", uri);
-                    status = HTTP_BAD_REQUEST;
-                }
-                else if (MPI_OK != (mpiStatus = handlers.mpiSetDesired((MPI_HANDLE)client, (MPI_JSON_STRING)payload, strlen(payload))))
-                {
-                    OsConfigLogError(GetPlatformLog(), "%s: failed for client %s, status %d", uri, client, mpiStatus);
-                    status = HTTP_INTERNAL_SERVER_ERROR;
-                }
+                status = HandleMpiManyCall(uri, (MPI_CALL_SET_MANY == call), client, rootObject, response, responseSize, handlers);
             }
-            else if (0 == strcmp(uri, MPI_GET_REPORTED_URI))
+            else if (MPI_CALL_GET_REPORTED == call)
             {
                 if (MPI_OK != (mpiStatus = handlers.mpiGetReported((MPI_HANDLE)client, response, responseSize)))
                 {
@@ -394,6 +881,11 @@ HTTP_STATUS HandleMpiCall(const char* uri, const char* requestBody, char** respo
         }
     }
 
+    if ((MPI_CALL_UNKNOWN != call) && (MPI_CALL_GET_METRICS != call))
+    {
+        RecordMpiMetrics(MPI_METRICS_SERVER, uri, component, object, (HTTP_OK == status) ? 0 : (int)status, startTime);
+    }
+
     json_value_free(rootValue);
 
     return status;
@@ -427,13 +919,134 @@ static char* HttpReasonAsString(HTTP_STATUS statusCode)
     return reason;
 }
 
-static void* MpiServerWorker(void* arguments)
+static MPI_CONNECTION* AcquireConnection(int socketHandle)
 {
-    const char* responseFormat = "HTTP/1.1 %d %s\r\nServer: OSConfig\r\nContent-Type: application/json\r\nContent-Length: %d\r\n\r\n%.*s";
+    MPI_CONNECTION* connection = NULL;
+    int i = 0;
 
-    int socketHandle = -1;
-    char* uri = NULL;
-    int contentLength = 0;
+    pthread_mutex_lock(&g_connectionsLock);
+
+    for (i = 0; i < MAX_OPEN_CONNECTIONS; i++)
+    {
+        if (false == g_connections[i].inUse)
+        {
+            connection = &g_connections[i];
+            connection->socketHandle = socketHandle;
+            connection->inUse = true;
+            connection->busy = false;
+            connection->lastActivity = time(NULL);
+            InitializeSocketBuffer(&connection->buffer, socketHandle);
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&g_connectionsLock);
+
+    return connection;
+}
+
+static void ReleaseConnection(MPI_CONNECTION* connection)
+{
+    if (NULL == connection)
+    {
+        return;
+    }
+
+    if (0 != close(connection->socketHandle))
+    {
+        OsConfigLogError(GetPlatformLog(), "Failed to close socket: path %s, handle '%d'", g_mpiSocket, connection->socketHandle);
+    }
+    else if (IsFullLoggingEnabled())
+    {
+        OsConfigLogInfo(GetPlatformLog(), "Closed connection: path %s, handle '%d'", g_mpiSocket, connection->socketHandle);
+    }
+
+    pthread_mutex_lock(&g_connectionsLock);
+    connection->socketHandle = -1;
+    connection->inUse = false;
+    connection->busy = false;
+    pthread_mutex_unlock(&g_connectionsLock);
+}
+
+// Only the listener moves a connection out of the idle state, so the listener can close idle connections safely
+static void CloseIdleConnections(void)
+{
+    MPI_CONNECTION* idle[MAX_OPEN_CONNECTIONS] = {0};
+    int idleCount = 0;
+    time_t now = time(NULL);
+    int i = 0;
+
+    pthread_mutex_lock(&g_connectionsLock);
+    for (i = 0; i < MAX_OPEN_CONNECTIONS; i++)
+    {
+        if (g_connections[i].inUse && (false == g_connections[i].busy) && ((now - g_connections[i].lastActivity) >= MPI_CONNECTION_IDLE_TIMEOUT))
+        {
+            idle[idleCount++] = &g_connections[i];
+        }
+    }
+    pthread_mutex_unlock(&g_connectionsLock);
+
+    for (i = 0; i < idleCount; i++)
+    {
+        if (IsFullLoggingEnabled())
+        {
+            OsConfigLogInfo(GetPlatformLog(), "Closing idle connection handle '%d'", idle[i]->socketHandle);
+        }
+        ReleaseConnection(idle[i]);
+    }
+}
+
+static void EnqueueConnection(MPI_CONNECTION* connection)
+{
+    pthread_mutex_lock(&g_connectionsLock);
+    connection->busy = true;
+    pthread_mutex_unlock(&g_connectionsLock);
+
+    pthread_mutex_lock(&g_readyLock);
+
+    // The ready queue can hold every open connection as a one-shot connection is queued at most once
+    if (g_serverActive && (g_readyCount < MAX_OPEN_CONNECTIONS))
+    {
+        g_readyQueue[(g_readyHead + g_readyCount) % MAX_OPEN_CONNECTIONS] = connection;
+        g_readyCount += 1;
+        pthread_cond_signal(&g_readyNotEmpty);
+        connection = NULL;
+    }
+
+    pthread_mutex_unlock(&g_readyLock);
+
+    ReleaseConnection(connection);
+}
+
+static MPI_CONNECTION* DequeueConnection(void)
+{
+    MPI_CONNECTION* connection = NULL;
+
+    pthread_mutex_lock(&g_readyLock);
+
+    while (g_serverActive && (0 == g_readyCount))
+    {
+        pthread_cond_wait(&g_readyNotEmpty, &g_readyLock);
+    }
+
+    if (g_serverActive)
+    {
+        connection = g_readyQueue[g_readyHead];
+        g_readyHead = (g_readyHead + 1) % MAX_OPEN_CONNECTIONS;
+        g_readyCount -= 1;
+    }
+
+    pthread_mutex_unlock(&g_readyLock);
+
+    return connection;
+}
+
+// Returns true when the connection can serve another request
+static bool HandleRequest(SOCKET_BUFFER* socketBuffer, MPI_CALLS mpiCalls)
+{
+    const char* responseFormat = "HTTP/1.1 %d %s\r\nServer: OSConfig\r\nContent-Type: application/json\r\nConnection: %s\r\nContent-Length: %d\r\n\r\n%.*s";
+
+    HTTP_HEADER header = {0};
     char* requestBody = NULL;
     HTTP_STATUS status = HTTP_OK;
     char* httpReason = NULL;
@@ -443,6 +1056,138 @@ static void* MpiServerWorker(void* arguments)
     int estimatedSize = 0;
     int actualSize = 0;
     ssize_t bytes = 0;
+    int result = 0;
+
+    if (0 != (result = ReadHttpHeaderFromSocketBuffer(socketBuffer, &header, GetPlatformLog())))
+    {
+        // The client closed the connection or stalled, there is no one to answer
+        if ((ECONNRESET == result) || (EAGAIN == result) || (EWOULDBLOCK == result))
+        {
+            return false;
+        }
+
+        OsConfigLogError(GetPlatformLog(), "Failed to read request header %d (%d)", socketBuffer->socketHandle, result);
+        status = HTTP_BAD_REQUEST;
+    }
+    else if (0 < header.contentLength)
+    {
+        if (NULL == (requestBody = (char*)malloc(header.contentLength + 1)))
+        {
+            OsConfigLogError(GetPlatformLog(), "%s: failed to allocate memory for HTTP body, Content-Length %d", header.uri, header.contentLength);
+            status = HTTP_BAD_REQUEST;
+        }
+        else
+        {
+            memset(requestBody, 0, header.contentLength + 1);
+
+            if (header.contentLength != (int)(bytes = ReadHttpBodyFromSocketBuffer(socketBuffer, requestBody, header.contentLength, GetPlatformLog())))
+            {
+                OsConfigLogError(GetPlatformLog(), "%s: failed to read complete HTTP body, Content-Length %d, bytes read %d", header.uri, header.contentLength, (int)bytes);
+                status = HTTP_BAD_REQUEST;
+            }
+        }
+    }
+
+    // After a malformed request the position of the next request on the stream is unknown
+    if (HTTP_BAD_REQUEST == status)
+    {
+        header.keepAlive = false;
+    }
+
+    if (status == HTTP_OK)
+    {
+        if (IsFullLoggingEnabled())
+        {
+            OsConfigLogInfo(GetPlatformLog(), "%s: content-length %d, body, '%s'", header.uri, header.contentLength, requestBody);
+        }
+
+        status = HandleMpiCall(header.uri, requestBody, &responseBody, &responseSize, mpiCalls);
+    }
+
+    httpReason = HttpReasonAsString(status);
+    estimatedSize = strlen(responseFormat) + MAX_STATUS_CODE_LENGTH + strlen(httpReason) + MAX_CONNECTION_LENGTH + MAX_CONTENTLENGTH_LENGTH + responseSize + 1;
+
+    if (NULL != (buffer = (char*)malloc(estimatedSize)))
+    {
+        memset(buffer, 0, estimatedSize);
+
+        snprintf(buffer, estimatedSize, responseFormat, (int)status, httpReason, header.keepAlive ? "keep-alive" : "close", responseSize, responseSize, (responseBody ? responseBody : ""));
+        actualSize = (int)strlen(buffer);
+
+        // MSG_NOSIGNAL: a client that went away must not take the whole platform down with SIGPIPE
+        bytes = send(socketBuffer->socketHandle, buffer, actualSize, MSG_NOSIGNAL);
+
+        if (bytes != actualSize)
+        {
+            OsConfigLogError(GetPlatformLog(), "%s: failed to write complete HTTP response, %d bytes of %d", header.uri, (int)bytes, actualSize);
+            header.keepAlive = false;
+        }
+    }
+    else
+    {
+        OsConfigLogError(GetPlatformLog(), "%s: failed to allocate memory for HTTP response, %d bytes of %d", header.uri, 0, estimatedSize);
+        header.keepAlive = false;
+    }
+
+    FREE_MEMORY(requestBody);
+    FREE_MEMORY(responseBody);
+    FREE_MEMORY(httpReason);
+    FREE_MEMORY(buffer);
+
+    return header.keepAlive;
+}
+
+// Returns 1 when request bytes are already waiting on the connection, 0 when the peer closed it, -1 when there is nothing to read yet
+static int PeekConnection(int socketHandle)
+{
+    char next = 0;
+    ssize_t bytes = recv(socketHandle, &next, sizeof(next), MSG_PEEK | MSG_DONTWAIT);
+    return (0 < bytes) ? 1 : ((0 == bytes) ? 0 : (((EAGAIN == errno) || (EWOULDBLOCK == errno)) ? -1 : 0));
+}
+
+static void HandleConnection(MPI_CONNECTION* connection, MPI_CALLS mpiCalls)
+{
+    struct epoll_event event = {0};
+    bool keepAlive = true;
+    int pipelined = 0;
+
+    // Serve requests pipelined back to back on this connection, bounded so that one client cannot monopolize a worker
+    while (keepAlive && (pipelined < MAX_PIPELINED_REQUESTS) && ((false == IsSocketBufferEmpty(&connection->buffer)) || (1 == PeekConnection(connection->socketHandle))))
+    {
+        keepAlive = HandleRequest(&connection->buffer, mpiCalls);
+        pipelined += 1;
+    }
+
+    // Requests already read into the buffer will not wake up epoll again, go to the back of the ready queue instead
+    if (keepAlive && (false == IsSocketBufferEmpty(&connection->buffer)))
+    {
+        EnqueueConnection(connection);
+        return;
+    }
+    else if (keepAlive && (0 != PeekConnection(connection->socketHandle)))
+    {
+        pthread_mutex_lock(&g_connectionsLock);
+        connection->lastActivity = time(NULL);
+        connection->busy = false;
+        pthread_mutex_unlock(&g_connectionsLock);
+
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        event.data.ptr = connection;
+
+        if (0 == epoll_ctl(g_epollfd, EPOLL_CTL_MOD, connection->socketHandle, &event))
+        {
+            return;
+        }
+
+        OsConfigLogError(GetPlatformLog(), "Failed to rearm connection handle '%d' (%d)", connection->socketHandle, errno);
+    }
+
+    ReleaseConnection(connection);
+}
+
+static void* MpiServerWorker(void* arguments)
+{
+    MPI_CONNECTION* connection = NULL;
 
     MPI_CALLS mpiCalls = {
         CallMpiOpen,
@@ -455,100 +1200,224 @@ static void* MpiServerWorker(void* arguments)
 
     UNUSED(arguments);
 
-    while (g_serverActive)
+    while (NULL != (connection = DequeueConnection()))
     {
-        status = HTTP_OK;
+        HandleConnection(connection, mpiCalls);
+    }
 
-        if (0 <= (socketHandle = accept(g_socketfd, (struct sockaddr*)&g_socketaddr, &g_socketlen)))
-        {
-            AreModulesLoadedAndLoadIfNot();
+    return NULL;
+}
 
-            if (IsFullLoggingEnabled())
-            {
-                OsConfigLogInfo(GetPlatformLog(), "Accepted connection: path %s, handle '%d'", g_socketaddr.sun_path, socketHandle);
-            }
+static void AcceptConnections(void)
+{
+    int socketHandle = -1;
+    MPI_CONNECTION* connection = NULL;
+    struct epoll_event event = {0};
+    struct timeval readTimeout = {MPI_REQUEST_READ_TIMEOUT, 0};
 
-            if (NULL == (uri = ReadUriFromSocket(socketHandle, GetPlatformLog())))
-            {
-                OsConfigLogError(GetPlatformLog(), "Failed to read request URI %d", socketHandle);
-                status = HTTP_BAD_REQUEST;
-            }
+    while (true)
+    {
+        g_socketlen = sizeof(g_socketaddr);
+        if (0 > (socketHandle = accept4(g_socketfd, (struct sockaddr*)&g_socketaddr, &g_socketlen, SOCK_CLOEXEC)))
+        {
+            break;
+        }
 
-            if ((contentLength = ReadHttpContentLengthFromSocket(socketHandle, GetPlatformLog())))
-            {
-                if (NULL == (requestBody = (char*)malloc(contentLength + 1)))
-                {
-                    OsConfigLogError(GetPlatformLog(), "%s: failed to allocate memory for HTTP body, Content-Length %d", uri, contentLength);
-                    status = HTTP_BAD_REQUEST;
-                }
+        AreModulesLoadedAndLoadIfNot();
 
-                memset(requestBody, 0, contentLength + 1);
+        if (NULL == (connection = AcquireConnection(socketHandle)))
+        {
+            OsConfigLogError(GetPlatformLog(), "Too many open connections (%d), refusing handle '%d'", MAX_OPEN_CONNECTIONS, socketHandle);
+            close(socketHandle);
+            continue;
+        }
 
-                if (contentLength != (int)(bytes = read(socketHandle, requestBody, contentLength)))
-                {
-                    OsConfigLogError(GetPlatformLog(), "%s: failed to read complete HTTP body, Content-Length %d, bytes read %d", uri, contentLength, (int)bytes);
-                    status = HTTP_BAD_REQUEST;
-                }
-            }
+        if (IsFullLoggingEnabled())
+        {
+            OsConfigLogInfo(GetPlatformLog(), "Accepted connection: path %s, handle '%d'", g_socketaddr.sun_path, socketHandle);
+        }
 
-            if (status == HTTP_OK)
-            {
-                if (IsFullLoggingEnabled())
-                {
-                    OsConfigLogInfo(GetPlatformLog(), "%s: content-length %d, body, '%s'", uri, contentLength, requestBody);
-                }
+        // A client that stalls in the middle of a request must not hold a worker forever
+        if (0 != setsockopt(socketHandle, SOL_SOCKET, SO_RCVTIMEO, &readTimeout, sizeof(readTimeout)))
+        {
+            OsConfigLogError(GetPlatformLog(), "Failed to set read timeout on connection handle '%d' (%d)", socketHandle, errno);
+        }
 
-                status = HandleMpiCall(uri, requestBody, &responseBody, &responseSize, mpiCalls);
-            }
+        // One-shot: once a request arrives the connection is owned by exactly one worker until it is released
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        event.data.ptr = connection;
 
-            httpReason = HttpReasonAsString(status);
-            estimatedSize = strlen(responseFormat) + MAX_STATUS_CODE_LENGTH + strlen(httpReason) + MAX_CONTENTLENGTH_LENGTH + responseSize + 1;
+        if (0 != epoll_ctl(g_epollfd, EPOLL_CTL_ADD, socketHandle, &event))
+        {
+            OsConfigLogError(GetPlatformLog(), "Failed to watch connection handle '%d' (%d)", socketHandle, errno);
+            ReleaseConnection(connection);
+        }
+    }
 
-            if (NULL != (buffer = (char*)malloc(estimatedSize)))
-            {
-                memset(buffer, 0, estimatedSize);
+    if ((EAGAIN != errno) && (EWOULDBLOCK != errno) && (EINTR != errno))
+    {
+        OsConfigLogError(GetPlatformLog(), "Failed to accept connection on socket '%s' (%d)", g_mpiSocket, errno);
+    }
+}
+
+static void* MpiServerListener(void* arguments)
+{
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int eventCount = 0;
+    time_t lastIdleCheck = time(NULL);
+    int i = 0;
 
-                snprintf(buffer, estimatedSize, responseFormat, (int)status, httpReason, responseSize, responseSize, (responseBody ? responseBody : ""));
-                actualSize = (int)strlen(buffer);
+    UNUSED(arguments);
 
-                bytes = write(socketHandle, buffer, actualSize);
+    while (g_serverActive)
+    {
+        if ((time(NULL) - lastIdleCheck) >= (MPI_CONNECTION_IDLE_CHECK / 1000))
+        {
+            CloseIdleConnections();
+            lastIdleCheck = time(NULL);
+        }
 
-                if (bytes != actualSize)
-                {
-                    OsConfigLogError(GetPlatformLog(), "%s: failed to write complete HTTP response, %d bytes of %d", uri, (int)bytes, actualSize);
-                }
-            }
-            else
+        if (0 > (eventCount = epoll_wait(g_epollfd, events, MAX_EPOLL_EVENTS, MPI_CONNECTION_IDLE_CHECK)))
+        {
+            if (EINTR != errno)
             {
-                OsConfigLogError(GetPlatformLog(), "%s: failed to allocate memory for HTTP response, %d bytes of %d", uri, 0, estimatedSize);
+                OsConfigLogError(GetPlatformLog(), "Failed waiting for events on socket '%s' (%d)", g_mpiSocket, errno);
+                break;
             }
+            continue;
+        }
 
-            if (0 != close(socketHandle))
+        for (i = 0; (i < eventCount) && g_serverActive; i++)
+        {
+            if (&g_wakeupfd == events[i].data.ptr)
             {
-                OsConfigLogError(GetPlatformLog(), "Failed to close socket: path %s, handle '%d'", g_socketaddr.sun_path, socketHandle);
+                break;
             }
-
-            if (IsFullLoggingEnabled())
+            else if (&g_socketfd == events[i].data.ptr)
             {
-                OsConfigLogInfo(GetPlatformLog(), "Closed connection: path %s, handle '%d'", g_socketaddr.sun_path, socketHandle);
+                AcceptConnections();
             }
+            else
+            {
+                EnqueueConnection((MPI_CONNECTION*)events[i].data.ptr);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static bool StartServerThreads(void)
+{
+    struct epoll_event event = {0};
+    int i = 0;
+
+    if (0 > (g_epollfd = epoll_create1(EPOLL_CLOEXEC)))
+    {
+        OsConfigLogError(GetPlatformLog(), "Failed to create epoll instance (%d)", errno);
+        return false;
+    }
+
+    if (0 > (g_wakeupfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)))
+    {
+        OsConfigLogError(GetPlatformLog(), "Failed to create wakeup event (%d)", errno);
+        return false;
+    }
+
+    event.events = EPOLLIN;
+    event.data.ptr = &g_wakeupfd;
+    if (0 != epoll_ctl(g_epollfd, EPOLL_CTL_ADD, g_wakeupfd, &event))
+    {
+        OsConfigLogError(GetPlatformLog(), "Failed to watch wakeup event (%d)", errno);
+        return false;
+    }
 
-            contentLength = 0;
-            responseSize = 0;
-            actualSize = 0;
-            estimatedSize = 0;
+    event.events = EPOLLIN;
+    event.data.ptr = &g_socketfd;
+    if (0 != epoll_ctl(g_epollfd, EPOLL_CTL_ADD, g_socketfd, &event))
+    {
+        OsConfigLogError(GetPlatformLog(), "Failed to watch socket '%s' (%d)", g_mpiSocket, errno);
+        return false;
+    }
 
-            FREE_MEMORY(requestBody);
-            FREE_MEMORY(responseBody);
-            FREE_MEMORY(httpReason);
-            FREE_MEMORY(buffer);
-            FREE_MEMORY(uri);
+    g_readyHead = 0;
+    g_readyCount = 0;
+    g_serverActive = true;
 
-            SleepMilliseconds(MPI_WORKER_SLEEP);
+    for (i = 0; i < MPI_WORKER_THREADS; i++)
+    {
+        if (0 != pthread_create(&g_mpiServerWorkers[i], NULL, MpiServerWorker, NULL))
+        {
+            OsConfigLogError(GetPlatformLog(), "Failed to start MPI worker %d", i);
+            break;
         }
     }
+    g_mpiServerWorkerCount = i;
 
-    return NULL;
+    if ((0 == g_mpiServerWorkerCount) || (0 != pthread_create(&g_mpiServerListener, NULL, MpiServerListener, NULL)))
+    {
+        OsConfigLogError(GetPlatformLog(), "Failed to start MPI listener");
+        return false;
+    }
+
+    g_mpiServerListenerStarted = true;
+
+    OsConfigLogInfo(GetPlatformLog(), "Serving socket '%s' with %d workers", g_mpiSocket, g_mpiServerWorkerCount);
+
+    return true;
+}
+
+static void StopServerThreads(void)
+{
+    uint64_t wakeup = 1;
+    ssize_t writeResult = 0;
+    int i = 0;
+
+    pthread_mutex_lock(&g_readyLock);
+    g_serverActive = false;
+    pthread_cond_broadcast(&g_readyNotEmpty);
+    pthread_mutex_unlock(&g_readyLock);
+
+    if (0 <= g_wakeupfd)
+    {
+        writeResult = write(g_wakeupfd, &wakeup, sizeof(wakeup));
+        UNUSED(writeResult);
+    }
+
+    if (g_mpiServerListenerStarted)
+    {
+        pthread_join(g_mpiServerListener, NULL);
+        g_mpiServerListenerStarted = false;
+    }
+
+    for (i = 0; i < g_mpiServerWorkerCount; i++)
+    {
+        pthread_join(g_mpiServerWorkers[i], NULL);
+    }
+    g_mpiServerWorkerCount = 0;
+
+    for (i = 0; i < MAX_OPEN_CONNECTIONS; i++)
+    {
+        if (g_connections[i].inUse)
+        {
+            ReleaseConnection(&g_connections[i]);
+        }
+    }
+
+    g_readyHead = 0;
+    g_readyCount = 0;
+
+    if (0 <= g_wakeupfd)
+    {
+        close(g_wakeupfd);
+        g_wakeupfd = -1;
+    }
+
+    if (0 <= g_epollfd)
+    {
+        close(g_epollfd);
+        g_epollfd = -1;
+    }
 }
 
 void MpiServerInitialize(void)
@@ -565,7 +1434,7 @@ void MpiServerInitialize(void)
         }
     }
 
-    if (0 <= (g_socketfd = socket(AF_UNIX, SOCK_STREAM, 0)))
+    if (0 <= (g_socketfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)))
     {
         memset(&g_socketaddr, 0, sizeof(g_socketaddr));
         g_socketaddr.sun_family = AF_UNIX;
@@ -583,8 +1452,10 @@ void MpiServerInitialize(void)
             {
                 OsConfigLogInfo(GetPlatformLog(), "Listening on socket '%s'", g_mpiSocket);
 
-                g_serverActive = true;
-                g_mpiServerWorker = pthread_create(&g_mpiServerWorker, NULL, MpiServerWorker, NULL);
+                if (!StartServerThreads())
+                {
+                    StopServerThreads();
+                }
             }
             else
             {
@@ -604,11 +1475,11 @@ void MpiServerInitialize(void)
 
 void MpiServerShutdown(void)
 {
-    g_serverActive = false;
-    pthread_join(g_mpiServerWorker, NULL);
+    StopServerThreads();
 
     UnloadModules();
 
     close(g_socketfd);
+    g_socketfd = -1;
     unlink(g_mpiSocket);
-}
\ No newline at end of file
+}
@@ -63,15 +63,23 @@ public:
         unsigned int userAccount;
 
         static int Deserialize(const rapidjson::Value& object, Info& info);
+        void Serialize(rapidjson::Writer<rapidjson::StringBuffer>& writer) const;
     };
 
     ManagementModule();
     ManagementModule(const std::string path);
+
+    // Module described by a cached MmiGetInfo result, the library is only loaded by Load() or by the first MMI call
+    ManagementModule(const std::string path, const Info& info);
     virtual ~ManagementModule();
 
     virtual int Load();
     virtual void Unload();
 
+    // Unloads the library when no MMI call was made for idleTimeout, the next call loads it again
+    bool UnloadIfIdle(std::chrono::seconds idleTimeout);
+    bool IsLoaded();
+
     Info GetInfo() const;
 
 protected:
@@ -90,6 +98,21 @@ protected:
 
     Info m_info;
 
+    // Serializes MMI calls into this module across all sessions, modules are not required to be thread-safe
+    std::mutex m_mmiMutex;
+
+    // MMI sessions opened on the loaded library, closed before it is unloaded.
+    // The load count is bumped by every unload so sessions holding an older handle open a new one.
+    std::set<MMI_HANDLE> m_mmiHandles;
+    unsigned long long m_loadCount;
+    std::chrono::steady_clock::time_point m_lastCallTime;
+
+    // Callers hold m_mmiMutex
+    int LoadLibrary();
+    void UnloadLibrary();
+    bool IsLibraryLoaded() const;
+    const char* GetMetricsName() const;
+
     virtual int CallMmiGetInfo(const char* clientName, MMI_JSON_STRING* payload, int* payloadSizeBytes);
     virtual MMI_HANDLE CallMmiOpen(const char* componentName, unsigned int maxPayloadSizeBytes);
     virtual void CallMmiClose(MMI_HANDLE handle);
@@ -108,7 +131,8 @@ public:
     int Open();
     void Close();
 
-    int Set(const char* componentName, const char* objectName, const MMI_JSON_STRING payload, const int payloadSizeBytes);
+    // isValidated skips the payload schema check when the caller already validated the payload while parsing it
+    int Set(const char* componentName, const char* objectName, const MMI_JSON_STRING payload, const int payloadSizeBytes, bool isValidated = false);
     int Get(const char* componentName, const char* objectName, MMI_JSON_STRING *payload, int *payloadSizeBytes);
 
     ManagementModule::Info GetInfo();
@@ -118,6 +142,15 @@ private:
     std::shared_ptr<ManagementModule> m_module;
 
     MMI_HANDLE m_mmiHandle;
+    bool m_isOpen;
+
+    // Load of the module the handle was opened on, see ManagementModule::m_loadCount
+    bool m_isHandleOpen;
+    unsigned long long m_loadCount;
+
+    // Callers hold the module's m_mmiMutex
+    void OpenHandle();
+    int AcquireHandle();
 };
 
 #endif // MANAGEMENTMODULE_H
\ No newline at end of file
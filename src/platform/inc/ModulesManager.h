@@ -4,22 +4,86 @@
 #ifndef MODULESMANAGER_H
 #define MODULESMANAGER_H
 
+// Immutable routing of component names to dense module indexes, rebuilt whenever the set of modules changes.
+// The names live in a flat open addressing table at most half full, a lookup hashes the name once and usually compares one entry.
+class ComponentRoutes
+{
+public:
+    ComponentRoutes();
+    ComponentRoutes(const std::map<std::string, std::shared_ptr<ManagementModule>>& modules, const std::map<std::string, std::string>& moduleComponentName);
+
+    // Index of the module that serves the component, -1 when none does
+    int Find(const char* componentName) const;
+
+    size_t GetModuleCount() const;
+    const std::shared_ptr<ManagementModule>& GetModule(size_t index) const;
+    const std::string& GetModuleName(size_t index) const;
+
+private:
+    struct Route
+    {
+        std::string componentName;
+        size_t hash = 0;
+        int moduleIndex = -1;
+    };
+
+    std::vector<Route> m_routes;
+    std::vector<std::shared_ptr<ManagementModule>> m_modules;
+    std::vector<std::string> m_moduleNames;
+
+    static size_t Hash(const char* name, size_t& length);
+};
+
 class ModulesManager
 {
 public:
     ModulesManager();
     ~ModulesManager();
 
-    int LoadModules(std::string modulePath, std::string configJson);
+    // The MmiGetInfo results of the modules are kept in moduleInfoCache when set, modules found there are not loaded to learn their components
+    int LoadModules(std::string modulePath, std::string configJson, std::string moduleInfoCache = "");
     void UnloadModules();
 
+    // Unloads the short lived modules not called for the configured idle time, they are loaded again by their next call
+    void UnloadIdleModules();
+
+    // Number of reads of cacheable reported objects served from the cache (hits) or from the module (misses)
+    unsigned long long GetReportedCacheHits() const;
+    unsigned long long GetReportedCacheMisses() const;
+
 protected:
+    struct ReportedCacheEntry
+    {
+        std::string payload;
+        unsigned int maxPayloadSizeBytes;
+        std::chrono::steady_clock::time_point expiry;
+    };
+
     std::map<std::string, std::vector<std::string>> m_reportedComponents;
     std::map<std::string, std::string> m_moduleComponentName;
     std::map<std::string, std::shared_ptr<ManagementModule>> m_modules;
+    std::chrono::seconds m_moduleIdleTimeout;
+
+    // Snapshot taken by each session when it opens, accessed with std::atomic_load/atomic_store
+    std::shared_ptr<const ComponentRoutes> m_componentRoutes;
+
+    // Time to live of cached reported objects per component and object, objects without one are not cached
+    std::map<std::string, std::map<std::string, std::chrono::seconds>> m_reportedCacheTtl;
+    std::map<std::pair<std::string, std::string>, ReportedCacheEntry> m_reportedCache;
+
+    // Bumped by every set to a component, a read that started before a set does not fill the cache
+    std::map<std::string, unsigned long long> m_componentGenerations;
+    std::mutex m_reportedCacheMutex;
+    std::atomic<unsigned long long> m_reportedCacheHits;
+    std::atomic<unsigned long long> m_reportedCacheMisses;
 
     int SetReportedObjects(const std::string& configJson);
     void RegisterModuleComponents(const std::string& moduleName, const std::vector<std::string>& components, bool replace = false);
+    void BuildComponentRoutes();
+
+    bool GetCachedObject(const std::string& componentName, const std::string& objectName, unsigned int maxPayloadSizeBytes, std::string& payload, unsigned long long& generation);
+    void CacheObject(const std::string& componentName, const std::string& objectName, unsigned int maxPayloadSizeBytes, const std::string& payload, unsigned long long generation);
+    void InvalidateCachedObjects(const std::string& componentName);
 
     friend class MpiSession;
 };
@@ -30,8 +94,6 @@ public:
     MpiSession(ModulesManager& modulesManager, std::string clientName, const unsigned int maxPayloadSizeBytes = 0);
     ~MpiSession();
 
-    char* GetUuid();
-
     int Open();
     void Close();
 
@@ -42,14 +104,18 @@ public:
 
 private:
     ModulesManager& m_modulesManager;
-    std::string m_uuid;
     std::string m_clientName;
     unsigned int m_maxPayloadSizeBytes;
 
-    std::map<std::string, std::shared_ptr<MmiSession>> m_mmiSessions;
-    std::shared_ptr<MmiSession> GetSession(const std::string& componentName);
+    // Serializes calls made on this session
+    std::mutex m_mutex;
+
+    // MMI sessions indexed like the modules of the routes the session was opened with
+    std::shared_ptr<const ComponentRoutes> m_componentRoutes;
+    std::vector<std::shared_ptr<MmiSession>> m_mmiSessions;
+    std::shared_ptr<MmiSession> GetSession(const char* componentName);
 
-    int SetDesiredPayload(rapidjson::Document& document);
+    int SetDesiredPayload(char* payload, int payloadSizeBytes);
     int GetReportedPayload(MPI_JSON_STRING* payload, int* payloadSizeBytes);
 };
 
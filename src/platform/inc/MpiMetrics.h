@@ -0,0 +1,42 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef MPI_METRICS_H
+#define MPI_METRICS_H
+
+#include <stdbool.h>
+
+#define MPI_METRICS_FILE "/run/osconfig/osconfig_metrics.json"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Where a call was timed: the MPI request served over the socket, the MPI session call, or the MMI call into the module
+typedef enum MPI_METRICS_LAYER
+{
+    MPI_METRICS_SERVER = 0,
+    MPI_METRICS_SESSION,
+    MPI_METRICS_MODULE
+} MPI_METRICS_LAYER;
+
+// Monotonic time in microseconds, taken before a call and passed to RecordMpiMetrics after it
+unsigned long long GetMpiMetricsTime(void);
+
+// Counts the call, an error when status is not 0, and its latency since startTime. Lock-free and allocation free,
+// component and object names may be null
+void RecordMpiMetrics(MPI_METRICS_LAYER layer, const char* call, const char* componentName, const char* objectName, int status, unsigned long long startTime);
+
+// Counts a lookup in the reported object cache of the modules manager, served from the cache when hit
+void RecordMpiCacheMetrics(bool hit);
+
+// The recorded metrics as a JSON object, the caller frees it with json_free_serialized_string
+char* GetMpiMetrics(void);
+int SaveMpiMetrics(const char* fileName);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MPI_METRICS_H
@@ -14,6 +14,9 @@
 #define MPI_GET_URI "MpiGet"
 #define MPI_SET_DESIRED_URI "MpiSetDesired"
 #define MPI_GET_REPORTED_URI "MpiGetReported"
+#define MPI_GET_MANY_URI "MpiGetMany"
+#define MPI_SET_MANY_URI "MpiSetMany"
+#define MPI_GET_METRICS_URI "MpiGetMetrics"
 
 #ifdef __cplusplus
 extern "C"
@@ -19,6 +19,7 @@
 #include <signal.h>
 #include <time.h>
 #include <version.h>
+#include <sys/random.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
@@ -41,6 +42,7 @@
 #include <set>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <cinttypes>
 #include <condition_variable>
 #include <cstring>
@@ -63,6 +65,8 @@
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
+#include <MimObjectSchema.h>
+
 #endif //#ifdef __cplusplus
 
 #ifdef __cplusplus
@@ -22,9 +22,11 @@ namespace Tests
         {
             m_moduleComponentName[component] = info.name;
         }
+
+        BuildComponentRoutes();
     }
 
-    void MockModulesManager::AddReportedObject(std::string componentName, std::string objectName)
+    void MockModulesManager::AddReportedObject(std::string componentName, std::string objectName, unsigned int cacheTtlSeconds)
     {
         if (m_reportedComponents.find(componentName) == m_reportedComponents.end())
         {
@@ -32,5 +34,20 @@ namespace Tests
         }
 
         m_reportedComponents[componentName].push_back(objectName);
+
+        if (0 < cacheTtlSeconds)
+        {
+            m_reportedCacheTtl[componentName][objectName] = std::chrono::seconds(cacheTtlSeconds);
+        }
+    }
+
+    bool MockModulesManager::IsModuleLoaded(std::string moduleName)
+    {
+        return (m_modules.find(moduleName) != m_modules.end()) && m_modules[moduleName]->IsLoaded();
+    }
+
+    void MockModulesManager::SetModuleIdleTimeout(unsigned int idleTimeoutSeconds)
+    {
+        m_moduleIdleTimeout = std::chrono::seconds(idleTimeoutSeconds);
     }
 } // namespace Tests
\ No newline at end of file
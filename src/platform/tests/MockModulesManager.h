@@ -17,8 +17,12 @@ namespace Tests
         // Helper method to "load" mock modules into the ModulesManager
         void Load(std::shared_ptr<ManagementModule> module);
 
-        // Helper method to add reported objects to the ModulesManager
-        void AddReportedObject(std::string componentName, std::string objectName);
+        // Helper method to add reported objects to the ModulesManager, a non-zero time to live caches the object
+        void AddReportedObject(std::string componentName, std::string objectName, unsigned int cacheTtlSeconds = 0);
+
+        // Helper methods to observe and drive the loading of short lived modules
+        bool IsModuleLoaded(std::string moduleName);
+        void SetModuleIdleTimeout(unsigned int idleTimeoutSeconds);
     };
 } // namespace Tests
 
@@ -4,10 +4,12 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <rapidjson/document.h>
+#include <parson.h>
 
 #include <PlatformCommon.h>
 #include <ManagementModule.h>
 #include <ModulesManager.h>
+#include <MpiMetrics.h>
 #include <MockManagementModule.h>
 #include <MockModulesManager.h>
 #include <CommonTests.h>
@@ -101,6 +103,76 @@ namespace Tests
         EXPECT_EQ(strlen(expected), payloadSizeBytes);
     }
 
+    static double GetReportedCacheMetric(const char* name)
+    {
+        rapidjson::Document document;
+        double value = -1;
+        char* metrics = GetMpiMetrics();
+
+        if ((nullptr != metrics) && !document.Parse(metrics).HasParseError() && document.HasMember("ReportedCache") && document["ReportedCache"].HasMember(name))
+        {
+            value = document["ReportedCache"][name].GetDouble();
+        }
+
+        json_free_serialized_string(metrics);
+        return value;
+    }
+
+    TEST_F(ModuleManagerTests, MpiGetCachedObject)
+    {
+        int payloadSizeBytes = 0;
+        MMI_JSON_STRING payload = nullptr;
+        char expected[] = "\"expected\"";
+        double hits = GetReportedCacheMetric("Hits");
+        double misses = GetReportedCacheMetric("Misses");
+
+        m_mockModuleManager->AddReportedObject(m_defaultComponent, m_defaultObject, 60);
+
+        EXPECT_CALL(*m_mockModule, CallMmiGet(_, StrEq(m_defaultComponent), StrEq(m_defaultObject), _, _)).Times(1).WillOnce(DoAll(SetArgPointee<3>(expected), SetArgPointee<4>(strlen(expected)), Return(MMI_OK)));
+
+        EXPECT_EQ(MPI_OK, m_mpiSession->Get(m_defaultComponent, m_defaultObject, &payload, &payloadSizeBytes));
+        EXPECT_STREQ(expected, payload);
+
+        // Served from the cache, the module is not called again
+        EXPECT_EQ(MPI_OK, m_mpiSession->Get(m_defaultComponent, m_defaultObject, &payload, &payloadSizeBytes));
+        EXPECT_EQ(strlen(expected), payloadSizeBytes);
+        EXPECT_EQ(0, strncmp(expected, payload, payloadSizeBytes));
+        delete[] payload;
+
+        EXPECT_EQ(1, m_mockModuleManager->GetReportedCacheHits());
+        EXPECT_EQ(1, m_mockModuleManager->GetReportedCacheMisses());
+
+        // Also served with the MPI metrics
+        EXPECT_EQ(hits + 1, GetReportedCacheMetric("Hits"));
+        EXPECT_EQ(misses + 1, GetReportedCacheMetric("Misses"));
+    }
+
+    TEST_F(ModuleManagerTests, MpiSetInvalidatesCachedObject)
+    {
+        int payloadSizeBytes = 0;
+        MMI_JSON_STRING payload = nullptr;
+        char expected_1[] = "\"expected_1\"";
+        char expected_2[] = "\"expected_2\"";
+
+        m_mockModuleManager->AddReportedObject(m_defaultComponent, m_defaultObject, 60);
+
+        EXPECT_CALL(*m_mockModule, CallMmiGet(_, StrEq(m_defaultComponent), StrEq(m_defaultObject), _, _)).Times(2)
+            .WillOnce(DoAll(SetArgPointee<3>(expected_1), SetArgPointee<4>(strlen(expected_1)), Return(MMI_OK)))
+            .WillOnce(DoAll(SetArgPointee<3>(expected_2), SetArgPointee<4>(strlen(expected_2)), Return(MMI_OK)));
+        EXPECT_CALL(*m_mockModule, CallMmiSet(_, StrEq(m_defaultComponent), StrEq(m_defaultObject), _, m_defaultPayloadSize)).Times(1).WillOnce(Return(MMI_OK));
+
+        EXPECT_EQ(MPI_OK, m_mpiSession->Get(m_defaultComponent, m_defaultObject, &payload, &payloadSizeBytes));
+        EXPECT_STREQ(expected_1, payload);
+
+        EXPECT_EQ(MPI_OK, m_mpiSession->Set(m_defaultComponent, m_defaultObject, m_defaultPayload, m_defaultPayloadSize));
+
+        EXPECT_EQ(MPI_OK, m_mpiSession->Get(m_defaultComponent, m_defaultObject, &payload, &payloadSizeBytes));
+        EXPECT_STREQ(expected_2, payload);
+
+        EXPECT_EQ(0, m_mockModuleManager->GetReportedCacheHits());
+        EXPECT_EQ(2, m_mockModuleManager->GetReportedCacheMisses());
+    }
+
     TEST_F(ModuleManagerTests, MpiGetInvalidComponentName)
     {
         int payloadSizeBytes = 0;
@@ -219,6 +291,38 @@ namespace Tests
         EXPECT_EQ(MPI_OK, mpiSession->SetDesired(payload, strlen(payload)));
     }
 
+    TEST_F(ModuleManagerTests, MpiSetDesiredObjectPayloads)
+    {
+        const char componentName[] = "component";
+        const char objectName_1[] = "object_1";
+        const char objectName_2[] = "object_2";
+        const char objectName_3[] = "object_3";
+        char value_1[] = "{\"key1\": \"value1\",\n                        \"key2\": null}";
+        char value_2[] = "[1, 2]";
+        char payload[] = R""""(
+            {
+                "component": {
+                    "object_1": {"key1": "value1",
+                        "key2": null},
+                    "object_2":[1, 2],
+                    "object_3": ["value", 1]
+                }
+            })"""";
+
+        std::shared_ptr<MockManagementModule> mockModule = std::make_shared<MockManagementModule>("mockModule", std::vector<std::string>({componentName}));
+        m_mockModuleManager->Load(mockModule);
+
+        std::shared_ptr<MpiSession> mpiSession = std::make_shared<MpiSession>(*m_mockModuleManager, m_defaultClient);
+        EXPECT_EQ(0, mpiSession->Open());
+
+        // Objects reach the module as they appear in the payload, an object that fails the MIM schema does not reach it
+        EXPECT_CALL(*mockModule, CallMmiSet(_, StrEq(componentName), StrEq(objectName_1), StrEq(value_1), strlen(value_1))).Times(1).WillOnce(Return(MMI_OK));
+        EXPECT_CALL(*mockModule, CallMmiSet(_, StrEq(componentName), StrEq(objectName_2), StrEq(value_2), strlen(value_2))).Times(1).WillOnce(Return(MMI_OK));
+        EXPECT_CALL(*mockModule, CallMmiSet(_, StrEq(componentName), StrEq(objectName_3), _, _)).Times(0);
+
+        EXPECT_EQ(MPI_OK, mpiSession->SetDesired(payload, strlen(payload)));
+    }
+
     TEST_F(ModuleManagerTests, MpiSetDesiredInvalidJsonPayload)
     {
         char invalid[] = "invalid";
@@ -342,6 +446,44 @@ namespace Tests
         EXPECT_TRUE(JSON_EQ(expected, actual));
     }
 
+    TEST_F(ModuleManagerTests, MpiGetReportedCachedObject)
+    {
+        const char componentName[] = "component";
+        const char objectName[] = "object";
+        char value[] = "\"value\"";
+        char expected[] = R""""(
+            {
+                "component": {
+                    "object": "value"
+                }
+            })"""";
+
+        MPI_JSON_STRING payload = nullptr;
+        int payloadSizeBytes = 0;
+
+        std::shared_ptr<MockManagementModule> mockModule = std::make_shared<MockManagementModule>("mockModule", std::vector<std::string>({componentName}));
+
+        m_mockModuleManager->Load(mockModule);
+        m_mockModuleManager->AddReportedObject(componentName, objectName, 60);
+
+        std::shared_ptr<MpiSession> mpiSession = std::make_shared<MpiSession>(*m_mockModuleManager, m_defaultClient);
+        EXPECT_EQ(0, mpiSession->Open());
+
+        EXPECT_CALL(*mockModule, CallMmiGet(_, StrEq(componentName), StrEq(objectName), _, _)).Times(1).WillOnce(DoAll(SetArgPointee<3>(value), SetArgPointee<4>(strlen(value)), Return(MMI_OK)));
+
+        for (int i = 0; i < 2; i++)
+        {
+            EXPECT_EQ(MPI_OK, mpiSession->GetReported(&payload, &payloadSizeBytes));
+
+            std::string actual(payload, payloadSizeBytes);
+            EXPECT_TRUE(JSON_EQ(expected, actual));
+            delete[] payload;
+        }
+
+        EXPECT_EQ(1, m_mockModuleManager->GetReportedCacheHits());
+        EXPECT_EQ(1, m_mockModuleManager->GetReportedCacheMisses());
+    }
+
     TEST_F(ModuleManagerTests, MpiGetReportedInvalidPayload)
     {
         int payloadSizeBytes = 0;
@@ -410,6 +552,71 @@ namespace Tests
         EXPECT_TRUE(JSON_EQ(g_multipleObjectsPayload, actual));
     }
 
+    TEST_F(ModuleManagerTests, LoadModulesShortLivedModuleLoadedOnCall)
+    {
+        const char moduleName[] = "Valid Test Module";
+        MPI_JSON_STRING payload = nullptr;
+        int payloadSizeBytes = 0;
+
+        ASSERT_EQ(MPI_OK, m_mockModuleManager->LoadModules(g_moduleDir, g_configJsonSingleReported));
+        EXPECT_FALSE(m_mockModuleManager->IsModuleLoaded(moduleName));
+
+        std::shared_ptr<MpiSession> mpiSession = std::make_shared<MpiSession>(*m_mockModuleManager, m_defaultClient);
+        EXPECT_EQ(0, mpiSession->Open());
+        EXPECT_FALSE(m_mockModuleManager->IsModuleLoaded(moduleName));
+
+        EXPECT_EQ(MPI_OK, mpiSession->SetDesired((MPI_JSON_STRING)g_singleObjectPayload, strlen(g_singleObjectPayload)));
+        EXPECT_TRUE(m_mockModuleManager->IsModuleLoaded(moduleName));
+
+        // Still within the idle time
+        m_mockModuleManager->UnloadIdleModules();
+        EXPECT_TRUE(m_mockModuleManager->IsModuleLoaded(moduleName));
+
+        m_mockModuleManager->SetModuleIdleTimeout(0);
+        m_mockModuleManager->UnloadIdleModules();
+        EXPECT_FALSE(m_mockModuleManager->IsModuleLoaded(moduleName));
+
+        // The session survives the unload and opens a new MMI session on the reloaded module
+        EXPECT_EQ(MPI_OK, mpiSession->GetReported(&payload, &payloadSizeBytes));
+        EXPECT_TRUE(m_mockModuleManager->IsModuleLoaded(moduleName));
+
+        delete[] payload;
+    }
+
+    TEST_F(ModuleManagerTests, LoadModulesCachedModuleInfo)
+    {
+        const char moduleName[] = "Valid Test Module";
+        MPI_JSON_STRING payload = nullptr;
+        int payloadSizeBytes = 0;
+
+        remove(g_moduleInfoCache);
+
+        ASSERT_EQ(MPI_OK, m_mockModuleManager->LoadModules(g_moduleDir, g_configJsonSingleReported, g_moduleInfoCache));
+
+        std::ifstream ifs(g_moduleInfoCache);
+        std::string cache((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        EXPECT_NE(std::string::npos, cache.find(moduleName));
+
+        // Components are routed from the cache, the module is loaded by the first call for one of them
+        std::shared_ptr<MockModulesManager> modulesManager = std::make_shared<MockModulesManager>();
+        ASSERT_EQ(MPI_OK, modulesManager->LoadModules(g_moduleDir, g_configJsonSingleReported, g_moduleInfoCache));
+        EXPECT_FALSE(modulesManager->IsModuleLoaded(moduleName));
+
+        std::shared_ptr<MpiSession> mpiSession = std::make_shared<MpiSession>(*modulesManager, m_defaultClient);
+        EXPECT_EQ(0, mpiSession->Open());
+
+        EXPECT_EQ(MPI_OK, mpiSession->SetDesired((MPI_JSON_STRING)g_singleObjectPayload, strlen(g_singleObjectPayload)));
+        EXPECT_EQ(MPI_OK, mpiSession->GetReported(&payload, &payloadSizeBytes));
+        EXPECT_TRUE(modulesManager->IsModuleLoaded(moduleName));
+
+        std::string actual(payload, payloadSizeBytes);
+        EXPECT_TRUE(JSON_EQ(g_singleObjectPayload, actual));
+
+        delete[] payload;
+        mpiSession.reset();
+        remove(g_moduleInfoCache);
+    }
+
     TEST_F(ModuleManagerTests, LoadModulesInvalidDirectory)
     {
         ASSERT_EQ(ENOENT, m_mockModuleManager->LoadModules("/invalid/path", g_configJsonNoneReported));
@@ -8,6 +8,7 @@
 #include <CommonUtils.h>
 #include <MpiServer.h>
 #include <Mpi.h>
+#include <parson.h>
 
 namespace Tests
 {
@@ -237,7 +238,20 @@ namespace Tests
         std::vector<std::string> requests = {
             "{\"ClientSession\": 123, \"Payload\": {}}",
             "{\"Payload\": {}}",
-            "{\"ClientSession\": \"\"}"
+            "{\"ClientSession\": \"\"}",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": }",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": {\"component\": {}}",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": \"MockPayload}",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": {\"component\": [}}",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": [{\"component\": {}]}",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": {\"component\": {\"object\"}}}",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": {\"component\": {\"object\": }}}",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": {\"component\" {}}}",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": {\"component\": {} \"other\": {}}}",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": {\"component\": {\"object\": tru}}}",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": {\"component\": {\"object\": 1.}}}",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": {\"component\": {\"object\": [1, 2,]}}}",
+            "{\"ClientSession\": \"Valid_Client\", \"Payload\": " + std::string(100, '[') + std::string(100, ']') + "}"
         };
 
         for (auto request : requests)
@@ -330,6 +344,18 @@ namespace Tests
         FREE_MEMORY(response);
     }
 
+    TEST_F(MpiServerTests, MpiSetDesiredRequestPayloadAsSent)
+    {
+        char* response = nullptr;
+        int responseSize = 0;
+
+        // The payload reaches MpiSetDesired exactly as it appears in the request, whatever the member order and spacing
+        EXPECT_EQ(HTTP_OK, HandleMpiCall(MPI_SET_DESIRED_URI, "\r\n{ \"Payload\" :\t\"MockPayload\" ,\n\"Other\": [{\"}\": \"]\"}, 1, null],\"ClientSession\":\"Valid_Client\" }\r\n", &response, &responseSize, g_mpiCalls));
+        EXPECT_EQ(nullptr, response);
+        EXPECT_EQ(0, responseSize);
+        FREE_MEMORY(response);
+    }
+
     TEST_F(MpiServerTests, MpiGetReportedRequest)
     {
         char* response = nullptr;
@@ -340,4 +366,156 @@ namespace Tests
         EXPECT_EQ(strlen(g_mockPayload), responseSize);
         FREE_MEMORY(response);
     }
+
+    TEST_F(MpiServerTests, MpiGetManyRequestInvalidRequestBody)
+    {
+        std::vector<std::string> requests = {
+            "{\"Objects\": []}",
+            "{\"ClientSession\": \"Valid_Client\"}",
+            "{\"ClientSession\": \"Valid_Client\", \"Objects\": {}}",
+            "{\"ClientSession\": \"Valid_Client\", \"Objects\": [123]}",
+            "{\"ClientSession\": \"Valid_Client\", \"Objects\": [{\"ComponentName\": \"Component\"}]}",
+            "{\"ClientSession\": \"Valid_Client\", \"Objects\": [{\"ComponentName\": \"Component\", \"ObjectName\": 123}]}"
+        };
+
+        for (auto request : requests)
+        {
+            char* response = nullptr;
+            int responseSize = 0;
+
+            EXPECT_EQ(HTTP_BAD_REQUEST, HandleMpiCall(MPI_GET_MANY_URI, request.c_str(), &response, &responseSize, g_mpiCalls));
+            EXPECT_EQ(nullptr, response);
+            EXPECT_EQ(0, responseSize);
+            FREE_MEMORY(response);
+        }
+    }
+
+    TEST_F(MpiServerTests, MpiSetManyRequestInvalidRequestBody)
+    {
+        std::vector<std::string> requests = {
+            "{\"Objects\": []}",
+            "{\"ClientSession\": \"Valid_Client\"}",
+            "{\"ClientSession\": \"Valid_Client\", \"Objects\": [{\"ComponentName\": \"Component\", \"ObjectName\": \"Object\"}]}"
+        };
+
+        for (auto request : requests)
+        {
+            char* response = nullptr;
+            int responseSize = 0;
+
+            EXPECT_EQ(HTTP_BAD_REQUEST, HandleMpiCall(MPI_SET_MANY_URI, request.c_str(), &response, &responseSize, g_mpiCalls));
+            EXPECT_EQ(nullptr, response);
+            EXPECT_EQ(0, responseSize);
+            FREE_MEMORY(response);
+        }
+    }
+
+    TEST_F(MpiServerTests, MpiGetManyRequest)
+    {
+        char* response = nullptr;
+        int responseSize = 0;
+
+        const char* request = "{\"ClientSession\": \"Valid_Client\", \"Objects\": ["
+            "{\"ComponentName\": \"Component\", \"ObjectName\": \"Object\"},"
+            "{\"ComponentName\": \"Error_Component\", \"ObjectName\": \"Error_Object\"}]}";
+        const char* expected = "[{\"ComponentName\": \"Component\", \"ObjectName\": \"Object\", \"Status\": 0, \"Payload\": \"MockPayload\"},"
+            "{\"ComponentName\": \"Error_Component\", \"ObjectName\": \"Error_Object\", \"Status\": -1}]";
+
+        EXPECT_EQ(HTTP_OK, HandleMpiCall(MPI_GET_MANY_URI, request, &response, &responseSize, g_mpiCalls));
+        ASSERT_NE(nullptr, response);
+        EXPECT_EQ(strlen(response), responseSize);
+        EXPECT_TRUE(JSON_EQ(expected, response));
+        FREE_MEMORY(response);
+
+        EXPECT_EQ(HTTP_OK, HandleMpiCall(MPI_GET_MANY_URI, "{\"ClientSession\": \"Valid_Client\", \"Objects\": []}", &response, &responseSize, g_mpiCalls));
+        EXPECT_STREQ("[]", response);
+        FREE_MEMORY(response);
+    }
+
+    TEST_F(MpiServerTests, MpiSetManyRequest)
+    {
+        char* response = nullptr;
+        int responseSize = 0;
+
+        const char* request = "{\"ClientSession\": \"Valid_Client\", \"Objects\": ["
+            "{\"ComponentName\": \"Component\", \"ObjectName\": \"Object\", \"Payload\": {\"a\": [1, 2]}},"
+            "{\"ComponentName\": \"Error_Component\", \"ObjectName\": \"Error_Object\", \"Payload\": \"MockPayload\"}]}";
+        const char* expected = "[{\"ComponentName\": \"Component\", \"ObjectName\": \"Object\", \"Status\": 0},"
+            "{\"ComponentName\": \"Error_Component\", \"ObjectName\": \"Error_Object\", \"Status\": -1}]";
+
+        EXPECT_EQ(HTTP_OK, HandleMpiCall(MPI_SET_MANY_URI, request, &response, &responseSize, g_mpiCalls));
+        ASSERT_NE(nullptr, response);
+        EXPECT_EQ(strlen(response), responseSize);
+        EXPECT_TRUE(JSON_EQ(expected, response));
+        FREE_MEMORY(response);
+    }
+
+    TEST_F(MpiServerTests, MpiGetMetricsRequest)
+    {
+        char* response = nullptr;
+        int responseSize = 0;
+        JSON_Value* rootValue = nullptr;
+        JSON_Array* calls = nullptr;
+        JSON_Object* call = nullptr;
+        JSON_Object* latency = nullptr;
+        JSON_Object* metricsCall = nullptr;
+        JSON_Object* errorCall = nullptr;
+        JSON_Object* cache = nullptr;
+        double latencyCount = 0;
+
+        for (int i = 0; i < 2; i++)
+        {
+            EXPECT_EQ(HTTP_OK, HandleMpiCall(MPI_GET_URI, "{\"ClientSession\": \"Valid_Client\", \"ComponentName\": \"Metrics_Component\", \"ObjectName\": \"Metrics_Object\"}", &response, &responseSize, g_mpiCalls));
+            FREE_MEMORY(response);
+        }
+        EXPECT_EQ(HTTP_INTERNAL_SERVER_ERROR, HandleMpiCall(MPI_SET_URI, "{\"ClientSession\": \"Valid_Client\", \"ComponentName\": \"Error_Component\", \"ObjectName\": \"Error_Object\", \"Payload\": {}}", &response, &responseSize, g_mpiCalls));
+        FREE_MEMORY(response);
+
+        // The metrics request needs no session and is not itself recorded
+        EXPECT_EQ(HTTP_OK, HandleMpiCall(MPI_GET_METRICS_URI, "", &response, &responseSize, g_mpiCalls));
+        ASSERT_NE(nullptr, response);
+        EXPECT_EQ(strlen(response), responseSize);
+        ASSERT_NE(nullptr, rootValue = json_parse_string(response));
+        ASSERT_NE(nullptr, calls = json_object_get_array(json_value_get_object(rootValue), "Calls"));
+        ASSERT_NE(nullptr, cache = json_object_get_object(json_value_get_object(rootValue), "ReportedCache"));
+        EXPECT_EQ(JSONNumber, json_value_get_type(json_object_get_value(cache, "Hits")));
+        EXPECT_EQ(JSONNumber, json_value_get_type(json_object_get_value(cache, "Misses")));
+
+        for (size_t i = 0; i < json_array_get_count(calls); i++)
+        {
+            call = json_array_get_object(calls, i);
+            EXPECT_STREQ("Server", json_object_get_string(call, "Layer"));
+            EXPECT_STRNE(MPI_GET_METRICS_URI, json_object_get_string(call, "Call"));
+
+            if ((0 == strcmp(MPI_GET_URI, json_object_get_string(call, "Call"))) && (nullptr != json_object_get_string(call, "ComponentName")) &&
+                (0 == strcmp("Metrics_Component", json_object_get_string(call, "ComponentName"))))
+            {
+                metricsCall = call;
+            }
+            else if ((0 == strcmp(MPI_SET_URI, json_object_get_string(call, "Call"))) && (nullptr != json_object_get_string(call, "ComponentName")) &&
+                (0 == strcmp(g_errorComponent, json_object_get_string(call, "ComponentName"))))
+            {
+                errorCall = call;
+            }
+        }
+
+        ASSERT_NE(nullptr, metricsCall);
+        EXPECT_STREQ("Metrics_Object", json_object_get_string(metricsCall, "ObjectName"));
+        EXPECT_EQ(2, json_object_get_number(metricsCall, "Count"));
+        EXPECT_EQ(0, json_object_get_number(metricsCall, "Errors"));
+        EXPECT_LE(json_object_get_number(metricsCall, "MaxMicroseconds"), json_object_get_number(metricsCall, "TotalMicroseconds"));
+        ASSERT_NE(nullptr, latency = json_object_get_object(metricsCall, "LatencyMicroseconds"));
+        for (size_t i = 0; i < json_object_get_count(latency); i++)
+        {
+            latencyCount += json_value_get_number(json_object_get_value_at(latency, i));
+        }
+        EXPECT_EQ(2, latencyCount);
+
+        ASSERT_NE(nullptr, errorCall);
+        EXPECT_LE(1, json_object_get_number(errorCall, "Errors"));
+        EXPECT_EQ(json_object_get_number(errorCall, "Count"), json_object_get_number(errorCall, "Errors"));
+
+        json_value_free(rootValue);
+        FREE_MEMORY(response);
+    }
 }
\ No newline at end of file
@@ -64,6 +64,67 @@ namespace Tests
         MpiClose(handle2);
     }
 
+    TEST_F(MpiTests, MpiClosedHandleIsInvalid)
+    {
+        char payload[] = "{}";
+        MPI_HANDLE handle1 = MpiOpen(m_defaultClient, 0);
+        ASSERT_NE(nullptr, handle1);
+
+        std::string closedHandle(reinterpret_cast<char*>(handle1));
+        MpiClose(handle1);
+        free(handle1);
+
+        // The slot of the closed session is reused under a different handle
+        MPI_HANDLE handle2 = MpiOpen(m_defaultClient, 0);
+        ASSERT_NE(nullptr, handle2);
+        EXPECT_STRNE(closedHandle.c_str(), reinterpret_cast<char*>(handle2));
+
+        EXPECT_EQ(EINVAL, MpiSetDesired(reinterpret_cast<MPI_HANDLE>(const_cast<char*>(closedHandle.c_str())), payload, strlen(payload)));
+        EXPECT_EQ(MPI_OK, MpiSetDesired(handle2, payload, strlen(payload)));
+
+        MpiClose(handle2);
+        free(handle2);
+    }
+
+    TEST_F(MpiTests, MpiOpenConcurrently)
+    {
+        const int threadCount = 8;
+        const int sessionCount = 100;
+        std::vector<std::thread> threads;
+        std::vector<std::vector<std::string>> handles(threadCount);
+
+        for (int i = 0; i < threadCount; i++)
+        {
+            threads.emplace_back([&handles, i, sessionCount]()
+            {
+                for (int j = 0; j < sessionCount; j++)
+                {
+                    MPI_HANDLE handle = MpiOpen(m_defaultClient, 0);
+                    if (nullptr != handle)
+                    {
+                        handles[i].push_back(reinterpret_cast<char*>(handle));
+                        MpiClose(handle);
+                        free(handle);
+                    }
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        // Every session got a handle of its own even though slots were reused
+        std::set<std::string> uniqueHandles;
+        for (auto& threadHandles : handles)
+        {
+            EXPECT_EQ(sessionCount, static_cast<int>(threadHandles.size()));
+            uniqueHandles.insert(threadHandles.begin(), threadHandles.end());
+        }
+        EXPECT_EQ(threadCount * sessionCount, static_cast<int>(uniqueHandles.size()));
+    }
+
     TEST_F(MpiTests, MpiOpenInvalidClientName)
     {
         ASSERT_EQ(nullptr, MpiOpen(nullptr, 0));